@@ -12,6 +12,23 @@ namespace TestBench
 		public int ftpin;
 	}
 
+	[ComVisible(true), StructLayout(LayoutKind.Sequential, Pack = 4)]
+	public struct gpio_irq_t
+	{
+		public int id;
+	}
+
+	[ComVisible(true)]
+	public enum gpio_irq_event
+	{
+		IRQ_NONE,
+		IRQ_RISE,
+		IRQ_FALL
+	}
+
+	[ComVisible(true), UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+	public delegate void GpioIrqHandler(IntPtr id, gpio_irq_event evt);
+
 	[ComVisible(true), StructLayout(LayoutKind.Sequential, Pack = 4)]
 	public struct analogin_t
 	{
@@ -404,6 +421,10 @@ namespace TestBench
 		void gpio_init_in(ref gpio_t obj, PinName pin);
 		void gpio_init_out(ref gpio_t obj, PinName pin);
 
+		void gpio_irq_init(ref gpio_irq_t obj, PinName pin, [MarshalAs(UnmanagedType.FunctionPtr)]GpioIrqHandler handler, IntPtr id);
+		void gpio_irq_free([In]ref gpio_irq_t obj);
+		void gpio_irq_set([In]ref gpio_irq_t obj, gpio_irq_event evt, int enable);
+
 		void analogout_init(ref dac_t obj, PinName pin);
 		void analogout_write_u16([In]ref dac_t obj, ushort value);
 
@@ -413,6 +434,7 @@ namespace TestBench
 		void analogin_init(ref analogin_t obj, PinName pin);
 		float analogin_read([In]ref analogin_t obj);
 		ushort analogin_read_u16([In]ref analogin_t obj);
+		void analogin_comparator([In]ref analogin_t obj, ushort low, ushort high, [MarshalAs(UnmanagedType.FunctionPtr)]GpioIrqHandler handler, IntPtr id);
 
 		void pwmout_init(ref pwmout_t obj, PinName pin);
 		void pwmout_free([In]ref pwmout_t obj);
@@ -8,6 +8,9 @@
 #include "libMPSSE_spi.h"
 #include "ntshell.h"
 #include "ntopt.h"
+#include "StreamRecord.h"
+#include "FrameBus.h"
+#include "PixelConvert.h"
 #include <queue>
 
 CRITICAL_SECTION hCs;
@@ -165,9 +168,37 @@ typedef struct
 } cmd_table_info_t;
 
 extern "C" int usrcmd_lpt(int argc, char **argv);
+extern "C" int usrcmd_rec(int argc, char **argv);
+extern "C" int usrcmd_face(int argc, char **argv);
+extern "C" int usrcmd_jpeg(int argc, char **argv);
+extern "C" int usrcmd_hr(int argc, char **argv);
+extern "C" int usrcmd_sensor(int argc, char **argv);
+extern "C" int usrcmd_bus(int argc, char **argv);
+extern "C" int usrcmd_zx(int argc, char **argv);
+extern "C" int usrcmd_pix(int argc, char **argv);
+extern "C" int usrcmd_cam(int argc, char **argv);
+extern "C" int usrcmd_thr(int argc, char **argv);
+extern "C" int usrcmd_tnf(int argc, char **argv);
+extern "C" int usrcmd_fus(int argc, char **argv);
+extern "C" int usrcmd_storage(int argc, char **argv);
+extern "C" int usrcmd_upload(int argc, char **argv);
 
 static const cmd_table_t cmdlist[] = {
 	{"lpt", "FLIR Lepton cotrol", usrcmd_lpt },
+	{"rec", "Stream record/replay", usrcmd_rec },
+	{"face", "Face detector model", usrcmd_face },
+	{"jpeg", "JPEG encoder benchmark", usrcmd_jpeg },
+	{"hr", "Heart rate", usrcmd_hr },
+	{"sensor", "Sensor task wakeups", usrcmd_sensor },
+	{"bus", "Camera frame bus", usrcmd_bus },
+	{"zx", "QR code binarizer", usrcmd_zx },
+	{"pix", "Pixel conversion benchmark", usrcmd_pix },
+	{"cam", "Camera ingest", usrcmd_cam },
+	{"thr", "Thermal record", usrcmd_thr },
+	{"tnf", "Thermal noise filter benchmark", usrcmd_tnf },
+	{"fus", "Thermal fusion", usrcmd_fus },
+	{"storage", "Capture storage writes", usrcmd_storage },
+	{"upload", "Upload queue", usrcmd_upload },
 };
 cmd_table_info_t cmd_table_info = { cmdlist, sizeof(cmdlist) / sizeof(cmdlist[0]) };
 
@@ -235,110 +266,321 @@ extern "C" __declspec(dllexport) void Stop(void)
 
 extern "C" __declspec(dllexport) void ARGB8888FromARGB4444(uint32_t *dst, const uint16_t *src, int width, int height)
 {
-	for (int j = 0; j < height; j++) {
-		for (int i = 0; i < width; i++) {
-			uint16_t tmp1 = *src++;
-			uint16_t a = (tmp1 & 0xF000) >> 12;
-			uint16_t r = (tmp1 & 0x0F00) >> 8;
-			uint16_t g = (tmp1 & 0x00F0) >> 4;
-			uint16_t b = (tmp1 & 0x000F);
-			*dst++ = (a << 28) | (a << 24) | (r << 20) | (r << 16) | (g << 12) | (g << 8) | (b << 4) | (b << 0);
-		}
-	}
+	PixelConvert::ToARGB8888(dst, 4 * width, src, 2 * width, width, height, PixelFormat::ARGB4444,
+		PixelConvert::GetNativeSwap(PixelFormat::ARGB4444));
 }
 
 extern "C" __declspec(dllexport) void ARGB8888FromRGB565(uint32_t *dst, const uint16_t *src, int width, int height)
 {
-	for (int j = 0; j < height; j++) {
-		for (int i = 0; i < width; i++) {
-			uint16_t tmp1 = *src++;
-			uint16_t r = (tmp1 & 0xF800) >> 11;
-			uint16_t g = (tmp1 & 0x07E0) >> 5;
-			uint16_t b = (tmp1 & 0x001F);
-			r = (r << 3) | (r >> 2);
-			g = (g << 2) | (g >> 4);
-			b = (b << 3) | (b >> 2);
-			*dst++ = 0xFF000000 | (r << 16) | (g << 8) | (b << 0);
+	PixelConvert::ToARGB8888(dst, 4 * width, src, 2 * width, width, height, PixelFormat::RGB565,
+		PixelConvert::GetNativeSwap(PixelFormat::RGB565));
+}
+
+extern "C" __declspec(dllexport) void ARGB8888FromYCBCR422(uint32_t *dst, const uint16_t *src, int width, int height)
+{
+	PixelConvert::ToARGB8888(dst, 4 * width, src, 2 * width, width, height, PixelFormat::YUYV,
+		PixelConvert::GetNativeSwap(PixelFormat::YUYV));
+}
+
+// 表示レイヤーの設定（graphics_format_t、wr_rd_swa_t）のまま読み出す
+extern "C" __declspec(dllexport) bool ARGB8888FromGraphics(uint32_t *dst, int dst_stride, const void *src, int src_stride,
+	int width, int height, int format, int swa, const uint32_t *clut, int clut_count)
+{
+	if ((format < DisplayBase::GRAPHICS_FORMAT_YCBCR422) || (format > DisplayBase::GRAPHICS_FORMAT_CLUT8))
+		return false;
+
+	return PixelConvert::ToARGB8888(dst, dst_stride, src, src_stride, width, height,
+		PixelFormat::FromGraphics((DisplayBase::graphics_format_t)format), (DisplayBase::wr_rd_swa_t)swa,
+		clut, clut_count);
+}
+
+/*
+ * カメラの取り込み
+ * 読み込みは専用のスレッドで行い、表示の更新では最新のフレームを
+ * フレームバッファの大きさと形式に1パスで縮小・変換するだけにする。
+ */
+class CameraIngest
+{
+public:
+	CameraIngest();
+	~CameraIngest();
+private:
+	cv::VideoCapture _capture;
+	CRITICAL_SECTION _cs;
+	HANDLE _thread;
+	volatile bool _running;
+	cv::Mat _grab;			// 読み込み中
+	cv::Mat _ready;			// 読み込み済みの最新
+	cv::Mat _work;			// 縮小・変換中
+	bool _fresh;
+	uint32_t _grabbed;
+	uint32_t _ingested;
+	uint32_t _dropped;		// 取り込む前に次のフレームで上書きされた数
+	// 統計は全て_csで保護し、camコマンドはまとめて読み出す
+	us_timestamp_t _latencySum;
+	us_timestamp_t _latencyMax;
+	uint32_t _latencyCount;
+	PixelResizer _resizer;
+	static DWORD WINAPI GrabThread(LPVOID param);
+	void Grab();
+public:
+	bool Open(int index);
+	void Release();
+	bool Capture(void *dst, int stride, int width, int height, DisplayBase::video_format_t format);
+	void PrintStats();
+};
+
+static CameraIngest *cameraIngest;
+
+CameraIngest::CameraIngest() :
+	_thread(NULL),
+	_running(false),
+	_fresh(false),
+	_grabbed(0),
+	_ingested(0),
+	_dropped(0),
+	_latencySum(0),
+	_latencyMax(0),
+	_latencyCount(0)
+{
+	InitializeCriticalSection(&_cs);
+}
+
+CameraIngest::~CameraIngest()
+{
+	Release();
+	DeleteCriticalSection(&_cs);
+	if (cameraIngest == this)
+		cameraIngest = NULL;
+}
+
+bool CameraIngest::Open(int index)
+{
+	if (!_capture.open(index))
+		return false;
+
+	_running = true;
+	_thread = CreateThread(NULL, 0, GrabThread, (LPVOID)this, 0, NULL);
+	if (_thread == NULL) {
+		_running = false;
+		_capture.release();
+		return false;
+	}
+	cameraIngest = this;
+
+	return true;
+}
+
+void CameraIngest::Release()
+{
+	if (_thread != NULL) {
+		_running = false;
+		WaitForSingleObject(_thread, INFINITE);
+		CloseHandle(_thread);
+		_thread = NULL;
+	}
+	_capture.release();
+}
+
+DWORD WINAPI CameraIngest::GrabThread(LPVOID param)
+{
+	((CameraIngest *)param)->Grab();
+	return 0;
+}
+
+void CameraIngest::Grab()
+{
+	while (_running) {
+		// 同じ大きさなら前のフレームの領域に読み込まれる
+		if (!_capture.read(_grab)) {
+			Sleep(10);
+			continue;
 		}
+
+		EnterCriticalSection(&_cs);
+		std::swap(_grab, _ready);
+		if (_fresh)
+			_dropped++;
+		_fresh = true;
+		_grabbed++;
+		LeaveCriticalSection(&_cs);
 	}
 }
 
-#define _DEBUG_TEST
+bool CameraIngest::Capture(void *dst, int stride, int width, int height, DisplayBase::video_format_t format)
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+	PixelFormat::T pixel_format;
+	StreamVideoFormat::T stream_format;
+
+	switch (format) {
+	case DisplayBase::VIDEO_FORMAT_RGB565:
+		pixel_format = PixelFormat::RGB565;
+		stream_format = StreamVideoFormat::RGB565;
+		break;
+	case DisplayBase::VIDEO_FORMAT_RGB888:
+		pixel_format = PixelFormat::ARGB8888;
+		stream_format = StreamVideoFormat::YCbCr422;
+		break;
+	default:
+		pixel_format = PixelFormat::YUYV;
+		stream_format = StreamVideoFormat::YCbCr422;
+		break;
+	}
 
-extern "C" __declspec(dllexport) void ARGB8888FromYCBCR422(uint32_t *dst, const uint16_t *src, int width, int height)
+	// 新しいフレームが無ければ前の画像のままにして待たない
+	EnterCriticalSection(&_cs);
+	if (!_fresh) {
+		LeaveCriticalSection(&_cs);
+		return false;
+	}
+	std::swap(_ready, _work);
+	_fresh = false;
+	LeaveCriticalSection(&_cs);
+
+	if (_work.type() != CV_8UC3)
+		return false;
+
+	us_timestamp_t start = ticker_read_us(ticker);
+	if (!_resizer.FromBGR888(dst, stride, pixel_format, width, height,
+		_work.data, (int)_work.step, _work.cols, _work.rows))
+		return false;
+	us_timestamp_t latency = ticker_read_us(ticker) - start;
+
+	EnterCriticalSection(&_cs);
+	_ingested++;
+	_latencySum += latency;
+	_latencyCount++;
+	if (_latencyMax < latency)
+		_latencyMax = latency;
+	LeaveCriticalSection(&_cs);
+
+	// RGB888は記録・配信の対象外
+	if (format != DisplayBase::VIDEO_FORMAT_RGB888) {
+		if (streamRecorder.IsRecording()) {
+			streamRecorder.WriteVideo(dst, width, height, stride, stream_format);
+		}
+
+		frameBus.Publish(dst, width, height, stride, stream_format);
+	}
+
+	return true;
+}
+
+void CameraIngest::PrintStats()
 {
-#ifndef _DEBUG_TEST
-	//cv::hal::cvtOnePlaneYUVtoBGR((const uchar *)src, 2 * width, (uchar *)dst, 4 * width, width, height, 4, false, 0, 0);
-	cv::Mat srcMat(width, height, CV_16UC1, (void *)src);
-	cv::Mat dstMat(width, height, CV_8UC4, (void *)dst);
-	cv::cvtColor(srcMat, dstMat, cv::COLOR_BGR2YCrCb);
-#else
-	ARGB8888FromRGB565(dst, src, width, height);
-#endif
+	// printfの前に一度に写し取り、読み出しと同時に0に戻して次の表示までの区間で測り直す
+	EnterCriticalSection(&_cs);
+	int cols = _work.cols, rows = _work.rows;
+	uint32_t grabbed = _grabbed, ingested = _ingested, dropped = _dropped;
+	us_timestamp_t sum = _latencySum, max = _latencyMax;
+	uint32_t count = _latencyCount;
+	_latencySum = 0;
+	_latencyMax = 0;
+	_latencyCount = 0;
+	LeaveCriticalSection(&_cs);
+
+	printf("%dx%d, grabbed %lu, ingested %lu, dropped %lu\n", cols, rows, grabbed, ingested, dropped);
+	if (count > 0) {
+		printf("ingest %.2f ms (max %.2f ms), %s\n", sum / 1000.0 / count,
+			max / 1000.0, PixelConvert::GetKernelName());
+	}
+}
+
+extern "C" int usrcmd_cam(int argc, char **argv)
+{
+	if (cameraIngest == NULL) {
+		printf("camera not opened\n");
+		return 0;
+	}
+
+	cameraIngest->PrintStats();
+
+	return 0;
 }
 
 extern "C" __declspec(dllexport) void *videoio_VideoCapture_new1()
 {
-	return new cv::VideoCapture();
+	return new CameraIngest();
 }
 
 extern "C" __declspec(dllexport) bool videoio_VideoCapture_open2(void *ptr, int index)
 {
-	return ((cv::VideoCapture *)ptr)->open(index);
+	return ((CameraIngest *)ptr)->Open(index);
 }
 
 extern "C" __declspec(dllexport) void videoio_VideoCapture_release(void *ptr)
 {
-	((cv::VideoCapture *)ptr)->release();
+	((CameraIngest *)ptr)->Release();
 }
 
 extern "C" __declspec(dllexport) void videoio_VideoCapture_delete(void *ptr)
 {
-	delete (cv::VideoCapture *)ptr;
+	delete (CameraIngest *)ptr;
 }
 
-extern "C" __declspec(dllexport) bool VideoCapture_Capture(void *ptr, void *_dst, int width, int height)
+/*
+ * 記録したフレームをビデオレイヤーのstrideと形式で書き込む
+ * 記録より大きいレイヤーでは左上だけを書き換える。
+ */
+static bool ReplayVideo(void *dst, int stride, int width, int height, DisplayBase::video_format_t format)
 {
-	cv::VideoCapture *vc = (cv::VideoCapture *)ptr;
+	static cv::Mat argb, bgr;
+	const uint8_t *src;
+	const StreamVideoInfo *info = streamReplay.ReadVideo(&src);
+	PixelFormat::T src_format, dst_format;
+	StreamVideoFormat::T stream_format;
 
-	cv::Mat image;
-	if (!vc->read(image)) {
+	if (info == NULL)
 		return false;
+
+	src_format = (info->format == StreamVideoFormat::RGB565) ? PixelFormat::RGB565 : PixelFormat::YUYV;
+	int w = std::min<int>(info->width, width);
+	int h = std::min<int>(info->height, height);
+
+	switch (format) {
+	case DisplayBase::VIDEO_FORMAT_RGB888:
+		// RGB888は記録・配信の対象外
+		return PixelConvert::ToARGB8888((uint32_t *)dst, stride, src, info->stride, w, h,
+			src_format, PixelConvert::GetNativeSwap(src_format));
+	case DisplayBase::VIDEO_FORMAT_RGB565:
+		dst_format = PixelFormat::RGB565;
+		stream_format = StreamVideoFormat::RGB565;
+		break;
+	default:
+		dst_format = PixelFormat::YUYV;
+		stream_format = StreamVideoFormat::YCbCr422;
+		break;
 	}
 
-	//cv::Mat rszimg(width, height, image.type(), _dst);
-	//cv::resize(image, dstMat, cv::Size(width, height),
-	//	(double)width / (double)image.rows,
-	//	(double)height / (double)image.cols);
-	cv::Mat rszimg(width, height, image.type());
-	cv::resize(image, rszimg, cv::Size(width, height));
-
-	//memcpy(dst, rszimg.data, width * height * 2);
-	if (rszimg.type() == CV_8UC3) {
-#ifndef _DEBUG_TEST
-		//cv::hal::cvtBGRtoYUV((uchar *)rszimg.data, 3 * width, (uchar *)_dst, 2 * width, width, height, CV_MAT_DEPTH(rszimg.type()), CV_MAT_CN(rszimg.type()), false, true);
-		cv::Mat dstMat(width, height, CV_16UC1, _dst);
-		cv::cvtColor(rszimg, dstMat, cv::COLOR_BGR2YCrCb);
-#else
-		uint16_t *dst = (uint16_t *)_dst;
-		uint8_t *src = (uint8_t *)rszimg.data;
-		for (int j = 0; j < height; j++) {
-			for (int i = 0; i < width; i++) {
-				uint16_t b = (*src++) >> (8 - 5);
-				uint16_t g = (*src++) >> (8 - 6);
-				uint16_t r = (*src++) >> (8 - 5);
-				*dst++ = (r << 11) | (g << 5) | (b << 0);
-			}
-		}
-#endif
+	if (dst_format == src_format) {
+		for (int y = 0; y < h; y++)
+			memcpy(&((uint8_t *)dst)[y * stride], &src[y * info->stride], w * 2);
+	}
+	else {
+		// 記録と形式が違えばARGB8888とBGRを経由して変換する
+		argb.create(h, w, CV_8UC4);
+		if (!PixelConvert::ToARGB8888((uint32_t *)argb.data, (int)argb.step, src, info->stride, w, h,
+			src_format, PixelConvert::GetNativeSwap(src_format)))
+			return false;
+		cv::cvtColor(argb, bgr, cv::COLOR_BGRA2BGR);
+		if (!PixelConvert::FromBGR888(dst, stride, dst_format, bgr.data, (int)bgr.step, w, h))
+			return false;
 	}
 
-	//cv::Mat dstMat(width, height, CV_16UC1, _dst);
-	//image.convertTo(dstMat, image.type());
+	frameBus.Publish(dst, w, h, stride, stream_format);
 
 	return true;
 }
 
+extern "C" __declspec(dllexport) bool VideoCapture_Capture(void *ptr, void *dst, int stride, int width, int height, int format)
+{
+	if (streamReplay.IsActive())
+		return ReplayVideo(dst, stride, width, height, (DisplayBase::video_format_t)format);
+
+	return ((CameraIngest *)ptr)->Capture(dst, stride, width, height, (DisplayBase::video_format_t)format);
+}
+
 #include <mmdeviceapi.h>
 #include <audioclient.h>
 #include <avrt.h>
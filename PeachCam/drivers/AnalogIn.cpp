@@ -13,4 +13,17 @@ float AnalogIn::read()
 	return TestBench->analogin_read(&analogin);
 }
 
+void AnalogIn::comparator(float low, float high, Callback<void(int)> func)
+{
+	_compare = func;
+	TestBench->analogin_comparator(&analogin, (uint16_t)(low * 0xFFFF), (uint16_t)(high * 0xFFFF),
+		(intptr_t)&AnalogIn::compare_handler, (intptr_t)this);
+}
+
+void AnalogIn::compare_handler(AnalogIn *self, gpio_irq_event event)
+{
+	if (self->_compare)
+		self->_compare(event == IRQ_RISE ? 1 : 0);
+}
+
 }
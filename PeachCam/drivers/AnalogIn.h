@@ -3,6 +3,7 @@
 #define _ANALOGIN_H_
 
 #include "PinNames.h"
+#include "platform/Callback.h"
 
 namespace mbed {
 
@@ -11,12 +12,16 @@ class AnalogIn
 public:
 	AnalogIn(PinName pin);
 	float read();
+	/* 値がhighを上回ったら1、lowを下回ったら0でfuncを呼ぶ */
+	void comparator(float low, float high, Callback<void(int)> func);
 
 	operator float() {
 		return read();
 	}
 private:
 	analogin_t analogin;
+	Callback<void(int)> _compare;
+	static void compare_handler(AnalogIn *self, gpio_irq_event event);
 };
 
 }
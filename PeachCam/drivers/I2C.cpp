@@ -9,6 +9,8 @@ namespace mbed {
 extern uint8 ft_pin_mode;
 extern uint8 ft_pin_onoff;
 
+SingletonPtr<PlatformMutex> I2C::_mutex;
+
 I2C::I2C(PinName sda, PinName scl) :
 	i2c(), sda(sda), scl(scl), hz(100000), wait(10)
 {
@@ -33,6 +35,17 @@ void I2C::frequency(int hz)
 }
 
 int I2C::read(int address, char *data, int length, bool repeated)
+{
+	int ret;
+
+	lock();
+	ret = transfer_read(address, data, length, repeated);
+	unlock();
+
+	return ret;
+}
+
+int I2C::transfer_read(int address, char *data, int length, bool repeated)
 {
 	if (i2c.fthandle == NULL) {
 		return TestBench->i2c_read(&i2c, address, (unsigned char *)data, length, repeated);
@@ -102,6 +115,17 @@ int I2C::read(int ack)
 }
 
 int I2C::write(int address, const char *data, int length, bool repeated)
+{
+	int ret;
+
+	lock();
+	ret = transfer_write(address, data, length, repeated);
+	unlock();
+
+	return ret;
+}
+
+int I2C::transfer_write(int address, const char *data, int length, bool repeated)
 {
 	if (i2c.fthandle == NULL) {
 		return TestBench->i2c_write(&i2c, address, (unsigned char *)data, length, repeated);
@@ -211,10 +235,12 @@ void I2C::PPinLow(int pin)
 
 void I2C::lock(void)
 {
+	_mutex->lock();
 }
 
 void I2C::unlock(void)
 {
+	_mutex->unlock();
 }
 
 }
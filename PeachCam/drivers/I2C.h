@@ -17,9 +17,13 @@ public:
 	void stop(void);
 	void PPinHigh(int pin);
 	void PPinLow(int pin);
+	/* Bus lock shared by all I2C objects (recursive, also taken by each transfer) */
 	virtual void lock(void);
 	virtual void unlock(void);
 private:
+	static SingletonPtr<PlatformMutex> _mutex;
+	int transfer_read(int address, char *data, int length, bool repeated);
+	int transfer_write(int address, const char *data, int length, bool repeated);
 	i2c_t i2c;
 	int sda;
 	int scl;
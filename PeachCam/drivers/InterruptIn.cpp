@@ -5,14 +5,68 @@ namespace mbed {
 
 InterruptIn::InterruptIn(PinName pin)
 {
+	TestBench->gpio_init_in(&gpio, pin);
+	TestBench->gpio_irq_init(&gpio_irq, pin, (intptr_t)&InterruptIn::irq_handler, (intptr_t)this);
+}
+
+InterruptIn::~InterruptIn()
+{
+	TestBench->gpio_irq_free(&gpio_irq);
+}
+
+int InterruptIn::read()
+{
+	return TestBench->gpio_read(&gpio);
 }
 
 void InterruptIn::rise(Callback<void()> func)
 {
+	if (func) {
+		_rise = func;
+		TestBench->gpio_irq_set(&gpio_irq, IRQ_RISE, 1);
+	}
+	else {
+		_rise = Callback<void()>();
+		TestBench->gpio_irq_set(&gpio_irq, IRQ_RISE, 0);
+	}
 }
 
 void InterruptIn::fall(Callback<void()> func)
 {
+	if (func) {
+		_fall = func;
+		TestBench->gpio_irq_set(&gpio_irq, IRQ_FALL, 1);
+	}
+	else {
+		_fall = Callback<void()>();
+		TestBench->gpio_irq_set(&gpio_irq, IRQ_FALL, 0);
+	}
+}
+
+void InterruptIn::enable_irq()
+{
+	TestBench->gpio_irq_set(&gpio_irq, IRQ_RISE, _rise ? 1 : 0);
+	TestBench->gpio_irq_set(&gpio_irq, IRQ_FALL, _fall ? 1 : 0);
+}
+
+void InterruptIn::disable_irq()
+{
+	TestBench->gpio_irq_set(&gpio_irq, IRQ_RISE, 0);
+	TestBench->gpio_irq_set(&gpio_irq, IRQ_FALL, 0);
+}
+
+void InterruptIn::irq_handler(InterruptIn *self, gpio_irq_event event)
+{
+	switch (event) {
+	case IRQ_RISE:
+		if (self->_rise)
+			self->_rise();
+		break;
+	case IRQ_FALL:
+		if (self->_fall)
+			self->_fall();
+		break;
+	}
 }
 
 }
@@ -11,10 +11,22 @@ class InterruptIn
 {
 public:
 	InterruptIn(PinName pin);
+	virtual ~InterruptIn();
+	int read();
 	void rise(Callback<void()> func);
 	void fall(Callback<void()> func);
+	void enable_irq();
+	void disable_irq();
+
+	operator int() {
+		return read();
+	}
 private:
-	PinName pin;
+	gpio_t gpio;
+	gpio_irq_t gpio_irq;
+	Callback<void()> _rise;
+	Callback<void()> _fall;
+	static void irq_handler(InterruptIn *self, gpio_irq_event event);
 };
 
 }
@@ -1,6 +1,7 @@
 #include "mbed.h"
 #include "SPI.h"
 #include "libMPSSE_spi.h"
+#include "StreamRecord.h"
 
 namespace mbed {
 
@@ -106,7 +107,21 @@ int SPI::write(int value)
 	}
 }
 
-int SPI::write(const char *_tx_buffer, int tx_length, char *_rx_buffer, int rx_length)
+int SPI::write(const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length)
+{
+	// 再生中は記録したVoSPIパケットを受信データとして返す
+	if (streamReplay.IsActive() && (rx_buffer != NULL))
+		return streamReplay.ReadVoSPI(rx_buffer, rx_length);
+
+	int result = transfer(tx_buffer, tx_length, rx_buffer, rx_length);
+
+	if (streamRecorder.IsRecording() && (rx_buffer != NULL) && (result > 0))
+		streamRecorder.WriteVoSPI(rx_buffer, rx_length);
+
+	return result;
+}
+
+int SPI::transfer(const char *_tx_buffer, int tx_length, char *_rx_buffer, int rx_length)
 {
 	if (spi.fthandle == NULL) {
 		return TestBench->spi_master_block_write(&spi, (unsigned char *)_tx_buffer, tx_length, (unsigned char *)_rx_buffer, rx_length, 0xFF);
@@ -16,6 +16,7 @@ public:
 	virtual void lock(void);
 	virtual void unlock(void);
 private:
+	int transfer(const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length);
 	spi_t spi;
 	int bits;
 	int mode;
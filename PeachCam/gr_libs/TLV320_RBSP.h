@@ -49,6 +49,9 @@ public:
 	}
 private:
 	i2s_t _i2s;
+	uint32_t _sample_freq;
+	rbsp_data_conf_t _read_conf;
+	static void read_end_tap(void *p_data, int32_t result, void *p_app_data);
 };
 
 /** TLV320_RBSP class, defined on the I2C master bus
@@ -117,8 +117,11 @@ size_t encode_jpeg(uint8_t* buf, int len, int width, int height, uint8_t* inbuf)
     return encode_size;
 }
 
-size_t create_jpeg(){
-    return encode_jpeg(JpegBuffer, sizeof(JpegBuffer), VIDEO_PIXEL_HW, VIDEO_PIXEL_VW, FrameBuffer_Video);
+size_t create_jpeg(const uint8_t *frame){
+    if (frame == NULL) {
+        frame = FrameBuffer_Video;
+    }
+    return encode_jpeg(JpegBuffer, sizeof(JpegBuffer), VIDEO_PIXEL_HW, VIDEO_PIXEL_VW, (uint8_t *)frame);
 }
 
 uint8_t* get_jpeg_adr(){
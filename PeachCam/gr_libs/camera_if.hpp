@@ -68,10 +68,10 @@ void camera_start(void);
 
 /**
 * @brief	Create jpeg from yuv image
-* @param	None
+* @param	frame	yuv image (NULL: video frame buffer)
 * @return	jpeg size
 */
-size_t create_jpeg();
+size_t create_jpeg(const uint8_t *frame = NULL);
 
 /**
 * @brief	Return jpeg addresse
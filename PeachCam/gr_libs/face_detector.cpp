@@ -30,26 +30,237 @@
 
 #include "mbed.h"
 #include "face_detector.hpp"
+#include <psapi.h>
+
+#pragma comment(lib, "psapi.lib")
 
 /* Internally store the cascade classifier model */
 CascadeClassifier detector_classifier;
 
+/* Read-only view of a binary cascade file */
+class ModelMapping {
+public:
+    ModelMapping() : _file(INVALID_HANDLE_VALUE), _mapping(NULL), _view(NULL), _size(0) {}
+    ~ModelMapping() { close(); }
+
+    bool open(const std::string &filename) {
+        LARGE_INTEGER size;
+
+        _file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (_file == INVALID_HANDLE_VALUE)
+            return false;
+
+        if (!GetFileSizeEx(_file, &size) || (size.QuadPart == 0)) {
+            close();
+            return false;
+        }
+        _size = (size_t)size.QuadPart;
+
+        _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (_mapping == NULL) {
+            close();
+            return false;
+        }
+
+        _view = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (_view == NULL) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (_view != NULL)
+            UnmapViewOfFile(_view);
+        if (_mapping != NULL)
+            CloseHandle(_mapping);
+        if (_file != INVALID_HANDLE_VALUE)
+            CloseHandle(_file);
+        _file = INVALID_HANDLE_VALUE;
+        _mapping = NULL;
+        _view = NULL;
+        _size = 0;
+    }
+
+    const void *data() const { return _view; }
+    size_t size() const { return _size; }
+
+private:
+    HANDLE _file;
+    HANDLE _mapping;
+    void *_view;
+    size_t _size;
+};
+
+/* Name of the binary cascade kept next to the XML model */
+static std::string binaryModelPath(const std::string &filename) {
+    size_t pos = filename.find_last_of('.');
+    size_t sep = filename.find_last_of("\\/");
+
+    if ((pos == std::string::npos) || ((sep != std::string::npos) && (pos < sep)))
+        return filename + ".bin";
+    return filename.substr(0, pos) + ".bin";
+}
+
+/* Size and last write time of the XML model, kept in the binary cascade so that an edited XML rebuilds it (0 if unknown) */
+static uint64 sourceStamp(const std::string &filename) {
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+
+    if (!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attr))
+        return 0;
+
+    uint64 time = ((uint64)attr.ftLastWriteTime.dwHighDateTime << 32) | attr.ftLastWriteTime.dwLowDateTime;
+    uint64 size = ((uint64)attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+    return (time * 1000003u) ^ size;
+}
+
+static bool loadBinaryModel(CascadeClassifier &classifier, const std::string &filename, uint64 stamp) {
+    ModelMapping model;
+
+    if (!model.open(filename))
+        return false;
+
+    return classifier.loadBinary(model.data(), model.size(), stamp);
+}
+
+static size_t privateUsage() {
+    PROCESS_MEMORY_COUNTERS_EX pmc;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS *)&pmc, sizeof(pmc)))
+        return 0;
+    return pmc.PrivateUsage;
+}
+
+/* Loads a cascade classifier, from the binary cascade if it is up to date */
+bool detectFaceLoad(CascadeClassifier &classifier, const std::string &filename) {
+    std::string binfile = binaryModelPath(filename);
+    uint64 stamp = sourceStamp(filename);
+
+    // Use the precompiled model if it was made from this XML, otherwise parse the XML and keep the result
+    if (!loadBinaryModel(classifier, binfile, stamp)) {
+        classifier.load(filename);
+
+        if (!classifier.empty() && !classifier.saveBinary(binfile, stamp)) {
+            printf("WARNING: Cannot write binary cascade file %s\n", binfile.c_str());
+        }
+    }
+
+    return !classifier.empty();
+}
+
 /* Initializes the face detector module */
 void detectFaceInit(const std::string &filename) {
-    // Load the cascade classifier file
-    detector_classifier.load(filename);
-
-    if (detector_classifier.empty()) {
+    if (!detectFaceLoad(detector_classifier, filename)) {
         printf("ERROR: Cannot load cascade classifier file\n");
         CV_Assert(0);
         mbed_die();
     }
 }
 
+/* Initializes the face detector module from a binary cascade image in memory */
+void detectFaceInitBinary(const void *model, size_t size) {
+    if (!detector_classifier.loadBinary(model, size)) {
+        printf("ERROR: Cannot load binary cascade classifier\n");
+        CV_Assert(0);
+        mbed_die();
+    }
+}
+
+/* Compares the cold start of the XML and the binary cascade */
+void detectFaceBench(const std::string &filename) {
+    std::string binfile = binaryModelPath(filename);
+    uint64 stamp = sourceStamp(filename);
+    const ticker_data_t *ticker = get_us_ticker_data();
+    us_timestamp_t start;
+    size_t heap;
+
+    {
+        CascadeClassifier classifier;
+        heap = privateUsage();
+        start = ticker_read_us(ticker);
+        bool ok = classifier.load(filename);
+        us_timestamp_t elapse = ticker_read_us(ticker) - start;
+        long used = (long)privateUsage() - (long)heap;
+        printf("xml   : %s %lluus heap %ldKB\n", ok ? "ok" : "NG", elapse, used / 1024);
+
+        if (ok && !classifier.saveBinary(binfile, stamp))
+            printf("WARNING: Cannot write binary cascade file %s\n", binfile.c_str());
+    }
+    {
+        CascadeClassifier classifier;
+        heap = privateUsage();
+        start = ticker_read_us(ticker);
+        bool ok = loadBinaryModel(classifier, binfile, stamp);
+        us_timestamp_t elapse = ticker_read_us(ticker) - start;
+        long used = (long)privateUsage() - (long)heap;
+        printf("binary: %s %lluus heap %ldKB\n", ok ? "ok" : "NG", elapse, used / 1024);
+    }
+}
+
+/* Best of a few runs, so that a preemption does not count */
+#define SCALING_BENCH_REPEAT (5)
+
+/* Reports how cvtColor, resize and detectMultiScale scale with 1 to N OpenCV threads */
+void detectFaceScalingBench(const std::string &filename, CascadeClassifier &classifier) {
+    const ticker_data_t *ticker = get_us_ticker_data();
+    static const char *names[] = { "cvtColor", "resize", "detectMultiScale" };
+    us_timestamp_t base[3] = { 1, 1, 1 };
+    Mat img = imread(filename, IMREAD_COLOR);
+    Mat gray, half;
+    Rect roi;
+
+    if (img.empty()) {
+        printf("cannot read %s\n", filename.c_str());
+        return;
+    }
+
+    int cpus = getNumberOfCPUs();
+    int saved = getNumThreads();
+    printf("%dx%d, %d CPUs, worker priority %d\n", img.cols, img.rows, cpus, getParallelThreadPriority());
+
+    for (int threads = 1; threads <= cpus; threads++) {
+        us_timestamp_t best[3] = { (us_timestamp_t)-1, (us_timestamp_t)-1, (us_timestamp_t)-1 };
+
+        setNumThreads(threads);
+        for (int i = 0; i < SCALING_BENCH_REPEAT; i++) {
+            us_timestamp_t t0 = ticker_read_us(ticker);
+            cvtColor(img, gray, COLOR_BGR2GRAY);
+            us_timestamp_t t1 = ticker_read_us(ticker);
+            resize(img, half, Size(img.cols / 2, img.rows / 2));
+            us_timestamp_t t2 = ticker_read_us(ticker);
+            detectFace(classifier, gray, roi);
+            us_timestamp_t t3 = ticker_read_us(ticker);
+
+            best[0] = std::min<us_timestamp_t>(best[0], t1 - t0);
+            best[1] = std::min<us_timestamp_t>(best[1], t2 - t1);
+            best[2] = std::min<us_timestamp_t>(best[2], t3 - t2);
+        }
+
+        printf("threads %d:", threads);
+        for (int j = 0; j < 3; j++) {
+            best[j] = std::max<us_timestamp_t>(best[j], 1);
+            if (threads == 1)
+                base[j] = best[j];
+            printf(" %s %lluus (x%.2f)", names[j], best[j], (double)base[j] / best[j]);
+        }
+        printf("\n");
+    }
+
+    // The thread count is global, so give back what the application had set
+    setNumThreads(saved);
+}
+
 
 /* Detects a face in an image */
 void detectFace(const Mat &img_gray, Rect &rect_face) {
-    if (detector_classifier.empty()) {
+    detectFace(detector_classifier, img_gray, rect_face);
+}
+
+/* Detects a face in an image with the given classifier */
+void detectFace(CascadeClassifier &classifier, const Mat &img_gray, Rect &rect_face) {
+    if (classifier.empty()) {
         printf("ERROR: Cannot load cascade classifier file\n");
         CV_Assert(0);
         mbed_die();
@@ -57,7 +268,7 @@ void detectFace(const Mat &img_gray, Rect &rect_face) {
 
     // Perform detected the biggest face
     std::vector<Rect> rect_faces;
-    detector_classifier.detectMultiScale(img_gray, rect_faces, 
+    classifier.detectMultiScale(img_gray, rect_faces, 
                                          DETECTOR_SCALE_FACTOR, 
                                          DETECTOR_MIN_NEIGHBOR, 
                                          CASCADE_FIND_BIGGEST_OBJECT,
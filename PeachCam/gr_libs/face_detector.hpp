@@ -48,6 +48,37 @@ using namespace cv;
 */
 void detectFaceInit(const std::string &filename);
 
+/**
+* @brief	Loads a cascade classifier other than the one of the face detector module
+* @param	classifier	Classifier to load
+* @param	filename	Name of the cascade classifier file to detect faces
+* @return	true if the classifier is loaded
+*/
+bool detectFaceLoad(CascadeClassifier &classifier, const std::string &filename);
+
+/**
+* @brief	Initializes the face detector module from a binary cascade image
+* @param	model	Start of the image (memory mapped file or read-only flash)
+* @param	size	Size of the image in bytes
+* @return	None
+*/
+void detectFaceInitBinary(const void *model, size_t size);
+
+/**
+* @brief	Reports load time and heap usage of the XML and the binary cascade
+* @param	filename	Name of the XML cascade classifier file
+* @return	None
+*/
+void detectFaceBench(const std::string &filename);
+
+/**
+* @brief	Reports how cvtColor, resize and detectMultiScale scale with 1 to N OpenCV threads
+* @param	filename	Name of a color image to process
+* @param	classifier	Classifier to run, not the one FaceDetectTask is using
+* @return	None
+*/
+void detectFaceScalingBench(const std::string &filename, CascadeClassifier &classifier);
+
 /**
 * @brief	Detects a face in an image
 * @param	img_gray	Grayscale image
@@ -56,4 +87,13 @@ void detectFaceInit(const std::string &filename);
 */
 void detectFace(const cv::Mat &img_gray, cv::Rect &rect_face);
 
+/**
+* @brief	Detects a face in an image with the given classifier
+* @param	classifier	Classifier loaded by detectFaceLoad
+* @param	img_gray	Grayscale image
+* @param	rect_face	Rectangle area of a detected face
+* @return	None
+*/
+void detectFace(CascadeClassifier &classifier, const cv::Mat &img_gray, cv::Rect &rect_face);
+
 #endif
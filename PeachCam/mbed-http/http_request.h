@@ -158,14 +158,20 @@ public:
 			char *buf = (char *)malloc(len);
 			for (;;) {
 				size_t ret = body.call(buf, len);
+				if (ret == 0) {
+					// body ended before body_size
+					free(buf);
+					error = -2102;
+					return NULL;
+				}
 				send_result = socket->send(buf, ret);
-				if (send_result != request_size) {
+				if (send_result != ret) {
 					free(buf);
 					error = send_result;
 					return NULL;
 				}
 				rest -= ret;
-				if (rest > 0)
+				if (rest == 0)
 					break;
 				len = rest;
 				if (len > 1024)
@@ -182,7 +188,7 @@ public:
 				if (ret <= 0)
 					break;
 				send_result = socket->send(buf, ret);
-				if (send_result != request_size) {
+				if (send_result != ret) {
 					free(buf);
 					error = send_result;
 					return NULL;
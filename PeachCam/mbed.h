@@ -16,6 +16,8 @@
 typedef unsigned int mode_t;
 
 int mkdir(const char *name, mode_t mode);
+int ftruncate(int fd, long length);
+int fsync(int fd);
 
 // プログラムに必要な追加ヘッダーをここで参照してください
 #include <climits>
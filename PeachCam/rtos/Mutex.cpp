@@ -4,10 +4,9 @@
 namespace rtos
 {
 
-Mutex::Mutex() :
-	_count(0)
+Mutex::Mutex()
 {
-	_id = CreateSemaphore(NULL, 0, 1, NULL);
+	_id = CreateMutex(NULL, FALSE, NULL);
 }
 
 Mutex::~Mutex()
@@ -17,28 +16,19 @@ Mutex::~Mutex()
 
 void Mutex::lock(void)
 {
-	if (InterlockedIncrement(&_count) == 0) {
-		WaitForSingleObject(_id, INFINITE);
-	}
+	WaitForSingleObject(_id, INFINITE);
 }
 
 void Mutex::unlock(void)
 {
-	if (InterlockedDecrement(&_count) == 0) {
-		ReleaseSemaphore(_id, 1, NULL);
-	}
+	ReleaseMutex(_id);
 }
 
 osStatus_t Mutex::Acquire(uint32_t timeout)
 {
-	DWORD ret = WAIT_OBJECT_0;
-
-	if (InterlockedIncrement(&_count) == 0) {
-		ret = WaitForSingleObject(_id, timeout);
-	}
-
-	switch (ret) {
+	switch (WaitForSingleObject(_id, timeout)) {
 	case WAIT_OBJECT_0:
+	case WAIT_ABANDONED:
 		return osOK;
 	case WAIT_TIMEOUT:
 		return osErrorTimeout;
@@ -49,13 +39,7 @@ osStatus_t Mutex::Acquire(uint32_t timeout)
 
 osStatus_t Mutex::Release()
 {
-	BOOL ret = TRUE;
-
-	if (InterlockedDecrement(&_count) == 0) {
-		ret = ReleaseSemaphore(_id, 1, NULL);
-	}
-
-	if (ret)
+	if (ReleaseMutex(_id))
 		return osOK;
 	else
 		return osError;
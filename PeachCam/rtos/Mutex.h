@@ -6,6 +6,7 @@
 namespace rtos
 {
 
+/* Recursive, owned by the locking thread (a Win32 mutex object) */
 class Mutex {
 public:
 	Mutex();
@@ -15,7 +16,6 @@ public:
 	osStatus_t Acquire(uint32_t timeout);
 	osStatus_t Release();
 private:
-	uint32_t _count;
 	HANDLE _id;
 };
 
@@ -4,10 +4,9 @@
 namespace rtos
 {
 
-Semaphore::Semaphore() :
-	_count(0)
+Semaphore::Semaphore(int32_t count, uint16_t max_count)
 {
-	_id = CreateSemaphore(NULL, 0, 1, NULL);
+	_id = CreateSemaphore(NULL, count, max_count, NULL);
 }
 
 Semaphore::~Semaphore()
@@ -15,17 +14,12 @@ Semaphore::~Semaphore()
 	CloseHandle(_id);
 }
 
+/* Returns a positive value when a token was taken, 0 on timeout and -1 on error */
 int32_t Semaphore::wait(uint32_t timeout)
 {
-	DWORD ret = WAIT_OBJECT_0;
-
-	if (InterlockedIncrement(&_count) == 0) {
-		ret = WaitForSingleObject(_id, timeout);
-	}
-
-	switch (ret) {
+	switch (WaitForSingleObject(_id, timeout)) {
 	case WAIT_OBJECT_0:
-		return _count + 1;
+		return 1;
 	case WAIT_TIMEOUT:
 		return 0;
 	}
@@ -33,15 +27,10 @@ int32_t Semaphore::wait(uint32_t timeout)
 	return -1;
 }
 
+/* A release beyond max_count is lost and reported as an error */
 osStatus Semaphore::release()
 {
-	BOOL ret = TRUE;
-
-	if (InterlockedDecrement(&_count) == 0) {
-		ret = ReleaseSemaphore(_id, 1, NULL);
-	}
-
-	if (ret)
+	if (ReleaseSemaphore(_id, 1, NULL))
 		return osOK;
 	else
 		return osError;
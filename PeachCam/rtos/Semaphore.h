@@ -7,14 +7,14 @@
 namespace rtos
 {
 
+/* Counting semaphore (a Win32 semaphore object) */
 class Semaphore {
 public:
-	Semaphore();
+	Semaphore(int32_t count = 0, uint16_t max_count = 0xffff);
 	~Semaphore();
 	int32_t wait(uint32_t timeout=osWaitForever);
 	osStatus release();
 private:
-	uint32_t _count;
 	HANDLE _id;
 };
 
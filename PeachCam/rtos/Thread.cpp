@@ -6,6 +6,19 @@ namespace rtos
 
 DWORD Thread::m_TlsIndex = 0xFFFFFFFF;
 
+static int ToWin32Priority(osPriority priority)
+{
+	switch (priority) {
+	case osPriorityIdle:
+		return THREAD_PRIORITY_IDLE;
+	case osPriorityRealtime:
+		return THREAD_PRIORITY_TIME_CRITICAL;
+	default:
+		// osPriorityLow..osPriorityHigh have the same values as THREAD_PRIORITY_LOWEST..HIGHEST
+		return (int)priority;
+	}
+}
+
 Thread::Thread(osPriority priority, uint32_t stack_size, unsigned char *stack_mem,
 	const char *name) : 
 	_flags(0),
@@ -19,6 +32,9 @@ Thread::Thread(osPriority priority, uint32_t stack_size, unsigned char *stack_me
 
 	_id = CreateThread(NULL, 0, &ThreadProc, (void *)this, CREATE_SUSPENDED, &m_ThreadID);
 
+	// Honor the priority like the RTOS does, so that capture threads run first
+	SetThreadPriority(_id, ToWin32Priority(priority));
+
 	if (name != NULL)
 		SetThreadName(m_ThreadID, name);
 }
@@ -0,0 +1,276 @@
+#include "mbed.h"
+#include "FrameBus.h"
+
+FrameBus frameBus;
+
+FrameView::FrameView() :
+	_seq(0),
+	_timestamp(0),
+	_width(0),
+	_height(0),
+	_stride(0),
+	_format(StreamVideoFormat::YCbCr422),
+	_changed(0),
+	_changedSeq(0),
+	_refs(0)
+{
+}
+
+cv::Rect FrameView::GetTileRect(int tile) const
+{
+	// 最小の縮小画像で分割した範囲を原寸に戻す（端数は最後の行・列に含める）
+	int w = GetWidth(FRAME_BUS_PYRAMID_LEVELS);
+	int h = GetHeight(FRAME_BUS_PYRAMID_LEVELS);
+	int col = tile % FRAME_BUS_TILE_COLS;
+	int row = tile / FRAME_BUS_TILE_COLS;
+	int x0 = col * (w / FRAME_BUS_TILE_COLS);
+	int y0 = row * (h / FRAME_BUS_TILE_ROWS);
+	int x1 = (col == FRAME_BUS_TILE_COLS - 1) ? w : x0 + (w / FRAME_BUS_TILE_COLS);
+	int y1 = (row == FRAME_BUS_TILE_ROWS - 1) ? h : y0 + (h / FRAME_BUS_TILE_ROWS);
+
+	return cv::Rect(x0 << FRAME_BUS_PYRAMID_LEVELS, y0 << FRAME_BUS_PYRAMID_LEVELS,
+		(x1 - x0) << FRAME_BUS_PYRAMID_LEVELS, (y1 - y0) << FRAME_BUS_PYRAMID_LEVELS);
+}
+
+cv::Rect FrameView::GetChangedRect(uint64_t tiles) const
+{
+	cv::Rect rect;
+
+	for (int i = 0; i < FRAME_BUS_TILE_COLS * FRAME_BUS_TILE_ROWS; i++) {
+		if ((tiles & ((uint64_t)1 << i)) == 0)
+			continue;
+		if (rect.area() == 0)
+			rect = GetTileRect(i);
+		else
+			rect |= GetTileRect(i);
+	}
+
+	return rect;
+}
+
+void FrameView::Fill(const void *data, int width, int height, int stride, StreamVideoFormat::T format)
+{
+	const uint8_t *src = (const uint8_t *)data;
+
+	_timestamp = ticker_read_us(get_us_ticker_data());
+	_width = width;
+	_height = height;
+	_stride = stride;
+	_format = format;
+
+	// 同じ大きさなら確保済みの領域をそのまま使う
+	_pixels.resize(stride * height);
+	memcpy(&_pixels[0], src, stride * height);
+
+	_gray[0].resize(width * height);
+	uint8_t *dst = &_gray[0][0];
+	for (int y = 0; y < height; y++) {
+		const uint8_t *line = &_pixels[y * stride];
+		if (format == StreamVideoFormat::YCbCr422) {
+			// YUY2の並びなので偶数バイトが輝度
+			for (int x = 0; x < width; x++) {
+				*dst++ = line[2 * x];
+			}
+		}
+		else {
+			const uint16_t *pixel = (const uint16_t *)line;
+			for (int x = 0; x < width; x++) {
+				uint16_t rgb = pixel[x];
+				int r = (rgb >> 11) & 0x1F;
+				int g = (rgb >> 5) & 0x3F;
+				int b = rgb & 0x1F;
+				r = (r << 3) | (r >> 2);
+				g = (g << 2) | (g >> 4);
+				b = (b << 3) | (b >> 2);
+				*dst++ = (uint8_t)((77 * r + 150 * g + 29 * b + 128) >> 8);
+			}
+		}
+	}
+
+	// 2x2の平均で縮小
+	for (int level = 1; level <= FRAME_BUS_PYRAMID_LEVELS; level++) {
+		int sw = width >> (level - 1);
+		int dw = width >> level;
+		int dh = height >> level;
+		_gray[level].resize(dw * dh);
+		const uint8_t *s = &_gray[level - 1][0];
+		uint8_t *d = &_gray[level][0];
+		for (int y = 0; y < dh; y++) {
+			const uint8_t *s0 = &s[(2 * y) * sw];
+			const uint8_t *s1 = s0 + sw;
+			for (int x = 0; x < dw; x++) {
+				*d++ = (uint8_t)((s0[2 * x] + s0[2 * x + 1] + s1[2 * x] + s1[2 * x + 1] + 2) >> 2);
+			}
+		}
+	}
+}
+
+FrameSubscriber::FrameSubscriber(const char *name, TaskThread *thread) :
+	_name(name),
+	_thread(thread),
+	_seq(0),
+	_received(0),
+	_dropped(0),
+	_skipped(0)
+{
+}
+
+FrameBus::FrameBus() :
+	_latest(NULL),
+	_seq(0),
+	_overrun(0),
+	_changedSeq(0),
+	_changedCount(0),
+	_history(),
+	_subscribers(),
+	_subscriberCount(0)
+{
+}
+
+FrameBus::~FrameBus()
+{
+}
+
+void FrameBus::Subscribe(FrameSubscriber *sub)
+{
+	_mutex.lock();
+	if (_subscriberCount < FRAME_BUS_SUBSCRIBER_MAX) {
+		sub->_seq = _seq;
+		_subscribers[_subscriberCount++] = sub;
+	}
+	_mutex.unlock();
+}
+
+void FrameBus::Publish(const void *data, int width, int height, int stride, StreamVideoFormat::T format)
+{
+	FrameView *frame = NULL;
+
+	_mutex.lock();
+	for (int i = 0; i < FRAME_BUS_POOL_COUNT; i++) {
+		if (_frames[i]._refs == 0) {
+			frame = &_frames[i];
+			break;
+		}
+	}
+	if (frame == NULL) {
+		_overrun++;
+		_mutex.unlock();
+		return;
+	}
+	// 書き込み中は他から渡らないように押さえておく
+	frame->_refs = 1;
+	_mutex.unlock();
+
+	frame->Fill(data, width, height, stride, format);
+	frame->_changed = DetectChange(frame);
+
+	_mutex.lock();
+	if (_latest != NULL)
+		_latest->_refs--;
+	// バスが持つ参照として残す
+	frame->_seq = ++_seq;
+	if (frame->_changed != 0) {
+		_changedSeq = _seq;
+		_changedCount++;
+	}
+	frame->_changedSeq = _changedSeq;
+	_history[_seq % FRAME_BUS_HISTORY] = frame->_changed;
+	_latest = frame;
+	_mutex.unlock();
+
+	for (int i = 0; i < _subscriberCount; i++) {
+		FrameSubscriber *sub = _subscribers[i];
+		if (sub->_thread != NULL)
+			sub->_thread->Signal(InterTaskSignals::FrameReady);
+	}
+}
+
+/*
+ * 最小の縮小画像をタイルに分けて基準画像との差分の絶対値和を求める
+ * 基準は変化したタイルだけ更新するので、ゆっくりした変化も積もれば検出する。
+ */
+uint64_t FrameBus::DetectChange(const FrameView *frame)
+{
+	cv::Mat gray = frame->GetGrayMat(FRAME_BUS_PYRAMID_LEVELS);
+	uint64_t changed = 0;
+
+	if ((_reference.rows != gray.rows) || (_reference.cols != gray.cols)) {
+		gray.copyTo(_reference);
+		return ((uint64_t)1 << (FRAME_BUS_TILE_COLS * FRAME_BUS_TILE_ROWS)) - 1;
+	}
+
+	for (int i = 0; i < FRAME_BUS_TILE_COLS * FRAME_BUS_TILE_ROWS; i++) {
+		cv::Rect tile = frame->GetTileRect(i);
+		cv::Rect rect(tile.x >> FRAME_BUS_PYRAMID_LEVELS, tile.y >> FRAME_BUS_PYRAMID_LEVELS,
+			tile.width >> FRAME_BUS_PYRAMID_LEVELS, tile.height >> FRAME_BUS_PYRAMID_LEVELS);
+		double sad = cv::norm(gray(rect), _reference(rect), cv::NORM_L1);
+		if (sad > (double)FRAME_BUS_CHANGE_THRESHOLD * rect.area()) {
+			changed |= (uint64_t)1 << i;
+			gray(rect).copyTo(_reference(rect));
+		}
+	}
+
+	return changed;
+}
+
+uint64_t FrameBus::GetChangedTiles(const FrameView *frame, uint32_t since)
+{
+	uint64_t tiles = 0;
+
+	if (!frame->IsChangedSince(since))
+		return 0;
+
+	_mutex.lock();
+	if ((since == 0) || (_seq - since >= FRAME_BUS_HISTORY) || (frame->_seq <= since)) {
+		tiles = ((uint64_t)1 << (FRAME_BUS_TILE_COLS * FRAME_BUS_TILE_ROWS)) - 1;
+	}
+	else {
+		for (uint32_t seq = since + 1; seq <= frame->_seq; seq++)
+			tiles |= _history[seq % FRAME_BUS_HISTORY];
+	}
+	_mutex.unlock();
+
+	return tiles;
+}
+
+const FrameView *FrameBus::Take(FrameSubscriber *sub, bool newer_only)
+{
+	FrameView *frame;
+
+	_mutex.lock();
+	frame = _latest;
+	if ((frame == NULL) || (newer_only && (frame->_seq == sub->_seq))) {
+		_mutex.unlock();
+		return NULL;
+	}
+	if (frame->_seq != sub->_seq) {
+		if (frame->_seq - sub->_seq > 1)
+			sub->_dropped += frame->_seq - sub->_seq - 1;
+		sub->_seq = frame->_seq;
+		sub->_received++;
+	}
+	frame->_refs++;
+	_mutex.unlock();
+
+	return frame;
+}
+
+void FrameBus::Release(const FrameView *frame)
+{
+	if (frame == NULL)
+		return;
+
+	_mutex.lock();
+	((FrameView *)frame)->_refs--;
+	_mutex.unlock();
+}
+
+void FrameBus::PrintStats()
+{
+	printf("seq %lu, overrun %lu, changed %lu\n", _seq, _overrun, _changedCount);
+	for (int i = 0; i < _subscriberCount; i++) {
+		FrameSubscriber *sub = _subscribers[i];
+		printf("%-16s received %lu, dropped %lu, skipped %lu, lag %lu\n", sub->_name,
+			sub->_received, sub->_dropped, sub->_skipped, GetLag(sub));
+	}
+}
@@ -0,0 +1,131 @@
+#ifndef _FRAMEBUS_H_
+#define _FRAMEBUS_H_
+
+#include <vector>
+#include "TaskBase.h"
+#include "StreamRecord.h"
+#include "opencv.hpp"
+
+/* フレームバッファの数（最新1枚＋購読者が処理中のもの） */
+#define FRAME_BUS_POOL_COUNT		(3)
+/* 輝度の縮小画像の段数（1/2、1/4） */
+#define FRAME_BUS_PYRAMID_LEVELS	(2)
+#define FRAME_BUS_SUBSCRIBER_MAX	(4)
+/* 変化検出のタイル分割（最小の縮小画像を分割する、64以下） */
+#define FRAME_BUS_TILE_COLS			(8)
+#define FRAME_BUS_TILE_ROWS			(6)
+/* タイル内の1画素あたりの差分の平均がこれを超えたら変化とみなす */
+#define FRAME_BUS_CHANGE_THRESHOLD	(8)
+/* 変化したタイルを遡れるフレーム数 */
+#define FRAME_BUS_HISTORY			(16)
+
+/*
+ * カメラの1フレームのスナップショット
+ * 発行後は書き換えないので、購読者は参照している間そのまま読める。
+ * level 0が原寸の輝度、1以降は縦横1/2ずつの縮小。
+ */
+class FrameView
+{
+	friend class FrameBus;
+public:
+	FrameView();
+private:
+	uint32_t _seq;
+	us_timestamp_t _timestamp;
+	int _width;
+	int _height;
+	int _stride;
+	StreamVideoFormat::T _format;
+	std::vector<uint8_t> _pixels;
+	std::vector<uint8_t> _gray[FRAME_BUS_PYRAMID_LEVELS + 1];
+	uint64_t _changed;
+	uint32_t _changedSeq;
+	int _refs;
+	void Fill(const void *data, int width, int height, int stride, StreamVideoFormat::T format);
+public:
+	uint32_t GetSeq() const { return _seq; }
+	us_timestamp_t GetTimestamp() const { return _timestamp; }
+	StreamVideoFormat::T GetFormat() const { return _format; }
+	const uint8_t *GetPixels() const { return &_pixels[0]; }
+	int GetStride() const { return _stride; }
+	const uint8_t *GetGray(int level = 0) const { return &_gray[level][0]; }
+	int GetWidth(int level = 0) const { return _width >> level; }
+	int GetHeight(int level = 0) const { return _height >> level; }
+	cv::Mat GetGrayMat(int level = 0) const {
+		return cv::Mat(GetHeight(level), GetWidth(level), CV_8UC1, (void *)GetGray(level));
+	}
+	/* 直前のフレームから変化したタイル（ビットはrow * FRAME_BUS_TILE_COLS + col） */
+	uint64_t GetChangedTiles() const { return _changed; }
+	/* このフレーム以前で最後に変化があったフレームの番号 */
+	uint32_t GetChangedSeq() const { return _changedSeq; }
+	bool IsChangedSince(uint32_t seq) const { return _changedSeq > seq; }
+	/* タイルの範囲（原寸の座標） */
+	cv::Rect GetTileRect(int tile) const;
+	cv::Rect GetChangedRect(uint64_t tiles) const;
+};
+
+class FrameSubscriber
+{
+	friend class FrameBus;
+public:
+	FrameSubscriber(const char *name, TaskThread *thread = NULL);
+private:
+	const char *_name;
+	TaskThread *_thread;
+	uint32_t _seq;			// 最後に受け取ったフレームの番号
+	uint32_t _received;
+	uint32_t _dropped;		// 受け取る前に次のフレームで上書きされた数
+	uint32_t _skipped;		// 変化が無いので処理を省いた数
+public:
+	const char *GetName() { return _name; }
+	uint32_t GetReceived() { return _received; }
+	uint32_t GetDropped() { return _dropped; }
+	uint32_t GetSkipped() { return _skipped; }
+	void CountSkipped() { _skipped++; }
+};
+
+/*
+ * カメラフレームの配信
+ *
+ * 取り込みが終わったフレームを1度だけプールにコピーして輝度を求め、
+ * 購読者には参照カウント付きで同じフレームを渡す。
+ * プールが空いていなければそのフレームは捨てる（カメラは待たせない）。
+ */
+class FrameBus
+{
+public:
+	FrameBus();
+	virtual ~FrameBus();
+private:
+	rtos::Mutex _mutex;
+	FrameView _frames[FRAME_BUS_POOL_COUNT];
+	FrameView *_latest;
+	uint32_t _seq;
+	uint32_t _overrun;
+	uint32_t _changedSeq;
+	uint32_t _changedCount;
+	uint64_t _history[FRAME_BUS_HISTORY];
+	cv::Mat _reference;
+	uint64_t DetectChange(const FrameView *frame);
+	FrameSubscriber *_subscribers[FRAME_BUS_SUBSCRIBER_MAX];
+	int _subscriberCount;
+	const FrameView *Take(FrameSubscriber *sub, bool newer_only);
+public:
+	void Subscribe(FrameSubscriber *sub);
+	void Publish(const void *data, int width, int height, int stride, StreamVideoFormat::T format);
+	/* まだ受け取っていない最新のフレーム、無ければNULL */
+	const FrameView *Acquire(FrameSubscriber *sub) { return Take(sub, true); }
+	/* 受け取り済みでも最新のフレーム、まだ1枚も無ければNULL */
+	const FrameView *AcquireLatest(FrameSubscriber *sub) { return Take(sub, false); }
+	void Release(const FrameView *frame);
+	uint32_t GetSeq() { return _seq; }
+	uint32_t GetLag(FrameSubscriber *sub) { return _seq - sub->_seq; }
+	uint32_t GetOverrun() { return _overrun; }
+	/* sinceより後からframeまでに変化したタイル（遡れなければ全タイル） */
+	uint64_t GetChangedTiles(const FrameView *frame, uint32_t since);
+	void PrintStats();
+};
+
+extern FrameBus frameBus;
+
+#endif // _FRAMEBUS_H_
@@ -13,7 +13,9 @@ GlobalState::GlobalState() :
 	mediaTask(NULL),
 	faceDetectTask(NULL),
 	leptonTask(NULL),
-	zxingTask(NULL)
+	zxingTask(NULL),
+	storageTask(NULL),
+	_day(-1)
 {
 }
 
@@ -33,10 +35,15 @@ void GlobalState::MakeFilePath()
 	time_t now = time(NULL);
 	struct tm *tm = localtime(&now);
 
-	mkdir(".\\DCIM", (mode_t)0000777);
-
 	sprintf(path, ".\\DCIM\\%04d%02d%02d", tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
-	mkdir(path, (mode_t)0000777);
+
+	// フォルダは日付が変わったときだけ作る
+	int day = (tm->tm_year << 9) | tm->tm_yday;
+	if (_day != day) {
+		mkdir(".\\DCIM", (mode_t)0000777);
+		mkdir(path, (mode_t)0000777);
+		_day = day;
+	}
 
 	sprintf(file, "%04d%02d%02d%02d%02d%02d", tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday,
 		tm->tm_hour, tm->tm_min, tm->tm_sec);
@@ -55,10 +62,10 @@ void GlobalState::UpdateRequest()
 	netTask->Signal(InterTaskSignals::UpdateRequest);
 }
 
-void GlobalState::UploadRequest(std::string filename)
+void GlobalState::UploadRequest(std::string filename, uint32_t size)
 {
 	printf("GlobalState::UploadRequest\r\n");
-	netTask->UploadRequest(filename);
+	netTask->UploadRequest(filename, size);
 }
 
 void GlobalState::PowerOff()
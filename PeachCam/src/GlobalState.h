@@ -12,6 +12,7 @@ class MediaTask;
 class FaceDetectTask;
 class LeptonTaskThread;
 class ZXingTask;
+class StorageTask;
 
 class GlobalState
 {
@@ -27,13 +28,15 @@ public:
 	FaceDetectTask *faceDetectTask;
 	LeptonTaskThread *leptonTask;
 	ZXingTask *zxingTask;
+	StorageTask *storageTask;
 	std::string _path;
+	int _day;				// フォルダを作った日
 public:
 	bool IsActive();
 	void MakeFilePath();
 	std::string GetFilePath();
 	void UpdateRequest();
-	void UploadRequest(std::string filename);
+	void UploadRequest(std::string filename, uint32_t size);
 	void PowerOff();
 	void PowerOn();
 	void TriggerOn();
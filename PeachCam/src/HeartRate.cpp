@@ -0,0 +1,365 @@
+#include "mbed.h"
+#include <math.h>
+#include <vector>
+#include "HeartRate.h"
+
+#define BIQUAD_Q			(14)
+/* 入力を固定小数点化するときの左シフト量 */
+#define INPUT_SHIFT			(4)
+/* ピーク位置の分解能（1/16サンプル） */
+#define PEAK_FRAC_SHIFT		(4)
+/* 脈波とみなす最小の振幅（生値で2カウント） */
+#define MIN_AMPLITUDE		(2 << INPUT_SHIFT)
+
+static const double PI = 3.14159265358979323846;
+
+SlidingMinMax::SlidingMinMax()
+{
+	Reset(HEART_RATE_WINDOW_MAX);
+}
+
+void SlidingMinMax::Reset(int length)
+{
+	if (length > HEART_RATE_WINDOW_MAX)
+		length = HEART_RATE_WINDOW_MAX;
+	if (length < 1)
+		length = 1;
+
+	_length = length;
+	_minHead = 0;
+	_minCount = 0;
+	_maxHead = 0;
+	_maxCount = 0;
+	_min[0].index = 0;
+	_min[0].value = 0;
+	_max[0].index = 0;
+	_max[0].value = 0;
+}
+
+void SlidingMinMax::Push(uint32_t index, int32_t value)
+{
+	int tail;
+
+	// 窓から外れた先頭を捨てる
+	while ((_minCount > 0) && ((index - _min[_minHead].index) >= (uint32_t)_length)) {
+		_minHead = (_minHead + 1) % HEART_RATE_WINDOW_MAX;
+		_minCount--;
+	}
+	while ((_maxCount > 0) && ((index - _max[_maxHead].index) >= (uint32_t)_length)) {
+		_maxHead = (_maxHead + 1) % HEART_RATE_WINDOW_MAX;
+		_maxCount--;
+	}
+
+	// 新しい値より大きい（小さい）末尾は二度と最小（最大）にならない
+	while (_minCount > 0) {
+		tail = (_minHead + _minCount - 1) % HEART_RATE_WINDOW_MAX;
+		if (_min[tail].value < value)
+			break;
+		_minCount--;
+	}
+	while (_maxCount > 0) {
+		tail = (_maxHead + _maxCount - 1) % HEART_RATE_WINDOW_MAX;
+		if (_max[tail].value > value)
+			break;
+		_maxCount--;
+	}
+
+	tail = (_minHead + _minCount) % HEART_RATE_WINDOW_MAX;
+	_min[tail].index = index;
+	_min[tail].value = value;
+	_minCount++;
+
+	tail = (_maxHead + _maxCount) % HEART_RATE_WINDOW_MAX;
+	_max[tail].index = index;
+	_max[tail].value = value;
+	_maxCount++;
+}
+
+Biquad::Biquad() :
+	_b0(1 << BIQUAD_Q), _b1(0), _b2(0), _a1(0), _a2(0),
+	_x1(0), _x2(0), _y1(0), _y2(0)
+{
+}
+
+static int32_t to_q(double value)
+{
+	return (int32_t)floor(value * (1 << BIQUAD_Q) + 0.5);
+}
+
+void Biquad::SetHighPass(float fs, float fc, float q)
+{
+	double w0 = 2.0 * PI * fc / fs;
+	double alpha = sin(w0) / (2.0 * q);
+	double c = cos(w0);
+	double a0 = 1.0 + alpha;
+
+	_b0 = to_q(((1.0 + c) / 2.0) / a0);
+	_b1 = to_q(-(1.0 + c) / a0);
+	_b2 = _b0;
+	_a1 = to_q((-2.0 * c) / a0);
+	_a2 = to_q((1.0 - alpha) / a0);
+}
+
+void Biquad::SetLowPass(float fs, float fc, float q)
+{
+	double w0 = 2.0 * PI * fc / fs;
+	double alpha = sin(w0) / (2.0 * q);
+	double c = cos(w0);
+	double a0 = 1.0 + alpha;
+
+	_b0 = to_q(((1.0 - c) / 2.0) / a0);
+	_b1 = to_q((1.0 - c) / a0);
+	_b2 = _b0;
+	_a1 = to_q((-2.0 * c) / a0);
+	_a2 = to_q((1.0 - alpha) / a0);
+}
+
+void Biquad::Reset(int32_t x, int32_t y)
+{
+	_x1 = _x2 = x;
+	_y1 = _y2 = y;
+}
+
+int32_t Biquad::Process(int32_t x)
+{
+	int64_t acc;
+	int32_t y;
+
+	acc = (int64_t)_b0 * x + (int64_t)_b1 * _x1 + (int64_t)_b2 * _x2
+		- (int64_t)_a1 * _y1 - (int64_t)_a2 * _y2;
+	y = (int32_t)((acc + (1 << (BIQUAD_Q - 1))) >> BIQUAD_Q);
+
+	_x2 = _x1;
+	_x1 = x;
+	_y2 = _y1;
+	_y1 = y;
+
+	return y;
+}
+
+HeartRateEngine::HeartRateEngine(int sample_rate)
+{
+	SetSampleRate(sample_rate);
+}
+
+void HeartRateEngine::SetSampleRate(int sample_rate)
+{
+	if (sample_rate < 1)
+		sample_rate = 1;
+
+	_sample_rate = sample_rate;
+	_decim = (sample_rate + HEART_RATE_PROC_RATE / 2) / HEART_RATE_PROC_RATE;
+	if (_decim < 1)
+		_decim = 1;
+	_proc_rate = sample_rate / _decim;
+
+	_hpf.SetHighPass((float)_proc_rate, 0.5f, 0.707f);
+	_lpf.SetLowPass((float)_proc_rate, 4.0f, 0.707f);
+
+	_refractory = (_proc_rate * 60) / HEART_RATE_BPM_MAX;
+	_timeout = (_proc_rate * 60 * 3) / (HEART_RATE_BPM_MIN * 2);
+
+	Reset();
+}
+
+void HeartRateEngine::Reset()
+{
+	_decim_count = 0;
+	_decim_sum = 0;
+	_index = 0;
+	_primed = false;
+	_window.Reset((HEART_RATE_WINDOW_MS * _proc_rate) / 1000);
+	_y1 = _y2 = 0;
+	_lastPeak = 0;
+	_hasPeak = false;
+	_amplitude = 0;
+	_level = 0;
+	_ibiPos = 0;
+	_ibiCount = 0;
+	_bpm10 = 0;
+	_confidence = 0;
+}
+
+void HeartRateEngine::Push(const uint16_t *samples, int count)
+{
+	for (int i = 0; i < count; i++) {
+		_decim_sum += samples[i];
+		if (++_decim_count < _decim)
+			continue;
+
+		ProcessSample(_decim_sum / _decim);
+		_decim_sum = 0;
+		_decim_count = 0;
+	}
+}
+
+void HeartRateEngine::ProcessSample(int32_t x)
+{
+	int32_t y, min, max;
+
+	x <<= INPUT_SHIFT;
+
+	// 直流分で過渡応答が出ないよう最初のサンプルで状態を合わせる
+	if (!_primed) {
+		_hpf.Reset(x, 0);
+		_lpf.Reset(0, 0);
+		_primed = true;
+	}
+
+	// 緑色光の脈波は収縮期に下がるので反転してピークを探す
+	y = -_lpf.Process(_hpf.Process(x));
+
+	_window.Push(_index, y);
+	min = _window.GetMin();
+	max = _window.GetMax();
+	_amplitude = max - min;
+
+	if (_amplitude > 0)
+		_level = (int32_t)(((int64_t)(y - min) * 15) / _amplitude);
+	else
+		_level = 0;
+
+	// 1つ前のサンプルが極大で、窓の振幅の6割を超えていればピーク
+	if ((_index >= 2) && (_y1 > _y2) && (_y1 >= y) && (_amplitude >= MIN_AMPLITUDE)
+		&& (_y1 > min + (_amplitude * 3) / 5)) {
+		// 放物線補間でピーク位置をサンプル以下まで求める
+		int32_t den = _y2 - 2 * _y1 + y;
+		int32_t frac = 0;
+		if (den != 0) {
+			frac = (int32_t)(((int64_t)(_y2 - y) << PEAK_FRAC_SHIFT) / (2 * den));
+			if (frac > (1 << (PEAK_FRAC_SHIFT - 1)))
+				frac = 1 << (PEAK_FRAC_SHIFT - 1);
+			if (frac < -(1 << (PEAK_FRAC_SHIFT - 1)))
+				frac = -(1 << (PEAK_FRAC_SHIFT - 1));
+		}
+		uint32_t peak = ((_index - 1) << PEAK_FRAC_SHIFT) + frac;
+
+		if (!_hasPeak) {
+			_lastPeak = peak;
+			_hasPeak = true;
+		}
+		else {
+			uint32_t interval = peak - _lastPeak;
+			if (interval >= ((uint32_t)_refractory << PEAK_FRAC_SHIFT)) {
+				if (interval <= ((uint32_t)_timeout << PEAK_FRAC_SHIFT)) {
+					_ibi[_ibiPos] = (uint16_t)interval;
+					_ibiPos = (_ibiPos + 1) % HEART_RATE_IBI_COUNT;
+					if (_ibiCount < HEART_RATE_IBI_COUNT)
+						_ibiCount++;
+					Evaluate();
+				}
+				_lastPeak = peak;
+			}
+		}
+	}
+
+	// しばらくピークが無ければ心拍を見失ったとする
+	if (_hasPeak && ((_index << PEAK_FRAC_SHIFT) - _lastPeak > ((uint32_t)_timeout << PEAK_FRAC_SHIFT))) {
+		_hasPeak = false;
+		_ibiCount = 0;
+		_ibiPos = 0;
+		_bpm10 = 0;
+		_confidence = 0;
+	}
+
+	_y2 = _y1;
+	_y1 = y;
+	_index++;
+}
+
+void HeartRateEngine::Evaluate()
+{
+	uint16_t sorted[HEART_RATE_IBI_COUNT];
+	int n = _ibiCount, i, j;
+	uint32_t median, dev = 0;
+
+	if (n < 2) {
+		_bpm10 = 0;
+		_confidence = 0;
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		uint16_t v = _ibi[i];
+		for (j = i; (j > 0) && (sorted[j - 1] > v); j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = v;
+	}
+	median = sorted[n / 2];
+	if (median == 0)
+		return;
+
+	_bpm10 = (int)((600u * (uint32_t)_proc_rate << PEAK_FRAC_SHIFT) / median);
+
+	// 心拍間隔のばらつきが小さく、履歴が揃っているほど信頼度を高くする
+	for (i = 0; i < n; i++)
+		dev += (sorted[i] > median) ? (sorted[i] - median) : (median - sorted[i]);
+	int confidence = 100 - (int)((400u * dev) / (median * n));
+	if (confidence < 0)
+		confidence = 0;
+	_confidence = (confidence * n) / HEART_RATE_IBI_COUNT;
+}
+
+void HeartRateBench(const char *filename, int sample_rate, int ref_bpm)
+{
+	FILE *fp;
+	char line[64];
+	std::vector<uint16_t> samples;
+	std::vector<uint16_t> refs;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		printf("cannot open %s\n", filename);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		int value, ref = ref_bpm;
+		if ((line[0] == '#') || (sscanf(line, "%d%*[ ,\t]%d", &value, &ref) < 1))
+			continue;
+		samples.push_back((uint16_t)value);
+		refs.push_back((uint16_t)ref);
+	}
+	fclose(fp);
+
+	if (samples.empty()) {
+		printf("no samples\n");
+		return;
+	}
+
+	// FIFOのウォーターマーク単位で与えて実機の呼び出し方に合わせる
+	HeartRateEngine engine(sample_rate);
+	const int block = 32;
+	us_timestamp_t elapse = 0, start;
+	uint64_t error = 0;
+	int scored = 0, valid = 0;
+
+	for (size_t pos = 0; pos < samples.size(); pos += block) {
+		int count = (int)std::min<size_t>(block, samples.size() - pos);
+
+		start = ticker_read_us(get_us_ticker_data());
+		engine.Push(&samples[pos], count);
+		elapse += ticker_read_us(get_us_ticker_data()) - start;
+
+		int ref = refs[pos + count - 1];
+		if (ref <= 0)
+			continue;
+		scored++;
+		if (engine.GetConfidence() < 50)
+			continue;
+		valid++;
+		error += abs(engine.GetBpm10() - ref * 10);
+	}
+
+	printf("samples %u, %lluus, %lluns/sample\n", (unsigned)samples.size(),
+		elapse, (elapse * 1000) / samples.size());
+	printf("bpm %d.%d, confidence %d\n", engine.GetBpm10() / 10, engine.GetBpm10() % 10,
+		engine.GetConfidence());
+	if (valid > 0) {
+		printf("coverage %d%%, mean abs error %llu.%llu bpm\n", (100 * valid) / scored,
+			(error / valid) / 10, (error / valid) % 10);
+	}
+	else if (scored > 0) {
+		printf("coverage 0%%\n");
+	}
+}
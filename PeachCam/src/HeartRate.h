@@ -0,0 +1,121 @@
+#ifndef _HEARTRATE_H_
+#define _HEARTRATE_H_
+
+#include <stdint.h>
+
+/* 内部処理のサンプリング周波数の目安（入力はこの程度まで間引く） */
+#define HEART_RATE_PROC_RATE	(64)
+/* 最小値・最大値を求める窓の長さ[ms] */
+#define HEART_RATE_WINDOW_MS	(2000)
+/* 窓に入るサンプル数の上限（内部周波数が128Hz未満なので2秒分で足りる） */
+#define HEART_RATE_WINDOW_MAX	(256)
+/* 心拍間隔の履歴数 */
+#define HEART_RATE_IBI_COUNT	(8)
+/* 対象とする心拍数の範囲[bpm] */
+#define HEART_RATE_BPM_MIN		(30)
+#define HEART_RATE_BPM_MAX		(220)
+
+/*
+ * スライディングウィンドウの最小値・最大値（単調キュー）
+ * 1サンプルあたり償却O(1)で窓内の最小値と最大値を返す。
+ */
+class SlidingMinMax
+{
+public:
+	SlidingMinMax();
+private:
+	struct entry_t {
+		uint32_t index;
+		int32_t value;
+	};
+	entry_t _min[HEART_RATE_WINDOW_MAX];
+	entry_t _max[HEART_RATE_WINDOW_MAX];
+	int _minHead, _minCount;
+	int _maxHead, _maxCount;
+	int _length;
+public:
+	void Reset(int length);
+	void Push(uint32_t index, int32_t value);
+	int32_t GetMin() { return _min[_minHead].value; }
+	int32_t GetMax() { return _max[_maxHead].value; }
+	bool IsEmpty() { return _minCount == 0; }
+};
+
+/*
+ * 固定小数点（Q14）の双二次IIRフィルタ（直接形I）
+ */
+class Biquad
+{
+public:
+	Biquad();
+private:
+	int32_t _b0, _b1, _b2, _a1, _a2;
+	int32_t _x1, _x2, _y1, _y2;
+public:
+	void SetHighPass(float fs, float fc, float q);
+	void SetLowPass(float fs, float fc, float q);
+	void Reset(int32_t x, int32_t y);
+	int32_t Process(int32_t x);
+};
+
+/*
+ * 脈波から心拍数を求めるストリーミング処理
+ *
+ *  入力 → 間引き（平均） → 帯域通過（0.5～4Hz） → ピーク検出 → 心拍間隔の中央値
+ *
+ * サンプリング周波数はSetSampleRateで与え、以降の処理はすべて整数演算で行う。
+ */
+class HeartRateEngine
+{
+public:
+	HeartRateEngine(int sample_rate = 1024);
+private:
+	int _sample_rate;
+	int _decim;
+	int _proc_rate;
+	int _decim_count;
+	int32_t _decim_sum;
+	uint32_t _index;
+	Biquad _hpf;
+	Biquad _lpf;
+	bool _primed;
+	SlidingMinMax _window;
+	int32_t _y1, _y2;
+	uint32_t _lastPeak;		// 1/16サンプル単位
+	bool _hasPeak;
+	int _refractory;
+	int _timeout;
+	int32_t _amplitude;
+	int32_t _level;
+	uint16_t _ibi[HEART_RATE_IBI_COUNT];	// 1/16サンプル単位
+	int _ibiPos;
+	int _ibiCount;
+	int _bpm10;
+	int _confidence;
+	void ProcessSample(int32_t x);
+	void Evaluate();
+public:
+	void SetSampleRate(int sample_rate);
+	int GetSampleRate() { return _sample_rate; }
+	void Reset();
+	void Push(const uint16_t *samples, int count);
+	void Push(uint16_t sample) { Push(&sample, 1); }
+	/* 心拍数[bpm]、求まっていなければ0 */
+	int GetBpm() { return (_bpm10 + 5) / 10; }
+	/* 心拍数[0.1bpm] */
+	int GetBpm10() { return _bpm10; }
+	/* 信頼度 0～100 */
+	int GetConfidence() { return _confidence; }
+	/* 窓内での現在の脈波の位置 0～15 */
+	int GetLevel() { return _level; }
+};
+
+/*
+ * 記録した脈波で処理時間と心拍数の誤差を測る
+ *  filename    1行1サンプル（2列目があれば基準の心拍数[bpm]）
+ *  sample_rate 記録時のサンプリング周波数[Hz]
+ *  ref_bpm     基準の心拍数（2列目が無い場合に使う、0なら誤差は出さない）
+ */
+void HeartRateBench(const char *filename, int sample_rate, int ref_bpm);
+
+#endif // _HEARTRATE_H_
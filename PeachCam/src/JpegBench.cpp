@@ -0,0 +1,170 @@
+#include "mbed.h"
+#include "opencv.hpp"
+#include "JpegBench.h"
+#include <vector>
+
+// 段階ごとのメソッドを差し替えるためにjpegint.hの構造体を使う
+#define JPEG_INTERNALS
+#include "jpeglib.h"
+#include "jsimd.h"
+
+/* 1回の計測で圧縮する回数 */
+#define JPEG_BENCH_REPEAT	(20)
+#define JPEG_BENCH_WIDTH	(640)
+#define JPEG_BENCH_HEIGHT	(480)
+
+enum JpegStage {
+	JPEG_STAGE_COLOR,
+	JPEG_STAGE_DOWNSAMPLE,
+	JPEG_STAGE_DCT,
+	JPEG_STAGE_HUFFMAN,
+	JPEG_STAGE_TOTAL,
+	JPEG_STAGE_COUNT
+};
+
+static const char *stage_names[JPEG_STAGE_COUNT] = {
+	"color", "downsample", "fdct+quant", "huffman", "total"
+};
+
+/* 差し替える前のメソッドと段階ごとの時間の合計 */
+struct JpegStageHook {
+	void (*color_convert)(j_compress_ptr cinfo, JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+		JDIMENSION output_row, int num_rows);
+	void (*downsample)(j_compress_ptr cinfo, JSAMPIMAGE input_buf, JDIMENSION in_row_index,
+		JSAMPIMAGE output_buf, JDIMENSION out_row_group_index);
+	forward_DCT_ptr forward_DCT[MAX_COMPONENTS];
+	boolean (*encode_mcu)(j_compress_ptr cinfo, JBLOCKROW *MCU_data);
+	us_timestamp_t time[JPEG_STAGE_COUNT];
+};
+
+static JpegStageHook hook;
+
+static void hook_color_convert(j_compress_ptr cinfo, JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+	JDIMENSION output_row, int num_rows)
+{
+	us_timestamp_t start = ticker_read_us(get_us_ticker_data());
+	hook.color_convert(cinfo, input_buf, output_buf, output_row, num_rows);
+	hook.time[JPEG_STAGE_COLOR] += ticker_read_us(get_us_ticker_data()) - start;
+}
+
+static void hook_downsample(j_compress_ptr cinfo, JSAMPIMAGE input_buf, JDIMENSION in_row_index,
+	JSAMPIMAGE output_buf, JDIMENSION out_row_group_index)
+{
+	us_timestamp_t start = ticker_read_us(get_us_ticker_data());
+	hook.downsample(cinfo, input_buf, in_row_index, output_buf, out_row_group_index);
+	hook.time[JPEG_STAGE_DOWNSAMPLE] += ticker_read_us(get_us_ticker_data()) - start;
+}
+
+static void hook_forward_DCT(j_compress_ptr cinfo, jpeg_component_info *compptr, JSAMPARRAY sample_data,
+	JBLOCKROW coef_blocks, JDIMENSION start_row, JDIMENSION start_col, JDIMENSION num_blocks)
+{
+	us_timestamp_t start = ticker_read_us(get_us_ticker_data());
+	hook.forward_DCT[compptr->component_index](cinfo, compptr, sample_data, coef_blocks,
+		start_row, start_col, num_blocks);
+	hook.time[JPEG_STAGE_DCT] += ticker_read_us(get_us_ticker_data()) - start;
+}
+
+static boolean hook_encode_mcu(j_compress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+	us_timestamp_t start = ticker_read_us(get_us_ticker_data());
+	boolean ret = hook.encode_mcu(cinfo, MCU_data);
+	hook.time[JPEG_STAGE_HUFFMAN] += ticker_read_us(get_us_ticker_data()) - start;
+	return ret;
+}
+
+/* rgbを1回圧縮してjpegに入れる。stagesなら段階ごとの時間も測る */
+static void EncodeFrame(const uint8_t *rgb, int quality, bool stages, std::vector<uint8_t> &jpeg)
+{
+	struct jpeg_compress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	unsigned char *buffer = NULL;
+	unsigned long size = 0;
+
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	jpeg_mem_dest(&cinfo, &buffer, &size);
+
+	cinfo.image_width = JPEG_BENCH_WIDTH;
+	cinfo.image_height = JPEG_BENCH_HEIGHT;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_RGB;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, quality, TRUE);
+	jpeg_start_compress(&cinfo, TRUE);
+
+	// メソッドはjpeg_start_compressで決まるのでその後で差し替える
+	if (stages) {
+		hook.color_convert = cinfo.cconvert->color_convert;
+		cinfo.cconvert->color_convert = hook_color_convert;
+		hook.downsample = cinfo.downsample->downsample;
+		cinfo.downsample->downsample = hook_downsample;
+		for (int ci = 0; ci < cinfo.num_components; ci++) {
+			hook.forward_DCT[ci] = cinfo.fdct->forward_DCT[ci];
+			cinfo.fdct->forward_DCT[ci] = hook_forward_DCT;
+		}
+		hook.encode_mcu = cinfo.entropy->encode_mcu;
+		cinfo.entropy->encode_mcu = hook_encode_mcu;
+	}
+
+	for (int y = 0; y < JPEG_BENCH_HEIGHT; y++) {
+		JSAMPROW row = (JSAMPROW)&rgb[y * JPEG_BENCH_WIDTH * 3];
+		jpeg_write_scanlines(&cinfo, &row, 1);
+	}
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+
+	jpeg.assign(buffer, buffer + size);
+	free(buffer);
+}
+
+static double stage_rate(us_timestamp_t elapse)
+{
+	if (elapse == 0)
+		elapse = 1;
+	return (double)JPEG_BENCH_WIDTH * JPEG_BENCH_HEIGHT * 3 * JPEG_BENCH_REPEAT / (double)elapse;
+}
+
+void JpegStageBench(const char *filename, int quality)
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+	cv::Mat img = cv::imread(filename, cv::IMREAD_COLOR);
+	cv::Mat vga, rgb;
+	us_timestamp_t times[2][JPEG_STAGE_COUNT];
+	std::vector<uint8_t> jpeg[2];
+
+	if (img.empty()) {
+		printf("cannot read %s\n", filename);
+		return;
+	}
+	cv::resize(img, vga, cv::Size(JPEG_BENCH_WIDTH, JPEG_BENCH_HEIGHT));
+	cv::cvtColor(vga, rgb, cv::COLOR_BGR2RGB);
+
+#ifndef JSIMD_SUPPORTED
+	printf("libjpeg is built without SIMD\n");
+#endif
+	for (int simd = 0; simd < 2; simd++) {
+		jsimd_set_enabled(simd ? TRUE : FALSE);
+
+		// 段階ごとの時間は1回ごとのタイマーの読み出しを含むので、合計は差し替えずに測る
+		memset(hook.time, 0, sizeof(hook.time));
+		for (int n = 0; n < JPEG_BENCH_REPEAT; n++)
+			EncodeFrame(rgb.ptr(), quality, true, jpeg[simd]);
+
+		us_timestamp_t start = ticker_read_us(ticker);
+		for (int n = 0; n < JPEG_BENCH_REPEAT; n++)
+			EncodeFrame(rgb.ptr(), quality, false, jpeg[simd]);
+		hook.time[JPEG_STAGE_TOTAL] = ticker_read_us(ticker) - start;
+
+		memcpy(times[simd], hook.time, sizeof(hook.time));
+	}
+	jsimd_set_enabled(TRUE);
+
+	printf("%dx%d q%d, %d bytes, %.2fms/frame -> %.2fms/frame [MB/s]\n", JPEG_BENCH_WIDTH, JPEG_BENCH_HEIGHT,
+		quality, (int)jpeg[1].size(), times[0][JPEG_STAGE_TOTAL] / (JPEG_BENCH_REPEAT * 1000.0),
+		times[1][JPEG_STAGE_TOTAL] / (JPEG_BENCH_REPEAT * 1000.0));
+	for (int s = 0; s < JPEG_STAGE_COUNT; s++) {
+		printf("%-10s : C %7.1f, SIMD %7.1f (x%.2f)\n", stage_names[s], stage_rate(times[0][s]),
+			stage_rate(times[1][s]), stage_rate(times[1][s]) / stage_rate(times[0][s]));
+	}
+	printf("output %s\n", (jpeg[0] == jpeg[1]) ? "identical" : "mismatch");
+}
@@ -0,0 +1,12 @@
+#ifndef _JPEGBENCH_H_
+#define _JPEGBENCH_H_
+
+/*
+ * 画像をVGA（640x480）にしてlibjpegで何回も圧縮し、段階（色変換・間引き・DCTと量子化・
+ * ハフマン符号化）ごとの速度[MB/s]をC版とSIMD版で表示する。
+ * 両方の出力が同じバイト列になるかも調べる。
+ * ハフマン符号化はSIMDを使わないので、C版とSIMD版は同じ処理になる。
+ */
+void JpegStageBench(const char *filename, int quality);
+
+#endif // _JPEGBENCH_H_
@@ -10,11 +10,20 @@
 #include "Palettes.h"
 #include "EasyAttach_CameraAndLCD.h"
 #include "crc16.h"
+#include "StreamRecord.h"
+#include "ThermalRecord.h"
+#include "StorageTask.h"
 
 #define RESULT_BUFFER_BYTE_PER_PIXEL  (2u)
 #define RESULT_BUFFER_STRIDE          (((LCD_PIXEL_WIDTH * RESULT_BUFFER_BYTE_PER_PIXEL) + 31u) & ~31u)
 #define RESULT_BUFFER_HEIGHT          (LCD_PIXEL_HEIGHT)
 extern uint8_t user_frame_buffer_result[RESULT_BUFFER_STRIDE * RESULT_BUFFER_HEIGHT]__attribute((section("NC_BSS"), aligned(32)));
+extern DisplayBase Display;
+
+/* 重ね合わせ専用のレイヤー（カメラと検出結果の間、ARGB4444） */
+#define FUSION_BUFFER_STRIDE          (((LCD_PIXEL_WIDTH * 2u) + 31u) & ~31u)
+#define FUSION_BUFFER_HEIGHT          (LCD_PIXEL_HEIGHT)
+static uint8_t fusion_frame_buffer[FUSION_BUFFER_STRIDE * FUSION_BUFFER_HEIGHT]__attribute((section("NC_BSS"), aligned(32)));
 
 const unsigned char BMPHeader[BITMAP_HEADER_SIZE] = {
 	0x42, 0x4D,					// "BM"
@@ -39,6 +48,14 @@ const unsigned char BMPHeader[BITMAP_HEADER_SIZE] = {
 	0x00, 0x00, 0x00, 0x00		// α成分のカラーマスク
 };
 
+static void set_le32(uint8_t *pos, uint32_t value)
+{
+	pos[0] = (uint8_t)value;
+	pos[1] = (uint8_t)(value >> 8);
+	pos[2] = (uint8_t)(value >> 16);
+	pos[3] = (uint8_t)(value >> 24);
+}
+
 LeptonTask::LeptonTask(TaskThread *taskThread) :
 	Task(osWaitForever),
 	_state(State::PowerOff),
@@ -49,9 +66,14 @@ LeptonTask::LeptonTask(TaskThread *taskThread) :
 	_port(),
 	_resets(0),
 	_minValue(65535), _maxValue(0),
-	_packets_per_frame(60),
-	_frame_packet(),
+	_telemetry(false),
 	_async(0),
+	_width(0), _height(0),
+	_segment(),
+	_invalidSegments(0),
+	_restartedSegments(0),
+	_capture(NULL),
+	_colorize(NULL),
 	_telemetryA(),
 	_telemetryB(),
 	_telemetryC(),
@@ -61,16 +83,21 @@ LeptonTask::LeptonTask(TaskThread *taskThread) :
 	_runFFCNormReq(0),
 	_telemetryReq(0),
 	_spotmeterReq(0),
+	_denoiseReq(0),
+	_filter(),
+	_fusionReq(0),
+	_fusionEnable(false),
+	_fusion(),
 	_spotmeterRoi(),
 	_reqSpotmeterRoi()
 {
-	memcpy(_image, BMPHeader, BITMAP_HEADER_SIZE);
-	memset(&_image[BITMAP_HEADER_SIZE / 2], 0xFF, sizeof(_image) - BITMAP_HEADER_SIZE);
+	// 型番が分かるまではLepton 2.xとして扱う
+	SetGeometry<Lepton2Geometry>();
 
-	_spotmeterRoi.startRow = 9 * PACKETS_PER_FRAME / 20;
-	_spotmeterRoi.endRow = 11 * PACKETS_PER_FRAME / 20;
-	_spotmeterRoi.startCol = 9 * PIXEL_PER_LINE / 20;
-	_spotmeterRoi.endCol = 11 * PIXEL_PER_LINE / 20;
+	_spotmeterRoi.startRow = 9 * Lepton2Geometry::Height / 20;
+	_spotmeterRoi.endRow = 11 * Lepton2Geometry::Height / 20;
+	_spotmeterRoi.startCol = 9 * Lepton2Geometry::Width / 20;
+	_spotmeterRoi.endCol = 11 * Lepton2Geometry::Width / 20;
 }
 
 LeptonTask::~LeptonTask()
@@ -236,6 +263,7 @@ void LeptonTask::OnStart()
 	}
 
 	LEP_OEM_PART_NUMBER_T partNumber;
+	bool lepton3 = false;
 	printf("FLiR OEM part number");
 	ret = LEP_GetOemFlirPartNumber(&_port, &partNumber);
 	if (ret == LEP_OK) {
@@ -248,8 +276,14 @@ void LeptonTask::OnStart()
 			printf("25 deg (l2)\n");
 		else if (strcmp(partNumber.value, "500-0763-01") == 0)
 			printf("shuttered 50 deg + radiometric (l2.5)\n");
-		else if (strcmp(partNumber.value, "500-0726-01") == 0)
+		else if (strcmp(partNumber.value, "500-0726-01") == 0) {
 			printf("shuttered 50 deg (l3)\n");
+			lepton3 = true;
+		}
+		else if (strcmp(partNumber.value, "500-0771-01") == 0) {
+			printf("shuttered 57 deg + radiometric (l3.5)\n");
+			lepton3 = true;
+		}
 		else
 			printf("unknown\n\n");
 	}
@@ -257,6 +291,12 @@ void LeptonTask::OnStart()
 		printf(" %s %d\n", GetLeptonErrorString(ret), ret);
 	}
 
+	if (lepton3)
+		SetGeometry<Lepton3Geometry>();
+	else
+		SetGeometry<Lepton2Geometry>();
+	printf("Image %dx%d\n", _width, _height);
+
 	printf("Get spotmeter ROI");
 	ret = LEP_GetRadSpotmeterRoi(&_port, &_spotmeterRoi);
 	if (ret == LEP_OK) {
@@ -635,15 +675,10 @@ void LeptonTask::EnableTelemetry(bool enable)
 	}
 
 	LEP_SYS_TELEMETRY_ENABLE_STATE_E telemetory = LEP_TELEMETRY_DISABLED;
-	printf("Packet Per Frame");
+	printf("Telemetry packets");
 	LEP_GetSysTelemetryEnableState(&_port, &telemetory);
-	if (telemetory != LEP_TELEMETRY_DISABLED) {
-		_packets_per_frame = 63;
-	}
-	else {
-		_packets_per_frame = 60;
-	}
-	printf(" %d\n", _packets_per_frame);
+	_telemetry = (telemetory != LEP_TELEMETRY_DISABLED);
+	printf(" %s\n", _telemetry ? "on" : "off");
 }
 
 void LeptonTask::GetSpotmeterObj()
@@ -744,23 +779,335 @@ void LeptonTask::ProcessEvent(InterTaskSignals::T signals)
 	}
 }
 
-void LeptonTask::Process()
+/*
+ * 型番で決まるセンサーの構成を選ぶ
+ * 読み込みと表示は構成ごとに展開した関数を使うので、画素ごとに構成で分岐しない。
+ */
+template <class G>
+void LeptonTask::SetGeometry()
+{
+	uint8_t *header = (uint8_t *)_image;
+	uint32_t size = G::Width * G::Height * sizeof(uint16_t);
+
+	_width = G::Width;
+	_height = G::Height;
+	_capture = &LeptonTask::CaptureFrame<G>;
+	_colorize = &LeptonTask::Colorize<G>;
+
+	memcpy(header, BMPHeader, BITMAP_HEADER_SIZE);
+	set_le32(&header[2], BITMAP_HEADER_SIZE + size);	// ファイルサイズ
+	set_le32(&header[18], G::Width);
+	set_le32(&header[22], G::Height);
+	set_le32(&header[34], size);						// 画像データサイズ
+	memset(&_image[BITMAP_HEADER_SIZE / 2], 0xFF, size);
+}
+
+void LeptonTask::ReadPacket(uint8_t *packet)
+{
+	_spi.lock();
+	_ss = 0;
+	_spi.write(NULL, 0, (char *)packet, PACKET_SIZE);
+	_ss = 1;
+	_spi.unlock();
+}
+
+/*
+ * 1フレーム分のセグメントを読む
+ * パケット番号が続かなければそのセグメントだけを先頭から読み直す（揃えたセグメントは残す）。
+ * Lepton 3.xは20番目のパケットのセグメント番号（0は無効）で1から順に
+ * 揃ったことを確かめてから画像に書く。
+ * falseを返すのはフレームの前の捨てパケットと、読み直しや捨てたセグメントが
+ * 上限を超えたときで、呼び出し側はこれを同期外れとして数える。
+ */
+template <class G>
+bool LeptonTask::CaptureFrame()
+{
+	const int packets = G::VideoPackets + (_telemetry ? G::TelemetryPackets : 0);
+	const int row_packets = G::Width / PACKET_PIXELS;
+	int segment = 0;		// 次に揃えるセグメント（0始まり）
+	int discards = 0;
+	int drops = 0;
+	bool started = false;	// フレームのパケットを読み始めた
+
+	while (segment < G::Segments) {
+		int number = 1;
+
+		for (int p = 0; p < packets; ) {
+			uint8_t *packet = _segment[p];
+			ReadPacket(packet);
+
+			int id = (packet[0] << 8) | packet[1];
+			bool discard = (id & 0x0F00) == 0x0F00;
+			if (p == 0) {
+				// フレームの前の捨てパケットは呼び出し側で数えて待つ
+				if (discard && !started)
+					return false;
+				// セグメントの先頭まで読み飛ばす
+				if (discard || ((id & 0x0FFF) != 0)) {
+					if (++discards >= LEPTON_SEGMENT_DISCARD_MAX)
+						return false;
+					continue;
+				}
+			}
+			else if (discard || ((id & 0x0FFF) != p)) {
+				// 途切れたセグメントだけを読み直す
+				_restartedSegments++;
+				if (++discards >= LEPTON_SEGMENT_DISCARD_MAX)
+					return false;
+				if (!discard && ((id & 0x0FFF) == 0)) {
+					// 途切れたパケットが次のセグメントの先頭ならそこから使う
+					memcpy(_segment[0], packet, PACKET_SIZE);
+					p = 1;
+				}
+				else {
+					p = 0;
+				}
+				continue;
+			}
+
+			if ((G::Segments > 1) && (p == LEPTON_SEGMENT_PACKET))
+				number = (id >> 12) & 0x07;
+			started = true;
+			p++;
+		}
+
+		if ((number == 0) || (number > G::Segments)) {
+			_invalidSegments++;
+			number = 0;
+		}
+		else if (number == 1) {
+			// 途中からでも1番が来たらフレームの先頭から揃え直す
+			segment = 0;
+		}
+		if (number != segment + 1) {
+			if (++drops >= LEPTON_SEGMENT_DROP_MAX)
+				return false;
+			segment = 0;
+			continue;
+		}
+
+		for (int p = 0; p < packets; p++) {
+			// フレームの中の通し番号（映像のあとにテレメトリが並ぶ）
+			int index = segment * packets + p;
+			if (index < G::Height * row_packets) {
+				int row = index / row_packets;
+				uint16_t *pixel = &_image[BITMAP_HEADER_SIZE / 2 + G::Width * (G::Height - 1 - row)
+					+ PACKET_PIXELS * (index % row_packets)];
+				const uint16_t *values = (const uint16_t *)_segment[p] + 2;
+				for (int i = 0; i < PACKET_PIXELS; i++) {
+					uint16_t value = values[i];
+					pixel[i] = (value >> 8) | (value << 8);
+				}
+			}
+			else switch (index - G::Height * row_packets) {
+			case 0:
+				memcpy(&_telemetryA, _segment[p], sizeof(_telemetryA));
+				break;
+			case 1:
+				memcpy(&_telemetryB, _segment[p], sizeof(_telemetryB));
+				break;
+			case 2:
+				memcpy(&_telemetryC, _segment[p], sizeof(_telemetryC));
+				break;
+			}
+		}
+		segment++;
+	}
+
+	return true;
+}
+
+static uint16_t hue_color(uint16_t value)
 {
-	uint8_t *result = _frame_packet;
-	uint16_t *frameBuffer;
-	uint16_t value, minValue, maxValue;
-	float scale;
-	int diff, packet_id;
-	uint16_t *values;
+	int colormap[3];
+	int span = 256;
+	int max = span - 1;
+	int h = value % (max * 6);
+	int s;
+	int b;
+	if (value < (1 << 13)) {
+		s = (span * value) / (1 << 13);
+		b = 0;
+	}
+	else {
+		value -= (1 << 13);
+		b = (span * value) / (1 << 13);
+		s = span - b;
+	}
+
+	int p = (h / max) % 6;
+	h %= span;
+	switch (p) {
+	case 0:
+		colormap[0] = b;
+		colormap[1] = ((s * h) / span) + b;
+		colormap[2] = ((s * max) / span) + b;
+		break;
+	case 1:
+		colormap[0] = b;
+		colormap[1] = ((s * max) / span) + b;
+		colormap[2] = ((s * (max - h)) / span) + b;
+		break;
+	case 2:
+		colormap[0] = ((s * h) / span) + b;
+		colormap[1] = ((s * max) / span) + b;
+		colormap[2] = b;
+		break;
+	case 3:
+		colormap[0] = ((s * max) / span) + b;
+		colormap[1] = ((s * (max - h)) / span) + b;
+		colormap[2] = b;
+		break;
+	case 4:
+		colormap[0] = ((s * max) / span) + b;
+		colormap[1] = b;
+		colormap[2] = ((s * h) / span) + b;
+		break;
+	default:
+		colormap[0] = ((s * (max - h)) / span) + b;
+		colormap[1] = b;
+		colormap[2] = ((s * max) / span) + b;
+		break;
+	}
+	colormap[0] = 256 * colormap[0] / span;
+	colormap[1] = 256 * colormap[1] / span;
+	colormap[2] = 256 * colormap[2] / span;
+
+	// ARGB4444
+	return 0xF000 | ((colormap[0] >> 4) << 8) | ((colormap[1] >> 4) << 4) | ((colormap[2] >> 4) << 0);
+}
 
+const uint8_t *LeptonTask::GetColormap()
+{
+	switch (_config->color) {
+	case 0:
+		return colormap_rainbow;
+	case 1:
+		return colormap_grayscale;
+	case 2:
+		return colormap_ironblack;
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * 重ね合わせのレイヤーを表示する・消す
+ * 顔の枠や文字を描く検出結果のレイヤーとは分けて、その下に置く。
+ */
+void LeptonTask::ShowFusionLayer(bool show)
+{
+	DisplayBase::rect_t rect;
+
+	if (!show) {
+		Display.Graphics_Stop(DisplayBase::GRAPHICS_LAYER_1);
+		memset(fusion_frame_buffer, 0, sizeof(fusion_frame_buffer));
+		return;
+	}
+
+	memset(fusion_frame_buffer, 0, sizeof(fusion_frame_buffer));
+	rect.vs = 0;
+	rect.vw = FUSION_BUFFER_HEIGHT;
+	rect.hs = 0;
+	rect.hw = LCD_PIXEL_WIDTH;
+	Display.Graphics_Read_Setting(
+		DisplayBase::GRAPHICS_LAYER_1,
+		(void *)fusion_frame_buffer,
+		FUSION_BUFFER_STRIDE,
+		DisplayBase::GRAPHICS_FORMAT_ARGB4444,
+		DisplayBase::WR_RD_WRSWA_32_16BIT,
+		&rect
+	);
+	Display.Graphics_Start(DisplayBase::GRAPHICS_LAYER_1);
+}
+
+/*
+ * 画像をカメラ画像の大きさに広げて重ねる（色相の色付けは白黒にする）
+ */
+void LeptonTask::RenderFusion()
+{
+	// 画像は下から上に並んでいるので、最後の行から負の間隔で渡す
+	_fusion.Render((uint16_t *)fusion_frame_buffer, FUSION_BUFFER_STRIDE / 2,
+		LCD_PIXEL_WIDTH, LCD_PIXEL_HEIGHT, &_image[BITMAP_HEADER_SIZE / 2 + _width * (_height - 1)], -_width,
+		_width, _height, _filter.GetRangeMin(), _filter.GetRangeMax(), GetColormap());
+}
+
+/*
+ * 画像を色付けして画面の右上に描く
+ */
+template <class G>
+void LeptonTask::Colorize()
+{
+	// スポットメーターの値はフレームごとにゆらぐので平滑化した範囲を使う
+	uint16_t maxValue = _filter.GetRangeMax();
+	uint16_t minValue = _filter.GetRangeMin();
+	int diff = maxValue - minValue;
+	const uint8_t *colormap;
+
+	if (diff < 256) {
+		diff = 256;
+		minValue = (maxValue + minValue) / 2;
+		if (minValue < 128)
+			minValue = 0;
+		else
+			minValue -= 128;
+	}
+	float scale = 255.9f / diff;
+
+	colormap = GetColormap();
+
+	const uint16_t *values = &_image[BITMAP_HEADER_SIZE / 2];
+	for (int row = 0; row < G::Height; row++) {
+		uint16_t *pixel = &((uint16_t *)&user_frame_buffer_result)[(LCD_PIXEL_WIDTH - 1 - G::Width) + (LCD_PIXEL_HEIGHT - 1 - row) * LCD_PIXEL_WIDTH];
+		if (colormap != NULL) {
+			for (int column = 0; column < G::Width; column++) {
+				// 範囲は遅れて追従するので外れた値は端の色にする
+				int index = (int)((*values++ - minValue) * scale);
+				if (index < 0)
+					index = 0;
+				else if (index > 255)
+					index = 255;
+				const uint8_t *color = &colormap[3 * index];
+				// ARGB4444
+				*pixel++ = 0xF000 | ((color[0] >> 4) << 8) | ((color[1] >> 4) << 4) | ((color[2] >> 4) << 0);
+			}
+		}
+		else {
+			for (int column = 0; column < G::Width; column++) {
+				*pixel++ = hue_color(*values++);
+			}
+		}
+	}
+}
+
+void LeptonTask::RecordFrame()
+{
+	uint8_t telemetry[THERMAL_TELEMETRY_SIZE];
+
+	if (_telemetry) {
+		memset(telemetry, 0, sizeof(telemetry));
+		memcpy(&telemetry[0 * THERMAL_TELEMETRY_ROW_SIZE], &_telemetryA, sizeof(_telemetryA));
+		memcpy(&telemetry[1 * THERMAL_TELEMETRY_ROW_SIZE], &_telemetryB, sizeof(_telemetryB));
+		memcpy(&telemetry[2 * THERMAL_TELEMETRY_ROW_SIZE], &_telemetryC, sizeof(_telemetryC));
+	}
+
+	// 画像は下から上に並んでいるので、最後の行から負の間隔で渡す
+	thermalRecorder.WriteFrame(&_image[BITMAP_HEADER_SIZE / 2 + _width * (_height - 1)],
+		_width, _height, -_width, _telemetry ? telemetry : NULL);
+}
+
+void LeptonTask::Process()
+{
 	if (_timer != 0)
 		return;
 
 	switch (_state) {
 	case State::PowerOn:
 		PowerOn();
+		_filter.Reset();
 		_ss = 0;
 		printf("reset\n");
+		streamRecorder.WriteResync();
 		_state = State::Resets;
 		_timer = 750;
 		break;
@@ -772,94 +1119,28 @@ void LeptonTask::Process()
 		_timer = 1;
 		break;
 	case State::Capture:
-		minValue = 65535;
-		maxValue = 0;
-		packet_id = -1;
-		for (int row = 0; row < _packets_per_frame; ) {
-			_spi.lock();
-			_ss = 0;
-			_spi.write(NULL, 0, (char *)result, PACKET_SIZE);
-			_ss = 1;
-			_spi.unlock();
-
-			int id = (result[0] << 8) | result[1];
-			if (id == packet_id) {
-				row++;
-				continue;
+		if (!(this->*_capture)()) {
+			_async++;
+			if (_async >= 10000) {
+				_ss = 0;
+				printf("reset\n");
+				streamRecorder.WriteResync();
+				_state = State::Resets;
+				_timer = 750;
 			}
-			else if ((id & 0x0F00) == 0x0F00) {
-				if (packet_id != -1) {
-					row++;
-					continue;
-				}
-				_async++;
-				if (_async >= 10000) {
-					_ss = 0;
-					printf("reset\n");
-					_state = State::Resets;
-					_timer = 750;
-				}
-				else {
-					_state = State::Capture;
-					_timer = 0;
-				}
-				return;
+			else {
+				_state = State::Capture;
+				_timer = 0;
 			}
-
-			if ((packet_id == -1) && ((id & 0x0FFF) != 0x7FF)) {
-				int r = 2 * (id & 0x00FF);
-				if (r >= _packets_per_frame)
-					continue;
-				row = r;
-			}
-			packet_id = id;
-
-			if (row < PACKETS_PER_FRAME) {
-				uint16_t *pixel = &_image[BITMAP_HEADER_SIZE / 2 + PIXEL_PER_LINE * (PACKETS_PER_FRAME - 1 - row)];
-				frameBuffer = (uint16_t *)result;
-				int col = 0;
-				for (int i = 2; i < PACKET_SIZE_UINT16; i++) {
-					value = frameBuffer[i];
-					value = (value >> 8) | (value << 8);
-					//frameBuffer[i] = value;
-
-					//if ((_spotmeterRoi.startRow <= row) && (_spotmeterRoi.endRow >= row)
-					//	&& (_spotmeterRoi.startCol <= col) && (_spotmeterRoi.endCol >= col)) {
-						if (value > maxValue) {
-							maxValue = value;
-						}
-						if (value < minValue) {
-							minValue = value;
-						}
-					//}
-					col++;
-					*pixel++ = value;
-				}
-			}
-			else switch (row - PACKETS_PER_FRAME) {
-			case 0:
-				frameBuffer = (uint16_t *)result;
-				memcpy(&_telemetryA, frameBuffer, sizeof(_telemetryA));
-				break;
-			case 1:
-				frameBuffer = (uint16_t *)result;
-				memcpy(&_telemetryB, frameBuffer, sizeof(_telemetryB));
-				break;
-			case 2:
-				frameBuffer = (uint16_t *)result;
-				memcpy(&_telemetryC, frameBuffer, sizeof(_telemetryC));
-				break;
-			}
-
-			row++;
-		}
-
-		if (packet_id == -1) {
-			_state = State::Viewing;
-			_timer = 0;
 			return;
 		}
 
+		if (thermalRecorder.IsRecording())
+			RecordFrame();
+
+		// 記録は生の値、表示と範囲は雑音を除いた値を使う
+		_filter.Process(&_image[BITMAP_HEADER_SIZE / 2], _width * _height);
+
 		//_maxValue = maxValue;
 		//_minValue = minValue;
 		GetSpotmeterObj(&_minValue, &_maxValue);
@@ -915,118 +1196,43 @@ void LeptonTask::Process()
 			SetSpotmeterRoi(_reqSpotmeterRoi);
 			break;
 		}
+		switch (_fusionReq) {
+		case 1:
+			_fusionReq = 0;
+			_fusionEnable = false;
+			ShowFusionLayer(false);
+			break;
+		case 2:
+			_fusionReq = 0;
+			_fusionEnable = true;
+			ShowFusionLayer(true);
+			break;
+		}
+		switch (_denoiseReq) {
+		case 1:
+			_denoiseReq = 0;
+			_filter.SetEnable(false);
+			break;
+		case 2:
+			_denoiseReq = 0;
+			_filter.SetEnable(true);
+			break;
+		}
 		_state = State::Viewing;
 		_timer = 0;
 		break;
 	case State::Viewing:
-		maxValue = _maxValue;
-		minValue = _minValue;
-		diff = maxValue - minValue;
-		if (diff < 256) {
-			diff = 256;
-			minValue = (maxValue + minValue) / 2;
-			if (minValue < 128)
-				minValue = 0;
-			else
-				minValue -= 128;
-		}
-		scale = 255.9f / diff;
-
-		values = &_image[BITMAP_HEADER_SIZE / 2];
-		for (int row = 0; row < PACKETS_PER_FRAME; row++) {
-			uint16_t *pixel = &((uint16_t *)&user_frame_buffer_result)[(LCD_PIXEL_WIDTH - 1 - PIXEL_PER_LINE) + (LCD_PIXEL_HEIGHT - 1 - row) * LCD_PIXEL_WIDTH];
-			for (int column = 0; column < PIXEL_PER_LINE; column++) {
-				uint16_t value = *values;
-				uint8_t index;
-				int colormap[3];
-
-				switch (_config->color) {
-				case 0:
-					index = (uint8_t)((value - minValue) * scale);
-					colormap[0] = colormap_rainbow[3 * index];
-					colormap[1] = colormap_rainbow[3 * index + 1];
-					colormap[2] = colormap_rainbow[3 * index + 2];
-					break;
-				case 1:
-					index = (uint8_t)((value - minValue) * scale);
-					colormap[0] = colormap_grayscale[3 * index];
-					colormap[1] = colormap_grayscale[3 * index + 1];
-					colormap[2] = colormap_grayscale[3 * index + 2];
-					break;
-				case 2:
-					index = (uint8_t)((value - minValue) * scale);
-					colormap[0] = colormap_ironblack[3 * index];
-					colormap[1] = colormap_ironblack[3 * index + 1];
-					colormap[2] = colormap_ironblack[3 * index + 2];
-					break;
-				default:
-				{
-					int span = 256;
-					int max = span - 1;
-					int h = value % (max * 6);
-					int s;
-					int b;
-					if (value < (1 << 13)) {
-						s = (span * value) / (1 << 13);
-						b = 0;
-					}
-					else {
-						value -= (1 << 13);
-						b = (span * value) / (1 << 13);
-						s = span - b;
-					}
-
-					int p = (h / max) % 6;
-					h %= span;
-					switch (p) {
-					case 0:
-						colormap[0] = b;
-						colormap[1] = ((s * h) / span) + b;
-						colormap[2] = ((s * max) / span) + b;
-						break;
-					case 1:
-						colormap[0] = b;
-						colormap[1] = ((s * max) / span) + b;
-						colormap[2] = ((s * (max - h)) / span) + b;
-						break;
-					case 2:
-						colormap[0] = ((s * h) / span) + b;
-						colormap[1] = ((s * max) / span) + b;
-						colormap[2] = b;
-						break;
-					case 3:
-						colormap[0] = ((s * max) / span) + b;
-						colormap[1] = ((s * (max - h)) / span) + b;
-						colormap[2] = b;
-						break;
-					case 4:
-						colormap[0] = ((s * max) / span) + b;
-						colormap[1] = b;
-						colormap[2] = ((s * h) / span) + b;
-						break;
-					default:
-						colormap[0] = ((s * (max - h)) / span) + b;
-						colormap[1] = b;
-						colormap[2] = ((s * max) / span) + b;
-						break;
-					}
-					colormap[0] = 256 * colormap[0] / span;
-					colormap[1] = 256 * colormap[1] / span;
-					colormap[2] = 256 * colormap[2] / span;
-					break;
-				}
-				}
-				// ARGB4444
-				*pixel++ = 0xF000 | ((colormap[0] >> 4) << 8) | ((colormap[1] >> 4) << 4) | ((colormap[2] >> 4) << 0);
-				values++;
-			}
-		}
+		if (_fusionEnable)
+			RenderFusion();
+		else
+			(this->*_colorize)();
 
 		// https://lepton.flir.com/application-notes/lepton-with-radiometry/
 		// https://github.com/groupgets/LeptonModule/blob/master/software/raspberrypi_video/LeptonThread.cpp
 		if (_resets >= 750) {
 			_ss = 0;
 			printf("reset\n");
+			streamRecorder.WriteResync();
 			_state = State::Resets;
 			_timer = 750;
 		}
@@ -1047,13 +1253,12 @@ void LeptonTask::Process()
 	}
 }
 
-void LeptonTask::SaveImage(const char *filename)
+void LeptonTask::SaveImage(StorageTask *storage, const char *filename)
 {
-	FILE *fp = fopen(filename, "wb");
-	if (fp == NULL)
-		return;
-	fwrite(_image, sizeof(uint16_t), IMAGE_SIZE, fp);
-	fclose(fp);
+	const uint8_t *image = (const uint8_t *)_image;
+	size_t size = BITMAP_HEADER_SIZE + _width * _height * sizeof(uint16_t);
+
+	storage->WriteFile(filename, std::vector<uint8_t>(image, image + size), false);
 }
 
 extern "C" {
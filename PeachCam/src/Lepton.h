@@ -3,6 +3,8 @@
 
 #include "TaskBase.h"
 #include "LEPTON_Types.h"
+#include "ThermalFilter.h"
+#include "ThermalFusion.h"
 #include "LEPTON_RAD.h"
 
 #ifdef _MSC_VER
@@ -105,12 +107,46 @@ struct lepton_config_t {
 
 #define PACKET_SIZE (164)
 #define PACKET_SIZE_UINT16 (PACKET_SIZE/2)
-#define PACKETS_PER_FRAME (60)
-#define PIXEL_PER_LINE (80)
+#define PACKET_PIXELS (80)
 #define BITMAP_HEADER_SIZE (70)
-#define IMAGE_SIZE (BITMAP_HEADER_SIZE/2 + PIXEL_PER_LINE * PACKETS_PER_FRAME)
+
+/*
+ * センサーの画素数とVoSPIのセグメント構成
+ * 1パケットは80画素で、Lepton 3.xは1行が2パケット、1フレームが4セグメントになる。
+ * テレメトリを有効にするとセグメントごとのパケットが増え、
+ * フレームの末尾（フッター）にテレメトリA、B、Cのパケットが並ぶ。
+ */
+struct Lepton2Geometry {
+	enum {
+		Width = 80,
+		Height = 60,
+		Segments = 1,
+		VideoPackets = 60,			// セグメントごとの映像のパケット数
+		TelemetryPackets = 3,		// テレメトリで増えるセグメントごとのパケット数
+	};
+};
+
+struct Lepton3Geometry {
+	enum {
+		Width = 160,
+		Height = 120,
+		Segments = 4,
+		VideoPackets = 60,
+		TelemetryPackets = 1,
+	};
+};
+
+/* セグメント番号が入るパケット（Lepton 3.x） */
+#define LEPTON_SEGMENT_PACKET (20)
+/* セグメントの間で待つ捨てパケットと、途切れて読み直すパケットの上限 */
+#define LEPTON_SEGMENT_DISCARD_MAX (4 * 1000)
+/* 無効・順番違いで捨てるセグメントの上限（Lepton 3.xは3フレームに1回だけ有効） */
+#define LEPTON_SEGMENT_DROP_MAX (4 * 3 * 4)
+#define LEPTON_SEGMENT_PACKETS_MAX (Lepton2Geometry::VideoPackets + Lepton2Geometry::TelemetryPackets)
+#define IMAGE_SIZE (BITMAP_HEADER_SIZE/2 + Lepton3Geometry::Width * Lepton3Geometry::Height)
 
 class TaskThread;
+class StorageTask;
 
 class LeptonTask : public Task
 {
@@ -141,10 +177,15 @@ private:
 	LEP_CAMERA_PORT_DESC_T _port;
 	int _resets;
 	uint16_t _minValue, _maxValue;
-	int _packets_per_frame;
+	bool _telemetry;
 	int _async;
-	uint8_t _frame_packet[PACKET_SIZE];
+	int _width, _height;
+	uint8_t _segment[LEPTON_SEGMENT_PACKETS_MAX][PACKET_SIZE];
 	uint16_t _image[IMAGE_SIZE];
+	uint32_t _invalidSegments;
+	uint32_t _restartedSegments;	// パケット番号が途切れて読み直したセグメント
+	bool (LeptonTask::*_capture)();
+	void (LeptonTask::*_colorize)();
 	TLeptonTelemetryA _telemetryA;
 	TLeptonTelemetryB _telemetryB;
 	TLeptonTelemetryC _telemetryC;
@@ -155,6 +196,11 @@ private:
 	bool _runFFCNormReq;
 	int _telemetryReq;
 	int _spotmeterReq;
+	int _denoiseReq;
+	ThermalFilter _filter;
+	int _fusionReq;
+	bool _fusionEnable;
+	ThermalFusion _fusion;
 	LEP_RAD_ROI_T _spotmeterRoi;
 	LEP_RAD_ROI_T _reqSpotmeterRoi;
 	void EnableAgc(bool enable);
@@ -166,17 +212,30 @@ private:
 	void SetSpotmeterRoi(LEP_RAD_ROI_T newRoi);
 	void LowPower();
 	void PowerOn();
+	template <class G> void SetGeometry();
+	template <class G> bool CaptureFrame();
+	template <class G> void Colorize();
+	void ReadPacket(uint8_t *packet);
+	void RecordFrame();
+	const uint8_t *GetColormap();
+	void ShowFusionLayer(bool show);
+	void RenderFusion();
 public:
 	void OnStart() override;
 	void ProcessEvent(InterTaskSignals::T signals) override;
 	void Process() override;
 	void SetConfig(lepton_config_t *config) { _config = config; }
-	void SaveImage(const char *filename);
+	void SaveImage(StorageTask *storage, const char *filename);
 	void ReqAgc(bool enable) { _agcReq = enable ? 2 : 1; }
 	void ReqRadiometry(bool enable) { _radiometryReq = enable ? 2 : 1; }
 	void ReqFFCNormalization() { _runFFCNormReq = 1; }
 	void ReqTelemetry(bool enable) { _telemetryReq = enable ? 2 : 1; }
 	void ReqGetSpotmeterObj() { _spotmeterReq = 1; }
+	void ReqDenoise(bool enable) { _denoiseReq = enable ? 2 : 1; }
+	void ReqFusion(bool enable) { _fusionReq = enable ? 2 : 1; }
+	void SetStorage(StorageTask *storage) { _fusion.SetStorage(storage); }
+	bool IsFusionEnabled() { return _fusionEnable; }
+	ThermalFusion *GetFusion() { return &_fusion; }
 	void ReqSetSpotmeterRoi(int x0, int y0, int x1, int y1)
 	{
 		_reqSpotmeterRoi.startCol = (LEP_UINT16)x0;
@@ -185,6 +244,12 @@ public:
 		_reqSpotmeterRoi.endRow = (LEP_UINT16)y1;
 		_spotmeterReq = 2;
 	}
+	int GetWidth() { return _width; }
+	int GetHeight() { return _height; }
+	uint32_t GetInvalidSegments() { return _invalidSegments; }
+	uint32_t GetRestartedSegments() { return _restartedSegments; }
+	bool IsDenoiseEnabled() { return _filter.IsEnabled(); }
+	int GetNoiseThreshold() { return _filter.GetThreshold(); }
 	uint16_t GetMinValue() { return _minValue; }
 	uint16_t GetMaxValue() { return _maxValue; }
 	uint16_t GetTelemetryRevision() { return _telemetryA.TelemetryRevision; }
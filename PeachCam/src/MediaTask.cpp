@@ -1,6 +1,7 @@
 #include "mbed.h"
 #include "MediaTask.h"
 #include "GlobalState.h"
+#include "StorageTask.h"
 #include "DisplayBase.h"
 #include "draw_font.h"
 #include "platform/CriticalSectionLock.h"
@@ -10,6 +11,10 @@ using namespace cv;
 
 #define AUDIO_FRAME_BUFFER_STRIDE    (((LCD_PIXEL_WIDTH * 2) + 31u) & ~31u)
 #define AUDIO_FRAME_BUFFER_HEIGHT    (LCD_PIXEL_HEIGHT)
+/* 顔検出のMatのプールを慣らすフレーム数（これより後にヒープから確保したら数える） */
+#define FACE_POOL_WARMUP_FRAMES      (10)
+/* 変化した範囲の周りも顔の一部として探す幅（変化した範囲の大きさに対する割合） */
+#define FACE_SEARCH_MARGIN_RATIO     (2)
 
 static uint8_t audio_frame_buffer[AUDIO_FRAME_BUFFER_STRIDE * AUDIO_FRAME_BUFFER_HEIGHT]__attribute((section("NC_BSS"),aligned(32)));
 
@@ -120,12 +125,11 @@ static void disp_audio_wave(int16_t * p_data, int32_t size, uint32_t color) {
 #define AUDIO_IN_BUF_NUM		(16)
 #define AUDIO_OUT_BUF_SIZE		(2048)
 #define AUDIO_OUT_BUF_NUM		(8)
+/* 1回の録音の長さ[s] */
+#define AUDIO_REC_SECONDS		(10)
 
 static uint8_t audio_in_buf[AUDIO_IN_BUF_NUM][AUDIO_IN_BUF_SIZE]__attribute((section("NC_BSS"), aligned(4)));
 static uint8_t audio_out_buf[AUDIO_OUT_BUF_NUM][AUDIO_OUT_BUF_SIZE]__attribute((section("NC_BSS"), aligned(4)));
-#if CHANNEL_NUM == 1
-static uint8_t audio_file_buf[AUDIO_IN_BUF_SIZE / 2];
-#endif
 uint8_t heart_mark;
 
 #define LE_2BYTE_NUM(x)			(x & 0xFF),((x >> 8) & 0xFF)
@@ -157,12 +161,20 @@ static const unsigned char wav_header_tbl[] = {
 	0x00,0x00,0x00,0x00
 };
 
+static void set_data_4byte(uint8_t *work_buf, uint32_t data)
+{
+	work_buf[0] = (uint8_t)(data >> 0);
+	work_buf[1] = (uint8_t)(data >> 8);
+	work_buf[2] = (uint8_t)(data >> 16);
+	work_buf[3] = (uint8_t)(data >> 24);
+}
+
 AudioTask::AudioTask(MediaTask *owner, cv::Rect *face_roi) :
 	Task(osWaitForever),
 	_owner(owner),
 	audio(0x80, AUDIO_OUT_BUF_NUM - 1, AUDIO_IN_BUF_NUM),
 	_state(State::PowerOff),
-	wav_fp(NULL),
+	_wav(-1),
 	pcm_size(0),
 	_rec_signal(false),
 	audio_read_data(),
@@ -255,12 +267,14 @@ void AudioTask::ProcessEvent(InterTaskSignals::T signals)
 	}
 	if ((signals & InterTaskSignals::TriggerOn) != 0) {
 		auto file = _owner->GetFilePath() + ".wav";
-		wav_fp = fopen(file.c_str(), "wb");
-		if (wav_fp != NULL) {
+		// 大きさは閉じるときにヘッダーを書き換えて確定する
+		_wav = _owner->GetStorage()->Open(file, sizeof(wav_header_tbl) + DATA_SPEED * AUDIO_REC_SECONDS, true);
+		if (_wav >= 0) {
 			pcm_size = 0;
-			fwrite(wav_header_tbl, sizeof(char), sizeof(wav_header_tbl), wav_fp);
+			_owner->GetStorage()->Append(_wav,
+				std::vector<uint8_t>(wav_header_tbl, wav_header_tbl + sizeof(wav_header_tbl)));
 			_state = State::Recording;
-			_timer = 10 * 1000;
+			_timer = AUDIO_REC_SECONDS * 1000;
 		}
 		file = ".\\shutter.wav";
 		shutter_fp = fopen(file.c_str(), "rb");
@@ -341,33 +355,34 @@ void AudioTask::Process()
 		break;
 	case State::Recording:
 		if (ret) {
-			if (wav_fp != NULL) {
+			if (_wav >= 0) {
 #if CHANNEL_NUM == 1
 				int16_t *src = (int16_t *)mail.p_data, *end = &src[mail.result / sizeof(int16_t)];
-				int16_t *dst = (int16_t *)audio_file_buf;
+				int len = mail.result / 2;
+				std::vector<uint8_t> block(len);
+				int16_t *dst = (int16_t *)block.data();
 				// 2chデータを1chに変換
 				for (; src < end; src += 2, dst++) {
-					*dst = *src;;
+					*dst = *src;
 				}
-				int len = mail.result / 2;
-				pcm_size += len;
-				fwrite(audio_file_buf, sizeof(char), len, wav_fp);
 #else
-				pcm_size += mail.result;
-				fwrite(mail.p_data, sizeof(char), mail.result, wav_fp);
+				int len = mail.result;
+				std::vector<uint8_t> block((uint8_t *)mail.p_data, (uint8_t *)mail.p_data + len);
 #endif
+				// 捨てられても0で埋められるので、ヘッダーの長さは録音した時間で数える
+				_owner->GetStorage()->Append(_wav, std::move(block));
+				pcm_size += len;
 			}
 		}
 		if (_timer == 0) {
-			if (wav_fp != NULL) {
+			if (_wav >= 0) {
+				std::vector<uint8_t> head(wav_header_tbl, wav_header_tbl + sizeof(wav_header_tbl));
 				// Set "RIFF" ChunkSize
-				fseek(wav_fp, 4, SEEK_SET);
-				wire_data_4byte(sizeof(wav_header_tbl) - 8 + pcm_size, wav_fp);
+				set_data_4byte(&head[4], sizeof(wav_header_tbl) - 8 + pcm_size);
 				// Set "data" ChunkSize
-				fseek(wav_fp, 40, SEEK_SET);
-				wire_data_4byte(pcm_size, wav_fp);
-				fclose(wav_fp);
-				wav_fp = NULL;
+				set_data_4byte(&head[40], pcm_size);
+				_owner->GetStorage()->Close(_wav, true, std::move(head));
+				_wav = -1;
 			}
 
 			_owner->UpdateRequest();
@@ -382,22 +397,11 @@ void AudioTask::Process()
 		_timer = osWaitForever;
 }
 
-void AudioTask::wire_data_4byte(uint32_t data, FILE *fp)
-{
-	uint8_t work_buf[4];
-
-	work_buf[0] = (uint8_t)(data >> 0);
-	work_buf[1] = (uint8_t)(data >> 8);
-	work_buf[2] = (uint8_t)(data >> 16);
-	work_buf[3] = (uint8_t)(data >> 24);
-
-	fwrite(work_buf, sizeof(char), sizeof(work_buf), fp);
-}
-
 VisualTask::VisualTask(MediaTask *owner) :
 	Task(osWaitForever),
 	_owner(owner),
-	_state(State::PowerOff)
+	_state(State::PowerOff),
+	_frames("VisualTask")
 {
 }
 
@@ -414,6 +418,8 @@ void VisualTask::OnStart()
 	Display.Graphics_Stop(DisplayBase::GRAPHICS_LAYER_0);
 	Display.Graphics_Stop(DisplayBase::GRAPHICS_LAYER_2);
 	Display.Graphics_Stop(DisplayBase::GRAPHICS_LAYER_3);
+
+	frameBus.Subscribe(&_frames);
 }
 
 void VisualTask::ProcessEvent(InterTaskSignals::T signals)
@@ -433,14 +439,14 @@ void VisualTask::ProcessEvent(InterTaskSignals::T signals)
 		if (temp != State::PowerOff) {
 			_state = State::Recording;
 
-			size_t jpeg_size = create_jpeg();
+			// 配信中のフレームがあればそれを使う（取り込み途中のバッファを避ける）
+			const FrameView *frame = frameBus.AcquireLatest(&_frames);
+			size_t jpeg_size = create_jpeg((frame != NULL) ? frame->GetPixels() : NULL);
+			frameBus.Release(frame);
 			auto file = _owner->GetFilePath() + ".jpeg";
-			FILE *jpeg_fp = fopen(file.c_str(), "wb");
-			if (jpeg_fp != NULL) {
-				fwrite(get_jpeg_adr(), sizeof(char), jpeg_size, jpeg_fp);
-				fclose(jpeg_fp);
-				jpeg_fp = NULL;
-			}
+			// JPEGのバッファは次の撮影で上書きされるので写しを渡す
+			const uint8_t *jpeg = get_jpeg_adr();
+			_owner->GetStorage()->WriteFile(file, std::vector<uint8_t>(jpeg, jpeg + jpeg_size), true);
 
 			_state = temp;
 			_timer = osWaitForever;
@@ -517,6 +523,11 @@ std::string MediaTask::GetFilePath()
 	return _globalState->GetFilePath();
 }
 
+StorageTask *MediaTask::GetStorage()
+{
+	return _globalState->storageTask;
+}
+
 bool MediaTask::IsActive()
 {
 	return (audioTask.GetState() == AudioTask::State::Recording)
@@ -547,7 +558,14 @@ FaceDetectTask::FaceDetectTask(GlobalState *globalState) :
 	TaskThread(this, osPriorityBelowNormal, (1024 * 33), NULL, "FaceDetectTask"),
 	_globalState(globalState),
 	_state(State::PowerOff),
-	_timer(0)
+	_timer(0),
+	// 識別器の中に残るMatのバッファもプールから取るので、識別器（グローバル変数）が
+	// 終了時に解放するより先に消えないよう、プールは最後まで解放しない
+	_matPool(new cv::PoolMatAllocator()),
+	_poolFrames(0),
+	_frames("FaceDetectTask", this),
+	_detectedSeq(0),
+	_detected(false)
 {
 }
 
@@ -560,15 +578,50 @@ void FaceDetectTask::Init(std::string filename)
 	_filename = filename;
 }
 
+cv::Rect FaceDetectTask::GetSearchRect(const FrameView *frame, uint64_t tiles)
+{
+	cv::Rect full(0, 0, frame->GetWidth(), frame->GetHeight());
+	cv::Rect rect = frame->GetChangedRect(tiles);
+
+	if (rect.area() == 0)
+		return full;
+
+	// 入ってきた顔は変化した範囲からはみ出していることがあるので広げる
+	int margin = std::max<int>(std::max<int>(rect.width, rect.height) / FACE_SEARCH_MARGIN_RATIO, DETECTOR_MIN_SIZE);
+	rect.x -= margin;
+	rect.y -= margin;
+	rect.width += 2 * margin;
+	rect.height += 2 * margin;
+
+	return rect & full;
+}
+
 void FaceDetectTask::OnStart()
 {
 	detectFaceInit(_filename);
+
+	// detectMultiScaleを手伝うOpenCVのワーカーはCPUの数だけ動くので、このスレッドより一段下げて
+	// Leptonの取り込み（osPriorityNormal）にも、同じ優先度のStorageTaskの書き込みにも割り込まないようにする
+	cv::setParallelThreadPriority(osPriorityLow);
+
+	frameBus.Subscribe(&_frames);
 }
 
 void FaceDetectTask::OnEnd()
 {
 }
 
+void FaceDetectTask::PrintPoolStats()
+{
+	cv::MatPoolStats stats = _matPool->getStats();
+
+	printf("frames %lu%s\n", _poolFrames, (_poolFrames >= FACE_POOL_WARMUP_FRAMES) ? " (frozen)" : "");
+	printf("alloc %u, hits %u, misses %u, after warm-up %u\n", (unsigned)stats.allocations,
+		(unsigned)stats.hits, (unsigned)stats.misses, (unsigned)stats.frozenMisses);
+	printf("in use %uKB (peak %uKB), reserved %uKB, footprint peak %uKB\n", (unsigned)(stats.inUse / 1024),
+		(unsigned)(stats.inUsePeak / 1024), (unsigned)(stats.reserved / 1024), (unsigned)(stats.footprintPeak / 1024));
+}
+
 int FaceDetectTask::GetTimer()
 {
 	return _timer;
@@ -576,6 +629,9 @@ int FaceDetectTask::GetTimer()
 
 void FaceDetectTask::Progress(int elapse)
 {
+	// 無期限に待っている間は時間で起きない
+	if (_timer == (int)osWaitForever)
+		return;
 	_timer -= elapse;
 	if (_timer < 0)
 		_timer = 0;
@@ -583,6 +639,11 @@ void FaceDetectTask::Progress(int elapse)
 
 void FaceDetectTask::ProcessEvent(InterTaskSignals::T signals)
 {
+	// 新しいフレームを待っていたら処理を再開する
+	if (((signals & InterTaskSignals::FrameReady) != 0)
+		&& (_state == State::Viewing) && (_timer == (int)osWaitForever)) {
+		_timer = 0;
+	}
 	if ((signals & InterTaskSignals::PowerOn) != 0) {
 		_state = State::Viewing;
 		_timer = 100;
@@ -598,16 +659,63 @@ void FaceDetectTask::Process()
 	if (_timer != 0)
 		return;
 
+	// 止められている間は時間をおいて確かめ直す
+	if (_pause.Acquire(0) != osOK) {
+		_timer = 100;
+		return;
+	}
+
 	switch (_state) {
-	case State::Viewing:
-		create_gray(frame_gray);
+	case State::Viewing: {
+		const FrameView *frame = NULL;
+		cv::Rect search;
+		// 1フレームの検出の間だけ、このスレッドで作るMatをプールから取る
+		cv::setThreadMatAllocator(_matPool);
+		if (frameBus.GetSeq() == 0) {
+			// フレームの配信が無い場合はフレームバッファから直接作る
+			create_gray(frame_gray);
+		}
+		else {
+			frame = frameBus.Acquire(&_frames);
+			// 顔が無かった画面から変化が無ければ検出し直さない
+			if ((frame != NULL) && !_detected && !frame->IsChangedSince(_detectedSeq)) {
+				_frames.CountSkipped();
+				frameBus.Release(frame);
+				frame = NULL;
+			}
+			if (frame != NULL) {
+				frame_gray = frame->GetGrayMat();
+				// 顔が無かった画面なら、新しい顔は変化した所にしか無い
+				if (!_detected) {
+					search = GetSearchRect(frame, frameBus.GetChangedTiles(frame, _detectedSeq));
+					frame_gray = frame_gray(search);
+				}
+				_detectedSeq = frame->GetSeq();
+			}
+			else {
+				frame_gray.release();
+			}
+		}
 		if (frame_gray.empty()){
+			cv::setThreadMatAllocator(NULL);
 			_state = State::Viewing;
-			_timer = 100;
+			// 配信があれば次のフレームの通知（FrameReady）で起きる
+			_timer = (frameBus.GetSeq() == 0) ? 100 : osWaitForever;
 			break;
 		}
 
 		detectFace(frame_gray, face_roi);
+		frame_gray.release();
+		if ((face_roi.width > 0) && (face_roi.height > 0)) {
+			face_roi.x += search.x;
+			face_roi.y += search.y;
+		}
+		frameBus.Release(frame);
+		cv::setThreadMatAllocator(NULL);
+		// 慣らした後にヒープから確保した数はfrozenMissesに数える
+		if (++_poolFrames == FACE_POOL_WARMUP_FRAMES)
+			_matPool->freeze();
+		_detected = (face_roi.width > 0 && face_roi.height > 0);
 		if (face_roi.width > 0 && face_roi.height > 0) {
 			printf("FaceDetect: %d,%d,%d,%d\r\n", face_roi.x, face_roi.y, face_roi.width, face_roi.height);
 			_state = State::Detecting;
@@ -618,6 +726,7 @@ void FaceDetectTask::Process()
 			_timer = 100;
 		}
 		break;
+	}
 	case State::Detecting:
 		face_roi.width = -1;
 		face_roi.height = -1;
@@ -630,4 +739,6 @@ void FaceDetectTask::Process()
 		_timer = osWaitForever;
 		break;
 	}
+
+	_pause.unlock();
 }
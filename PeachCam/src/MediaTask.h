@@ -9,6 +9,7 @@
 #include "camera_if.hpp"
 #include "face_detector.hpp"
 #include "AUDIO_GRBoard.h"
+#include "FrameBus.h"
 
 struct mail_t {
 	void *p_data;
@@ -36,7 +37,7 @@ private:
 	MediaTask *_owner;
 	AUDIO_GRBoard audio;
 	State::T _state;
-	FILE *wav_fp;
+	int _wav;				// StorageTaskのファイル
 	int pcm_size;
 	bool _rec_signal;
 	rbsp_data_conf_t audio_read_data;
@@ -55,7 +56,6 @@ private:
 	static void callback_audio_write_end(void *p_data, int32_t result, void *p_app_data) {
 		((AudioTask *)p_app_data)->AudioWriteEnd(p_data, result);
 	}
-	static void wire_data_4byte(uint32_t data, FILE *fp);
 public:
 	State::T GetState() { return _state; }
 	void OnStart() override;
@@ -81,6 +81,7 @@ public:
 private:
 	MediaTask *_owner;
 	State::T _state;
+	FrameSubscriber _frames;
 public:
 	State::T GetState() { return _state; }
 	void OnStart() override;
@@ -113,6 +114,7 @@ public:
 };
 
 class GlobalState;
+class StorageTask;
 
 class MediaTask : public TaskThread
 {
@@ -128,6 +130,7 @@ private:
 	VibratorTask vibratorTask;
 public:
 	std::string GetFilePath();
+	StorageTask *GetStorage();
 	bool IsActive();
 	bool IsRecording() {
 		return (audioTask.GetState() == AudioTask::State::Recording)
@@ -158,13 +161,26 @@ private:
 	GlobalState *_globalState;
 	State::T _state;
 	int _timer;
+	cv::PoolMatAllocator *_matPool;	// 1フレームの検出で作るMatのバッファを次のフレームで使い回す（解放しない）
+	uint32_t _poolFrames;	// プールを使って検出したフレーム
 	cv::Mat frame_gray;
+	FrameSubscriber _frames;
+	uint32_t _detectedSeq;	// 最後に検出したフレーム
+	bool _detected;			// 最後の検出で顔があったか
 	std::string _filename;
+	rtos::Mutex _pause;		// 検出の間ロックする（Pauseで止める）
 public:
 	cv::Rect face_roi;
 	void Init(std::string filename);
+	/* 実行中の検出が終わるのを待って、Resumeまで検出を止める（同じスレッドから呼ぶ） */
+	void Pause() { _pause.lock(); }
+	void Resume() { _pause.unlock(); }
+	/* 顔が無かった画面からの変化で、顔を探す範囲を決める（原寸の座標） */
+	static cv::Rect GetSearchRect(const FrameView *frame, uint64_t tiles);
 public:
 	State::T GetState() { return _state; }
+	/* Matのプールの使用量と、慣らした後にヒープから確保した数を表示する */
+	void PrintPoolStats();
 	void OnStart() override;
 	void OnEnd() override;
 	int GetTimer() override;
@@ -72,7 +72,7 @@ UploadTask::UploadTask(NetTask *owner) :
 	_storage(),
 	_storageAddr(),
 	_update_req(false),
-	_uploads()
+	_queue()
 {
 }
 
@@ -88,11 +88,10 @@ void UploadTask::Init(std::string server, std::string storage)
 	_storageAddr.set_ip_address(storage.c_str());
 }
 
-void UploadTask::UploadRequest(std::string filename)
+void UploadTask::UploadRequest(std::string filename, uint32_t size)
 {
-	_mutex.lock();
-	_uploads.push_back(filename);
-	_mutex.unlock();
+	// 書き込みスレッドから呼ばれるので記録ファイルへの追記はここで済ませる
+	_queue.Push(_server, filename, size);
 
 	_owner->Signal(InterTaskSignals::UploadRequest);
 }
@@ -110,41 +109,116 @@ void UploadTask::ProcessEvent(InterTaskSignals::T signals)
 			_timer = 0;
 		}
 	}
+	if ((signals & InterTaskSignals::WifiConnected) != 0) {
+		// つながり直したら待たずに溜まった分を送る
+		_queue.ResetBackoff();
+		if ((_queue.GetCount() > 0) && (_state != State::Update)) {
+			_state = (_serverAddr.get_ip_version() == NSAPI_UNSPEC) ? State::Undetected : State::Upload;
+			_timer = 0;
+		}
+	}
 	if ((signals & InterTaskSignals::UploadRequest) != 0) {
 		if (_serverAddr.get_ip_version() == NSAPI_UNSPEC) {
 			_state = State::Undetected;
 			_timer = 0;
 		}
-		else {
+		else if (_state != State::Upload) {
 			_state = State::Upload;
 			_timer = 0;
 		}
 	}
 }
 
+void UploadTask::NextState()
+{
+	if (_update_req) {
+		_state = State::Update;
+		_timer = 0;
+		return;
+	}
+
+	_timer = _queue.GetWaitTime();
+	_state = (_timer == osWaitForever) ? State::Detected : State::Upload;
+}
+
+/*
+ * 送り先を1つ選んで、1つの接続でまとめて送る
+ * 接続できなかったときだけfalseを返す（送り先ごとに待ち時間を延ばす）。
+ */
 bool UploadTask::Upload()
 {
-	bool result;
-	std::string filename;
+	std::string dest;
+	std::list<UploadQueue::job_t> batch;
+	SocketAddress addr;
+	TCPSocket socket;
+	bool connected = false, failed = false;
+	int sent = 0;
+	uint32_t bytes = 0;
 
-	_mutex.lock();
-	result = !_uploads.empty();
-	if (result) {
-		filename = _uploads.front();
-		_uploads.pop_front();
+	if (!_queue.GetBatch(dest, batch))
+		return true;
+
+	if (dest == _server) {
+		addr = _serverAddr;
 	}
-	_mutex.unlock();
+	else if (!_owner->QuerySever(dest, addr)) {
+		_queue.Failed(dest);
+		return false;
+	}
+
+	us_timestamp_t start = ticker_read_us(get_us_ticker_data());
+	for (auto &job : batch) {
+		if (!connected) {
+			connected = _owner->OpenUpload(&socket, addr);
+			sent = 0;
+			if (!connected) {
+				failed = true;
+				break;
+			}
+		}
 
-	if (result) {
-		result = _owner->Upload(_serverAddr, filename);
+		UploadResult::T result = _owner->Upload(&socket, addr, job.filename);
+		if ((result == UploadResult::Failed) && (sent > 0)) {
+			// 続けて送る間にサーバーが接続を閉じた
+			socket.close();
+			sent = 0;
+			connected = _owner->OpenUpload(&socket, addr);
+			if (connected)
+				result = _owner->Upload(&socket, addr, job.filename);
+		}
+
+		switch (result) {
+		case UploadResult::Succeeded:
+			_queue.Complete(job.id, true);
+			bytes += job.size;
+			sent++;
+			break;
+		case UploadResult::Missing:
+			_queue.Complete(job.id, false);
+			break;
+		case UploadResult::Rejected:
+			// このファイルだけ後回しにする
+			_queue.Reject(job.id);
+			socket.close();
+			connected = false;
+			break;
+		default:
+			failed = true;
+			break;
+		}
+		if (failed)
+			break;
 	}
-	if (!result) {
-		_mutex.lock();
-		_uploads.push_back(filename);
-		_mutex.unlock();
+	if (connected)
+		socket.close();
+
+	if (failed) {
+		_queue.Failed(dest);
+		return false;
 	}
 
-	return result;
+	_queue.Succeeded(dest, bytes, ticker_read_us(get_us_ticker_data()) - start);
+	return true;
 }
 
 void UploadTask::Process()
@@ -163,14 +237,7 @@ void UploadTask::Process()
 		else if (_owner->QuerySever(_server.c_str(), addr)) {
 			_serverAddr.set_addr(addr.get_addr());
 			_retry = 0;
-			if (_update_req) {
-				_state = State::Update;
-				_timer = 0;
-			}
-			else {
-				_state = State::Detected;
-				_timer = 1 * 60 * 1000;
-			}
+			NextState();
 		}
 		else {
 			_retry++;
@@ -191,8 +258,7 @@ void UploadTask::Process()
 			_timer = 0;
 		}
 		else {
-			_state = State::Detected;
-			_timer = osWaitForever;
+			NextState();
 		}
 		break;
 	case State::Update:
@@ -200,8 +266,7 @@ void UploadTask::Process()
 			_owner->WifiSleep(true);
 			_update_req = false;
 			_retry = 0;
-			_state = State::Detected;
-			_timer = osWaitForever;
+			NextState();
 		}
 		else {
 			_retry++;
@@ -225,29 +290,27 @@ void UploadTask::Process()
 		}
 		break;
 	case State::Upload:
-		if (Upload()) {
-			_retry = 0;
+		if (!_owner->IsConnected()) {
+			// つながったらWifiConnectedで再開する
 			_state = State::Detected;
 			_timer = osWaitForever;
 		}
+		else if (Upload()) {
+			_retry = 0;
+			NextState();
+		}
 		else {
+			SocketAddress literal;
 			_retry++;
-			if (_retry >= 3) {
-				if (_serverAddr.get_ip_version() == NSAPI_UNSPEC) {
-					_serverAddr.set_addr(nsapi_addr_t());
-					_retry = 0;
-					_state = State::Undetected;
-					_timer = 0;
-				}
-				else {
-					_retry = 0;
-					_state = State::Upload;
-					_timer = 3 * 60 * 1000;
-				}
+			if ((_retry >= 3) && !literal.set_ip_address(_server.c_str())) {
+				// 名前を引き直す（待ち時間は送り先ごとに延びている）
+				_serverAddr.set_addr(nsapi_addr_t());
+				_retry = 0;
+				_state = State::Undetected;
+				_timer = _queue.GetWaitTime();
 			}
 			else {
-				_state = State::Upload;
-				_timer = 10 * 1000;
+				NextState();
 			}
 		}
 		break;
@@ -441,29 +504,59 @@ bool NetTask::Update(SocketAddress server, SocketAddress storage)
 	return (get_res != NULL) && (get_res->get_status_code() == 200);
 }
 
-void NetTask::UploadRequest(std::string filename)
+void NetTask::UploadRequest(std::string filename, uint32_t size)
 {
-	_uploadTask.UploadRequest(filename);
+	_uploadTask.UploadRequest(filename, size);
 }
 
-bool NetTask::Upload(SocketAddress server, std::string filename)
+bool NetTask::OpenUpload(TCPSocket *socket, SocketAddress server)
 {
-	if (upload_file != NULL)
+	server.set_port(3000);
+
+	if (socket->open(_wifi) != NSAPI_ERROR_OK)
 		return false;
 
+	if (socket->connect(server) != NSAPI_ERROR_OK) {
+		socket->close();
+		return false;
+	}
+
+	return true;
+}
+
+UploadResult::T NetTask::Upload(TCPSocket *socket, SocketAddress server, std::string filename)
+{
+	UploadResult::T result;
+
+	if (upload_file != NULL)
+		return UploadResult::Failed;
+
 	upload_file = fopen(filename.c_str(), "rb");
+	if (upload_file == NULL)
+		return UploadResult::Missing;
+
+	fseek(upload_file, 0, SEEK_END);
+	long size = ftell(upload_file);
+	fseek(upload_file, 0, SEEK_SET);
 
 	auto url = std::string("http://") + std::string(server.get_ip_address())
 		+ ":3000/upload?name=" + filename;
-	auto post_req = new HttpRequest(_wifi, HTTP_POST, url.c_str());
-	auto post_res = post_req->send(mbed::callback(this, &NetTask::UploadBody));
+	// 開いた接続を続けて使う（HTTP/1.1のKeep-Alive）
+	auto post_req = new HttpRequest(socket, HTTP_POST, url.c_str());
+	auto post_res = post_req->send(mbed::callback(this, &NetTask::UploadBody), (nsapi_size_t)size);
+
+	if (post_res == NULL)
+		result = UploadResult::Failed;
+	else if (post_res->get_status_code() == 200)
+		result = UploadResult::Succeeded;
+	else
+		result = UploadResult::Rejected;
+	delete post_req;
 
 	fclose(upload_file);
 	upload_file = NULL;
 
-	if ((post_res == NULL) || (post_res->get_status_code() == 200))
-		return false;
-	return true;
+	return result;
 }
 
 size_t NetTask::UploadBody(char *buf, size_t length)
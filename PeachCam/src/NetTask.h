@@ -7,6 +7,7 @@
 #include "TaskBase.h"
 #include "ESP32Interface.h"
 #include "GoogleDrive.h"
+#include "UploadQueue.h"
 
 class NetTask;
 
@@ -59,14 +60,15 @@ private:
 	std::string _storage;
 	SocketAddress _storageAddr;
 	bool _update_req;
-	std::list<std::string> _uploads;
-	rtos::Mutex _mutex;
+	UploadQueue _queue;
+	void NextState();
+	bool Upload();
 public:
 	void Init(std::string server, std::string storage);
 	State::T GetState() { return _state; }
 	SocketAddress GetServerAddr() { return _serverAddr; }
-	void UploadRequest(std::string filename);
-	bool Upload();
+	void UploadRequest(std::string filename, uint32_t size);
+	UploadQueue *GetQueue() { return &_queue; }
 	void ProcessEvent(InterTaskSignals::T signals) override;
 	void Process() override;
 };
@@ -102,6 +104,17 @@ public:
 	void Process() override;
 };
 
+class UploadResult
+{
+public:
+	enum T {
+		Succeeded,
+		Rejected,		// サーバーが200以外を返した
+		Missing,		// ファイルが開けない
+		Failed,			// 接続が切れた
+	};
+};
+
 class GlobalState;
 
 class NetTask : public TaskThread
@@ -128,12 +141,14 @@ public:
 	bool IsConnected() { return _wifiTask.GetState() == WifiTask::State::Connected; }
 	bool IsDetectedServer() { return _uploadTask.GetState() != UploadTask::State::Undetected; }
 	SocketAddress GetServerAddr() { return _uploadTask.GetServerAddr(); }
+	UploadQueue *GetUploadQueue() { return _uploadTask.GetQueue(); }
 	void WifiStatus(nsapi_event_t evt);
 	void WifiConnected();
 	bool QuerySever(const std::string hostname, SocketAddress &addr);
 	bool Update(SocketAddress server, SocketAddress storage);
-	void UploadRequest(std::string filename);
-	bool Upload(SocketAddress server, std::string filename);
+	void UploadRequest(std::string filename, uint32_t size);
+	bool OpenUpload(TCPSocket *socket, SocketAddress server);
+	UploadResult::T Upload(TCPSocket *socket, SocketAddress server, std::string filename);
 	bool WifiSleep(bool enable);
 };
 
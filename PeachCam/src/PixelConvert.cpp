@@ -0,0 +1,1156 @@
+#include "mbed.h"
+#include "PixelConvert.h"
+#include "opencv.hpp"
+#include <vector>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXEL_CONVERT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PIXEL_CONVERT_NEON
+#endif
+
+/* SIMDで1度に処理する画素数 */
+#define PIXEL_CONVERT_BLOCK	(8)
+
+PixelFormat::T PixelFormat::FromGraphics(DisplayBase::graphics_format_t format)
+{
+	switch (format) {
+	case DisplayBase::GRAPHICS_FORMAT_YCBCR422:
+		return YUYV;
+	case DisplayBase::GRAPHICS_FORMAT_RGB565:
+		return RGB565;
+	case DisplayBase::GRAPHICS_FORMAT_RGB888:
+		return RGB888;
+	case DisplayBase::GRAPHICS_FORMAT_ARGB8888:
+		return ARGB8888;
+	case DisplayBase::GRAPHICS_FORMAT_ARGB4444:
+		return ARGB4444;
+	default:
+		return CLUT8;
+	}
+}
+
+int PixelFormat::GetBytesPerPixel(T format)
+{
+	switch (format) {
+	case YUYV:
+	case UYVY:
+	case RGB565:
+	case ARGB4444:
+		return 2;
+	case RGB888:
+	case ARGB8888:
+		return 4;
+	case BGR888:
+		return 3;
+	default:
+		return 1;
+	}
+}
+
+struct pixel_row_context_t {
+	const uint32_t *clut;
+	int clut_count;
+};
+
+typedef void (*to_argb_row_t)(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx);
+typedef void (*from_bgr_row_t)(uint8_t *dst, const uint8_t *src, int width);
+
+static inline uint8_t clamp8(int value)
+{
+	return (value < 0) ? 0 : ((value > 255) ? 255 : (uint8_t)value);
+}
+
+/*
+ * BT.601（16～235）のYCbCrからRGBへ、係数は64倍の整数
+ * SIMD版と同じ演算順序なので結果は一致する。
+ */
+static inline uint32_t ycbcr_to_argb(int y, int cb, int cr)
+{
+	int yr = (y - 16) * 75 + 32;
+	cb -= 128;
+	cr -= 128;
+
+	int r = (yr + 102 * cr) >> 6;
+	int g = (yr - 25 * cb - 52 * cr) >> 6;
+	int b = (yr + 129 * cb) >> 6;
+
+	return 0xFF000000 | (clamp8(r) << 16) | (clamp8(g) << 8) | clamp8(b);
+}
+
+/* YUYVはyofs=0、cofs=1、UYVYはyofs=1、cofs=0 */
+template <int yofs, int cofs>
+static void ycbcr422_to_argb_c(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	int x;
+
+	for (x = 0; x + 1 < width; x += 2) {
+		int cb = src[cofs];
+		int cr = src[cofs + 2];
+		*dst++ = ycbcr_to_argb(src[yofs], cb, cr);
+		*dst++ = ycbcr_to_argb(src[yofs + 2], cb, cr);
+		src += 4;
+	}
+	// 奇数幅の最後の画素は色差を持たない
+	if (x < width)
+		*dst = ycbcr_to_argb(src[yofs], 128, 128);
+}
+
+static void rgb565_to_argb_c(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	const uint16_t *s = (const uint16_t *)src;
+
+	for (int x = 0; x < width; x++) {
+		uint16_t tmp1 = *s++;
+		uint16_t r = (tmp1 & 0xF800) >> 11;
+		uint16_t g = (tmp1 & 0x07E0) >> 5;
+		uint16_t b = (tmp1 & 0x001F);
+		r = (r << 3) | (r >> 2);
+		g = (g << 2) | (g >> 4);
+		b = (b << 3) | (b >> 2);
+		*dst++ = 0xFF000000 | (r << 16) | (g << 8) | (b << 0);
+	}
+}
+
+static void argb4444_to_argb_c(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	const uint16_t *s = (const uint16_t *)src;
+
+	for (int x = 0; x < width; x++) {
+		uint16_t tmp1 = *s++;
+		uint32_t a = (tmp1 & 0xF000) >> 12;
+		uint32_t r = (tmp1 & 0x0F00) >> 8;
+		uint32_t g = (tmp1 & 0x00F0) >> 4;
+		uint32_t b = (tmp1 & 0x000F);
+		*dst++ = (a << 28) | (a << 24) | (r << 20) | (r << 16) | (g << 12) | (g << 8) | (b << 4) | (b << 0);
+	}
+}
+
+static void rgb888_to_argb_c(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	const uint32_t *s = (const uint32_t *)src;
+
+	for (int x = 0; x < width; x++) {
+		*dst++ = 0xFF000000 | *s++;
+	}
+}
+
+static void argb8888_to_argb_c(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	memcpy(dst, src, width * sizeof(uint32_t));
+}
+
+static void clut8_to_argb_c(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	for (int x = 0; x < width; x++) {
+		int index = *src++;
+		*dst++ = (index < ctx->clut_count) ? ctx->clut[index] : 0;
+	}
+}
+
+static void bgr_to_rgb565_c(uint8_t *dst, const uint8_t *src, int width)
+{
+	uint16_t *d = (uint16_t *)dst;
+
+	for (int x = 0; x < width; x++) {
+		uint16_t b = src[0] >> (8 - 5);
+		uint16_t g = src[1] >> (8 - 6);
+		uint16_t r = src[2] >> (8 - 5);
+		*d++ = (r << 11) | (g << 5) | (b << 0);
+		src += 3;
+	}
+}
+
+static void bgr_to_argb_c(uint8_t *dst, const uint8_t *src, int width)
+{
+	uint32_t *d = (uint32_t *)dst;
+
+	for (int x = 0; x < width; x++) {
+		*d++ = 0xFF000000 | (src[2] << 16) | (src[1] << 8) | src[0];
+		src += 3;
+	}
+}
+
+/* BT.601（16～235）、色差は2画素の平均から求める */
+template <int yofs, int cofs>
+static void bgr_to_ycbcr422_c(uint8_t *dst, const uint8_t *src, int width)
+{
+	int x;
+
+	for (x = 0; x + 1 < width; x += 2) {
+		int b0 = src[0], g0 = src[1], r0 = src[2];
+		int b1 = src[3], g1 = src[4], r1 = src[5];
+		int r = (r0 + r1 + 1) >> 1;
+		int g = (g0 + g1 + 1) >> 1;
+		int b = (b0 + b1 + 1) >> 1;
+		dst[yofs] = (uint8_t)(16 + ((66 * r0 + 129 * g0 + 25 * b0 + 128) >> 8));
+		dst[yofs + 2] = (uint8_t)(16 + ((66 * r1 + 129 * g1 + 25 * b1 + 128) >> 8));
+		dst[cofs] = (uint8_t)(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+		dst[cofs + 2] = (uint8_t)(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+		src += 6;
+		dst += 4;
+	}
+	if (x < width) {
+		int b0 = src[0], g0 = src[1], r0 = src[2];
+		dst[yofs] = (uint8_t)(16 + ((66 * r0 + 129 * g0 + 25 * b0 + 128) >> 8));
+		dst[cofs] = 128;
+	}
+}
+
+/* 2行を重みweight（0～1 << PIXEL_RESIZE_WEIGHT_BITS）で補間する */
+static void blend_rows_c(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, int bytes, int weight)
+{
+	int w0 = (1 << PIXEL_RESIZE_WEIGHT_BITS) - weight;
+	int round = 1 << (PIXEL_RESIZE_WEIGHT_BITS - 1);
+
+	for (int i = 0; i < bytes; i++) {
+		dst[i] = (uint8_t)((src0[i] * w0 + src1[i] * weight + round) >> PIXEL_RESIZE_WEIGHT_BITS);
+	}
+}
+
+#if defined(PIXEL_CONVERT_SSE2)
+
+/* 16bit×8のB、G、R、A（0～255）をARGB8888で8画素書き込む */
+static inline void store_argb_sse2(uint32_t *dst, __m128i b, __m128i g, __m128i r, __m128i a)
+{
+	__m128i bg = _mm_packus_epi16(b, g);
+	__m128i ra = _mm_packus_epi16(r, a);
+	bg = _mm_unpacklo_epi8(bg, _mm_srli_si128(bg, 8));
+	ra = _mm_unpacklo_epi8(ra, _mm_srli_si128(ra, 8));
+	_mm_storeu_si128((__m128i *)&dst[0], _mm_unpacklo_epi16(bg, ra));
+	_mm_storeu_si128((__m128i *)&dst[4], _mm_unpackhi_epi16(bg, ra));
+}
+
+template <int yofs, int cofs>
+static void ycbcr422_to_argb_simd(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	const __m128i alpha = _mm_set1_epi16(0x00FF);
+	const __m128i c16 = _mm_set1_epi16(16);
+	const __m128i c128 = _mm_set1_epi16(128);
+	const __m128i round = _mm_set1_epi16(32);
+	int x;
+
+	for (x = 0; x + PIXEL_CONVERT_BLOCK <= width; x += PIXEL_CONVERT_BLOCK) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		__m128i y = (yofs == 0) ? _mm_and_si128(v, mask) : _mm_srli_epi16(v, 8);
+		__m128i c = (cofs == 0) ? _mm_and_si128(v, mask) : _mm_srli_epi16(v, 8);
+		// c = Cb0 Cr0 Cb1 Cr1 ... を画素ごとに複製する
+		__m128i cb = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+		__m128i cr = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+		cb = _mm_sub_epi16(cb, c128);
+		cr = _mm_sub_epi16(cr, c128);
+
+		__m128i yr = _mm_adds_epi16(_mm_mullo_epi16(_mm_sub_epi16(y, c16), _mm_set1_epi16(75)), round);
+		__m128i r = _mm_srai_epi16(_mm_adds_epi16(yr, _mm_mullo_epi16(cr, _mm_set1_epi16(102))), 6);
+		__m128i g = _mm_srai_epi16(_mm_subs_epi16(_mm_subs_epi16(yr,
+			_mm_mullo_epi16(cb, _mm_set1_epi16(25))), _mm_mullo_epi16(cr, _mm_set1_epi16(52))), 6);
+		__m128i b = _mm_srai_epi16(_mm_adds_epi16(yr, _mm_mullo_epi16(cb, _mm_set1_epi16(129))), 6);
+
+		store_argb_sse2(dst, b, g, r, alpha);
+		src += 2 * PIXEL_CONVERT_BLOCK;
+		dst += PIXEL_CONVERT_BLOCK;
+	}
+	ycbcr422_to_argb_c<yofs, cofs>(dst, src, width - x, ctx);
+}
+
+static void rgb565_to_argb_simd(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	const __m128i alpha = _mm_set1_epi16(0x00FF);
+	const __m128i m5 = _mm_set1_epi16(0x1F);
+	const __m128i m6 = _mm_set1_epi16(0x3F);
+	int x;
+
+	for (x = 0; x + PIXEL_CONVERT_BLOCK <= width; x += PIXEL_CONVERT_BLOCK) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		__m128i r = _mm_srli_epi16(v, 11);
+		__m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), m6);
+		__m128i b = _mm_and_si128(v, m5);
+		r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+		g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+		b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+		store_argb_sse2(dst, b, g, r, alpha);
+		src += 2 * PIXEL_CONVERT_BLOCK;
+		dst += PIXEL_CONVERT_BLOCK;
+	}
+	rgb565_to_argb_c(dst, src, width - x, ctx);
+}
+
+static void argb4444_to_argb_simd(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	const __m128i m4 = _mm_set1_epi16(0x0F);
+	int x;
+
+	for (x = 0; x + PIXEL_CONVERT_BLOCK <= width; x += PIXEL_CONVERT_BLOCK) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		__m128i a = _mm_srli_epi16(v, 12);
+		__m128i r = _mm_and_si128(_mm_srli_epi16(v, 8), m4);
+		__m128i g = _mm_and_si128(_mm_srli_epi16(v, 4), m4);
+		__m128i b = _mm_and_si128(v, m4);
+		a = _mm_or_si128(a, _mm_slli_epi16(a, 4));
+		r = _mm_or_si128(r, _mm_slli_epi16(r, 4));
+		g = _mm_or_si128(g, _mm_slli_epi16(g, 4));
+		b = _mm_or_si128(b, _mm_slli_epi16(b, 4));
+
+		store_argb_sse2(dst, b, g, r, a);
+		src += 2 * PIXEL_CONVERT_BLOCK;
+		dst += PIXEL_CONVERT_BLOCK;
+	}
+	argb4444_to_argb_c(dst, src, width - x, ctx);
+}
+
+static void rgb888_to_argb_simd(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+	int x;
+
+	for (x = 0; x + PIXEL_CONVERT_BLOCK <= width; x += PIXEL_CONVERT_BLOCK) {
+		__m128i v0 = _mm_loadu_si128((const __m128i *)&src[0]);
+		__m128i v1 = _mm_loadu_si128((const __m128i *)&src[16]);
+		_mm_storeu_si128((__m128i *)&dst[0], _mm_or_si128(v0, alpha));
+		_mm_storeu_si128((__m128i *)&dst[4], _mm_or_si128(v1, alpha));
+		src += 4 * PIXEL_CONVERT_BLOCK;
+		dst += PIXEL_CONVERT_BLOCK;
+	}
+	rgb888_to_argb_c(dst, src, width - x, ctx);
+}
+
+static void blend_rows_simd(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, int bytes, int weight)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i w0 = _mm_set1_epi16((short)((1 << PIXEL_RESIZE_WEIGHT_BITS) - weight));
+	const __m128i w1 = _mm_set1_epi16((short)weight);
+	const __m128i round = _mm_set1_epi16(1 << (PIXEL_RESIZE_WEIGHT_BITS - 1));
+	int i;
+
+	for (i = 0; i + 16 <= bytes; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)&src0[i]);
+		__m128i b = _mm_loadu_si128((const __m128i *)&src1[i]);
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w0),
+			_mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w1));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w0),
+			_mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w1));
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, round), PIXEL_RESIZE_WEIGHT_BITS);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, round), PIXEL_RESIZE_WEIGHT_BITS);
+		_mm_storeu_si128((__m128i *)&dst[i], _mm_packus_epi16(lo, hi));
+	}
+	blend_rows_c(&dst[i], &src0[i], &src1[i], bytes - i, weight);
+}
+
+/* BGR888を16画素（48byte）読み込み、B、G、R（8bit×16）に分ける */
+static inline void load_bgr_sse2(const uint8_t *src, __m128i &b, __m128i &g, __m128i &r)
+{
+	__m128i t00 = _mm_loadu_si128((const __m128i *)&src[0]);
+	__m128i t01 = _mm_loadu_si128((const __m128i *)&src[16]);
+	__m128i t02 = _mm_loadu_si128((const __m128i *)&src[32]);
+
+	__m128i t10 = _mm_unpacklo_epi8(t00, _mm_unpackhi_epi64(t01, t01));
+	__m128i t11 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t00, t00), t02);
+	__m128i t12 = _mm_unpacklo_epi8(t01, _mm_unpackhi_epi64(t02, t02));
+
+	__m128i t20 = _mm_unpacklo_epi8(t10, _mm_unpackhi_epi64(t11, t11));
+	__m128i t21 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t10, t10), t12);
+	__m128i t22 = _mm_unpacklo_epi8(t11, _mm_unpackhi_epi64(t12, t12));
+
+	__m128i t30 = _mm_unpacklo_epi8(t20, _mm_unpackhi_epi64(t21, t21));
+	__m128i t31 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t20, t20), t22);
+	__m128i t32 = _mm_unpacklo_epi8(t21, _mm_unpackhi_epi64(t22, t22));
+
+	b = _mm_unpacklo_epi8(t30, _mm_unpackhi_epi64(t31, t31));
+	g = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t30, t30), t32);
+	r = _mm_unpacklo_epi8(t31, _mm_unpackhi_epi64(t32, t32));
+}
+
+/* 16bit×8のR、G、B（0～255）をRGB565にする */
+static inline __m128i pack_rgb565_sse2(__m128i b, __m128i g, __m128i r)
+{
+	r = _mm_slli_epi16(_mm_srli_epi16(r, 8 - 5), 11);
+	g = _mm_slli_epi16(_mm_srli_epi16(g, 8 - 6), 5);
+	b = _mm_srli_epi16(b, 8 - 5);
+	return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+static void bgr_to_rgb565_simd(uint8_t *dst, const uint8_t *src, int width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int x;
+
+	for (x = 0; x + 2 * PIXEL_CONVERT_BLOCK <= width; x += 2 * PIXEL_CONVERT_BLOCK) {
+		__m128i b, g, r;
+		load_bgr_sse2(src, b, g, r);
+		_mm_storeu_si128((__m128i *)&dst[0], pack_rgb565_sse2(
+			_mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(r, zero)));
+		_mm_storeu_si128((__m128i *)&dst[16], pack_rgb565_sse2(
+			_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(r, zero)));
+		src += 6 * PIXEL_CONVERT_BLOCK;
+		dst += 4 * PIXEL_CONVERT_BLOCK;
+	}
+	bgr_to_rgb565_c(dst, src, width - x);
+}
+
+static void bgr_to_argb_simd(uint8_t *dst, const uint8_t *src, int width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha = _mm_set1_epi16(0x00FF);
+	int x;
+
+	for (x = 0; x + 2 * PIXEL_CONVERT_BLOCK <= width; x += 2 * PIXEL_CONVERT_BLOCK) {
+		__m128i b, g, r;
+		load_bgr_sse2(src, b, g, r);
+		store_argb_sse2((uint32_t *)&dst[0], _mm_unpacklo_epi8(b, zero),
+			_mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(r, zero), alpha);
+		store_argb_sse2((uint32_t *)&dst[32], _mm_unpackhi_epi8(b, zero),
+			_mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(r, zero), alpha);
+		src += 6 * PIXEL_CONVERT_BLOCK;
+		dst += 8 * PIXEL_CONVERT_BLOCK;
+	}
+	bgr_to_argb_c(dst, src, width - x);
+}
+
+/* 16bit×8のR、G、Bから輝度を求める（和は16bitに収まるので符号なしで扱う） */
+static inline __m128i rgb_to_y_sse2(__m128i r, __m128i g, __m128i b)
+{
+	__m128i y = _mm_mullo_epi16(r, _mm_set1_epi16(66));
+	y = _mm_add_epi16(y, _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+	y = _mm_add_epi16(y, _mm_mullo_epi16(b, _mm_set1_epi16(25)));
+	y = _mm_srli_epi16(_mm_add_epi16(y, _mm_set1_epi16(128)), 8);
+	return _mm_add_epi16(y, _mm_set1_epi16(16));
+}
+
+/* 16bit×8のR、G、Bと係数から色差を求める */
+static inline __m128i rgb_to_c_sse2(__m128i r, __m128i g, __m128i b, short kr, short kg, short kb)
+{
+	__m128i c = _mm_mullo_epi16(r, _mm_set1_epi16(kr));
+	c = _mm_add_epi16(c, _mm_mullo_epi16(g, _mm_set1_epi16(kg)));
+	c = _mm_add_epi16(c, _mm_mullo_epi16(b, _mm_set1_epi16(kb)));
+	c = _mm_srai_epi16(_mm_add_epi16(c, _mm_set1_epi16(128)), 8);
+	return _mm_add_epi16(c, _mm_set1_epi16(128));
+}
+
+template <int yofs, int cofs>
+static void bgr_to_ycbcr422_simd(uint8_t *dst, const uint8_t *src, int width)
+{
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	int x;
+
+	for (x = 0; x + 2 * PIXEL_CONVERT_BLOCK <= width; x += 2 * PIXEL_CONVERT_BLOCK) {
+		__m128i b, g, r;
+		load_bgr_sse2(src, b, g, r);
+		// 16bitレーンの下位が偶数画素、上位が奇数画素になる
+		__m128i b0 = _mm_and_si128(b, mask), b1 = _mm_srli_epi16(b, 8);
+		__m128i g0 = _mm_and_si128(g, mask), g1 = _mm_srli_epi16(g, 8);
+		__m128i r0 = _mm_and_si128(r, mask), r1 = _mm_srli_epi16(r, 8);
+		__m128i y0 = rgb_to_y_sse2(r0, g0, b0);
+		__m128i y1 = rgb_to_y_sse2(r1, g1, b1);
+
+		// 2画素の平均（切り上げ）
+		__m128i ra = _mm_avg_epu16(r0, r1);
+		__m128i ga = _mm_avg_epu16(g0, g1);
+		__m128i ba = _mm_avg_epu16(b0, b1);
+		__m128i cb = rgb_to_c_sse2(ra, ga, ba, -38, -74, 112);
+		__m128i cr = rgb_to_c_sse2(ra, ga, ba, 112, -94, -18);
+
+		__m128i w0 = (yofs == 0) ? _mm_or_si128(y0, _mm_slli_epi16(cb, 8)) : _mm_or_si128(cb, _mm_slli_epi16(y0, 8));
+		__m128i w1 = (yofs == 0) ? _mm_or_si128(y1, _mm_slli_epi16(cr, 8)) : _mm_or_si128(cr, _mm_slli_epi16(y1, 8));
+		_mm_storeu_si128((__m128i *)&dst[0], _mm_unpacklo_epi16(w0, w1));
+		_mm_storeu_si128((__m128i *)&dst[16], _mm_unpackhi_epi16(w0, w1));
+		src += 6 * PIXEL_CONVERT_BLOCK;
+		dst += 4 * PIXEL_CONVERT_BLOCK;
+	}
+	bgr_to_ycbcr422_c<yofs, cofs>(dst, src, width - x);
+}
+
+#elif defined(PIXEL_CONVERT_NEON)
+
+/* 8bit×8のB、G、R、AをARGB8888で8画素書き込む */
+static inline void store_argb_neon(uint32_t *dst, uint8x8_t b, uint8x8_t g, uint8x8_t r, uint8x8_t a)
+{
+	uint8x8x4_t v;
+	v.val[0] = b;
+	v.val[1] = g;
+	v.val[2] = r;
+	v.val[3] = a;
+	vst4_u8((uint8_t *)dst, v);
+}
+
+/* 16bit×8のY（64倍済み）と色差からR、G、Bを求める */
+static inline void ycbcr_to_rgb_neon(int16x8_t yr, int16x8_t cb, int16x8_t cr,
+	uint8x8_t *r, uint8x8_t *g, uint8x8_t *b)
+{
+	*r = vqmovun_s16(vshrq_n_s16(vqaddq_s16(yr, vmulq_n_s16(cr, 102)), 6));
+	*g = vqmovun_s16(vshrq_n_s16(vqsubq_s16(vqsubq_s16(yr, vmulq_n_s16(cb, 25)), vmulq_n_s16(cr, 52)), 6));
+	*b = vqmovun_s16(vshrq_n_s16(vqaddq_s16(yr, vmulq_n_s16(cb, 129)), 6));
+}
+
+template <int yofs, int cofs>
+static void ycbcr422_to_argb_simd(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	const uint8x8_t alpha = vdup_n_u8(0xFF);
+	int x;
+
+	// 16画素（32byte）ずつ、偶数画素と奇数画素に分けて求める
+	for (x = 0; x + 2 * PIXEL_CONVERT_BLOCK <= width; x += 2 * PIXEL_CONVERT_BLOCK) {
+		uint8x8x4_t v = vld4_u8(src);
+		uint8x8_t y0 = v.val[yofs];
+		uint8x8_t y1 = v.val[yofs + 2];
+		int16x8_t cb = vreinterpretq_s16_u16(vsubl_u8(v.val[cofs], vdup_n_u8(128)));
+		int16x8_t cr = vreinterpretq_s16_u16(vsubl_u8(v.val[cofs + 2], vdup_n_u8(128)));
+		int16x8_t yr0 = vqaddq_s16(vmulq_n_s16(vreinterpretq_s16_u16(vsubl_u8(y0, vdup_n_u8(16))), 75), vdupq_n_s16(32));
+		int16x8_t yr1 = vqaddq_s16(vmulq_n_s16(vreinterpretq_s16_u16(vsubl_u8(y1, vdup_n_u8(16))), 75), vdupq_n_s16(32));
+		uint8x8_t r0, g0, b0, r1, g1, b1;
+		ycbcr_to_rgb_neon(yr0, cb, cr, &r0, &g0, &b0);
+		ycbcr_to_rgb_neon(yr1, cb, cr, &r1, &g1, &b1);
+
+		uint8x8x2_t r = vzip_u8(r0, r1);
+		uint8x8x2_t g = vzip_u8(g0, g1);
+		uint8x8x2_t b = vzip_u8(b0, b1);
+		store_argb_neon(&dst[0], b.val[0], g.val[0], r.val[0], alpha);
+		store_argb_neon(&dst[PIXEL_CONVERT_BLOCK], b.val[1], g.val[1], r.val[1], alpha);
+		src += 4 * PIXEL_CONVERT_BLOCK;
+		dst += 2 * PIXEL_CONVERT_BLOCK;
+	}
+	ycbcr422_to_argb_c<yofs, cofs>(dst, src, width - x, ctx);
+}
+
+static void rgb565_to_argb_simd(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	const uint8x8_t alpha = vdup_n_u8(0xFF);
+	int x;
+
+	for (x = 0; x + PIXEL_CONVERT_BLOCK <= width; x += PIXEL_CONVERT_BLOCK) {
+		uint16x8_t v = vld1q_u16((const uint16_t *)src);
+		uint8x8_t r = vshrn_n_u16(v, 8);				// RRRRRGGG
+		uint8x8_t g = vshrn_n_u16(v, 3);				// GGGGGGBB
+		uint8x8_t b = vmovn_u16(vshlq_n_u16(v, 3));		// BBBBB000
+		r = vorr_u8(vand_u8(r, vdup_n_u8(0xF8)), vshr_n_u8(r, 5));
+		g = vorr_u8(vand_u8(g, vdup_n_u8(0xFC)), vshr_n_u8(g, 6));
+		b = vorr_u8(b, vshr_n_u8(b, 5));
+
+		store_argb_neon(dst, b, g, r, alpha);
+		src += 2 * PIXEL_CONVERT_BLOCK;
+		dst += PIXEL_CONVERT_BLOCK;
+	}
+	rgb565_to_argb_c(dst, src, width - x, ctx);
+}
+
+static void argb4444_to_argb_simd(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	const uint8x8_t m4 = vdup_n_u8(0x0F);
+	int x;
+
+	for (x = 0; x + PIXEL_CONVERT_BLOCK <= width; x += PIXEL_CONVERT_BLOCK) {
+		uint16x8_t v = vld1q_u16((const uint16_t *)src);
+		uint8x8_t ar = vshrn_n_u16(v, 8);				// AAAARRRR
+		uint8x8_t gb = vmovn_u16(v);					// GGGGBBBB
+		uint8x8_t a = vshr_n_u8(ar, 4);
+		uint8x8_t r = vand_u8(ar, m4);
+		uint8x8_t g = vshr_n_u8(gb, 4);
+		uint8x8_t b = vand_u8(gb, m4);
+		a = vorr_u8(a, vshl_n_u8(a, 4));
+		r = vorr_u8(r, vshl_n_u8(r, 4));
+		g = vorr_u8(g, vshl_n_u8(g, 4));
+		b = vorr_u8(b, vshl_n_u8(b, 4));
+
+		store_argb_neon(dst, b, g, r, a);
+		src += 2 * PIXEL_CONVERT_BLOCK;
+		dst += PIXEL_CONVERT_BLOCK;
+	}
+	argb4444_to_argb_c(dst, src, width - x, ctx);
+}
+
+static void rgb888_to_argb_simd(uint32_t *dst, const uint8_t *src, int width, const pixel_row_context_t *ctx)
+{
+	const uint32x4_t alpha = vdupq_n_u32(0xFF000000);
+	int x;
+
+	for (x = 0; x + PIXEL_CONVERT_BLOCK <= width; x += PIXEL_CONVERT_BLOCK) {
+		vst1q_u32(&dst[0], vorrq_u32(vld1q_u32((const uint32_t *)&src[0]), alpha));
+		vst1q_u32(&dst[4], vorrq_u32(vld1q_u32((const uint32_t *)&src[16]), alpha));
+		src += 4 * PIXEL_CONVERT_BLOCK;
+		dst += PIXEL_CONVERT_BLOCK;
+	}
+	rgb888_to_argb_c(dst, src, width - x, ctx);
+}
+
+static void bgr_to_rgb565_simd(uint8_t *dst, const uint8_t *src, int width)
+{
+	int x;
+
+	for (x = 0; x + PIXEL_CONVERT_BLOCK <= width; x += PIXEL_CONVERT_BLOCK) {
+		uint8x8x3_t v = vld3_u8(src);
+		uint16x8_t r = vshlq_n_u16(vmovl_u8(vshr_n_u8(v.val[2], 3)), 11);
+		uint16x8_t g = vshll_n_u8(vshr_n_u8(v.val[1], 2), 5);
+		uint16x8_t b = vmovl_u8(vshr_n_u8(v.val[0], 3));
+		vst1q_u16((uint16_t *)dst, vorrq_u16(vorrq_u16(r, g), b));
+		src += 3 * PIXEL_CONVERT_BLOCK;
+		dst += 2 * PIXEL_CONVERT_BLOCK;
+	}
+	bgr_to_rgb565_c(dst, src, width - x);
+}
+
+static void bgr_to_argb_simd(uint8_t *dst, const uint8_t *src, int width)
+{
+	const uint8x8_t alpha = vdup_n_u8(0xFF);
+	int x;
+
+	for (x = 0; x + PIXEL_CONVERT_BLOCK <= width; x += PIXEL_CONVERT_BLOCK) {
+		uint8x8x3_t v = vld3_u8(src);
+		store_argb_neon((uint32_t *)dst, v.val[0], v.val[1], v.val[2], alpha);
+		src += 3 * PIXEL_CONVERT_BLOCK;
+		dst += 4 * PIXEL_CONVERT_BLOCK;
+	}
+	bgr_to_argb_c(dst, src, width - x);
+}
+
+/* 8bit×8のR、G、Bから輝度を求める */
+static inline uint8x8_t rgb_to_y_neon(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+	uint16x8_t y = vmull_u8(r, vdup_n_u8(66));
+	y = vmlal_u8(y, g, vdup_n_u8(129));
+	y = vmlal_u8(y, b, vdup_n_u8(25));
+	y = vaddq_u16(y, vdupq_n_u16(128));
+	return vadd_u8(vshrn_n_u16(y, 8), vdup_n_u8(16));
+}
+
+template <int yofs, int cofs>
+static void bgr_to_ycbcr422_simd(uint8_t *dst, const uint8_t *src, int width)
+{
+	int x;
+
+	// 16画素（48byte）ずつ、偶数画素と奇数画素に分かれた形で読み込む
+	for (x = 0; x + 2 * PIXEL_CONVERT_BLOCK <= width; x += 2 * PIXEL_CONVERT_BLOCK) {
+		uint8x16x3_t v = vld3q_u8(src);
+		uint8x8x2_t b = vuzp_u8(vget_low_u8(v.val[0]), vget_high_u8(v.val[0]));
+		uint8x8x2_t g = vuzp_u8(vget_low_u8(v.val[1]), vget_high_u8(v.val[1]));
+		uint8x8x2_t r = vuzp_u8(vget_low_u8(v.val[2]), vget_high_u8(v.val[2]));
+		uint8x8x4_t out;
+
+		out.val[yofs] = rgb_to_y_neon(r.val[0], g.val[0], b.val[0]);
+		out.val[yofs + 2] = rgb_to_y_neon(r.val[1], g.val[1], b.val[1]);
+
+		// 2画素の平均（切り上げ）
+		int16x8_t ra = vreinterpretq_s16_u16(vmovl_u8(vrhadd_u8(r.val[0], r.val[1])));
+		int16x8_t ga = vreinterpretq_s16_u16(vmovl_u8(vrhadd_u8(g.val[0], g.val[1])));
+		int16x8_t ba = vreinterpretq_s16_u16(vmovl_u8(vrhadd_u8(b.val[0], b.val[1])));
+		int16x8_t cb = vmulq_n_s16(ra, -38);
+		cb = vmlaq_n_s16(cb, ga, -74);
+		cb = vmlaq_n_s16(cb, ba, 112);
+		int16x8_t cr = vmulq_n_s16(ra, 112);
+		cr = vmlaq_n_s16(cr, ga, -94);
+		cr = vmlaq_n_s16(cr, ba, -18);
+		out.val[cofs] = vmovn_u16(vreinterpretq_u16_s16(vaddq_s16(vshrq_n_s16(vaddq_s16(cb, vdupq_n_s16(128)), 8), vdupq_n_s16(128))));
+		out.val[cofs + 2] = vmovn_u16(vreinterpretq_u16_s16(vaddq_s16(vshrq_n_s16(vaddq_s16(cr, vdupq_n_s16(128)), 8), vdupq_n_s16(128))));
+
+		vst4_u8(dst, out);
+		src += 6 * PIXEL_CONVERT_BLOCK;
+		dst += 4 * PIXEL_CONVERT_BLOCK;
+	}
+	bgr_to_ycbcr422_c<yofs, cofs>(dst, src, width - x);
+}
+
+static void blend_rows_simd(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, int bytes, int weight)
+{
+	const uint8x8_t w0 = vdup_n_u8((uint8_t)((1 << PIXEL_RESIZE_WEIGHT_BITS) - weight));
+	const uint8x8_t w1 = vdup_n_u8((uint8_t)weight);
+	int i;
+
+	for (i = 0; i + 16 <= bytes; i += 16) {
+		uint8x16_t a = vld1q_u8(&src0[i]);
+		uint8x16_t b = vld1q_u8(&src1[i]);
+		uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(a), w0), vget_low_u8(b), w1);
+		uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(a), w0), vget_high_u8(b), w1);
+		vst1q_u8(&dst[i], vcombine_u8(vrshrn_n_u16(lo, PIXEL_RESIZE_WEIGHT_BITS), vrshrn_n_u16(hi, PIXEL_RESIZE_WEIGHT_BITS)));
+	}
+	blend_rows_c(&dst[i], &src0[i], &src1[i], bytes - i, weight);
+}
+
+#else
+
+#define ycbcr422_to_argb_simd ycbcr422_to_argb_c
+#define rgb565_to_argb_simd rgb565_to_argb_c
+#define argb4444_to_argb_simd argb4444_to_argb_c
+#define rgb888_to_argb_simd rgb888_to_argb_c
+#define bgr_to_rgb565_simd bgr_to_rgb565_c
+#define bgr_to_argb_simd bgr_to_argb_c
+#define bgr_to_ycbcr422_simd bgr_to_ycbcr422_c
+#define blend_rows_simd blend_rows_c
+
+#endif
+
+static to_argb_row_t get_to_argb_row(PixelFormat::T format, bool simd)
+{
+	switch (format) {
+	case PixelFormat::YUYV:
+		return simd ? ycbcr422_to_argb_simd<0, 1> : ycbcr422_to_argb_c<0, 1>;
+	case PixelFormat::UYVY:
+		return simd ? ycbcr422_to_argb_simd<1, 0> : ycbcr422_to_argb_c<1, 0>;
+	case PixelFormat::RGB565:
+		return simd ? rgb565_to_argb_simd : rgb565_to_argb_c;
+	case PixelFormat::RGB888:
+		return simd ? rgb888_to_argb_simd : rgb888_to_argb_c;
+	case PixelFormat::ARGB8888:
+		return argb8888_to_argb_c;
+	case PixelFormat::ARGB4444:
+		return simd ? argb4444_to_argb_simd : argb4444_to_argb_c;
+	case PixelFormat::CLUT8:
+		return clut8_to_argb_c;
+	default:
+		return NULL;
+	}
+}
+
+static from_bgr_row_t get_from_bgr_row(PixelFormat::T format, bool simd)
+{
+	switch (format) {
+	case PixelFormat::YUYV:
+		return simd ? bgr_to_ycbcr422_simd<0, 1> : bgr_to_ycbcr422_c<0, 1>;
+	case PixelFormat::UYVY:
+		return simd ? bgr_to_ycbcr422_simd<1, 0> : bgr_to_ycbcr422_c<1, 0>;
+	case PixelFormat::RGB565:
+		return simd ? bgr_to_rgb565_simd : bgr_to_rgb565_c;
+	case PixelFormat::ARGB8888:
+		return simd ? bgr_to_argb_simd : bgr_to_argb_c;
+	default:
+		return NULL;
+	}
+}
+
+DisplayBase::wr_rd_swa_t PixelConvert::GetNativeSwap(PixelFormat::T format)
+{
+	switch (PixelFormat::GetBytesPerPixel(format)) {
+	case 1:
+		return DisplayBase::WR_RD_WRSWA_32_16_8BIT;
+	case 2:
+		return DisplayBase::WR_RD_WRSWA_32_16BIT;
+	default:
+		return DisplayBase::WR_RD_WRSWA_32BIT;
+	}
+}
+
+/*
+ * スワップ設定は64bit内のバイト位置のXOR（8bit:1、16bit:2、32bit:4）なので、
+ * 標準の設定との差分だけ並べ替えてから変換する。
+ */
+class ToARGB8888Body : public cv::ParallelLoopBody
+{
+public:
+	uint32_t *dst;
+	int dst_stride;
+	const uint8_t *src;
+	int src_stride;
+	int width;
+	int swap;
+	int row_bytes;
+	to_argb_row_t row;
+	pixel_row_context_t ctx;
+
+	void operator()(const cv::Range &range) const override
+	{
+		std::vector<uint8_t> work;
+
+		if (swap != 0)
+			work.resize((row_bytes + 7) & ~7);
+
+		for (int y = range.start; y < range.end; y++) {
+			const uint8_t *s = &src[y * src_stride];
+			if (swap != 0) {
+				for (int i = 0; i < (int)work.size(); i++) {
+					int j = i ^ swap;
+					work[i] = (j < src_stride) ? s[j] : 0;
+				}
+				s = &work[0];
+			}
+			row((uint32_t *)((uint8_t *)dst + y * dst_stride), s, width, &ctx);
+		}
+	}
+};
+
+bool PixelConvert::ToARGB8888(uint32_t *dst, int dst_stride, const void *src, int src_stride,
+	int width, int height, PixelFormat::T format, DisplayBase::wr_rd_swa_t swa,
+	const uint32_t *clut, int clut_count, Kernel::T kernel)
+{
+	ToARGB8888Body body;
+
+	body.row = get_to_argb_row(format, kernel == Kernel::Auto);
+	if (body.row == NULL)
+		return false;
+
+	body.dst = dst;
+	body.dst_stride = dst_stride;
+	body.src = (const uint8_t *)src;
+	body.src_stride = src_stride;
+	body.width = width;
+	body.swap = (int)swa ^ (int)GetNativeSwap(format);
+	body.row_bytes = width * PixelFormat::GetBytesPerPixel(format);
+	body.ctx.clut = clut;
+	body.ctx.clut_count = (clut != NULL) ? clut_count : 0;
+
+	if ((width * height >= PIXEL_CONVERT_PARALLEL_PIXELS) && (kernel == Kernel::Auto))
+		cv::parallel_for_(cv::Range(0, height), body);
+	else
+		body(cv::Range(0, height));
+
+	return true;
+}
+
+class FromBGR888Body : public cv::ParallelLoopBody
+{
+public:
+	uint8_t *dst;
+	int dst_stride;
+	const uint8_t *src;
+	int src_stride;
+	int width;
+	from_bgr_row_t row;
+
+	void operator()(const cv::Range &range) const override
+	{
+		for (int y = range.start; y < range.end; y++) {
+			row(&dst[y * dst_stride], &src[y * src_stride], width);
+		}
+	}
+};
+
+bool PixelConvert::FromBGR888(void *dst, int dst_stride, PixelFormat::T format,
+	const uint8_t *src, int src_stride, int width, int height, Kernel::T kernel)
+{
+	FromBGR888Body body;
+
+	body.row = get_from_bgr_row(format, kernel == Kernel::Auto);
+	if (body.row == NULL)
+		return false;
+
+	body.dst = (uint8_t *)dst;
+	body.dst_stride = dst_stride;
+	body.src = src;
+	body.src_stride = src_stride;
+	body.width = width;
+
+	if ((width * height >= PIXEL_CONVERT_PARALLEL_PIXELS) && (kernel == Kernel::Auto))
+		cv::parallel_for_(cv::Range(0, height), body);
+	else
+		body(cv::Range(0, height));
+
+	return true;
+}
+
+PixelResizer::PixelResizer() :
+	_srcWidth(0),
+	_srcHeight(0),
+	_dstWidth(0),
+	_dstHeight(0)
+{
+}
+
+/* 画素の中心を合わせた双線形補間の位置と重み */
+static void resize_table(int src, int dst, int *ofs, uint8_t *weight)
+{
+	for (int i = 0; i < dst; i++) {
+		// 16bit固定小数点
+		int64_t pos = (((int64_t)(2 * i + 1) * src) << 16) / (2 * dst) - (1 << 15);
+		if (pos < 0)
+			pos = 0;
+		int n = (int)(pos >> 16);
+		int w = (int)((pos & 0xFFFF) >> (16 - PIXEL_RESIZE_WEIGHT_BITS));
+		// 右端は1つ手前の画素と右の画素の重みで表す
+		if (n >= src - 1) {
+			n = src - 2;
+			w = 1 << PIXEL_RESIZE_WEIGHT_BITS;
+		}
+		ofs[i] = n;
+		weight[i] = (uint8_t)w;
+	}
+}
+
+void PixelResizer::Prepare(int src_width, int src_height, int dst_width, int dst_height)
+{
+	if ((_srcWidth == src_width) && (_srcHeight == src_height)
+		&& (_dstWidth == dst_width) && (_dstHeight == dst_height))
+		return;
+
+	_srcWidth = src_width;
+	_srcHeight = src_height;
+	_dstWidth = dst_width;
+	_dstHeight = dst_height;
+
+	_xofs.resize(dst_width);
+	_xweight.resize(dst_width);
+	resize_table(src_width, dst_width, &_xofs[0], &_xweight[0]);
+	_yofs.resize(dst_height);
+	_yweight.resize(dst_height);
+	resize_table(src_height, dst_height, &_yofs[0], &_yweight[0]);
+
+	_work.resize(PIXEL_RESIZE_STRIPES * 3 * (src_width + dst_width));
+}
+
+class PixelResizeBody : public cv::ParallelLoopBody
+{
+public:
+	uint8_t *dst;
+	int dst_stride;
+	const uint8_t *src;
+	int src_stride;
+	int src_width;
+	int dst_width;
+	int dst_height;
+	const int *xofs;
+	const uint8_t *xweight;
+	const int *yofs;
+	const uint8_t *yweight;
+	uint8_t *work;
+	int stripes;
+	from_bgr_row_t row;
+	void (*blend)(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, int bytes, int weight);
+
+	/* rangeは分割の番号 */
+	void operator()(const cv::Range &range) const override
+	{
+		const int round = 1 << (PIXEL_RESIZE_WEIGHT_BITS - 1);
+
+		for (int stripe = range.start; stripe < range.end; stripe++) {
+			uint8_t *vbuf = &work[stripe * 3 * (src_width + dst_width)];
+			uint8_t *hbuf = vbuf + 3 * src_width;
+			int y0 = stripe * dst_height / stripes;
+			int y1 = (stripe + 1) * dst_height / stripes;
+
+			for (int y = y0; y < y1; y++) {
+				const uint8_t *s0 = &src[yofs[y] * src_stride];
+				const uint8_t *line = s0;
+				if (yweight[y] != 0) {
+					blend(vbuf, s0, s0 + src_stride, 3 * src_width, yweight[y]);
+					line = vbuf;
+				}
+
+				// 横の補間は画素ごとに読む位置が違うのでCで行う
+				uint8_t *h = hbuf;
+				for (int x = 0; x < dst_width; x++) {
+					const uint8_t *p = &line[3 * xofs[x]];
+					int w1 = xweight[x];
+					int w0 = (1 << PIXEL_RESIZE_WEIGHT_BITS) - w1;
+					h[0] = (uint8_t)((p[0] * w0 + p[3] * w1 + round) >> PIXEL_RESIZE_WEIGHT_BITS);
+					h[1] = (uint8_t)((p[1] * w0 + p[4] * w1 + round) >> PIXEL_RESIZE_WEIGHT_BITS);
+					h[2] = (uint8_t)((p[2] * w0 + p[5] * w1 + round) >> PIXEL_RESIZE_WEIGHT_BITS);
+					h += 3;
+				}
+
+				row(&dst[y * dst_stride], hbuf, dst_width);
+			}
+		}
+	}
+};
+
+bool PixelResizer::FromBGR888(void *dst, int dst_stride, PixelFormat::T format, int dst_width, int dst_height,
+	const uint8_t *src, int src_stride, int src_width, int src_height, PixelConvert::Kernel::T kernel)
+{
+	PixelResizeBody body;
+	bool simd = (kernel == PixelConvert::Kernel::Auto);
+
+	if ((src_width < 2) || (src_height < 2) || (dst_width <= 0) || (dst_height <= 0))
+		return false;
+
+	body.row = get_from_bgr_row(format, simd);
+	if (body.row == NULL)
+		return false;
+
+	Prepare(src_width, src_height, dst_width, dst_height);
+
+	body.dst = (uint8_t *)dst;
+	body.dst_stride = dst_stride;
+	body.src = src;
+	body.src_stride = src_stride;
+	body.src_width = src_width;
+	body.dst_width = dst_width;
+	body.dst_height = dst_height;
+	body.xofs = &_xofs[0];
+	body.xweight = &_xweight[0];
+	body.yofs = &_yofs[0];
+	body.yweight = &_yweight[0];
+	body.work = &_work[0];
+	body.stripes = PIXEL_RESIZE_STRIPES;
+	body.blend = simd ? blend_rows_simd : blend_rows_c;
+
+	if ((dst_width * dst_height >= PIXEL_CONVERT_PARALLEL_PIXELS) && simd)
+		cv::parallel_for_(cv::Range(0, PIXEL_RESIZE_STRIPES), body);
+	else
+		body(cv::Range(0, PIXEL_RESIZE_STRIPES));
+
+	return true;
+}
+
+const char *PixelConvert::GetKernelName()
+{
+#if defined(PIXEL_CONVERT_SSE2)
+	return "SSE2";
+#elif defined(PIXEL_CONVERT_NEON)
+	return "NEON";
+#else
+	return "C";
+#endif
+}
+
+static const char *pixel_format_name(PixelFormat::T format)
+{
+	switch (format) {
+	case PixelFormat::YUYV: return "YUYV";
+	case PixelFormat::UYVY: return "UYVY";
+	case PixelFormat::RGB565: return "RGB565";
+	case PixelFormat::RGB888: return "RGB888";
+	case PixelFormat::ARGB8888: return "ARGB8888";
+	case PixelFormat::ARGB4444: return "ARGB4444";
+	case PixelFormat::CLUT8: return "CLUT8";
+	case PixelFormat::BGR888: return "BGR888";
+	}
+	return "?";
+}
+
+static double pixel_rate(us_timestamp_t elapse, int pixels, int count)
+{
+	if (elapse == 0)
+		elapse = 1;
+	return (double)pixels * count / (double)elapse;
+}
+
+void PixelConvertBench(int width, int height)
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+	const int count = 20;
+	int pixels = width * height;
+	std::vector<uint8_t> src(4 * pixels);
+	std::vector<uint8_t> dst0(4 * pixels), dst1(4 * pixels);
+	std::vector<uint32_t> clut(256);
+	us_timestamp_t start, scalar, simd;
+
+	for (size_t i = 0; i < src.size(); i++)
+		src[i] = (uint8_t)rand();
+	for (size_t i = 0; i < clut.size(); i++)
+		clut[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+
+	printf("%dx%d, %s [Mpixel/s]\n", width, height, PixelConvert::GetKernelName());
+
+	static const PixelFormat::T to_argb[] = {
+		PixelFormat::YUYV, PixelFormat::UYVY, PixelFormat::RGB565, PixelFormat::RGB888,
+		PixelFormat::ARGB8888, PixelFormat::ARGB4444, PixelFormat::CLUT8
+	};
+	for (size_t i = 0; i < sizeof(to_argb) / sizeof(to_argb[0]); i++) {
+		PixelFormat::T format = to_argb[i];
+		int stride = width * PixelFormat::GetBytesPerPixel(format);
+		DisplayBase::wr_rd_swa_t swa = PixelConvert::GetNativeSwap(format);
+
+		start = ticker_read_us(ticker);
+		for (int n = 0; n < count; n++)
+			PixelConvert::ToARGB8888((uint32_t *)&dst0[0], 4 * width, &src[0], stride, width, height,
+				format, swa, &clut[0], 256, PixelConvert::Kernel::Scalar);
+		scalar = ticker_read_us(ticker) - start;
+
+		start = ticker_read_us(ticker);
+		for (int n = 0; n < count; n++)
+			PixelConvert::ToARGB8888((uint32_t *)&dst1[0], 4 * width, &src[0], stride, width, height,
+				format, swa, &clut[0], 256);
+		simd = ticker_read_us(ticker) - start;
+
+		printf("%-8s -> ARGB8888 : C %7.1f, %s %7.1f%s\n", pixel_format_name(format),
+			pixel_rate(scalar, pixels, count), PixelConvert::GetKernelName(), pixel_rate(simd, pixels, count),
+			(memcmp(&dst0[0], &dst1[0], 4 * pixels) == 0) ? "" : " (mismatch)");
+	}
+
+	static const PixelFormat::T from_bgr[] = {
+		PixelFormat::YUYV, PixelFormat::UYVY, PixelFormat::RGB565, PixelFormat::ARGB8888
+	};
+	for (size_t i = 0; i < sizeof(from_bgr) / sizeof(from_bgr[0]); i++) {
+		PixelFormat::T format = from_bgr[i];
+		int stride = width * PixelFormat::GetBytesPerPixel(format);
+
+		start = ticker_read_us(ticker);
+		for (int n = 0; n < count; n++)
+			PixelConvert::FromBGR888(&dst0[0], stride, format, &src[0], 3 * width, width, height,
+				PixelConvert::Kernel::Scalar);
+		scalar = ticker_read_us(ticker) - start;
+
+		start = ticker_read_us(ticker);
+		for (int n = 0; n < count; n++)
+			PixelConvert::FromBGR888(&dst1[0], stride, format, &src[0], 3 * width, width, height);
+		simd = ticker_read_us(ticker) - start;
+
+		printf("BGR888   -> %-8s : C %7.1f, %s %7.1f%s\n", pixel_format_name(format),
+			pixel_rate(scalar, pixels, count), PixelConvert::GetKernelName(), pixel_rate(simd, pixels, count),
+			(memcmp(&dst0[0], &dst1[0], stride * height) == 0) ? "" : " (mismatch)");
+	}
+}
+
+void PixelResizeBench(int width, int height)
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+	const int count = 20;
+	static const struct {
+		int width;
+		int height;
+	} sources[] = { { 640, 480 }, { 1280, 720 } };
+	std::vector<uint8_t> dst0(2 * width * height), dst1(2 * width * height);
+	PixelResizer resizer;
+	us_timestamp_t start, separate, scalar, simd;
+
+	printf("-> %dx%d YUYV, %s [ms/frame]\n", width, height, PixelConvert::GetKernelName());
+
+	for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+		cv::Mat image(sources[i].height, sources[i].width, CV_8UC3);
+		cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(256));
+
+		// 縮小した画像を作ってから変換する
+		start = ticker_read_us(ticker);
+		for (int n = 0; n < count; n++) {
+			cv::Mat rszimg;
+			cv::resize(image, rszimg, cv::Size(width, height));
+			PixelConvert::FromBGR888(&dst0[0], 2 * width, PixelFormat::YUYV, rszimg.data, (int)rszimg.step, width, height);
+		}
+		separate = ticker_read_us(ticker) - start;
+
+		start = ticker_read_us(ticker);
+		for (int n = 0; n < count; n++)
+			resizer.FromBGR888(&dst0[0], 2 * width, PixelFormat::YUYV, width, height,
+				image.data, (int)image.step, image.cols, image.rows, PixelConvert::Kernel::Scalar);
+		scalar = ticker_read_us(ticker) - start;
+
+		start = ticker_read_us(ticker);
+		for (int n = 0; n < count; n++)
+			resizer.FromBGR888(&dst1[0], 2 * width, PixelFormat::YUYV, width, height,
+				image.data, (int)image.step, image.cols, image.rows);
+		simd = ticker_read_us(ticker) - start;
+
+		printf("%4dx%-4d : resize+pack %6.2f, fused C %6.2f, fused %s %6.2f%s\n",
+			sources[i].width, sources[i].height, separate / 1000.0 / count, scalar / 1000.0 / count,
+			PixelConvert::GetKernelName(), simd / 1000.0 / count,
+			(memcmp(&dst0[0], &dst1[0], dst0.size()) == 0) ? "" : " (mismatch)");
+	}
+}
+
+extern "C" int usrcmd_pix(int argc, char **argv)
+{
+	int width = 640, height = 480;
+	bool resize = false;
+
+	if ((argc > 1) && (strcmp(argv[1], "resize") == 0)) {
+		resize = true;
+		width = 480;
+		height = 272;
+		argc--;
+		argv++;
+	}
+	if (argc > 2) {
+		width = atoi(argv[1]);
+		height = atoi(argv[2]);
+	}
+	if ((width <= 0) || (height <= 0)) {
+		printf("pix [resize] [<width> <height>] \n");
+		return 0;
+	}
+
+	if (resize)
+		PixelResizeBench(width, height);
+	else
+		PixelConvertBench(width, height);
+
+	return 0;
+}
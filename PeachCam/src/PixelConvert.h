@@ -0,0 +1,110 @@
+#ifndef _PIXELCONVERT_H_
+#define _PIXELCONVERT_H_
+
+#include <stdint.h>
+#include <vector>
+#include "DisplayBase.h"
+
+/* これ以上の画素数なら行ごとに分けて並列に変換する */
+#define PIXEL_CONVERT_PARALLEL_PIXELS	(256 * 256)
+/* 拡大縮小の分割数（分割ごとに作業領域を持つ） */
+#define PIXEL_RESIZE_STRIPES			(4)
+/* 補間の重みのビット数（8bitの画素と16bitで積和できる範囲） */
+#define PIXEL_RESIZE_WEIGHT_BITS		(7)
+
+/*
+ * 画素形式
+ * YCbCr422はYUYV（Y0 Cb Y1 Cr）とUYVY（Cb Y0 Cr Y1）の並びを区別する。
+ * RGB888はDisplayBaseと同じく1画素4byte（上位8bitは無視）、
+ * BGR888はOpenCVの3byte/画素。
+ */
+class PixelFormat
+{
+public:
+	enum T {
+		YUYV,
+		UYVY,
+		RGB565,
+		RGB888,
+		ARGB8888,
+		ARGB4444,
+		CLUT8,
+		BGR888,
+	};
+	static T FromGraphics(DisplayBase::graphics_format_t format);
+	static int GetBytesPerPixel(T format);
+};
+
+/*
+ * 画素形式の変換
+ *
+ *  ToARGB8888   表示レイヤーの読み出し（全形式 → ARGB8888）
+ *  FromBGR888   カメラ画像の書き込み（OpenCVのBGR → RGB565/YUYV/UYVY/ARGB8888）
+ *
+ * strideはバイト単位。swaはフレームバッファのスワップ設定で、
+ * 各形式の標準の設定（16bpp:32_16BIT、32bpp:32BIT、8bpp:32_16_8BIT）を無変換とする。
+ * YCbCrとRGBの変換はITU-R BT.601（16～235）。
+ */
+class PixelConvert
+{
+public:
+	class Kernel
+	{
+	public:
+		enum T {
+			Auto,		// 使えるSIMD命令で変換する
+			Scalar,		// 比較用
+		};
+	};
+public:
+	static bool ToARGB8888(uint32_t *dst, int dst_stride, const void *src, int src_stride,
+		int width, int height, PixelFormat::T format, DisplayBase::wr_rd_swa_t swa,
+		const uint32_t *clut = NULL, int clut_count = 0, Kernel::T kernel = Kernel::Auto);
+	/* 形式ごとの標準のスワップ設定 */
+	static DisplayBase::wr_rd_swa_t GetNativeSwap(PixelFormat::T format);
+	static bool FromBGR888(void *dst, int dst_stride, PixelFormat::T format,
+		const uint8_t *src, int src_stride, int width, int height, Kernel::T kernel = Kernel::Auto);
+	/* 使われるSIMD命令の名前 */
+	static const char *GetKernelName();
+};
+
+/*
+ * 拡大縮小と形式変換を1パスで行う（双線形補間）
+ *
+ * 出力の1行ごとに縦の補間、横の補間、形式変換を続けて行うので、
+ * 中間の画像は作らない。座標の表と作業領域は大きさが変わったときだけ作り直す。
+ * SIMDを使うのは縦の補間（2行の混合）と形式変換の一部で、
+ * 横の補間（3byte/画素の隣り合う2画素の混合）はCで行う。
+ */
+class PixelResizer
+{
+public:
+	PixelResizer();
+private:
+	int _srcWidth;
+	int _srcHeight;
+	int _dstWidth;
+	int _dstHeight;
+	std::vector<int> _xofs;				// 左の画素の位置
+	std::vector<uint8_t> _xweight;		// 右の画素の重み
+	std::vector<int> _yofs;
+	std::vector<uint8_t> _yweight;
+	std::vector<uint8_t> _work;			// 分割ごとの1行分の作業領域
+	void Prepare(int src_width, int src_height, int dst_width, int dst_height);
+public:
+	/* 縦横とも2画素以上、出力はRGB565/YUYV/UYVY/ARGB8888 */
+	bool FromBGR888(void *dst, int dst_stride, PixelFormat::T format, int dst_width, int dst_height,
+		const uint8_t *src, int src_stride, int src_width, int src_height,
+		PixelConvert::Kernel::T kernel = PixelConvert::Kernel::Auto);
+};
+
+/*
+ * 形式の組み合わせごとの変換速度[Mpixel/s]を表示する
+ */
+void PixelConvertBench(int width, int height);
+/*
+ * カメラ画像（640x480、1280x720）から指定の大きさへの取り込み時間[ms/frame]を表示する
+ */
+void PixelResizeBench(int width, int height);
+
+#endif // _PIXELCONVERT_H_
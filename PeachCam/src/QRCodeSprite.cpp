@@ -0,0 +1,71 @@
+#include "mbed.h"
+#include "QRCodeSprite.h"
+#include "qrcode.h"
+
+QRCodeSprite::QRCodeSprite(uint8_t version, uint8_t ecc, int scale, uint16_t onColor, uint16_t offColor) :
+	_version(version),
+	_ecc(ecc),
+	_scale(scale),
+	_onColor(onColor),
+	_offColor(offColor),
+	_valid(false),
+	_modules(qrcode_getBufferSize(version)),
+	_size(0),
+	_draws(0),
+	_renders(0)
+{
+}
+
+void QRCodeSprite::Render(const char *text, int length)
+{
+	_text.assign(text, length);
+	_renders++;
+
+	QRCode qrcode;
+	_valid = qrcode_initBytes(&qrcode, &_modules[0], _version, _ecc, (uint8_t *)text, length) == 0;
+	if (!_valid)
+		return;
+
+	_size = qrcode.size * _scale;
+	_pixels.resize(_size * _size);
+
+	// 1モジュール分の高さの先頭の行だけ塗って、残りの行はそれを写す
+	for (int my = 0; my < qrcode.size; my++) {
+		uint16_t *line = &_pixels[my * _scale * _size];
+		uint16_t *dst = line;
+		for (int mx = 0; mx < qrcode.size; mx++) {
+			uint16_t color = qrcode_getModule(&qrcode, mx, my) ? _onColor : _offColor;
+			for (int i = 0; i < _scale; i++)
+				*dst++ = color;
+		}
+		for (int i = 1; i < _scale; i++)
+			memcpy(line + i * _size, line, _size * sizeof(uint16_t));
+	}
+}
+
+bool QRCodeSprite::Draw(LCD_Handler_t *lcd, int x, int y, const char *text, int length)
+{
+	if ((_renders == 0) || (_text.compare(0, std::string::npos, text, length) != 0))
+		Render(text, length);
+	if (!_valid) {
+		// 前のコードの絵が残らないように、この版の大きさの範囲を消す
+		int size = (4 * _version + 17) * _scale;
+		lcd_fillRect(lcd, x, y, size, size, 0x0000);
+		return false;
+	}
+	_draws++;
+
+	// 画面からはみ出す分は描かない
+	int w = _size, h = _size;
+	if (x + w > lcd->_width)
+		w = lcd->_width - x;
+	if (y + h > lcd->_height)
+		h = lcd->_height - y;
+	if ((x < 0) || (y < 0) || (w <= 0) || (h <= 0))
+		return false;
+
+	uint16_t *frame = (uint16_t *)lcd->_buffer;
+	for (int row = 0; row < h; row++)
+		memcpy(&frame[x + (y + row) * lcd->_width], &_pixels[row * _size], w * sizeof(uint16_t));
+	return true;
+}
@@ -0,0 +1,41 @@
+#ifndef _QRCODESPRITE_H_
+#define _QRCODESPRITE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "adafruit_gfx.h"
+
+/*
+ * 文字列をQRコードにした絵（ARGB4444）を覚えておいて画面に写す
+ *
+ * 同じ文字列が続く間は符号化もモジュールごとの塗りもせず、絵を1行ずつmemcpyするだけ。
+ * 文字列が変わった時だけqrcode_initBytesで作り直す。
+ */
+class QRCodeSprite
+{
+public:
+	QRCodeSprite(uint8_t version, uint8_t ecc, int scale, uint16_t onColor, uint16_t offColor);
+private:
+	uint8_t _version;
+	uint8_t _ecc;
+	int _scale;					// 1モジュールの画素数（縦横）
+	uint16_t _onColor;
+	uint16_t _offColor;
+	std::string _text;			// 今の絵の元の文字列
+	bool _valid;				// 符号化できた（入りきらなければfalse）
+	std::vector<uint8_t> _modules;
+	int _size;					// 絵の1辺の画素数
+	std::vector<uint16_t> _pixels;
+	uint32_t _draws;
+	uint32_t _renders;			// 作り直した回数
+	void Render(const char *text, int length);
+public:
+	/* textのQRコードをlcdの(x, y)に描く。符号化できなければ前の絵を消してfalseを返す */
+	bool Draw(LCD_Handler_t *lcd, int x, int y, const char *text, int length);
+	int GetSize() { return _size; }
+	uint32_t GetDraws() { return _draws; }
+	uint32_t GetRenders() { return _renders; }
+};
+
+#endif // _QRCODESPRITE_H_
@@ -6,11 +6,11 @@
 extern uint8_t heart_mark;
 
 TriggerButtonTask::TriggerButtonTask(SensorTask *owner) :
-	Task(10),
+	Task(osWaitForever),
 	_owner(owner),
-	button(BUTTON1),
+	button(SENSOR_PIN_TRIGGER),
 	_state((button != 0) ? State::Down : State::Up),
-	_count(0)
+	_pending(false)
 {
 }
 
@@ -18,41 +18,65 @@ TriggerButtonTask::~TriggerButtonTask()
 {
 }
 
+void TriggerButtonTask::OnStart()
+{
+	button.rise(callback(this, edge_isr));
+	button.fall(callback(this, edge_isr));
+}
+
+void TriggerButtonTask::edge_isr(TriggerButtonTask *obj)
+{
+	obj->_owner->Signal(InterTaskSignals::TriggerChanged);
+}
+
+void TriggerButtonTask::ProcessEvent(InterTaskSignals::T signals)
+{
+	// エッジが来るたびに確定までの時間を延長する
+	if ((signals & InterTaskSignals::TriggerChanged) != 0) {
+		_pending = true;
+		_timer = SENSOR_DEBOUNCE_MS;
+	}
+}
+
 void TriggerButtonTask::Process()
 {
+	if (!_pending) {
+		_timer = osWaitForever;
+		return;
+	}
+
 	if (_timer != 0)
 		return;
 
-	_timer = 10;
+	_pending = false;
+	_timer = osWaitForever;
 
 	State::T now = (button != 0) ? State::Down : State::Up;
-	if (now != _state) {
-		_count++;
-		if (_count > 10) {
-			_state = now;
-			_count = 0;
+	if (now == _state)
+		return;
 
-			if (now == State::Down)
-				printf("Button::Down\r\n");
-			else
-				printf("Button::Up\r\n");
+	_state = now;
 
-			if (now == State::Down)
-				_owner->TriggerOn();
-		}
-	}
-	else {
-		_count = 0;
-	}
+	if (now == State::Down)
+		printf("Button::Down\r\n");
+	else
+		printf("Button::Up\r\n");
+
+	if (now == State::Down)
+		_owner->TriggerOn();
+
+	_owner->SensorChanged();
 }
 
 GripButtonTask::GripButtonTask(SensorTask *owner) :
-	Task(10),
+	Task(osWaitForever),
 	_owner(owner),
-	button(A0),
+	button(SENSOR_PIN_GRIP),
 	_state(State::Release),
-	_count(0),
-	_threshold(0.8f)
+	_pending(false),
+	_level(1),
+	_threshold(0.8f),
+	_hysteresis(0.05f)
 {
 }
 
@@ -60,36 +84,64 @@ GripButtonTask::~GripButtonTask()
 {
 }
 
+void GripButtonTask::OnStart()
+{
+	_level = (button < _threshold) ? 0 : 1;
+	button.comparator(_threshold - _hysteresis, _threshold + _hysteresis,
+		callback(this, &GripButtonTask::compare_isr));
+
+	// 起動時の状態も変化として確定させる
+	_pending = true;
+	_timer = SENSOR_DEBOUNCE_MS;
+}
+
+void GripButtonTask::compare_isr(int level)
+{
+	_level = level;
+	_owner->Signal(InterTaskSignals::GripChanged);
+}
+
+void GripButtonTask::ProcessEvent(InterTaskSignals::T signals)
+{
+	if ((signals & InterTaskSignals::GripChanged) != 0) {
+		_pending = true;
+		_timer = SENSOR_DEBOUNCE_MS;
+	}
+}
+
 void GripButtonTask::Process()
 {
+	if (!_pending) {
+		_timer = osWaitForever;
+		return;
+	}
+
 	if (_timer != 0)
 		return;
 
-	_timer = 10;
+	_pending = false;
+	_timer = osWaitForever;
 
-	State::T now = (button < _threshold) ? State::Hold : State::Release;
-	if (now != _state) {
-		_count++;
-		if (_count > 10) {
-			_state = now;
-			_count = 0;
+	State::T now = (_level == 0) ? State::Hold : State::Release;
+	if (now == _state)
+		return;
 
-			if (now == State::Hold)
-				printf("Grip::Hold\r\n");
-			else
-				printf("Grip::Release\r\n");
-		}
-	}
-	else {
-		_count = 0;
-	}
+	_state = now;
+
+	if (now == State::Hold)
+		printf("Grip::Hold\r\n");
+	else
+		printf("Grip::Release\r\n");
+
+	_owner->SensorChanged();
 }
 
 PowerOffTask::PowerOffTask(SensorTask *owner) :
 	Task(100),
 	_owner(owner),
 	_state(State::PowerOff),
-	_count(0)
+	_count(0),
+	_watch(SENSOR_POWER_WATCH)
 {
 }
 
@@ -97,22 +149,42 @@ PowerOffTask::~PowerOffTask()
 {
 }
 
+void PowerOffTask::Wakeup()
+{
+	_watch = SENSOR_POWER_WATCH;
+	_timer = 0;
+}
+
 void PowerOffTask::Process()
 {
 	if (_timer != 0)
 		return;
 
-	_timer = 100;
-
 	switch (_state) {
 	case State::PowerOff:
 		if (_owner->IsGlobalActive()) {
 			_state = State::PowerOn;
+			_count = 0;
+			_timer = 100;
 			_owner->PowerOn();
 		}
+		// トリガーで録音が始まるのを待つため、変化の後しばらくは監視を続ける
+		else if (_watch > 0) {
+			_watch--;
+			_timer = 100;
+		}
+		else {
+			_timer = osWaitForever;
+		}
 		break;
 	case State::PowerOn:
-		if (!_owner->IsGlobalActive()) {
+		if (_owner->IsActive()) {
+			// 握っている間は離されるまで待つ
+			_count = 0;
+			_timer = osWaitForever;
+		}
+		else if (!_owner->IsGlobalActive()) {
+			_timer = 100;
 			_count++;
 			if (_count > 30) {
 				_count = 0;
@@ -120,10 +192,12 @@ void PowerOffTask::Process()
 				_owner->PowerOff();
 
 				_state = State::PowerOff;
+				_watch = SENSOR_POWER_WATCH;
 			}
 		}
 		else {
 			_count = 0;
+			_timer = 100;
 		}
 		break;
 	}
@@ -133,11 +207,8 @@ HeartRateTask::HeartRateTask(SensorTask *owner) :
 	Task(osWaitForever),
 	_owner(owner),
 	bh1792(I2C_SDA, I2C_SCL),
-	intr(A0),
-	_state(State::PowerOff),
-	_pos(0),
-	_count(0),
-	_sum(0)
+	intr(SENSOR_PIN_HEART_RATE),
+	_state(State::PowerOff)
 {
 }
 
@@ -145,6 +216,24 @@ HeartRateTask::~HeartRateTask()
 {
 }
 
+int HeartRateTask::GetSampleRate(uint8_t msr)
+{
+	switch (msr) {
+	case BH1792_PRM_MSR_32HZ:
+		return 32;
+	case BH1792_PRM_MSR_128HZ:
+		return 128;
+	case BH1792_PRM_MSR_64HZ:
+		return 64;
+	case BH1792_PRM_MSR_256HZ:
+		return 256;
+	case BH1792_PRM_MSR_1024HZ:
+		return 1024;
+	default:
+		return 4;
+	}
+}
+
 void HeartRateTask::OnStart()
 {
 	int32_t ret = 0;
@@ -174,10 +263,6 @@ void HeartRateTask::ProcessEvent(InterTaskSignals::T signals)
 	if ((signals & InterTaskSignals::PowerOn) != 0) {
 		if ((_state == State::PowerOff)
 			|| (_state = State::DeviceError)) {
-			memset(_heart_wave, 0, sizeof(_heart_wave));
-			_pos = 0;
-			_count = 0;
-
 			prm.sel_adc = BH1792_PRM_SEL_ADC_GREEN;
 			//prm.msr = BH1792_PRM_MSR_SINGLE;
 			prm.msr = BH1792_PRM_MSR_1024HZ;
@@ -204,42 +289,22 @@ void HeartRateTask::ProcessEvent(InterTaskSignals::T signals)
 				return;
 			}
 
+			_engine.SetSampleRate(GetSampleRate(prm.msr));
+
 			_state = State::Async;
 			_timer = 0;
 		}
 	}
 	if ((signals & InterTaskSignals::HeartRateInt) != 0) {
 		bh1792_data_t data;
-		int count, val = 0, min = UINT16_MAX, max = 0;
 
 		if (bh1792.GetMeasData(&data) == BH1792_SUCCESS) {
 			for (int i = 0; i < data.fifo_lev; i++) {
-				_sum -= _heart_wave[_pos];
-				uint16_t fifo_on = data.fifo[i].on;
-				_heart_wave[_pos] = fifo_on;
-				_sum += fifo_on;
-				val += fifo_on;
-
-				_pos++;
-				if (_pos >= sizeof(_heart_wave) / sizeof(_heart_wave[0])) {
-					_pos = 0;
-				}
-			}
-			count = _count + data.fifo_lev;
-			if (count > sizeof(_heart_wave) / sizeof(_heart_wave[0])) {
-				count = sizeof(_heart_wave) / sizeof(_heart_wave[0]);
+				_samples[i] = data.fifo[i].on;
 			}
-			_count = count;
+			_engine.Push(_samples, data.fifo_lev);
 
-			for (int i = 0; i < count; i++) {
-				uint16_t v = _heart_wave[i];
-				if (min > v) min = v;
-				if (max < v) max = v;
-			}
-			//val = (val / (int)data.fifo_lev) - ((int)_sum / (int)_count);
-			val = ((2 * 0xF * val) / (int)data.fifo_lev) / ((int)max - (int)min);
-			//printf("heart_mark %d < %d < %d\r\n", min, val, max);
-			heart_mark = (uint8_t)((val / 2) + (val % 2));
+			heart_mark = (uint8_t)_engine.GetLevel();
 		}
 	}
 	if ((signals & InterTaskSignals::PowerOff) != 0) {
@@ -265,7 +330,8 @@ void HeartRateTask::Process()
 	if (_timer != 0)
 		return;
 
-	if ((_state == State::InitError) || (_state == State::DeviceError)) {
+	if ((_state == State::PowerOff) || (_state == State::InitError)
+		|| (_state == State::DeviceError)) {
 		_timer = osWaitForever;
 		return;
 	}
@@ -340,6 +406,11 @@ void SensorTask::TriggerOn()
 	_globalState->TriggerOn();
 }
 
+void SensorTask::SensorChanged()
+{
+	powerOffTask.Wakeup();
+}
+
 LeptonTaskThread::LeptonTaskThread(GlobalState *globalState) :
 	TaskThread(&leptonTask),
 	_globalState(globalState),
@@ -4,8 +4,21 @@
 
 #include "TaskBase.h"
 #include "bh1792.h"
+#include "HeartRate.h"
 #include "Lepton.h"
 
+/* ボタンの状態が変化してから確定するまでの時間[ms] */
+#define SENSOR_DEBOUNCE_MS		(100)
+/* 電源OFF中に状態変化を監視し続ける回数（100ms単位） */
+#define SENSOR_POWER_WATCH		(30)
+
+/* ピンの割り当て（割り込みは1つのピンに1つのタスクだけ） */
+#define SENSOR_PIN_TRIGGER		BUTTON1		// トリガーボタン（エッジ割り込み）
+/* グリップは元の配線のままA0（TestBenchのグリップのスライダーもAN0につながる） */
+#define SENSOR_PIN_GRIP			A0			// グリップボタン（アナログ入力のコンパレータ）
+/* BH1792のINTはA0から空いているD6（P8_13）に配線し直す（D0/D1はESP32、D2～D5はLeptonのSPIが使う） */
+#define SENSOR_PIN_HEART_RATE	D6			// BH1792のINT（立ち上がり割り込み）
+
 class SensorTask;
 
 class TriggerButtonTask : public Task
@@ -24,11 +37,14 @@ public:
 	virtual ~TriggerButtonTask();
 private:
 	SensorTask *_owner;
-	mbed::DigitalIn button;
+	mbed::InterruptIn button;
 	State::T _state;
-	int _count;
+	bool _pending;
+	static void edge_isr(TriggerButtonTask *obj);
 public:
 	State::T GetState() { return _state; }
+	void OnStart() override;
+	void ProcessEvent(InterTaskSignals::T signals) override;
 	void Process() override;
 };
 
@@ -50,10 +66,15 @@ private:
 	SensorTask *_owner;
 	mbed::AnalogIn button;
 	State::T _state;
-	int _count;
+	bool _pending;
+	volatile int _level;
 	float _threshold;
+	float _hysteresis;
+	void compare_isr(int level);
 public:
 	State::T GetState() { return _state; }
+	void OnStart() override;
+	void ProcessEvent(InterTaskSignals::T signals) override;
 	void Process() override;
 };
 
@@ -75,8 +96,10 @@ private:
 	SensorTask *_owner;
 	State::T _state;
 	int _count;
+	int _watch;
 public:
 	State::T GetState() { return _state; }
+	void Wakeup();
 	void Process() override;
 };
 
@@ -102,13 +125,14 @@ private:
 	BH1792 bh1792;
 	mbed::InterruptIn intr;
 	State::T _state;
-	uint16_t _heart_wave[2048];
-	int _pos;
-	int _count;
-	uint32_t _sum;
+	HeartRateEngine _engine;
+	uint16_t _samples[BH1792_PRM_FIFO_LEV_FULL];
 	static void intr_isr(HeartRateTask *obj);
+	static int GetSampleRate(uint8_t msr);
 public:
 	State::T GetState() { return _state; }
+	int GetBpm() { return _engine.GetBpm(); }
+	int GetConfidence() { return _engine.GetConfidence(); }
 	void OnStart() override;
 	void ProcessEvent(InterTaskSignals::T signals) override;
 	void Process() override;
@@ -135,6 +159,8 @@ public:
 	void PowerOff();
 	void PowerOn();
 	void TriggerOn();
+	void SensorChanged();
+	HeartRateTask *GetHeartRateTask() { return &heartRateTask; }
 };
 
 class LeptonTaskThread : public TaskThread
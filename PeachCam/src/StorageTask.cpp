@@ -0,0 +1,368 @@
+#include "mbed.h"
+#include "StorageTask.h"
+#include "GlobalState.h"
+#include <algorithm>
+
+StorageTask::Latency::Latency() :
+	_samples(),
+	_count(0)
+{
+}
+
+void StorageTask::Latency::Add(us_timestamp_t latency)
+{
+	_samples[_count % STORAGE_LATENCY_SAMPLES] = (uint32_t)latency;
+	_count++;
+}
+
+void StorageTask::Latency::Print(const char *name)
+{
+	uint32_t samples[STORAGE_LATENCY_SAMPLES];
+	int count = (_count < STORAGE_LATENCY_SAMPLES) ? _count : STORAGE_LATENCY_SAMPLES;
+
+	if (count == 0) {
+		printf("%-6s no samples\n", name);
+		return;
+	}
+
+	memcpy(samples, _samples, count * sizeof(samples[0]));
+	std::sort(&samples[0], &samples[count]);
+
+	printf("%-6s p50 %6.2f ms, p90 %6.2f ms, p99 %6.2f ms, max %6.2f ms (%d samples)\n", name,
+		samples[(count - 1) * 50 / 100] / 1000.0, samples[(count - 1) * 90 / 100] / 1000.0,
+		samples[(count - 1) * 99 / 100] / 1000.0, samples[count - 1] / 1000.0, count);
+}
+
+StorageTask::StorageTask(GlobalState *globalState) :
+	TaskThread(this, osPriorityBelowNormal, (1024 * 8), NULL, "StorageTask"),
+	_globalState(globalState),
+	_timer(osWaitForever),
+	_jobs(),
+	_queued(0),
+	_queuedPeak(0),
+	_files(),
+	_fileCount(0),
+	_bytes(0),
+	_writes(0),
+	_dropped(0),
+	_padded(0),
+	_errors(0)
+{
+}
+
+StorageTask::~StorageTask()
+{
+}
+
+int StorageTask::Open(const std::string &filename, uint32_t expected_size, bool pad)
+{
+	int file = -1;
+
+	_mutex.lock();
+	for (int i = 0; i < STORAGE_FILE_MAX; i++) {
+		if (!_files[i].used) {
+			file = i;
+			break;
+		}
+	}
+	if (file >= 0) {
+		// 開くまではこのスレッドからしか触らない
+		_files[file].used = true;
+		_files[file].filename = filename;
+		_files[file].expected = expected_size;
+		_files[file].pad = pad;
+		_files[file].dropped = 0;
+	}
+	else {
+		_dropped++;
+	}
+	_mutex.unlock();
+
+	if (file < 0)
+		return -1;
+
+	Enqueue(Request::Open, file, std::vector<uint8_t>(), false);
+
+	return file;
+}
+
+bool StorageTask::Append(int file, std::vector<uint8_t> &&data)
+{
+	if ((file < 0) || (file >= STORAGE_FILE_MAX))
+		return false;
+
+	return Enqueue(Request::Append, file, std::move(data), false);
+}
+
+void StorageTask::Close(int file, bool upload, std::vector<uint8_t> &&head)
+{
+	if ((file < 0) || (file >= STORAGE_FILE_MAX))
+		return;
+
+	Enqueue(Request::Close, file, std::move(head), upload);
+}
+
+bool StorageTask::WriteFile(const std::string &filename, std::vector<uint8_t> &&data, bool upload)
+{
+	int file = Open(filename, (uint32_t)data.size());
+	if (file < 0)
+		return false;
+
+	bool result = Append(file, std::move(data));
+	Close(file, result && upload);
+
+	return result;
+}
+
+bool StorageTask::Enqueue(Request::T type, int file, std::vector<uint8_t> &&data, bool upload)
+{
+	job_t job;
+
+	_mutex.lock();
+	// 書き込みが追いつかないときは追記を捨てる（開く・閉じるは必ず通す）
+	if ((type == Request::Append) && (_queued + data.size() > STORAGE_QUEUE_SIZE)) {
+		_dropped++;
+		if (_files[file].pad)
+			_files[file].dropped += (uint32_t)data.size();
+		_mutex.unlock();
+		return false;
+	}
+	_jobs.push_back(job);
+	job_t &entry = _jobs.back();
+	entry.type = type;
+	entry.file = file;
+	entry.data = std::move(data);
+	entry.upload = upload;
+	entry.queued = ticker_read_us(get_us_ticker_data());
+	// padで開いたファイルは捨てた分を後の依頼の前に埋める（WAVの時間とヘッダーの長さを合わせる）
+	entry.gap = _files[file].dropped;
+	_files[file].dropped = 0;
+	_queued += entry.data.size();
+	if (_queuedPeak < _queued)
+		_queuedPeak = _queued;
+	_mutex.unlock();
+
+	Signal(InterTaskSignals::StorageRequest);
+
+	return true;
+}
+
+void StorageTask::OnStart()
+{
+	for (int i = 0; i < STORAGE_FILE_MAX; i++) {
+		_files[i].staging.reserve(STORAGE_WRITE_SIZE);
+	}
+}
+
+void StorageTask::OnEnd()
+{
+}
+
+int StorageTask::GetTimer()
+{
+	return _timer;
+}
+
+void StorageTask::Progress(int elapse)
+{
+	if (_timer == osWaitForever)
+		return;
+
+	_timer -= elapse;
+	if (_timer < 0)
+		_timer = 0;
+}
+
+void StorageTask::ProcessEvent(InterTaskSignals::T signals)
+{
+	if ((signals & InterTaskSignals::StorageRequest) != 0) {
+		_timer = 0;
+	}
+}
+
+void StorageTask::Process()
+{
+	std::list<job_t> jobs;
+
+	if (_timer != 0)
+		return;
+
+	_mutex.lock();
+	jobs.splice(jobs.end(), _jobs);
+	_mutex.unlock();
+
+	for (auto &job : jobs) {
+		file_t *file = &_files[job.file];
+
+		switch (job.type) {
+		case Request::Open:
+			DoOpen(file);
+			break;
+		case Request::Append:
+			DoAppend(file, job.data, job.gap);
+			break;
+		case Request::Close:
+			DoClose(file, job.data, job.gap, job.upload, job.queued);
+			break;
+		}
+
+		_mutex.lock();
+		_queued -= job.data.size();
+		_mutex.unlock();
+	}
+
+	_timer = osWaitForever;
+}
+
+void StorageTask::DoOpen(file_t *file)
+{
+	file->position = 0;
+	file->staging.clear();
+	file->error = false;
+
+	file->fp = fopen(file->filename.c_str(), "wb");
+	if (file->fp == NULL) {
+		file->error = true;
+		_errors++;
+		return;
+	}
+	// まとめて書くのでstdioのバッファは通さない
+	setvbuf(file->fp, NULL, _IONBF, 0);
+
+	// 終端まで伸ばしてクラスタを先に割り当てておく
+	if (file->expected > 0) {
+		if ((fseek(file->fp, file->expected - 1, SEEK_SET) != 0)
+			|| (fputc(0, file->fp) == EOF)
+			|| (fseek(file->fp, 0, SEEK_SET) != 0)) {
+			file->expected = 0;
+			fseek(file->fp, 0, SEEK_SET);
+		}
+	}
+}
+
+void StorageTask::Pad(file_t *file, uint32_t size)
+{
+	_padded += size;
+
+	while (size > 0) {
+		uint32_t len = STORAGE_WRITE_SIZE - (uint32_t)file->staging.size();
+		if (len > size)
+			len = size;
+		file->staging.insert(file->staging.end(), (size_t)len, (uint8_t)0);
+		size -= len;
+
+		if (file->staging.size() >= STORAGE_WRITE_SIZE)
+			Flush(file);
+	}
+}
+
+void StorageTask::DoAppend(file_t *file, const std::vector<uint8_t> &data, uint32_t gap)
+{
+	const uint8_t *pos = data.data();
+	size_t rest = data.size();
+
+	Pad(file, gap);
+
+	while (rest > 0) {
+		size_t size = STORAGE_WRITE_SIZE - file->staging.size();
+		if (size > rest)
+			size = rest;
+		file->staging.insert(file->staging.end(), pos, pos + size);
+		pos += size;
+		rest -= size;
+
+		if (file->staging.size() >= STORAGE_WRITE_SIZE)
+			Flush(file);
+	}
+}
+
+void StorageTask::Flush(file_t *file)
+{
+	if (file->staging.empty())
+		return;
+
+	if ((file->fp != NULL) && !file->error) {
+		us_timestamp_t start = ticker_read_us(get_us_ticker_data());
+		size_t size = fwrite(file->staging.data(), sizeof(uint8_t), file->staging.size(), file->fp);
+		_writeLatency.Add(ticker_read_us(get_us_ticker_data()) - start);
+		_writes++;
+		if (size != file->staging.size()) {
+			file->error = true;
+			_errors++;
+		}
+		else {
+			_bytes += size;
+		}
+	}
+
+	file->position += (uint32_t)file->staging.size();
+	file->staging.clear();
+}
+
+void StorageTask::DoClose(file_t *file, const std::vector<uint8_t> &head, uint32_t gap, bool upload, us_timestamp_t queued)
+{
+	bool patched = false;
+
+	Pad(file, gap);
+
+	// 先頭がまだ書かれていなければ書く前に書き換える
+	if (!head.empty() && (file->position == 0)) {
+		if (file->staging.size() < head.size())
+			file->staging.resize(head.size());
+		memcpy(file->staging.data(), head.data(), head.size());
+		patched = true;
+	}
+	Flush(file);
+
+	if ((file->fp != NULL) && !file->error) {
+		if (!head.empty() && !patched) {
+			if ((fseek(file->fp, 0, SEEK_SET) != 0)
+				|| (fwrite(head.data(), sizeof(uint8_t), head.size(), file->fp) != head.size())) {
+				file->error = true;
+				_errors++;
+			}
+		}
+		// 確保した領域より短ければ切り詰める
+		if (file->expected > file->position) {
+			fflush(file->fp);
+			ftruncate(fileno(file->fp), file->position);
+		}
+		// アップロードを依頼する前に媒体まで書き込む
+		if ((fflush(file->fp) != 0) || (fsync(fileno(file->fp)) != 0)) {
+			file->error = true;
+			_errors++;
+		}
+	}
+
+	if (file->fp != NULL) {
+		if (fclose(file->fp) != 0) {
+			file->error = true;
+			_errors++;
+		}
+		file->fp = NULL;
+	}
+
+	_closeLatency.Add(ticker_read_us(get_us_ticker_data()) - queued);
+	_fileCount++;
+
+	if (upload && !file->error)
+		_globalState->UploadRequest(file->filename, file->position);
+
+	_mutex.lock();
+	file->used = false;
+	_mutex.unlock();
+}
+
+void StorageTask::PrintStats()
+{
+	_mutex.lock();
+	uint32_t dropped = _dropped;
+	uint32_t queued = _queued;
+	uint32_t queuedPeak = _queuedPeak;
+	_mutex.unlock();
+
+	printf("files %lu, bytes %llu, writes %lu, dropped %lu (padded %llu bytes), errors %lu, queued %lu (peak %lu)\n",
+		_fileCount, _bytes, _writes, dropped, _padded, _errors, queued, queuedPeak);
+	_writeLatency.Print("write");
+	_closeLatency.Print("close");
+}
@@ -0,0 +1,113 @@
+#ifndef _STORAGETASK_H_
+#define _STORAGETASK_H_
+
+#include <string>
+#include <vector>
+#include <list>
+#include "TaskBase.h"
+
+/* 書き込みの単位（セクタの倍数、ファイルの先頭からこの単位で書く） */
+#define STORAGE_WRITE_SIZE		(32 * 1024)
+/* 書き込み待ちのデータの上限 */
+#define STORAGE_QUEUE_SIZE		(512 * 1024)
+/* 同時に開けるファイルの数 */
+#define STORAGE_FILE_MAX		(4)
+/* 遅延の分布を求めるために残す件数 */
+#define STORAGE_LATENCY_SAMPLES	(128)
+
+class GlobalState;
+
+/*
+ * 撮影データの書き込み
+ *
+ * JPEG、WAV、Leptonの画像などの書き込みはすべてこのスレッドで行う。
+ * データはムーブで受け取るので、呼び出し側はファイルの完了を待たない。
+ * 書き込みは想定の大きさで領域を確保してから大きな単位にまとめて行い、
+ * 閉じたあと（fcloseが成功したあと）でアップロードを依頼する。
+ */
+class StorageTask : public TaskThread, public ITask
+{
+public:
+	StorageTask(GlobalState *globalState);
+	virtual ~StorageTask();
+private:
+	class Request
+	{
+	public:
+		enum T {
+			Open,
+			Append,
+			Close,
+		};
+	};
+	struct job_t {
+		Request::T type;
+		int file;
+		std::vector<uint8_t> data;
+		bool upload;
+		us_timestamp_t queued;
+		uint32_t gap;				// 直前に捨てた追記の大きさ（0で埋める）
+	};
+	struct file_t {
+		bool used;
+		FILE *fp;
+		std::string filename;
+		uint32_t expected;			// 確保する大きさ
+		uint32_t position;			// stagingの先頭のファイル位置
+		std::vector<uint8_t> staging;
+		bool error;
+		bool pad;					// 捨てた追記の分を0で埋める
+		uint32_t dropped;			// 捨てた追記の大きさ（次の依頼で0で埋める）
+	};
+	class Latency
+	{
+	public:
+		Latency();
+	private:
+		uint32_t _samples[STORAGE_LATENCY_SAMPLES];
+		uint32_t _count;
+	public:
+		void Add(us_timestamp_t latency);
+		void Print(const char *name);
+	};
+	GlobalState *_globalState;
+	int _timer;
+	rtos::Mutex _mutex;
+	std::list<job_t> _jobs;
+	uint32_t _queued;			// 書き込み待ちのバイト数
+	uint32_t _queuedPeak;
+	file_t _files[STORAGE_FILE_MAX];
+	uint32_t _fileCount;
+	uint64_t _bytes;
+	uint32_t _writes;
+	uint32_t _dropped;
+	uint64_t _padded;			// 捨てた追記の代わりに0で埋めたバイト数
+	uint32_t _errors;
+	Latency _writeLatency;		// 1回の書き込み
+	Latency _closeLatency;		// 閉じる依頼から媒体への書き込み（fsync）の完了まで
+	bool Enqueue(Request::T type, int file, std::vector<uint8_t> &&data, bool upload);
+	void DoOpen(file_t *file);
+	void DoAppend(file_t *file, const std::vector<uint8_t> &data, uint32_t gap);
+	void Pad(file_t *file, uint32_t size);
+	void DoClose(file_t *file, const std::vector<uint8_t> &head, uint32_t gap, bool upload, us_timestamp_t queued);
+	void Flush(file_t *file);
+public:
+	/* expected_sizeは想定の大きさ（0なら確保しない）、padは捨てた追記を0で埋めるか、開けなければ-1 */
+	int Open(const std::string &filename, uint32_t expected_size, bool pad = false);
+	/* 書き込みが追いつかなければ捨てる（padで開いたファイルではその分を0で埋めて位置を保つ） */
+	bool Append(int file, std::vector<uint8_t> &&data);
+	/* headはファイルの先頭を書き換える内容（WAVのヘッダーなど） */
+	void Close(int file, bool upload, std::vector<uint8_t> &&head = std::vector<uint8_t>());
+	/* 1回で書き終わるファイル */
+	bool WriteFile(const std::string &filename, std::vector<uint8_t> &&data, bool upload);
+	void PrintStats();
+public:
+	void OnStart() override;
+	void OnEnd() override;
+	int GetTimer() override;
+	void Progress(int elapse) override;
+	void ProcessEvent(InterTaskSignals::T signals) override;
+	void Process() override;
+};
+
+#endif // _STORAGETASK_H_
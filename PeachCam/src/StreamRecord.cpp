@@ -0,0 +1,599 @@
+#include "mbed.h"
+#include "StreamRecord.h"
+
+StreamRecorder streamRecorder;
+StreamReplay streamReplay;
+
+static us_timestamp_t stream_now()
+{
+	return ticker_read_us(get_us_ticker_data());
+}
+
+StreamRecorder::StreamRecorder() :
+	_fp(NULL),
+	_origin(0),
+	_offset(0),
+	_index(),
+	_vospi_count(0),
+	_chunk_count()
+{
+}
+
+StreamRecorder::~StreamRecorder()
+{
+	Close();
+}
+
+bool StreamRecorder::Open(const char *filename)
+{
+	StreamFileHeader header;
+
+	Close();
+
+	_mutex.lock();
+
+	FILE *fp = fopen(filename, "wb");
+	if (fp == NULL) {
+		_mutex.unlock();
+		printf("StreamRecorder: cannot open %s\n", filename);
+		return false;
+	}
+	// VoSPIパケットのような小さなチャンクをまとめて書き出す
+	setvbuf(fp, NULL, _IOFBF, 64 * 1024);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, STREAM_FILE_MAGIC, sizeof(header.magic));
+	header.version = STREAM_FILE_VERSION;
+	header.header_size = sizeof(header);
+	header.start_time = (int64_t)time(NULL);
+	fwrite(&header, sizeof(header), 1, fp);
+
+	_index.clear();
+	_vospi_count = 0;
+	memset(_chunk_count, 0, sizeof(_chunk_count));
+	_offset = sizeof(header);
+	_origin = stream_now();
+	_fp = fp;
+
+	_mutex.unlock();
+
+	return true;
+}
+
+void StreamRecorder::Close()
+{
+	StreamChunkHeader chunk;
+	StreamFileFooter footer;
+
+	_mutex.lock();
+
+	if (_fp == NULL) {
+		_mutex.unlock();
+		return;
+	}
+
+	memset(&chunk, 0, sizeof(chunk));
+	chunk.type = StreamChunk::Index;
+	chunk.size = (uint32_t)(_index.size() * sizeof(StreamIndexEntry));
+	chunk.timestamp = stream_now() - _origin;
+	fwrite(&chunk, sizeof(chunk), 1, _fp);
+	if (!_index.empty())
+		fwrite(&_index[0], sizeof(StreamIndexEntry), _index.size(), _fp);
+
+	footer.index_offset = _offset + sizeof(chunk);
+	footer.index_count = (uint32_t)_index.size();
+	memcpy(footer.magic, STREAM_FOOTER_MAGIC, sizeof(footer.magic));
+	fwrite(&footer, sizeof(footer), 1, _fp);
+
+	fclose(_fp);
+	_fp = NULL;
+
+	printf("StreamRecorder: video %u, vospi %u, resync %u, pcm %u, index %u\n",
+		(unsigned)_chunk_count[StreamChunk::Video], (unsigned)_chunk_count[StreamChunk::VoSPI],
+		(unsigned)_chunk_count[StreamChunk::Resync], (unsigned)_chunk_count[StreamChunk::Pcm],
+		(unsigned)_index.size());
+
+	_index.clear();
+
+	_mutex.unlock();
+}
+
+bool StreamRecorder::WriteChunk(StreamChunk::T type, const void *info, uint32_t info_size,
+	const void *data, uint32_t size, bool indexed)
+{
+	StreamChunkHeader chunk;
+
+	_mutex.lock();
+
+	if (_fp == NULL) {
+		_mutex.unlock();
+		return false;
+	}
+
+	memset(&chunk, 0, sizeof(chunk));
+	chunk.type = (uint8_t)type;
+	chunk.size = info_size + size;
+	chunk.timestamp = stream_now() - _origin;
+
+	if (indexed) {
+		StreamIndexEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.timestamp = chunk.timestamp;
+		entry.offset = _offset;
+		entry.type = (uint8_t)type;
+		_index.push_back(entry);
+	}
+
+	fwrite(&chunk, sizeof(chunk), 1, _fp);
+	if (info_size > 0)
+		fwrite(info, sizeof(char), info_size, _fp);
+	if (size > 0)
+		fwrite(data, sizeof(char), size, _fp);
+	_offset += sizeof(chunk) + chunk.size;
+	_chunk_count[type & 0x0F]++;
+
+	_mutex.unlock();
+
+	return true;
+}
+
+void StreamRecorder::WriteVideo(const void *data, int width, int height, int stride, StreamVideoFormat::T format)
+{
+	StreamVideoInfo info;
+
+	info.width = (uint16_t)width;
+	info.height = (uint16_t)height;
+	info.stride = (uint16_t)stride;
+	info.format = (uint16_t)format;
+
+	WriteChunk(StreamChunk::Video, &info, sizeof(info), data, stride * height, true);
+}
+
+void StreamRecorder::WriteVoSPI(const void *packet, int size)
+{
+	// 数の判断と更新もWriteChunkと同じロックの中で行う（_mutexは再帰できる）
+	_mutex.lock();
+	bool indexed = (_vospi_count % STREAM_VOSPI_INDEX_INTERVAL) == 0;
+	if (WriteChunk(StreamChunk::VoSPI, NULL, 0, packet, size, indexed))
+		_vospi_count++;
+	_mutex.unlock();
+}
+
+void StreamRecorder::WriteResync()
+{
+	// 再同期の直後から読めるように、次のVoSPIパケットも索引に載せる
+	_mutex.lock();
+	if (WriteChunk(StreamChunk::Resync, NULL, 0, NULL, 0, true))
+		_vospi_count = 0;
+	_mutex.unlock();
+}
+
+void StreamRecorder::WritePcm(const void *data, int size, int sample_rate, int channels)
+{
+	StreamPcmInfo info;
+
+	info.sample_rate = sample_rate;
+	info.channels = (uint16_t)channels;
+	info.bits = 16;
+
+	WriteChunk(StreamChunk::Pcm, &info, sizeof(info), data, size, true);
+}
+
+StreamReader::StreamReader() :
+	_fp(NULL),
+	_header(),
+	_index(),
+	_end(0),
+	_cursor()
+{
+}
+
+StreamReader::~StreamReader()
+{
+	Close();
+}
+
+bool StreamReader::Open(const char *filename)
+{
+	Close();
+
+	_mutex.lock();
+
+	_fp = fopen(filename, "rb");
+	if (_fp == NULL) {
+		_mutex.unlock();
+		printf("StreamReader: cannot open %s\n", filename);
+		return false;
+	}
+
+	if ((fread(&_header, sizeof(_header), 1, _fp) != 1)
+		|| (memcmp(_header.magic, STREAM_FILE_MAGIC, sizeof(_header.magic)) != 0)
+		|| (_header.version != STREAM_FILE_VERSION)) {
+		fclose(_fp);
+		_fp = NULL;
+		_mutex.unlock();
+		printf("StreamReader: %s is not a stream file\n", filename);
+		return false;
+	}
+
+	if (!LoadIndex())
+		RebuildIndex();
+
+	for (int i = 0; i < sizeof(_cursor) / sizeof(_cursor[0]); i++)
+		_cursor[i] = _header.header_size;
+
+	_mutex.unlock();
+
+	return true;
+}
+
+void StreamReader::Close()
+{
+	_mutex.lock();
+
+	if (_fp != NULL) {
+		fclose(_fp);
+		_fp = NULL;
+	}
+	_index.clear();
+	_end = 0;
+
+	_mutex.unlock();
+}
+
+bool StreamReader::LoadIndex()
+{
+	StreamFileFooter footer;
+
+	if (_fseeki64(_fp, -(int64_t)sizeof(footer), SEEK_END) != 0)
+		return false;
+	if (fread(&footer, sizeof(footer), 1, _fp) != 1)
+		return false;
+	if (memcmp(footer.magic, STREAM_FOOTER_MAGIC, sizeof(footer.magic)) != 0)
+		return false;
+
+	_index.resize(footer.index_count);
+	if (footer.index_count > 0) {
+		_fseeki64(_fp, footer.index_offset, SEEK_SET);
+		if (fread(&_index[0], sizeof(StreamIndexEntry), footer.index_count, _fp) != footer.index_count) {
+			_index.clear();
+			return false;
+		}
+	}
+	_end = footer.index_offset - sizeof(StreamChunkHeader);
+
+	return true;
+}
+
+bool StreamReader::RebuildIndex()
+{
+	StreamChunkHeader chunk;
+	uint64_t pos = _header.header_size;
+	uint64_t size;
+	uint32_t vospi_count = 0;
+
+	printf("StreamReader: no index, scanning chunks\n");
+
+	_fseeki64(_fp, 0, SEEK_END);
+	size = _ftelli64(_fp);
+
+	_index.clear();
+	for (;;) {
+		_fseeki64(_fp, pos, SEEK_SET);
+		if (fread(&chunk, sizeof(chunk), 1, _fp) != 1)
+			break;
+		if ((chunk.type == 0) || (chunk.type == StreamChunk::Index))
+			break;
+		// 書きかけのチャンクは捨てる
+		if (pos + sizeof(chunk) + chunk.size > size)
+			break;
+
+		bool indexed = true;
+		if (chunk.type == StreamChunk::VoSPI)
+			indexed = (vospi_count++ % STREAM_VOSPI_INDEX_INTERVAL) == 0;
+		else if (chunk.type == StreamChunk::Resync)
+			vospi_count = 0;
+
+		if (indexed) {
+			StreamIndexEntry entry;
+			memset(&entry, 0, sizeof(entry));
+			entry.timestamp = chunk.timestamp;
+			entry.offset = pos;
+			entry.type = chunk.type;
+			_index.push_back(entry);
+		}
+
+		pos += sizeof(chunk) + chunk.size;
+	}
+	_end = pos;
+
+	return true;
+}
+
+uint64_t StreamReader::GetDuration()
+{
+	if (_index.empty())
+		return 0;
+	return _index.back().timestamp;
+}
+
+void StreamReader::Rewind()
+{
+	_mutex.lock();
+	for (int i = 0; i < sizeof(_cursor) / sizeof(_cursor[0]); i++)
+		_cursor[i] = _header.header_size;
+	_mutex.unlock();
+}
+
+void StreamReader::Seek(uint64_t timestamp)
+{
+	StreamChunkHeader chunk;
+
+	_mutex.lock();
+
+	for (int type = 0; type < sizeof(_cursor) / sizeof(_cursor[0]); type++) {
+		uint64_t pos = _header.header_size;
+
+		// 索引から直前の位置を探す
+		for (auto it = _index.begin(); it != _index.end(); it++) {
+			if (it->timestamp > timestamp)
+				break;
+			if (it->type == type)
+				pos = it->offset;
+		}
+
+		// 索引の間引き分を読み飛ばす
+		while (pos + sizeof(chunk) <= _end) {
+			_fseeki64(_fp, pos, SEEK_SET);
+			if (fread(&chunk, sizeof(chunk), 1, _fp) != 1)
+				break;
+			if ((chunk.type == type) && (chunk.timestamp >= timestamp))
+				break;
+			pos += sizeof(chunk) + chunk.size;
+		}
+		_cursor[type] = pos;
+	}
+
+	_mutex.unlock();
+}
+
+bool StreamReader::Next(StreamChunk::T type, StreamChunkHeader *chunk, std::vector<uint8_t> &payload)
+{
+	bool result = false;
+
+	_mutex.lock();
+
+	if (_fp == NULL) {
+		_mutex.unlock();
+		return false;
+	}
+
+	uint64_t pos = _cursor[type & 0x0F];
+	while (pos + sizeof(*chunk) <= _end) {
+		_fseeki64(_fp, pos, SEEK_SET);
+		if (fread(chunk, sizeof(*chunk), 1, _fp) != 1)
+			break;
+		pos += sizeof(*chunk) + chunk->size;
+		if (chunk->type != type)
+			continue;
+
+		payload.resize(chunk->size);
+		if ((chunk->size == 0)
+			|| (fread(&payload[0], sizeof(char), chunk->size, _fp) == chunk->size))
+			result = true;
+		break;
+	}
+	_cursor[type & 0x0F] = pos;
+
+	_mutex.unlock();
+
+	return result;
+}
+
+StreamReplay::StreamReplay() :
+	_reader(),
+	_mode(Mode::Paced),
+	_origin(0),
+	_active(false),
+	_pcmThread(osPriorityAboveNormal, 1024 * 2, NULL, "StreamReplayPcm"),
+	_pcmStarted(false),
+	_pcmRequests()
+{
+}
+
+StreamReplay::~StreamReplay()
+{
+}
+
+bool StreamReplay::Start(const char *filename, Mode::T mode)
+{
+	Stop();
+
+	if (!_reader.Open(filename))
+		return false;
+
+	printf("StreamReplay: %s %s, %llu ms, %u index entries\n", filename,
+		(mode == Mode::Paced) ? "paced" : "fast",
+		_reader.GetDuration() / 1000, (unsigned)_reader.GetIndexCount());
+
+	_mode = mode;
+	_origin = stream_now();
+	_active = true;
+
+	if (!_pcmStarted) {
+		_pcmStarted = true;
+		_pcmThread.start(callback(this, &StreamReplay::PcmMain));
+	}
+
+	return true;
+}
+
+void StreamReplay::Stop()
+{
+	if (!_active)
+		return;
+
+	_active = false;
+
+	// 待たせているPCM要求を空で返させる
+	_pcmMutex.lock();
+	size_t count = _pcmRequests.size();
+	_pcmMutex.unlock();
+	for (size_t i = 0; i < count; i++)
+		_pcmRequested.release();
+
+	_reader.Close();
+}
+
+void StreamReplay::Seek(uint64_t timestamp)
+{
+	_reader.Seek(timestamp);
+	_origin = stream_now() - timestamp;
+}
+
+void StreamReplay::WaitUntil(uint64_t timestamp)
+{
+	if (_mode != Mode::Paced)
+		return;
+
+	us_timestamp_t target = _origin + timestamp;
+	us_timestamp_t now = stream_now();
+	if (target > now + 1000)
+		ThisThread::sleep_for((uint32_t)((target - now) / 1000));
+}
+
+int StreamReplay::ReadVoSPI(char *rx_buffer, int rx_length)
+{
+	StreamChunkHeader chunk;
+
+	if ((rx_buffer == NULL) || (rx_length <= 0))
+		return 0;
+
+	if (!_reader.Next(StreamChunk::VoSPI, &chunk, _vospiPayload)) {
+		// 記録の終わりはディスカードパケットを返し続ける
+		memset(rx_buffer, 0, rx_length);
+		rx_buffer[0] = 0x0F;
+		return rx_length;
+	}
+
+	WaitUntil(chunk.timestamp);
+
+	int size = ((int)_vospiPayload.size() < rx_length) ? (int)_vospiPayload.size() : rx_length;
+	memcpy(rx_buffer, &_vospiPayload[0], size);
+	if (size < rx_length)
+		memset(&rx_buffer[size], 0, rx_length - size);
+
+	return rx_length;
+}
+
+const StreamVideoInfo *StreamReplay::ReadVideo(const uint8_t **pixels)
+{
+	StreamChunkHeader chunk;
+	bool found = false;
+
+	if (_mode == Mode::Paced) {
+		// 経過時間までのフレームのうち最新のものを使う
+		uint64_t elapse = stream_now() - _origin;
+		for (;;) {
+			if (!_reader.Next(StreamChunk::Video, &chunk, _videoScan))
+				break;
+			_videoPayload.swap(_videoScan);
+			found = true;
+			if (chunk.timestamp >= elapse)
+				break;
+		}
+	}
+	else {
+		found = _reader.Next(StreamChunk::Video, &chunk, _videoPayload);
+	}
+	if (!found || (_videoPayload.size() < sizeof(StreamVideoInfo)))
+		return NULL;
+
+	const StreamVideoInfo *info = (const StreamVideoInfo *)&_videoPayload[0];
+	if (_videoPayload.size() < sizeof(StreamVideoInfo) + (size_t)info->stride * info->height)
+		return NULL;
+
+	*pixels = &_videoPayload[sizeof(StreamVideoInfo)];
+
+	return info;
+}
+
+int StreamReplay::ReadPcm(void *p_data, uint32_t data_size, const rbsp_data_conf_t *p_data_conf)
+{
+	pcm_request_t req;
+
+	req.p_data = p_data;
+	req.size = data_size;
+	req.conf = *p_data_conf;
+
+	_pcmMutex.lock();
+	_pcmRequests.push_back(req);
+	_pcmMutex.unlock();
+
+	_pcmRequested.release();
+
+	return 0;
+}
+
+void StreamReplay::PcmMain()
+{
+	StreamChunkHeader chunk;
+	pcm_request_t req;
+	bool ret;
+
+	for (;;) {
+		_pcmRequested.wait();
+
+		_pcmMutex.lock();
+		ret = !_pcmRequests.empty();
+		if (ret) {
+			req = _pcmRequests.front();
+			_pcmRequests.pop_front();
+		}
+		_pcmMutex.unlock();
+
+		if (!ret)
+			continue;
+
+		int result = 0;
+		if (_active && _reader.Next(StreamChunk::Pcm, &chunk, _pcmPayload)
+			&& (_pcmPayload.size() >= sizeof(StreamPcmInfo))) {
+			WaitUntil(chunk.timestamp);
+
+			result = (int)(_pcmPayload.size() - sizeof(StreamPcmInfo));
+			if ((uint32_t)result > req.size)
+				result = req.size;
+			memcpy(req.p_data, &_pcmPayload[sizeof(StreamPcmInfo)], result);
+		}
+
+		if (req.conf.p_notify_func != NULL)
+			req.conf.p_notify_func(req.p_data, result, req.conf.p_app_data);
+	}
+}
+
+extern "C" int usrcmd_rec(int argc, char **argv)
+{
+	if (argc < 2) {
+		printf("rec start <file> | stop | play <file> [fast] | seek <ms> | end\n");
+		return 0;
+	}
+
+	if ((strcmp(argv[1], "start") == 0) && (argc > 2)) {
+		streamRecorder.Open(argv[2]);
+	}
+	else if (strcmp(argv[1], "stop") == 0) {
+		streamRecorder.Close();
+	}
+	else if ((strcmp(argv[1], "play") == 0) && (argc > 2)) {
+		bool fast = (argc > 3) && (strcmp(argv[3], "fast") == 0);
+		streamReplay.Start(argv[2], fast ? StreamReplay::Mode::Fast : StreamReplay::Mode::Paced);
+	}
+	else if ((strcmp(argv[1], "seek") == 0) && (argc > 2)) {
+		streamReplay.Seek(1000ull * atoi(argv[2]));
+	}
+	else if (strcmp(argv[1], "end") == 0) {
+		streamReplay.Stop();
+	}
+
+	return 0;
+}
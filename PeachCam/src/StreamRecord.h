@@ -0,0 +1,202 @@
+#ifndef _STREAMRECORD_H_
+#define _STREAMRECORD_H_
+
+#include <string>
+#include <vector>
+#include <list>
+#include "AUDIO_RBSP.h"
+
+#ifdef _MSC_VER
+#pragma pack(push, 1)
+#define __attribute__(x)
+#endif
+
+/*
+ * 記録ファイル形式（リトルエンディアン）
+ *
+ *  StreamFileHeader
+ *  StreamChunkHeader + ペイロード
+ *  ...
+ *  StreamChunkHeader(Index) + StreamIndexEntry[]
+ *  StreamFileFooter
+ *
+ * 索引はフッターから辿る。フッターが無い（電源断などで閉じられなかった）
+ * ファイルは開くときにチャンクを走査して索引を作り直す。
+ */
+#define STREAM_FILE_MAGIC		"PCSR"
+#define STREAM_FOOTER_MAGIC		"PCSI"
+#define STREAM_FILE_VERSION		(1)
+/* VoSPIパケットはこの個数ごとに索引に載せる */
+#define STREAM_VOSPI_INDEX_INTERVAL	(64)
+
+class StreamChunk
+{
+public:
+	enum T {
+		Video = 1,		// カメラフレーム（StreamVideoInfo + 画素）
+		VoSPI = 2,		// Lepton VoSPIパケット（164byte、ディスカードパケットも含む）
+		Resync = 3,		// VoSPI再同期（/CS LOW 185ms以上）
+		Pcm = 4,		// PCMブロック（StreamPcmInfo + サンプル）
+		Index = 15,
+	};
+};
+
+class StreamVideoFormat
+{
+public:
+	enum T {
+		RGB565 = 0,
+		YCbCr422 = 1,
+	};
+};
+
+struct StreamFileHeader {
+	char magic[4];
+	uint16_t version;
+	uint16_t header_size;
+	uint32_t flags;
+	uint32_t reserved;
+	int64_t start_time;			// 記録開始時刻（time_t）
+} __attribute__((packed));
+
+struct StreamChunkHeader {
+	uint8_t type;				// StreamChunk::T
+	uint8_t flags;
+	uint16_t reserved;
+	uint32_t size;				// ペイロードのバイト数
+	uint64_t timestamp;			// 記録開始からの経過時間[us]
+} __attribute__((packed));
+
+struct StreamVideoInfo {
+	uint16_t width;
+	uint16_t height;
+	uint16_t stride;
+	uint16_t format;			// StreamVideoFormat::T
+} __attribute__((packed));
+
+struct StreamPcmInfo {
+	uint32_t sample_rate;
+	uint16_t channels;
+	uint16_t bits;
+} __attribute__((packed));
+
+struct StreamIndexEntry {
+	uint64_t timestamp;
+	uint64_t offset;			// チャンクヘッダーのファイル位置
+	uint8_t type;
+	uint8_t reserved[7];
+} __attribute__((packed));
+
+struct StreamFileFooter {
+	uint64_t index_offset;
+	uint32_t index_count;
+	char magic[4];
+} __attribute__((packed));
+
+#ifdef _MSC_VER
+#pragma pack(pop)
+#endif
+
+class StreamRecorder
+{
+public:
+	StreamRecorder();
+	virtual ~StreamRecorder();
+private:
+	rtos::Mutex _mutex;
+	FILE *_fp;
+	us_timestamp_t _origin;
+	uint64_t _offset;
+	std::vector<StreamIndexEntry> _index;
+	uint32_t _vospi_count;
+	uint32_t _chunk_count[16];
+	bool WriteChunk(StreamChunk::T type, const void *info, uint32_t info_size,
+		const void *data, uint32_t size, bool indexed);
+public:
+	bool IsRecording() { return _fp != NULL; }
+	bool Open(const char *filename);
+	void Close();
+	void WriteVideo(const void *data, int width, int height, int stride, StreamVideoFormat::T format);
+	void WriteVoSPI(const void *packet, int size);
+	void WriteResync();
+	void WritePcm(const void *data, int size, int sample_rate, int channels);
+	uint32_t GetChunkCount(StreamChunk::T type) { return _chunk_count[type & 0x0F]; }
+};
+
+class StreamReader
+{
+public:
+	StreamReader();
+	virtual ~StreamReader();
+private:
+	rtos::Mutex _mutex;
+	FILE *_fp;
+	StreamFileHeader _header;
+	std::vector<StreamIndexEntry> _index;
+	uint64_t _end;
+	uint64_t _cursor[16];
+	bool LoadIndex();
+	bool RebuildIndex();
+public:
+	bool IsOpen() { return _fp != NULL; }
+	bool Open(const char *filename);
+	void Close();
+	uint64_t GetDuration();
+	size_t GetIndexCount() { return _index.size(); }
+	void Rewind();
+	void Seek(uint64_t timestamp);
+	bool Next(StreamChunk::T type, StreamChunkHeader *chunk, std::vector<uint8_t> &payload);
+};
+
+class StreamReplay
+{
+public:
+	class Mode
+	{
+	public:
+		enum T {
+			Paced,		// 記録時の間隔で供給する
+			Fast,		// 要求されたら直ちに供給する
+		};
+	};
+public:
+	StreamReplay();
+	virtual ~StreamReplay();
+private:
+	struct pcm_request_t {
+		void *p_data;
+		uint32_t size;
+		rbsp_data_conf_t conf;
+	};
+	StreamReader _reader;
+	Mode::T _mode;
+	us_timestamp_t _origin;
+	bool _active;
+	rtos::Thread _pcmThread;
+	bool _pcmStarted;
+	rtos::Mutex _pcmMutex;
+	rtos::Semaphore _pcmRequested;
+	std::list<pcm_request_t> _pcmRequests;
+	/* 読み出すスレッドが別々なので、バッファは種類ごとに持つ */
+	std::vector<uint8_t> _vospiPayload;		// Lepton（SPI）のスレッド
+	std::vector<uint8_t> _pcmPayload;		// PCMのスレッド
+	std::vector<uint8_t> _videoPayload;		// カメラのスレッド（返したフレーム）
+	std::vector<uint8_t> _videoScan;		// カメラのスレッド（読み飛ばし中のフレーム）
+	void WaitUntil(uint64_t timestamp);
+	void PcmMain();
+public:
+	bool IsActive() { return _active; }
+	bool Start(const char *filename, Mode::T mode);
+	void Stop();
+	void Seek(uint64_t timestamp);
+	StreamReader *GetReader() { return &_reader; }
+	int ReadVoSPI(char *rx_buffer, int rx_length);
+	/* 次に表示するフレームの情報、画素はpixelsに返す（次の呼び出しまで有効） */
+	const StreamVideoInfo *ReadVideo(const uint8_t **pixels);
+	int ReadPcm(void *p_data, uint32_t data_size, const rbsp_data_conf_t *p_data_conf);
+};
+
+extern StreamRecorder streamRecorder;
+extern StreamReplay streamReplay;
+
+#endif // _STREAMRECORD_H_
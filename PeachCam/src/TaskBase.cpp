@@ -110,7 +110,8 @@ void Tasks::Process()
 TaskThread::TaskThread(ITask *task, osPriority priority,
 		uint32_t stack_size, unsigned char *stack_mem, const char *name) :
 	_thread(priority, stack_size, stack_mem, name),
-	_task(task)
+	_task(task),
+	_wakeups(0)
 {
 
 }
@@ -155,6 +156,8 @@ void TaskThread::Main()
 		if (timer == 0)
 			Thread::yield();
 
+		_wakeups++;
+
 		now = ticker_read_us(get_us_ticker_data());
 
 		timer = (int)((now / 1000) - (prev / 1000));
@@ -17,6 +17,10 @@ public:
 		HeartRateInt = 0x0100,
 		StartShutter = 0x0200,
 		EndShutter = 0x0400,
+		TriggerChanged = 0x0800,
+		GripChanged = 0x1000,
+		FrameReady = 0x2000,
+		StorageRequest = 0x4000,
 	};
 };
 
@@ -71,6 +75,7 @@ public:
 protected:
 	rtos::Thread _thread;
 	ITask *_task;
+	uint32_t _wakeups;
 	virtual void Main();
 	static void sMain(void *obj) { ((TaskThread *)obj)->Main(); }
 	virtual void OnStart();
@@ -78,6 +83,8 @@ protected:
 public:
 	virtual void Start();
 	void Signal(InterTaskSignals::T signals);
+	/* スレッドが起床した回数 */
+	uint32_t GetWakeups() { return _wakeups; }
 };
 
 #endif // _TASKBASE_H_
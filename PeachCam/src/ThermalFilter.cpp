@@ -0,0 +1,388 @@
+#include "mbed.h"
+#include "ThermalFilter.h"
+#include "ThermalRecord.h"
+#include <algorithm>
+#include <math.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#include <emmintrin.h>
+#define THERMAL_FILTER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define THERMAL_FILTER_NEON
+#endif
+
+/* SIMDで1度に処理する画素数 */
+#define THERMAL_FILTER_BLOCK	(8)
+
+struct thermal_filter_params_t {
+	uint16_t threshold;		// これ以下の差は雑音
+	uint16_t ramp;			// 閾値からこの差で追従率が256になる
+	uint16_t slope;			// 追従率の傾き（256倍）
+	uint16_t min_gain;
+};
+
+/*
+ * 推定値eと入力xを k/256 で混ぜる
+ * SIMD版と同じ整数演算なので結果は一致する。
+ */
+static void filter_pixels_c(uint16_t *pixels, uint16_t *estimate, int count,
+	const thermal_filter_params_t *params, uint16_t *min_value, uint16_t *max_value)
+{
+	uint16_t minv = *min_value, maxv = *max_value;
+
+	for (int i = 0; i < count; i++) {
+		uint16_t x = pixels[i], e = estimate[i];
+		int diff = (x > e) ? x - e : e - x;
+		int t = (diff > params->threshold) ? diff - params->threshold : 0;
+		if (t > params->ramp)
+			t = params->ramp;
+		int k = params->min_gain + ((t * params->slope) >> 8);
+		uint16_t y = (uint16_t)((e * (256 - k) + x * k + 128) >> 8);
+
+		pixels[i] = y;
+		estimate[i] = y;
+		if (minv > y)
+			minv = y;
+		if (maxv < y)
+			maxv = y;
+	}
+
+	*min_value = minv;
+	*max_value = maxv;
+}
+
+static void minmax_c(const uint16_t *pixels, int count, uint16_t *min_value, uint16_t *max_value)
+{
+	uint16_t minv = *min_value, maxv = *max_value;
+
+	for (int i = 0; i < count; i++) {
+		if (minv > pixels[i])
+			minv = pixels[i];
+		if (maxv < pixels[i])
+			maxv = pixels[i];
+	}
+
+	*min_value = minv;
+	*max_value = maxv;
+}
+
+#if defined(THERMAL_FILTER_SSE2)
+
+static void filter_pixels_simd(uint16_t *pixels, uint16_t *estimate, int count,
+	const thermal_filter_params_t *params, uint16_t *min_value, uint16_t *max_value)
+{
+	// 符号なしの比較と積和ができないので、0x8000をずらして符号付きで扱う
+	const __m128i bias = _mm_set1_epi16((short)0x8000);
+	const __m128i threshold = _mm_set1_epi16((short)params->threshold);
+	const __m128i ramp = _mm_set1_epi16((short)params->ramp);
+	const __m128i slope = _mm_set1_epi16((short)params->slope);
+	const __m128i min_gain = _mm_set1_epi16((short)params->min_gain);
+	const __m128i one = _mm_set1_epi16(256);
+	const __m128i round = _mm_set1_epi32(128);
+	__m128i minv = _mm_set1_epi16((short)(*min_value ^ 0x8000));
+	__m128i maxv = _mm_set1_epi16((short)(*max_value ^ 0x8000));
+	int i;
+
+	for (i = 0; i + THERMAL_FILTER_BLOCK <= count; i += THERMAL_FILTER_BLOCK) {
+		__m128i x = _mm_loadu_si128((const __m128i *)&pixels[i]);
+		__m128i e = _mm_loadu_si128((const __m128i *)&estimate[i]);
+		__m128i diff = _mm_or_si128(_mm_subs_epu16(x, e), _mm_subs_epu16(e, x));
+		__m128i t = _mm_subs_epu16(diff, threshold);
+		t = _mm_sub_epi16(t, _mm_subs_epu16(t, ramp));
+		__m128i k = _mm_add_epi16(min_gain, _mm_srli_epi16(_mm_mullo_epi16(t, slope), 8));
+		__m128i w0 = _mm_sub_epi16(one, k);
+		__m128i xs = _mm_xor_si128(x, bias);
+		__m128i es = _mm_xor_si128(e, bias);
+		__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(es, xs), _mm_unpacklo_epi16(w0, k));
+		__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(es, xs), _mm_unpackhi_epi16(w0, k));
+		lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 8);
+		hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 8);
+		__m128i ys = _mm_packs_epi32(lo, hi);
+		__m128i y = _mm_xor_si128(ys, bias);
+
+		_mm_storeu_si128((__m128i *)&pixels[i], y);
+		_mm_storeu_si128((__m128i *)&estimate[i], y);
+		minv = _mm_min_epi16(minv, ys);
+		maxv = _mm_max_epi16(maxv, ys);
+	}
+
+	uint16_t temp[2][THERMAL_FILTER_BLOCK];
+	_mm_storeu_si128((__m128i *)temp[0], _mm_xor_si128(minv, bias));
+	_mm_storeu_si128((__m128i *)temp[1], _mm_xor_si128(maxv, bias));
+	minmax_c(temp[0], THERMAL_FILTER_BLOCK, min_value, max_value);
+	minmax_c(temp[1], THERMAL_FILTER_BLOCK, min_value, max_value);
+
+	filter_pixels_c(&pixels[i], &estimate[i], count - i, params, min_value, max_value);
+}
+
+#elif defined(THERMAL_FILTER_NEON)
+
+static void filter_pixels_simd(uint16_t *pixels, uint16_t *estimate, int count,
+	const thermal_filter_params_t *params, uint16_t *min_value, uint16_t *max_value)
+{
+	const uint16x8_t threshold = vdupq_n_u16(params->threshold);
+	const uint16x8_t ramp = vdupq_n_u16(params->ramp);
+	const uint16x8_t slope = vdupq_n_u16(params->slope);
+	const uint16x8_t min_gain = vdupq_n_u16(params->min_gain);
+	const uint16x8_t one = vdupq_n_u16(256);
+	uint16x8_t minv = vdupq_n_u16(*min_value);
+	uint16x8_t maxv = vdupq_n_u16(*max_value);
+	int i;
+
+	for (i = 0; i + THERMAL_FILTER_BLOCK <= count; i += THERMAL_FILTER_BLOCK) {
+		uint16x8_t x = vld1q_u16(&pixels[i]);
+		uint16x8_t e = vld1q_u16(&estimate[i]);
+		uint16x8_t t = vminq_u16(vqsubq_u16(vabdq_u16(x, e), threshold), ramp);
+		uint16x8_t k = vaddq_u16(min_gain, vshrq_n_u16(vmulq_u16(t, slope), 8));
+		uint16x8_t w0 = vsubq_u16(one, k);
+		uint32x4_t lo = vmlal_u16(vmull_u16(vget_low_u16(e), vget_low_u16(w0)), vget_low_u16(x), vget_low_u16(k));
+		uint32x4_t hi = vmlal_u16(vmull_u16(vget_high_u16(e), vget_high_u16(w0)), vget_high_u16(x), vget_high_u16(k));
+		uint16x8_t y = vcombine_u16(vrshrn_n_u32(lo, 8), vrshrn_n_u32(hi, 8));
+
+		vst1q_u16(&pixels[i], y);
+		vst1q_u16(&estimate[i], y);
+		minv = vminq_u16(minv, y);
+		maxv = vmaxq_u16(maxv, y);
+	}
+
+	uint16_t temp[2][THERMAL_FILTER_BLOCK];
+	vst1q_u16(temp[0], minv);
+	vst1q_u16(temp[1], maxv);
+	minmax_c(temp[0], THERMAL_FILTER_BLOCK, min_value, max_value);
+	minmax_c(temp[1], THERMAL_FILTER_BLOCK, min_value, max_value);
+
+	filter_pixels_c(&pixels[i], &estimate[i], count - i, params, min_value, max_value);
+}
+
+#else
+
+#define filter_pixels_simd filter_pixels_c
+
+#endif
+
+ThermalFilter::ThermalFilter() :
+	_estimate(),
+	_sample(),
+	_enable(true),
+	_threshold(0),
+	_frameMin(0),
+	_frameMax(0),
+	_rangeValid(false),
+	_rangeMin(0),
+	_rangeMax(0)
+{
+}
+
+void ThermalFilter::Reset()
+{
+	_estimate.clear();
+	_threshold = 0;
+	_rangeValid = false;
+}
+
+void ThermalFilter::SetEnable(bool enable)
+{
+	_enable = enable;
+	_estimate.clear();
+}
+
+void ThermalFilter::EstimateNoise(const uint16_t *pixels, int count)
+{
+	_sample.clear();
+	for (int i = 0; i < count; i += THERMAL_FILTER_SAMPLE_STEP) {
+		uint16_t x = pixels[i], e = _estimate[i];
+		_sample.push_back((x > e) ? x - e : e - x);
+	}
+
+	// 動いている画素は一部なので、中央値は雑音で決まる（正規分布なら0.67σ）
+	auto median = _sample.begin() + _sample.size() / 2;
+	std::nth_element(_sample.begin(), median, _sample.end());
+	int threshold = (3 * (int)*median) << 4;
+	if (threshold < (THERMAL_FILTER_MIN_THRESHOLD << 4))
+		threshold = THERMAL_FILTER_MIN_THRESHOLD << 4;
+
+	if (_threshold == 0)
+		_threshold = threshold;
+	else
+		_threshold += (threshold - _threshold) >> 3;
+}
+
+void ThermalFilter::UpdateRange()
+{
+	int32_t minValue = (int32_t)_frameMin << 4;
+	int32_t maxValue = (int32_t)_frameMax << 4;
+
+	if (!_rangeValid) {
+		_rangeMin = minValue;
+		_rangeMax = maxValue;
+		_rangeValid = true;
+		return;
+	}
+
+	// 広がるときは速く、狭まるときはゆっくり追う
+	_rangeMin += (minValue - _rangeMin) >> ((minValue < _rangeMin) ? THERMAL_RANGE_EXPAND_SHIFT : THERMAL_RANGE_SHRINK_SHIFT);
+	_rangeMax += (maxValue - _rangeMax) >> ((maxValue > _rangeMax) ? THERMAL_RANGE_EXPAND_SHIFT : THERMAL_RANGE_SHRINK_SHIFT);
+}
+
+void ThermalFilter::Process(uint16_t *pixels, int count, PixelConvert::Kernel::T kernel)
+{
+	_frameMin = 0xFFFF;
+	_frameMax = 0;
+
+	if (count <= 0)
+		return;
+
+	if (!_enable || (_estimate.size() != (size_t)count)) {
+		// 最初のフレームはそのまま推定値にする
+		if (_enable)
+			_estimate.assign(pixels, pixels + count);
+		minmax_c(pixels, count, &_frameMin, &_frameMax);
+		UpdateRange();
+		return;
+	}
+
+	EstimateNoise(pixels, count);
+
+	thermal_filter_params_t params;
+	int threshold = (_threshold + 8) >> 4;
+	// rampで割るので、1以上で16bitに収まる範囲にする
+	if (threshold > 0x7FFF)
+		threshold = 0x7FFF;
+	params.threshold = (uint16_t)threshold;
+	params.ramp = (uint16_t)((threshold > 0) ? 2 * threshold : 1);
+	params.slope = (uint16_t)(((256 - THERMAL_FILTER_MIN_GAIN) << 8) / params.ramp);
+	params.min_gain = THERMAL_FILTER_MIN_GAIN;
+
+	if (kernel == PixelConvert::Kernel::Auto)
+		filter_pixels_simd(pixels, &_estimate[0], count, &params, &_frameMin, &_frameMax);
+	else
+		filter_pixels_c(pixels, &_estimate[0], count, &params, &_frameMin, &_frameMax);
+
+	UpdateRange();
+}
+
+/* 正解の分かる合成画像（背景の傾き、動く熱源、雑音） */
+static void thermal_synthesize(uint16_t *truth, uint16_t *noisy, int width, int height, int frame)
+{
+	int cx = (frame * width / 64) % width, cy = height / 2;
+	int radius = height / 6;
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			// 0.01K単位で約20℃の背景と約35℃の熱源
+			int value = 29315 + 4 * x + 2 * y;
+			if ((x - cx) * (x - cx) + (y - cy) * (y - cy) < radius * radius)
+				value += 1500;
+			// 一様乱数12個の和で正規分布に近づける（σ≒7カウント）
+			int noise = 0;
+			for (int i = 0; i < 12; i++)
+				noise += rand() % 7;
+			noise -= 36;
+			truth[y * width + x] = (uint16_t)value;
+			noisy[y * width + x] = (uint16_t)(value + noise);
+		}
+	}
+}
+
+void ThermalFilterBench(const char *filename)
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+	const int synthetic_frames = 128;
+	ThermalReader reader;
+	int width = 160, height = 120, frames = synthetic_frames;
+	us_timestamp_t start, scalar = 0, simd = 0;
+
+	if (filename != NULL) {
+		if (!reader.Open(filename))
+			return;
+		width = reader.GetWidth();
+		height = reader.GetHeight();
+		frames = (int)reader.GetFrameCount();
+	}
+
+	int pixels = width * height;
+	std::vector<uint16_t> raw(pixels), truth(pixels), prevRaw(pixels), prevOut(pixels);
+	std::vector<uint16_t> out0(pixels), out1(pixels);
+	ThermalFilter filter0, filter1;
+	uint16_t rawMin = 0, rawMax = 0, rangeMin = 0, rangeMax = 0;
+	double rawNoise = 0, outNoise = 0, rawFlicker = 0, outFlicker = 0;
+	double rawError = 0, outError = 0;
+	int mismatch = 0, done = 0;
+
+	srand(1);
+	for (int n = 0; n < frames; n++) {
+		if (filename != NULL) {
+			if (!reader.ReadFrame(n, &raw[0], NULL, NULL))
+				break;
+		}
+		else {
+			thermal_synthesize(&truth[0], &raw[0], width, height, n);
+		}
+
+		out0 = raw;
+		out1 = raw;
+		start = ticker_read_us(ticker);
+		filter0.Process(&out0[0], pixels, PixelConvert::Kernel::Scalar);
+		scalar += ticker_read_us(ticker) - start;
+		start = ticker_read_us(ticker);
+		filter1.Process(&out1[0], pixels);
+		simd += ticker_read_us(ticker) - start;
+		if (out0 != out1)
+			mismatch++;
+
+		// 時間方向の雑音（前のフレームとの差の平均）と表示範囲のゆらぎ
+		uint16_t minValue = 0xFFFF, maxValue = 0;
+		minmax_c(&raw[0], pixels, &minValue, &maxValue);
+		if (n > 0) {
+			uint64_t rawSum = 0, outSum = 0;
+			for (int i = 0; i < pixels; i++) {
+				rawSum += abs((int)raw[i] - (int)prevRaw[i]);
+				outSum += abs((int)out1[i] - (int)prevOut[i]);
+			}
+			rawNoise += (double)rawSum / pixels;
+			outNoise += (double)outSum / pixels;
+			rawFlicker += abs((int)minValue - (int)rawMin) + abs((int)maxValue - (int)rawMax);
+			outFlicker += abs((int)filter1.GetRangeMin() - (int)rangeMin) + abs((int)filter1.GetRangeMax() - (int)rangeMax);
+		}
+		if (filename == NULL) {
+			double rawSq = 0, outSq = 0;
+			for (int i = 0; i < pixels; i++) {
+				double d0 = (double)raw[i] - truth[i], d1 = (double)out1[i] - truth[i];
+				rawSq += d0 * d0;
+				outSq += d1 * d1;
+			}
+			rawError += sqrt(rawSq / pixels);
+			outError += sqrt(outSq / pixels);
+		}
+		rawMin = minValue;
+		rawMax = maxValue;
+		rangeMin = filter1.GetRangeMin();
+		rangeMax = filter1.GetRangeMax();
+		prevRaw = raw;
+		prevOut = out1;
+		done++;
+	}
+
+	if (done < 2) {
+		printf("no frames\n");
+		return;
+	}
+
+	printf("%dx%d, %d frames, C %.1f us/frame, %s %.1f us/frame%s\n", width, height, done,
+		(double)scalar / done, PixelConvert::GetKernelName(), (double)simd / done,
+		(mismatch == 0) ? "" : " (mismatch)");
+	printf("temporal noise raw %.2f, filtered %.2f counts/frame (threshold %d)\n",
+		rawNoise / (done - 1), outNoise / (done - 1), filter1.GetThreshold());
+	printf("range flicker raw %.2f, smoothed %.2f counts/frame\n",
+		rawFlicker / (done - 1), outFlicker / (done - 1));
+	if (filename == NULL)
+		printf("rms error raw %.2f, filtered %.2f counts\n", rawError / done, outError / done);
+}
+
+extern "C" int usrcmd_tnf(int argc, char **argv)
+{
+	ThermalFilterBench((argc > 1) ? argv[1] : NULL);
+
+	return 0;
+}
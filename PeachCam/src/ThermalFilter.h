@@ -0,0 +1,63 @@
+#ifndef _THERMALFILTER_H_
+#define _THERMALFILTER_H_
+
+#include <stdint.h>
+#include <vector>
+#include "PixelConvert.h"
+
+/* 静止している画素の最小の追従率（256で入力そのまま） */
+#define THERMAL_FILTER_MIN_GAIN		(32)
+/* 雑音とみなす差の下限（カウント） */
+#define THERMAL_FILTER_MIN_THRESHOLD	(2)
+/* 雑音の推定に使う画素の間隔 */
+#define THERMAL_FILTER_SAMPLE_STEP	(4)
+/* 表示範囲が広がるとき・狭まるときの追従の速さ（2のべき乗分の1） */
+#define THERMAL_RANGE_EXPAND_SHIFT	(1)
+#define THERMAL_RANGE_SHRINK_SHIFT	(4)
+
+/*
+ * 熱画像の時間方向の雑音除去
+ *
+ * 画素ごとに前回の推定値と入力を重み k/256 で混ぜる（再帰型のフィルタ）。
+ * 差が雑音の閾値以下なら k は最小、閾値からその3倍まで上がる間に256まで上げるので、
+ * 動いたところは残像にならずにすぐ追従する。
+ * 閾値は推定値との差の中央値から毎フレーム求めるので、AGCの8bitでも放射測定の
+ * 0.01K単位でも同じ設定で動く。
+ * 出力の最小・最大値を指数的に平滑化して色付けの範囲にする。
+ */
+class ThermalFilter
+{
+public:
+	ThermalFilter();
+private:
+	std::vector<uint16_t> _estimate;	// 前回の出力
+	std::vector<uint16_t> _sample;		// 雑音の推定用
+	bool _enable;
+	int _threshold;						// 雑音の閾値（1/16カウント）
+	uint16_t _frameMin;
+	uint16_t _frameMax;
+	bool _rangeValid;
+	int32_t _rangeMin;					// 表示範囲（1/16カウント）
+	int32_t _rangeMax;
+	void EstimateNoise(const uint16_t *pixels, int count);
+	void UpdateRange();
+public:
+	void Reset();
+	void SetEnable(bool enable);
+	bool IsEnabled() { return _enable; }
+	/* 連続したcount画素をその場で書き換える（無効なら最小・最大値だけ求める） */
+	void Process(uint16_t *pixels, int count, PixelConvert::Kernel::T kernel = PixelConvert::Kernel::Auto);
+	int GetThreshold() { return _threshold >> 4; }
+	uint16_t GetFrameMin() { return _frameMin; }
+	uint16_t GetFrameMax() { return _frameMax; }
+	uint16_t GetRangeMin() { return (uint16_t)((_rangeMin + 8) >> 4); }
+	uint16_t GetRangeMax() { return (uint16_t)((_rangeMax + 8) >> 4); }
+};
+
+/*
+ * 雑音除去の速度とC/SIMDの一致、記録ファイル（.thr）の時間方向の雑音と
+ * 表示範囲のゆらぎを表示する。ファイルが無ければ正解の分かる合成画像で誤差も表示する。
+ */
+void ThermalFilterBench(const char *filename);
+
+#endif // _THERMALFILTER_H_
@@ -0,0 +1,479 @@
+#include "mbed.h"
+#include "ThermalFusion.h"
+#include "StorageTask.h"
+#include "Palettes.h"
+#include <algorithm>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#include <emmintrin.h>
+#define THERMAL_FUSION_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define THERMAL_FUSION_NEON
+#endif
+
+/* SIMDで1度に処理する画素数 */
+#define THERMAL_FUSION_BLOCK	(8)
+
+struct thermal_fusion_maps_t {
+	char magic[4];
+	uint32_t src_width;
+	uint32_t src_height;
+	uint32_t dst_width;
+	uint32_t dst_height;
+	uint32_t reserved;
+	double homography[9];
+};
+
+/* (v - min)をdiffで頭打ちにして0～255にする（scaleは255/diffの65536倍） */
+static void normalize_row_c(uint8_t *dst, const uint16_t *src, int width,
+	uint16_t min_value, uint16_t diff, uint16_t scale)
+{
+	for (int x = 0; x < width; x++) {
+		int d = (src[x] > min_value) ? src[x] - min_value : 0;
+		if (d > diff)
+			d = diff;
+		dst[x] = (uint8_t)((d * scale) >> 16);
+	}
+}
+
+#if defined(THERMAL_FUSION_SSE2)
+
+static void normalize_row_simd(uint8_t *dst, const uint16_t *src, int width,
+	uint16_t min_value, uint16_t diff, uint16_t scale)
+{
+	const __m128i vmin = _mm_set1_epi16((short)min_value);
+	const __m128i vdiff = _mm_set1_epi16((short)diff);
+	const __m128i vscale = _mm_set1_epi16((short)scale);
+	int x;
+
+	for (x = 0; x + THERMAL_FUSION_BLOCK <= width; x += THERMAL_FUSION_BLOCK) {
+		__m128i d = _mm_subs_epu16(_mm_loadu_si128((const __m128i *)&src[x]), vmin);
+		d = _mm_sub_epi16(d, _mm_subs_epu16(d, vdiff));
+		__m128i v = _mm_mulhi_epu16(d, vscale);
+		_mm_storel_epi64((__m128i *)&dst[x], _mm_packus_epi16(v, v));
+	}
+
+	normalize_row_c(&dst[x], &src[x], width - x, min_value, diff, scale);
+}
+
+#elif defined(THERMAL_FUSION_NEON)
+
+static void normalize_row_simd(uint8_t *dst, const uint16_t *src, int width,
+	uint16_t min_value, uint16_t diff, uint16_t scale)
+{
+	const uint16x8_t vmin = vdupq_n_u16(min_value);
+	const uint16x8_t vdiff = vdupq_n_u16(diff);
+	const uint16x4_t vscale = vdup_n_u16(scale);
+	int x;
+
+	for (x = 0; x + THERMAL_FUSION_BLOCK <= width; x += THERMAL_FUSION_BLOCK) {
+		uint16x8_t d = vminq_u16(vqsubq_u16(vld1q_u16(&src[x]), vmin), vdiff);
+		uint16x8_t v = vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(d), vscale), 16),
+			vshrn_n_u32(vmull_u16(vget_high_u16(d), vscale), 16));
+		vst1_u8(&dst[x], vmovn_u16(v));
+	}
+
+	normalize_row_c(&dst[x], &src[x], width - x, min_value, diff, scale);
+}
+
+#else
+
+#define normalize_row_simd normalize_row_c
+
+#endif
+
+/*
+ * 表を引いて双線形補間し、色を付けて1行書く
+ * 画素ごとに参照先が違うのでSIMDにはせず、整数演算だけで済ませる。
+ */
+static void fuse_row(uint16_t *dst, const int16_t *xy, const uint16_t *frac, int width,
+	const uint8_t *index, int src_width, int src_height, const uint16_t *palette)
+{
+	int pitch = src_width + 1;
+
+	for (int x = 0; x < width; x++, xy += 2) {
+		int sx = xy[0], sy = xy[1];
+		if (((unsigned)sx >= (unsigned)src_width) || ((unsigned)sy >= (unsigned)src_height)) {
+			dst[x] = 0;
+			continue;
+		}
+		const uint8_t *p = &index[sy * pitch + sx];
+		int wx = frac[x] & (cv::INTER_TAB_SIZE - 1);
+		int wy = frac[x] >> cv::INTER_BITS;
+		int top = (p[0] << cv::INTER_BITS) + (p[1] - p[0]) * wx;
+		int bottom = (p[pitch] << cv::INTER_BITS) + (p[pitch + 1] - p[pitch]) * wx;
+		int value = ((top << cv::INTER_BITS) + (bottom - top) * wy + (1 << (2 * cv::INTER_BITS - 1))) >> (2 * cv::INTER_BITS);
+		dst[x] = palette[value];
+	}
+}
+
+/* 位置合わせが無ければ縦を合わせて中央に置く（画素の中心を合わせる） */
+static void default_homography(double *h, int src_width, int src_height, int dst_width, int dst_height)
+{
+	double scale = (double)dst_height / src_height;
+
+	memset(h, 0, 9 * sizeof(double));
+	h[0] = scale;
+	h[2] = 0.5 * scale - 0.5 + (dst_width - src_width * scale) / 2;
+	h[4] = scale;
+	h[5] = 0.5 * scale - 0.5;
+	h[8] = 1.0;
+}
+
+ThermalFusion::ThermalFusion() :
+	_storage(NULL),
+	_loaded(false),
+	_dirty(true),
+	_calWidth(0),
+	_calHeight(0),
+	_srcWidth(0),
+	_srcHeight(0),
+	_dstWidth(0),
+	_dstHeight(0),
+	_alpha(THERMAL_FUSION_ALPHA),
+	_map1(),
+	_map2(),
+	_index(),
+	_buildTime(0)
+{
+	memset(_homography, 0, sizeof(_homography));
+	memset(_palette, 0, sizeof(_palette));
+}
+
+ThermalFusion::~ThermalFusion()
+{
+}
+
+void ThermalFusion::LoadCalibration()
+{
+	FILE *fp = fopen(THERMAL_FUSION_CALIBRATION, "r");
+	double h[9];
+	int width, height;
+
+	_calWidth = 0;
+	_calHeight = 0;
+	if (fp == NULL)
+		return;
+
+	bool result = (fscanf(fp, "%d %d", &width, &height) == 2) && (width > 0) && (height > 0);
+	for (int i = 0; result && (i < 9); i++)
+		result = (fscanf(fp, "%lf", &h[i]) == 1);
+	fclose(fp);
+
+	if (!result) {
+		printf("ThermalFusion: invalid %s\n", THERMAL_FUSION_CALIBRATION);
+		return;
+	}
+
+	memcpy(_homography, h, sizeof(_homography));
+	_calWidth = width;
+	_calHeight = height;
+}
+
+bool ThermalFusion::LoadMaps(const double *homography)
+{
+	thermal_fusion_maps_t header;
+	FILE *fp;
+
+	// 読むだけなのでStorageTaskを通さない
+	fp = fopen(THERMAL_FUSION_MAPS, "rb");
+	if (fp == NULL)
+		return false;
+
+	bool result = (fread(&header, sizeof(header), 1, fp) == 1)
+		&& (memcmp(header.magic, THERMAL_FUSION_MAPS_MAGIC, sizeof(header.magic)) == 0)
+		&& (header.src_width == (uint32_t)_srcWidth) && (header.src_height == (uint32_t)_srcHeight)
+		&& (header.dst_width == (uint32_t)_dstWidth) && (header.dst_height == (uint32_t)_dstHeight)
+		&& (memcmp(header.homography, homography, sizeof(header.homography)) == 0);
+	if (result) {
+		_map1.create(_dstHeight, _dstWidth, CV_16SC2);
+		_map2.create(_dstHeight, _dstWidth, CV_16UC1);
+		size_t size1 = _map1.total() * _map1.elemSize(), size2 = _map2.total() * _map2.elemSize();
+		result = (fread(_map1.data, 1, size1, fp) == size1) && (fread(_map2.data, 1, size2, fp) == size2);
+	}
+	fclose(fp);
+
+	return result;
+}
+
+void ThermalFusion::SaveMaps(const double *homography)
+{
+	thermal_fusion_maps_t header;
+
+	if (_storage == NULL)
+		return;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, THERMAL_FUSION_MAPS_MAGIC, sizeof(header.magic));
+	header.src_width = _srcWidth;
+	header.src_height = _srcHeight;
+	header.dst_width = _dstWidth;
+	header.dst_height = _dstHeight;
+	memcpy(header.homography, homography, sizeof(header.homography));
+
+	size_t size1 = _map1.total() * _map1.elemSize(), size2 = _map2.total() * _map2.elemSize();
+	std::vector<uint8_t> data(sizeof(header) + size1 + size2);
+	memcpy(&data[0], &header, sizeof(header));
+	memcpy(&data[sizeof(header)], _map1.data, size1);
+	memcpy(&data[sizeof(header) + size1], _map2.data, size2);
+
+	_storage->WriteFile(THERMAL_FUSION_MAPS, std::move(data), false);
+}
+
+void ThermalFusion::BuildMaps(const double *homography)
+{
+	cv::Matx33d inv = cv::Matx33d(homography).inv();
+	cv::Mat mapx(_dstHeight, _dstWidth, CV_32FC1), mapy(_dstHeight, _dstWidth, CV_32FC1);
+
+	// 表示の各画素が熱画像のどこに当たるか
+	for (int v = 0; v < _dstHeight; v++) {
+		float *px = mapx.ptr<float>(v), *py = mapy.ptr<float>(v);
+		for (int u = 0; u < _dstWidth; u++) {
+			double x = inv(0, 0) * u + inv(0, 1) * v + inv(0, 2);
+			double y = inv(1, 0) * u + inv(1, 1) * v + inv(1, 2);
+			double w = inv(2, 0) * u + inv(2, 1) * v + inv(2, 2);
+			if (w <= 0.0) {
+				px[u] = -1.0f;
+				py[u] = -1.0f;
+			}
+			else {
+				px[u] = (float)(x / w);
+				py[u] = (float)(y / w);
+			}
+		}
+	}
+
+	cv::convertMaps(mapx, mapy, _map1, _map2, CV_16SC2, false);
+}
+
+bool ThermalFusion::Prepare(int src_width, int src_height, int dst_width, int dst_height)
+{
+	double h[9];
+
+	_mutex.lock();
+	if (!_loaded) {
+		LoadCalibration();
+		_loaded = true;
+		_dirty = true;
+	}
+	if (!_dirty && (_srcWidth == src_width) && (_srcHeight == src_height)
+		&& (_dstWidth == dst_width) && (_dstHeight == dst_height)) {
+		_mutex.unlock();
+		return true;
+	}
+
+	if (_calWidth > 0) {
+		// 位置合わせした時と熱画像の大きさが違えば座標を合わせる
+		cv::Matx33d scale((double)_calWidth / src_width, 0, 0, 0, (double)_calHeight / src_height, 0, 0, 0, 1);
+		cv::Matx33d temp = cv::Matx33d(_homography) * scale;
+		memcpy(h, temp.val, sizeof(h));
+	}
+	else {
+		default_homography(h, src_width, src_height, dst_width, dst_height);
+	}
+	_dirty = false;
+	_srcWidth = src_width;
+	_srcHeight = src_height;
+	_dstWidth = dst_width;
+	_dstHeight = dst_height;
+	_mutex.unlock();
+
+	us_timestamp_t start = ticker_read_us(get_us_ticker_data());
+	if (!LoadMaps(h)) {
+		BuildMaps(h);
+		SaveMaps(h);
+	}
+	_buildTime = ticker_read_us(get_us_ticker_data()) - start;
+
+	_index.assign((src_width + 1) * (src_height + 1), 0);
+
+	return !_map1.empty();
+}
+
+bool ThermalFusion::Calibrate(const std::vector<cv::Point2f> &thermal, const std::vector<cv::Point2f> &camera,
+	int src_width, int src_height)
+{
+	if ((thermal.size() < 4) || (thermal.size() != camera.size()) || (src_width <= 0) || (src_height <= 0))
+		return false;
+
+	// 4点ちょうどなら全部使い、それより多ければ外れた点を除く
+	cv::Mat h = cv::findHomography(thermal, camera, (thermal.size() > 4) ? cv::RANSAC : 0, 3.0);
+	if (h.empty()) {
+		printf("ThermalFusion: calibration failed\n");
+		return false;
+	}
+
+	FILE *fp = fopen(THERMAL_FUSION_CALIBRATION, "w");
+	if (fp != NULL) {
+		fprintf(fp, "%d %d\n", src_width, src_height);
+		for (int i = 0; i < 9; i++)
+			fprintf(fp, "%.9g%c", h.at<double>(i / 3, i % 3), ((i % 3) == 2) ? '\n' : ' ');
+		fclose(fp);
+	}
+
+	_mutex.lock();
+	for (int i = 0; i < 9; i++)
+		_homography[i] = h.at<double>(i / 3, i % 3);
+	_calWidth = src_width;
+	_calHeight = src_height;
+	_loaded = true;
+	_dirty = true;
+	_mutex.unlock();
+
+	return true;
+}
+
+void ThermalFusion::ResetCalibration()
+{
+	remove(THERMAL_FUSION_CALIBRATION);
+
+	_mutex.lock();
+	_calWidth = 0;
+	_calHeight = 0;
+	_loaded = true;
+	_dirty = true;
+	_mutex.unlock();
+}
+
+void ThermalFusion::SetAlpha(int alpha)
+{
+	_alpha = (alpha < 0) ? 0 : ((alpha > 15) ? 15 : alpha);
+}
+
+bool ThermalFusion::Render(uint16_t *dst, int dst_stride, int dst_width, int dst_height,
+	const uint16_t *pixels, int stride, int width, int height,
+	uint16_t min_value, uint16_t max_value, const uint8_t *colormap, PixelConvert::Kernel::T kernel)
+{
+	if ((width <= 0) || (height <= 0) || !Prepare(width, height, dst_width, dst_height))
+		return false;
+
+	// 色付けと同じく256カウント未満の範囲は中央から広げる
+	int diff = max_value - min_value;
+	if (diff < 256) {
+		diff = 256;
+		min_value = (max_value + min_value) / 2;
+		if (min_value < 128)
+			min_value = 0;
+		else
+			min_value -= 128;
+	}
+	uint16_t scale = (uint16_t)((255u << 16) / (unsigned)diff);
+
+	if (colormap == NULL)
+		colormap = colormap_grayscale;
+	uint16_t alpha = (uint16_t)(_alpha << 12);
+	for (int i = 0; i < 256; i++) {
+		const uint8_t *color = &colormap[3 * i];
+		_palette[i] = alpha | ((color[0] >> 4) << 8) | ((color[1] >> 4) << 4) | ((color[2] >> 4) << 0);
+	}
+
+	// 熱画像の大きさで正規化し、補間で右と下の隣を読めるように端を複製する
+	int pitch = width + 1;
+	for (int y = 0; y < height; y++) {
+		uint8_t *row = &_index[y * pitch];
+		if (kernel == PixelConvert::Kernel::Auto)
+			normalize_row_simd(row, pixels + y * stride, width, min_value, (uint16_t)diff, scale);
+		else
+			normalize_row_c(row, pixels + y * stride, width, min_value, (uint16_t)diff, scale);
+		row[width] = row[width - 1];
+	}
+	memcpy(&_index[height * pitch], &_index[(height - 1) * pitch], pitch);
+
+	for (int y = 0; y < dst_height; y++) {
+		fuse_row(dst + y * dst_stride, _map1.ptr<int16_t>(y), _map2.ptr<uint16_t>(y), dst_width,
+			&_index[0], width, height, _palette);
+	}
+
+	return true;
+}
+
+void ThermalFusion::PrintInfo()
+{
+	_mutex.lock();
+	if (_calWidth > 0) {
+		printf("calibrated at %dx%d\n", _calWidth, _calHeight);
+		for (int i = 0; i < 3; i++)
+			printf("  %10.4f %10.4f %10.4f\n", _homography[3 * i], _homography[3 * i + 1], _homography[3 * i + 2]);
+	}
+	else {
+		printf("not calibrated (centered)\n");
+	}
+	printf("%dx%d -> %dx%d, alpha %d/15, maps %.1f ms\n", _srcWidth, _srcHeight, _dstWidth, _dstHeight,
+		_alpha, _buildTime / 1000.0);
+	_mutex.unlock();
+}
+
+void ThermalFusionBench()
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+	const int count = 50;
+	const int width = 160, height = 120;
+	static const struct {
+		int width;
+		int height;
+	} targets[] = { { 320, 240 }, { 480, 272 } };
+	std::vector<uint16_t> thermal(width * height);
+	us_timestamp_t start, scalar, simd, separate;
+
+	// 背景の傾きと熱源
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int value = 29315 + 8 * x + 4 * y + (rand() % 16);
+			if ((x - 100) * (x - 100) + (y - 60) * (y - 60) < 400)
+				value += 1500;
+			thermal[y * width + x] = (uint16_t)value;
+		}
+	}
+	uint16_t min_value = *std::min_element(thermal.begin(), thermal.end());
+	uint16_t max_value = *std::max_element(thermal.begin(), thermal.end());
+
+	printf("%dx%d -> ARGB4444, %s [ms/frame]\n", width, height, PixelConvert::GetKernelName());
+
+	for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); i++) {
+		int dst_width = targets[i].width, dst_height = targets[i].height;
+		std::vector<uint16_t> dst0(dst_width * dst_height), dst1(dst_width * dst_height);
+		ThermalFusion fusion;
+
+		// 最初の1回で表を作る
+		start = ticker_read_us(ticker);
+		fusion.Render(&dst0[0], dst_width, dst_width, dst_height, &thermal[0], width, width, height,
+			min_value, max_value, colormap_ironblack, PixelConvert::Kernel::Scalar);
+		us_timestamp_t maps = ticker_read_us(ticker) - start;
+
+		start = ticker_read_us(ticker);
+		for (int n = 0; n < count; n++)
+			fusion.Render(&dst0[0], dst_width, dst_width, dst_height, &thermal[0], width, width, height,
+				min_value, max_value, colormap_ironblack, PixelConvert::Kernel::Scalar);
+		scalar = ticker_read_us(ticker) - start;
+
+		start = ticker_read_us(ticker);
+		for (int n = 0; n < count; n++)
+			fusion.Render(&dst1[0], dst_width, dst_width, dst_height, &thermal[0], width, width, height,
+				min_value, max_value, colormap_ironblack);
+		simd = ticker_read_us(ticker) - start;
+		bool match = (dst0 == dst1);
+
+		// 比較用: 拡大してから色付けする
+		cv::Mat src(height, width, CV_16UC1, &thermal[0]);
+		float scale = 255.9f / (max_value - min_value);
+		start = ticker_read_us(ticker);
+		for (int n = 0; n < count; n++) {
+			cv::Mat large;
+			cv::resize(src, large, cv::Size(dst_width, dst_height), 0, 0, cv::INTER_LINEAR);
+			for (int y = 0; y < dst_height; y++) {
+				const uint16_t *values = large.ptr<uint16_t>(y);
+				uint16_t *pixel = &dst0[y * dst_width];
+				for (int x = 0; x < dst_width; x++) {
+					const uint8_t *color = &colormap_ironblack[3 * (uint8_t)((values[x] - min_value) * scale)];
+					pixel[x] = 0xA000 | ((color[0] >> 4) << 8) | ((color[1] >> 4) << 4) | ((color[2] >> 4) << 0);
+				}
+			}
+		}
+		separate = ticker_read_us(ticker) - start;
+
+		printf("%dx%d : maps %.1f, C %.2f, %s %.2f%s, resize+colorize %.2f\n", dst_width, dst_height,
+			maps / 1000.0, scalar / 1000.0 / count, PixelConvert::GetKernelName(), simd / 1000.0 / count,
+			match ? "" : " (mismatch)", separate / 1000.0 / count);
+	}
+}
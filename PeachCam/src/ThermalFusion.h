@@ -0,0 +1,81 @@
+#ifndef _THERMALFUSION_H_
+#define _THERMALFUSION_H_
+
+#include <stdint.h>
+#include <vector>
+#include "opencv.hpp"
+#include "PixelConvert.h"
+
+/* 熱画像とカメラの位置合わせ（ホモグラフィーとその時の熱画像の大きさ） */
+#define THERMAL_FUSION_CALIBRATION	".\\fusion.cal"
+/* 位置合わせから作った座標の表（位置合わせと大きさが同じなら読み込む） */
+#define THERMAL_FUSION_MAPS			".\\fusion.map"
+#define THERMAL_FUSION_MAPS_MAGIC	"PCFM"
+/* 重ねる熱画像の不透明度（ARGB4444のアルファ、0～15） */
+#define THERMAL_FUSION_ALPHA		(10)
+
+class StorageTask;
+
+/*
+ * 熱画像をカメラ画像に重ねる
+ *
+ * カメラの座標から熱画像の座標への表をconvertMapsで固定小数点（CV_16SC2とCV_16UC1）に
+ * しておき、毎フレーム次の2パスで描く。
+ *  1. 熱画像を表示範囲で0～255に正規化する（SIMD、熱画像の画素数だけ）
+ *  2. 表を引いて双線形補間し、色とアルファを付けて書き込む（表示の画素数だけ）
+ * 書き込み先はカメラのレイヤーの上にあるARGB4444のレイヤーで、混ぜるのは表示回路が行う。
+ * 熱画像の外側は透明にする。
+ */
+class ThermalFusion
+{
+public:
+	ThermalFusion();
+	virtual ~ThermalFusion();
+private:
+	rtos::Mutex _mutex;
+	StorageTask *_storage;
+	bool _loaded;					// 位置合わせを読んだ
+	bool _dirty;					// 表を作り直す
+	double _homography[9];			// 熱画像 → カメラ
+	int _calWidth;					// 位置合わせした時の熱画像の大きさ
+	int _calHeight;
+	int _srcWidth;
+	int _srcHeight;
+	int _dstWidth;
+	int _dstHeight;
+	int _alpha;
+	cv::Mat _map1;					// CV_16SC2 整数の座標
+	cv::Mat _map2;					// CV_16UC1 補間の重みの番号
+	std::vector<uint8_t> _index;	// 正規化した熱画像（右と下に1画素広げる）
+	uint16_t _palette[256];
+	us_timestamp_t _buildTime;
+	void LoadCalibration();
+	bool LoadMaps(const double *homography);
+	void SaveMaps(const double *homography);
+	void BuildMaps(const double *homography);
+	bool Prepare(int src_width, int src_height, int dst_width, int dst_height);
+public:
+	void SetStorage(StorageTask *storage) { _storage = storage; }
+	/* 熱画像とカメラの対応点（4点以上）から位置合わせする */
+	bool Calibrate(const std::vector<cv::Point2f> &thermal, const std::vector<cv::Point2f> &camera,
+		int src_width, int src_height);
+	/* 位置合わせを消して、熱画像を画面いっぱいに広げる */
+	void ResetCalibration();
+	void SetAlpha(int alpha);
+	/*
+	 * 熱画像（strideは画素単位、負なら下から上）をdst（ARGB4444）に描く
+	 * colormapはRGBの256色、NULLなら白黒
+	 */
+	bool Render(uint16_t *dst, int dst_stride, int dst_width, int dst_height,
+		const uint16_t *pixels, int stride, int width, int height,
+		uint16_t min_value, uint16_t max_value, const uint8_t *colormap,
+		PixelConvert::Kernel::T kernel = PixelConvert::Kernel::Auto);
+	void PrintInfo();
+};
+
+/*
+ * 320x240と480x272への重ね合わせの時間[ms/frame]を表示する
+ */
+void ThermalFusionBench();
+
+#endif // _THERMALFUSION_H_
@@ -0,0 +1,519 @@
+#include "mbed.h"
+#include "ThermalRecord.h"
+#include "StorageTask.h"
+
+ThermalRecorder thermalRecorder;
+
+static us_timestamp_t thermal_now()
+{
+	return ticker_read_us(get_us_ticker_data());
+}
+
+/* 符号付きの残差を小さい正の値に寄せる（0,-1,1,-2,...→0,1,2,3,...） */
+static inline uint16_t zigzag_encode(uint16_t value, uint16_t pred)
+{
+	int16_t residual = (int16_t)(value - pred);
+	return (uint16_t)((residual << 1) ^ (residual >> 15));
+}
+
+static inline uint16_t zigzag_decode(uint16_t code, uint16_t pred)
+{
+	return (uint16_t)(pred + ((code >> 1) ^ (uint16_t)-(int16_t)(code & 1)));
+}
+
+ThermalRecorder::ThermalRecorder() :
+	_storage(NULL),
+	_file(-1),
+	_width(0),
+	_height(0),
+	_origin(0),
+	_offset(0),
+	_number(0),
+	_needKey(true),
+	_index(),
+	_previous(),
+	_planes(),
+	_zsReady(false),
+	_keyFrames(0),
+	_dropped(0),
+	_rawBytes(0),
+	_codedBytes(0),
+	_encodeTime(0),
+	_encodeMax(0)
+{
+	memset(&_zs, 0, sizeof(_zs));
+}
+
+ThermalRecorder::~ThermalRecorder()
+{
+	Close();
+	if (_zsReady)
+		deflateEnd(&_zs);
+}
+
+bool ThermalRecorder::Open(StorageTask *storage, const char *filename, int width, int height)
+{
+	ThermalFileHeader header;
+
+	Close();
+
+	_mutex.lock();
+
+	if (!_zsReady) {
+		// 残差は0付近の値が続くのでRLEで十分縮み、辞書を探すより速い
+		if (deflateInit2(&_zs, 1, Z_DEFLATED, 10, 7, Z_RLE) != Z_OK) {
+			_mutex.unlock();
+			printf("ThermalRecorder: deflateInit2 failed\n");
+			return false;
+		}
+		_zsReady = true;
+	}
+
+	// 0で埋めると索引とフッターの位置がずれるので、捨てたフレームは詰めて書く
+	int file = storage->Open(filename, 0, false);
+	if (file < 0) {
+		_mutex.unlock();
+		printf("ThermalRecorder: cannot open %s\n", filename);
+		return false;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, THERMAL_FILE_MAGIC, sizeof(header.magic));
+	header.version = THERMAL_FILE_VERSION;
+	header.header_size = sizeof(header);
+	header.width = (uint16_t)width;
+	header.height = (uint16_t)height;
+	header.bits = 14;
+	header.keyframe_interval = THERMAL_KEYFRAME_INTERVAL;
+	header.start_time = (int64_t)time(NULL);
+
+	std::vector<uint8_t> data((uint8_t *)&header, (uint8_t *)&header + sizeof(header));
+	if (!storage->Append(file, std::move(data))) {
+		storage->Close(file, false);
+		_mutex.unlock();
+		printf("ThermalRecorder: cannot write %s\n", filename);
+		return false;
+	}
+
+	_storage = storage;
+	_file = file;
+	_width = width;
+	_height = height;
+	_offset = sizeof(header);
+	_number = 0;
+	_needKey = true;
+	_index.clear();
+	_previous.assign(width * height, 0);
+	_planes.resize(THERMAL_TELEMETRY_SIZE + width * height * 2);
+	_keyFrames = 0;
+	_dropped = 0;
+	_rawBytes = 0;
+	_codedBytes = 0;
+	_encodeTime = 0;
+	_encodeMax = 0;
+	_origin = thermal_now();
+
+	_mutex.unlock();
+
+	return true;
+}
+
+void ThermalRecorder::Close()
+{
+	ThermalFileFooter footer;
+
+	_mutex.lock();
+
+	if (_file < 0) {
+		_mutex.unlock();
+		return;
+	}
+
+	// 索引が書けなくても読むときに走査して作り直せる
+	size_t size = _index.size() * sizeof(ThermalIndexEntry);
+	std::vector<uint8_t> data(size + sizeof(footer));
+	if (size > 0)
+		memcpy(&data[0], &_index[0], size);
+
+	memset(&footer, 0, sizeof(footer));
+	footer.index_offset = _offset;
+	footer.index_count = (uint32_t)_index.size();
+	footer.frame_count = _number;
+	memcpy(footer.magic, THERMAL_FOOTER_MAGIC, sizeof(footer.magic));
+	memcpy(&data[size], &footer, sizeof(footer));
+
+	_storage->Append(_file, std::move(data));
+	_storage->Close(_file, false);
+	_file = -1;
+	_storage = NULL;
+
+	_mutex.unlock();
+
+	PrintStats();
+}
+
+void ThermalRecorder::WriteFrame(const uint16_t *pixels, int width, int height, int stride, const uint8_t *telemetry)
+{
+	ThermalFrameHeader header;
+
+	_mutex.lock();
+
+	if ((_file < 0) || (width != _width) || (height != _height)) {
+		_mutex.unlock();
+		return;
+	}
+
+	us_timestamp_t start = thermal_now();
+	bool key = _needKey || (_number % THERMAL_KEYFRAME_INTERVAL) == 0;
+
+	if (telemetry != NULL)
+		memcpy(&_planes[0], telemetry, THERMAL_TELEMETRY_SIZE);
+	else
+		memset(&_planes[0], 0, THERMAL_TELEMETRY_SIZE);
+
+	// 下位バイトと上位バイトを別の面にすると上位側がほぼ0の連続になる
+	uint8_t *lo = &_planes[THERMAL_TELEMETRY_SIZE];
+	uint8_t *hi = lo + width * height;
+	for (int y = 0; y < height; y++) {
+		const uint16_t *line = pixels + y * stride;
+		uint16_t *prev = &_previous[y * width];
+		if (key) {
+			uint16_t pred = (y > 0) ? _previous[(y - 1) * width] : 0;
+			for (int x = 0; x < width; x++) {
+				uint16_t value = line[x];
+				uint16_t code = zigzag_encode(value, pred);
+				pred = value;
+				prev[x] = value;
+				*lo++ = (uint8_t)code;
+				*hi++ = (uint8_t)(code >> 8);
+			}
+		}
+		else {
+			for (int x = 0; x < width; x++) {
+				uint16_t value = line[x];
+				uint16_t code = zigzag_encode(value, prev[x]);
+				prev[x] = value;
+				*lo++ = (uint8_t)code;
+				*hi++ = (uint8_t)(code >> 8);
+			}
+		}
+	}
+
+	std::vector<uint8_t> data(sizeof(header) + deflateBound(&_zs, (uLong)_planes.size()));
+	deflateReset(&_zs);
+	_zs.next_in = &_planes[0];
+	_zs.avail_in = (uInt)_planes.size();
+	_zs.next_out = &data[sizeof(header)];
+	_zs.avail_out = (uInt)(data.size() - sizeof(header));
+	if (deflate(&_zs, Z_FINISH) != Z_STREAM_END) {
+		_dropped++;
+		_needKey = true;
+		_mutex.unlock();
+		return;
+	}
+	data.resize(sizeof(header) + _zs.total_out);
+
+	memset(&header, 0, sizeof(header));
+	header.flags = (key ? ThermalFrame::Key : 0) | ((telemetry != NULL) ? ThermalFrame::Telemetry : 0);
+	header.size = (uint32_t)_zs.total_out;
+	header.number = _number;
+	header.timestamp = start - _origin;
+	memcpy(&data[0], &header, sizeof(header));
+
+	us_timestamp_t elapse = thermal_now() - start;
+	_encodeTime += elapse;
+	if (_encodeMax < elapse)
+		_encodeMax = elapse;
+
+	size_t size = data.size();
+	if (!_storage->Append(_file, std::move(data))) {
+		// ファイルには何も書かれないので_offsetと_numberは進めない
+		// 参照先が欠けるので次はキーフレームにする
+		_dropped++;
+		_needKey = true;
+		_mutex.unlock();
+		return;
+	}
+
+	if (key) {
+		ThermalIndexEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.timestamp = header.timestamp;
+		entry.offset = _offset;
+		entry.number = _number;
+		_index.push_back(entry);
+		_keyFrames++;
+	}
+	_needKey = false;
+	_offset += size;
+	_number++;
+	_rawBytes += width * height * 2 + ((telemetry != NULL) ? THERMAL_TELEMETRY_SIZE : 0);
+	_codedBytes += size;
+
+	_mutex.unlock();
+}
+
+void ThermalRecorder::PrintStats()
+{
+	_mutex.lock();
+	printf("thermal %s, %lu frames (%lu key), %lu dropped\n", (_file >= 0) ? "recording" : "stopped",
+		(unsigned long)_number, (unsigned long)_keyFrames, (unsigned long)_dropped);
+	if (_number > 0) {
+		printf("raw %llu bytes, coded %llu bytes, ratio %.2f\n",
+			_rawBytes, _codedBytes, (double)_rawBytes / _codedBytes);
+		printf("encode avg %llu us, max %llu us\n", _encodeTime / _number, _encodeMax);
+	}
+	_mutex.unlock();
+}
+
+ThermalReader::ThermalReader() :
+	_fp(NULL),
+	_index(),
+	_frameCount(0),
+	_end(0),
+	_frame(),
+	_telemetry(),
+	_timestamp(0),
+	_current(-1),
+	_next(0),
+	_payload(),
+	_planes()
+{
+	memset(&_header, 0, sizeof(_header));
+}
+
+ThermalReader::~ThermalReader()
+{
+	Close();
+}
+
+bool ThermalReader::Open(const char *filename)
+{
+	Close();
+
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL) {
+		printf("ThermalReader: cannot open %s\n", filename);
+		return false;
+	}
+
+	if ((fread(&_header, sizeof(_header), 1, fp) != 1)
+		|| (memcmp(_header.magic, THERMAL_FILE_MAGIC, sizeof(_header.magic)) != 0)
+		|| (_header.version != THERMAL_FILE_VERSION)
+		|| (_header.header_size < sizeof(_header))
+		|| (_header.width == 0) || (_header.height == 0)) {
+		fclose(fp);
+		printf("ThermalReader: invalid header %s\n", filename);
+		return false;
+	}
+	_fp = fp;
+
+	if (!LoadIndex())
+		RebuildIndex();
+
+	_frame.assign(_header.width * _header.height, 0);
+	_telemetry.assign(THERMAL_TELEMETRY_SIZE, 0);
+	_planes.resize(THERMAL_TELEMETRY_SIZE + _header.width * _header.height * 2);
+	_current = -1;
+
+	return true;
+}
+
+void ThermalReader::Close()
+{
+	if (_fp != NULL) {
+		fclose(_fp);
+		_fp = NULL;
+	}
+	_index.clear();
+	_frameCount = 0;
+	_end = 0;
+	_current = -1;
+}
+
+bool ThermalReader::LoadIndex()
+{
+	ThermalFileFooter footer;
+	uint64_t size;
+
+	if (_fseeki64(_fp, 0, SEEK_END) != 0)
+		return false;
+	size = _ftelli64(_fp);
+	if (size < _header.header_size + sizeof(footer))
+		return false;
+	if (_fseeki64(_fp, -(int64_t)sizeof(footer), SEEK_END) != 0)
+		return false;
+	if (fread(&footer, sizeof(footer), 1, _fp) != 1)
+		return false;
+	if (memcmp(footer.magic, THERMAL_FOOTER_MAGIC, sizeof(footer.magic)) != 0)
+		return false;
+
+	// 索引はフレームの後ろからフッターの直前までにちょうど収まっていること
+	if ((footer.index_offset < _header.header_size)
+		|| (footer.index_offset > size - sizeof(footer))
+		|| (footer.index_count != (size - sizeof(footer) - footer.index_offset) / sizeof(ThermalIndexEntry))
+		|| ((size - sizeof(footer) - footer.index_offset) % sizeof(ThermalIndexEntry) != 0)
+		|| ((footer.index_count == 0) != (footer.frame_count == 0)))
+		return false;
+
+	_index.resize(footer.index_count);
+	if (footer.index_count > 0) {
+		if ((_fseeki64(_fp, footer.index_offset, SEEK_SET) != 0)
+			|| (fread(&_index[0], sizeof(ThermalIndexEntry), footer.index_count, _fp) != footer.index_count)) {
+			_index.clear();
+			return false;
+		}
+	}
+	// 各キーフレームはフレームの範囲に昇順で並んでいること
+	for (uint32_t i = 0; i < footer.index_count; i++) {
+		const ThermalIndexEntry &entry = _index[i];
+		if ((entry.offset < _header.header_size)
+			|| (entry.offset + sizeof(ThermalFrameHeader) > footer.index_offset)
+			|| (entry.number >= footer.frame_count)
+			|| ((i > 0) && ((entry.offset <= _index[i - 1].offset) || (entry.number <= _index[i - 1].number)))) {
+			_index.clear();
+			return false;
+		}
+	}
+	_frameCount = footer.frame_count;
+	_end = footer.index_offset;
+
+	return true;
+}
+
+bool ThermalReader::RebuildIndex()
+{
+	ThermalFrameHeader header;
+	uint64_t pos = _header.header_size;
+	uint64_t size;
+
+	printf("ThermalReader: no index, scanning frames\n");
+
+	_fseeki64(_fp, 0, SEEK_END);
+	size = _ftelli64(_fp);
+
+	_index.clear();
+	_frameCount = 0;
+	for (;;) {
+		_fseeki64(_fp, pos, SEEK_SET);
+		if (fread(&header, sizeof(header), 1, _fp) != 1)
+			break;
+		// 書きかけのフレームや番号の合わないものは捨てる
+		if ((header.number != _frameCount) || (pos + sizeof(header) + header.size > size))
+			break;
+		if ((_frameCount == 0) && ((header.flags & ThermalFrame::Key) == 0))
+			break;
+
+		if ((header.flags & ThermalFrame::Key) != 0) {
+			ThermalIndexEntry entry;
+			memset(&entry, 0, sizeof(entry));
+			entry.timestamp = header.timestamp;
+			entry.offset = pos;
+			entry.number = header.number;
+			_index.push_back(entry);
+		}
+
+		_frameCount++;
+		pos += sizeof(header) + header.size;
+	}
+	_end = pos;
+
+	return !_index.empty();
+}
+
+bool ThermalReader::Decode(uint64_t pos)
+{
+	ThermalFrameHeader header;
+	int width = _header.width, height = _header.height;
+
+	if ((pos + sizeof(header) > _end) || (_fseeki64(_fp, pos, SEEK_SET) != 0)
+		|| (fread(&header, sizeof(header), 1, _fp) != 1)
+		|| (pos + sizeof(header) + header.size > _end)) {
+		printf("ThermalReader: truncated frame at %llu\n", pos);
+		return false;
+	}
+	// 差分フレームは直前のフレームが復号済みでなければならない
+	bool key = (header.flags & ThermalFrame::Key) != 0;
+	if (!key && ((_current < 0) || (header.number != _current + 1))) {
+		printf("ThermalReader: no reference for frame %lu\n", (unsigned long)header.number);
+		return false;
+	}
+
+	_payload.resize(header.size);
+	if ((header.size > 0) && (fread(&_payload[0], 1, header.size, _fp) != header.size)) {
+		printf("ThermalReader: truncated frame at %llu\n", pos);
+		return false;
+	}
+
+	uLongf length = (uLongf)_planes.size();
+	if ((uncompress(&_planes[0], &length, _payload.data(), header.size) != Z_OK)
+		|| (length != _planes.size())) {
+		printf("ThermalReader: corrupt frame %lu\n", (unsigned long)header.number);
+		_current = -1;
+		return false;
+	}
+
+	memcpy(&_telemetry[0], &_planes[0], THERMAL_TELEMETRY_SIZE);
+
+	const uint8_t *lo = &_planes[THERMAL_TELEMETRY_SIZE];
+	const uint8_t *hi = lo + width * height;
+	for (int y = 0; y < height; y++) {
+		uint16_t *line = &_frame[y * width];
+		if (key) {
+			uint16_t pred = (y > 0) ? line[-width] : 0;
+			for (int x = 0; x < width; x++) {
+				pred = zigzag_decode((uint16_t)(*lo++ | (*hi++ << 8)), pred);
+				line[x] = pred;
+			}
+		}
+		else {
+			for (int x = 0; x < width; x++)
+				line[x] = zigzag_decode((uint16_t)(*lo++ | (*hi++ << 8)), line[x]);
+		}
+	}
+
+	_timestamp = header.timestamp;
+	_current = header.number;
+	_next = pos + sizeof(header) + header.size;
+
+	return true;
+}
+
+bool ThermalReader::ReadFrame(uint32_t number, uint16_t *pixels, uint8_t *telemetry, uint64_t *timestamp)
+{
+	if ((_fp == NULL) || (number >= _frameCount))
+		return false;
+
+	// 続きでなければ手前のキーフレームから復号し直す
+	if ((_current < 0) || (number < _current) || (number > _current + THERMAL_KEYFRAME_INTERVAL)) {
+		const ThermalIndexEntry *key = NULL;
+		for (auto &entry : _index) {
+			if (entry.number > number)
+				break;
+			key = &entry;
+		}
+		if (key == NULL)
+			return false;
+		if ((_current < 0) || (number < _current) || (key->number > _current)) {
+			_current = -1;
+			if (!Decode(key->offset))
+				return false;
+		}
+	}
+
+	while (_current < number) {
+		if (!Decode(_next)) {
+			_current = -1;
+			return false;
+		}
+	}
+
+	if (pixels != NULL)
+		memcpy(pixels, _frame.data(), _frame.size() * sizeof(uint16_t));
+	if (telemetry != NULL)
+		memcpy(telemetry, _telemetry.data(), THERMAL_TELEMETRY_SIZE);
+	if (timestamp != NULL)
+		*timestamp = _timestamp;
+
+	return true;
+}
@@ -0,0 +1,158 @@
+#ifndef _THERMALRECORD_H_
+#define _THERMALRECORD_H_
+
+#include <string>
+#include <vector>
+#include "zlib.h"
+
+#ifdef _MSC_VER
+#pragma pack(push, 1)
+#define __attribute__(x)
+#endif
+
+/*
+ * 熱画像の記録ファイル形式（リトルエンディアン）
+ *
+ *  ThermalFileHeader
+ *  ThermalFrameHeader + 圧縮したペイロード
+ *  ...
+ *  ThermalIndexEntry[]（キーフレームのみ）
+ *  ThermalFileFooter
+ *
+ * ペイロードはテレメトリA、B、Cのパケット（164byte×3）と、14bitの値の予測残差を
+ * 下位バイト、上位バイトの順に面に分けて並べたものをzlibで圧縮する。
+ * キーフレームは左（行の先頭は上）の画素、それ以外は前のフレームの同じ画素から予測する。
+ * 索引はフッターから辿る。フッターが無いファイルは開くときにフレームを走査して作り直す。
+ * 書き込みが追いつかずに捨てたフレームは詰めて記録し、番号は連続のまま時刻が飛ぶ。
+ */
+#define THERMAL_FILE_MAGIC			"PCTH"
+#define THERMAL_FOOTER_MAGIC		"PCTI"
+#define THERMAL_FILE_VERSION		(1)
+/* キーフレームの間隔（ランダムアクセスで復号するフレーム数の上限） */
+#define THERMAL_KEYFRAME_INTERVAL	(32)
+#define THERMAL_TELEMETRY_ROW_SIZE	(164)
+#define THERMAL_TELEMETRY_SIZE		(3 * THERMAL_TELEMETRY_ROW_SIZE)
+
+class ThermalFrame
+{
+public:
+	enum T {
+		Key = 0x01,			// 前のフレームを参照しない
+		Telemetry = 0x02,	// テレメトリが有効
+	};
+};
+
+struct ThermalFileHeader {
+	char magic[4];
+	uint16_t version;
+	uint16_t header_size;
+	uint16_t width;
+	uint16_t height;
+	uint16_t bits;				// 画素の有効ビット数
+	uint16_t keyframe_interval;
+	int64_t start_time;			// 記録開始時刻（time_t）
+} __attribute__((packed));
+
+struct ThermalFrameHeader {
+	uint8_t flags;				// ThermalFrame::T
+	uint8_t reserved[3];
+	uint32_t size;				// 圧縮したペイロードのバイト数
+	uint32_t number;			// フレーム番号（0から）
+	uint32_t reserved2;
+	uint64_t timestamp;			// 記録開始からの経過時間[us]
+} __attribute__((packed));
+
+struct ThermalIndexEntry {
+	uint64_t timestamp;
+	uint64_t offset;			// フレームヘッダーのファイル位置
+	uint32_t number;
+	uint32_t reserved;
+} __attribute__((packed));
+
+struct ThermalFileFooter {
+	uint64_t index_offset;
+	uint32_t index_count;
+	uint32_t frame_count;
+	char magic[4];
+} __attribute__((packed));
+
+#ifdef _MSC_VER
+#pragma pack(pop)
+#endif
+
+class StorageTask;
+
+/*
+ * 熱画像の記録
+ * 圧縮はLeptonのスレッドで行い、書き込みはStorageTaskに任せる。
+ */
+class ThermalRecorder
+{
+public:
+	ThermalRecorder();
+	virtual ~ThermalRecorder();
+private:
+	rtos::Mutex _mutex;
+	StorageTask *_storage;
+	int _file;
+	int _width;
+	int _height;
+	us_timestamp_t _origin;
+	uint64_t _offset;
+	uint32_t _number;
+	bool _needKey;				// 前のフレームが書けなかった
+	std::vector<ThermalIndexEntry> _index;
+	std::vector<uint16_t> _previous;
+	std::vector<uint8_t> _planes;
+	z_stream _zs;
+	bool _zsReady;
+	uint32_t _keyFrames;
+	uint32_t _dropped;
+	uint64_t _rawBytes;
+	uint64_t _codedBytes;
+	us_timestamp_t _encodeTime;
+	us_timestamp_t _encodeMax;
+public:
+	bool IsRecording() { return _file >= 0; }
+	bool Open(StorageTask *storage, const char *filename, int width, int height);
+	void Close();
+	/* strideは画素単位（負なら下から上） */
+	void WriteFrame(const uint16_t *pixels, int width, int height, int stride, const uint8_t *telemetry);
+	void PrintStats();
+};
+
+class ThermalReader
+{
+public:
+	ThermalReader();
+	virtual ~ThermalReader();
+private:
+	FILE *_fp;
+	ThermalFileHeader _header;
+	std::vector<ThermalIndexEntry> _index;
+	uint32_t _frameCount;
+	uint64_t _end;
+	std::vector<uint16_t> _frame;		// 最後に復号したフレーム
+	std::vector<uint8_t> _telemetry;
+	uint64_t _timestamp;
+	int64_t _current;					// 最後に復号したフレーム番号
+	uint64_t _next;						// 次のフレームの位置
+	std::vector<uint8_t> _payload;
+	std::vector<uint8_t> _planes;
+	bool LoadIndex();
+	bool RebuildIndex();
+	bool Decode(uint64_t pos);
+public:
+	bool IsOpen() { return _fp != NULL; }
+	bool Open(const char *filename);
+	void Close();
+	int GetWidth() { return _header.width; }
+	int GetHeight() { return _header.height; }
+	uint32_t GetFrameCount() { return _frameCount; }
+	/* pixelsは幅×高さ、telemetryはTHERMAL_TELEMETRY_SIZE（NULLなら返さない） */
+	bool ReadFrame(uint32_t number, uint16_t *pixels, uint8_t *telemetry, uint64_t *timestamp);
+};
+
+extern ThermalRecorder thermalRecorder;
+
+#endif // _THERMALRECORD_H_
@@ -0,0 +1,421 @@
+#include "mbed.h"
+#include "UploadQueue.h"
+
+static void format_add(char *record, size_t size, const UploadQueue::job_t &job)
+{
+	snprintf(record, size, "+ %lu %lu %s %s", (unsigned long)job.id, (unsigned long)job.size,
+		job.dest.c_str(), job.filename.c_str());
+}
+
+static void format_done(char *record, size_t size, uint32_t id)
+{
+	snprintf(record, size, "- %lu", (unsigned long)id);
+}
+
+static uint8_t checksum(const char *pos, const char *end)
+{
+	uint8_t sum = 0;
+
+	while (pos < end)
+		sum ^= (uint8_t)*pos++;
+
+	return sum;
+}
+
+UploadQueue::UploadQueue() :
+	_jobs(),
+	_dests(),
+	_nextId(1),
+	_pendingBytes(0),
+	_journalDone(0),
+	_journalErrors(0),
+	_uploaded(0),
+	_uploadedBytes(0),
+	_failed(0),
+	_abandoned(0),
+	_lastBytes(0),
+	_lastElapse(0)
+{
+}
+
+UploadQueue::~UploadQueue()
+{
+}
+
+UploadQueue::dest_t *UploadQueue::GetDest(const std::string &name)
+{
+	for (auto &dest : _dests) {
+		if (dest.name == name)
+			return &dest;
+	}
+
+	dest_t dest;
+	dest.name = name;
+	dest.failures = 0;
+	dest.next = 0;
+	_dests.push_back(dest);
+
+	return &_dests.back();
+}
+
+bool UploadQueue::WriteRecord(FILE *fp, const char *record)
+{
+	// 行の末尾にNMEAと同じ形式でチェックサムを付ける
+	return fprintf(fp, "%s*%02X\n", record, checksum(record, record + strlen(record))) > 0;
+}
+
+bool UploadQueue::AppendRecord(const char *record)
+{
+	FILE *fp = fopen(UPLOAD_JOURNAL_FILE, "ab");
+	bool result = (fp != NULL);
+
+	// 閉じるまでFATに書かれないので1行ごとに閉じる
+	if (result) {
+		result = WriteRecord(fp, record);
+		if (fclose(fp) != 0)
+			result = false;
+	}
+	if (!result)
+		_journalErrors++;
+
+	return result;
+}
+
+bool UploadQueue::ParseRecord(char *line)
+{
+	char *end = strrchr(line, '*');
+	unsigned int sum;
+	unsigned long id, size;
+	char dest[64];
+	int pos = 0;
+
+	// 書きかけの行は改行かチェックサムが合わない
+	if ((end == NULL) || (strlen(end) != 4) || (end[3] != '\n')
+		|| (sscanf(end + 1, "%2x", &sum) != 1) || (sum != checksum(line, end)))
+		return false;
+	*end = '\0';
+
+	switch (line[0]) {
+	case '+': {
+		if ((sscanf(line, "+ %lu %lu %63s %n", &id, &size, dest, &pos) != 3) || (line[pos] == '\0'))
+			return false;
+		// 同じ番号がもう入っていれば二重に送らない
+		for (auto &queued : _jobs) {
+			if (queued.id == (uint32_t)id)
+				return true;
+		}
+		job_t job;
+		job.id = (uint32_t)id;
+		job.dest = dest;
+		job.filename = &line[pos];
+		job.size = (uint32_t)size;
+		job.attempts = 0;
+		_jobs.push_back(job);
+		_pendingBytes += job.size;
+		break;
+	}
+	case '-':
+		if (sscanf(line, "- %lu", &id) != 1)
+			return false;
+		for (auto it = _jobs.begin(); it != _jobs.end(); ++it) {
+			if (it->id == id) {
+				Remove(it);
+				break;
+			}
+		}
+		_journalDone++;
+		break;
+	default:
+		return false;
+	}
+
+	if (_nextId <= id)
+		_nextId = (uint32_t)id + 1;
+
+	return true;
+}
+
+void UploadQueue::Compact()
+{
+	char record[320];
+	FILE *fp = fopen(UPLOAD_JOURNAL_TEMP, "wb");
+	bool result = (fp != NULL);
+
+	if (result) {
+		for (auto &job : _jobs) {
+			format_add(record, sizeof(record), job);
+			if (!WriteRecord(fp, record)) {
+				result = false;
+				break;
+			}
+		}
+		if (fclose(fp) != 0)
+			result = false;
+	}
+	// 書き終わってから入れ替える（元を消したあとで止まってもLoadで拾える）
+	if (result) {
+		remove(UPLOAD_JOURNAL_FILE);
+		result = (rename(UPLOAD_JOURNAL_TEMP, UPLOAD_JOURNAL_FILE) == 0);
+	}
+
+	if (result) {
+		_journalDone = 0;
+	}
+	else {
+		_journalErrors++;
+		remove(UPLOAD_JOURNAL_TEMP);
+	}
+}
+
+void UploadQueue::Remove(std::list<job_t>::iterator it)
+{
+	_pendingBytes -= it->size;
+	_jobs.erase(it);
+}
+
+void UploadQueue::Done(std::list<job_t>::iterator it, bool uploaded)
+{
+	char record[32];
+
+	if (uploaded) {
+		_uploaded++;
+		_uploadedBytes += it->size;
+	}
+	else {
+		_abandoned++;
+	}
+
+	format_done(record, sizeof(record), it->id);
+	AppendRecord(record);
+	_journalDone++;
+	Remove(it);
+
+	if ((_journalDone >= UPLOAD_JOURNAL_COMPACT) && (_journalDone > (int)_jobs.size()))
+		Compact();
+}
+
+void UploadQueue::Load()
+{
+	char line[320];
+	int skipped = 0;
+	FILE *fp;
+
+	_mutex.lock();
+	fp = fopen(UPLOAD_JOURNAL_FILE, "rb");
+	if (fp == NULL) {
+		// 詰め直しで元の記録を消したところで止まった
+		if (rename(UPLOAD_JOURNAL_TEMP, UPLOAD_JOURNAL_FILE) == 0)
+			fp = fopen(UPLOAD_JOURNAL_FILE, "rb");
+	}
+	else {
+		// 書きかけの詰め直しは捨てる
+		remove(UPLOAD_JOURNAL_TEMP);
+	}
+
+	if (fp != NULL) {
+		while (fgets(line, sizeof(line), fp) != NULL) {
+			if (!ParseRecord(line))
+				skipped++;
+		}
+		fclose(fp);
+
+		// 消されたファイルは送らない
+		for (auto it = _jobs.begin(); it != _jobs.end(); ) {
+			auto next = std::next(it);
+			FILE *file = fopen(it->filename.c_str(), "rb");
+			if (file == NULL) {
+				Remove(it);
+				skipped++;
+			}
+			else {
+				fclose(file);
+			}
+			it = next;
+		}
+
+		if ((_journalDone > 0) || (skipped > 0))
+			Compact();
+	}
+	_mutex.unlock();
+
+	printf("UploadQueue::Load %d files, %llu bytes (%d skipped)\r\n",
+		GetCount(), GetPendingBytes(), skipped);
+}
+
+void UploadQueue::Push(const std::string &dest, const std::string &filename, uint32_t size)
+{
+	char record[320];
+	job_t job;
+
+	_mutex.lock();
+	job.id = _nextId++;
+	job.dest = dest;
+	job.filename = filename;
+	job.size = size;
+	job.attempts = 0;
+	format_add(record, sizeof(record), job);
+	AppendRecord(record);
+	_jobs.push_back(job);
+	_pendingBytes += size;
+	_mutex.unlock();
+}
+
+bool UploadQueue::GetBatch(std::string &dest, std::list<job_t> &batch)
+{
+	us_timestamp_t now = ticker_read_us(get_us_ticker_data());
+	bool result = false;
+
+	_mutex.lock();
+	for (auto &job : _jobs) {
+		if (!result) {
+			if (GetDest(job.dest)->next > now)
+				continue;
+			dest = job.dest;
+			result = true;
+		}
+		else if (job.dest != dest) {
+			continue;
+		}
+		batch.push_back(job);
+		if (batch.size() >= UPLOAD_BATCH_MAX)
+			break;
+	}
+	_mutex.unlock();
+
+	return result;
+}
+
+void UploadQueue::Complete(uint32_t id, bool uploaded)
+{
+	_mutex.lock();
+	for (auto it = _jobs.begin(); it != _jobs.end(); ++it) {
+		if (it->id == id) {
+			Done(it, uploaded);
+			break;
+		}
+	}
+	_mutex.unlock();
+}
+
+void UploadQueue::Reject(uint32_t id)
+{
+	_mutex.lock();
+	_failed++;
+	for (auto it = _jobs.begin(); it != _jobs.end(); ++it) {
+		if (it->id != id)
+			continue;
+		it->attempts++;
+		if (it->attempts >= UPLOAD_ATTEMPT_MAX)
+			Done(it, false);
+		else
+			_jobs.splice(_jobs.end(), _jobs, it);
+		break;
+	}
+	_mutex.unlock();
+}
+
+void UploadQueue::Succeeded(const std::string &dest, uint32_t bytes, us_timestamp_t elapse)
+{
+	_mutex.lock();
+	dest_t *entry = GetDest(dest);
+	entry->failures = 0;
+	entry->next = 0;
+	if (bytes > 0) {
+		_lastBytes = bytes;
+		_lastElapse = elapse;
+	}
+	_mutex.unlock();
+}
+
+void UploadQueue::Failed(const std::string &dest)
+{
+	us_timestamp_t now = ticker_read_us(get_us_ticker_data());
+
+	_mutex.lock();
+	_failed++;
+	dest_t *entry = GetDest(dest);
+	entry->failures++;
+	// 下限から倍々に延ばし、半分から全部の間でゆらがせる
+	uint32_t backoff = UPLOAD_BACKOFF_MAX;
+	if (entry->failures <= 16) {
+		backoff = (uint32_t)UPLOAD_BACKOFF_MIN << (entry->failures - 1);
+		if (backoff > UPLOAD_BACKOFF_MAX)
+			backoff = UPLOAD_BACKOFF_MAX;
+	}
+	backoff = backoff / 2 + (uint32_t)rand() % (backoff / 2 + 1);
+	entry->next = now + (us_timestamp_t)backoff * 1000;
+	_mutex.unlock();
+}
+
+void UploadQueue::ResetBackoff()
+{
+	_mutex.lock();
+	for (auto &dest : _dests) {
+		dest.failures = 0;
+		dest.next = 0;
+	}
+	_mutex.unlock();
+}
+
+int UploadQueue::GetWaitTime()
+{
+	us_timestamp_t now = ticker_read_us(get_us_ticker_data());
+	int wait = osWaitForever;
+
+	_mutex.lock();
+	for (auto &job : _jobs) {
+		us_timestamp_t next = GetDest(job.dest)->next;
+		if (next <= now) {
+			wait = 0;
+			break;
+		}
+		int temp = (int)((next - now + 999) / 1000);
+		if ((wait == osWaitForever) || (wait > temp))
+			wait = temp;
+	}
+	_mutex.unlock();
+
+	return wait;
+}
+
+int UploadQueue::GetCount()
+{
+	int count;
+
+	_mutex.lock();
+	count = (int)_jobs.size();
+	_mutex.unlock();
+
+	return count;
+}
+
+uint64_t UploadQueue::GetPendingBytes()
+{
+	uint64_t bytes;
+
+	_mutex.lock();
+	bytes = _pendingBytes;
+	_mutex.unlock();
+
+	return bytes;
+}
+
+void UploadQueue::PrintStats()
+{
+	us_timestamp_t now = ticker_read_us(get_us_ticker_data());
+
+	_mutex.lock();
+	printf("pending %d files, %llu bytes\n", (int)_jobs.size(), _pendingBytes);
+	printf("uploaded %lu files, %llu bytes, failed %lu, abandoned %lu\n",
+		_uploaded, _uploadedBytes, _failed, _abandoned);
+	printf("journal %d done records, %lu errors\n", _journalDone, _journalErrors);
+	if (_lastElapse > 0) {
+		printf("last batch %lu bytes in %.2f s (%.1f KB/s)\n", _lastBytes,
+			_lastElapse / 1000000.0, _lastBytes * 1000000.0 / 1024.0 / _lastElapse);
+	}
+	for (auto &dest : _dests) {
+		printf("%-16s failures %d, wait %lu ms\n", dest.name.c_str(), dest.failures,
+			(dest.next > now) ? (unsigned long)((dest.next - now) / 1000) : 0UL);
+	}
+	_mutex.unlock();
+}
@@ -0,0 +1,89 @@
+#ifndef _UPLOADQUEUE_H_
+#define _UPLOADQUEUE_H_
+
+#include <string>
+#include <list>
+
+/* アップロード待ちの記録（追記のみ） */
+#define UPLOAD_JOURNAL_FILE		".\\upload.log"
+/* 詰め直しの書き出し先（書き終わってから記録と入れ替える） */
+#define UPLOAD_JOURNAL_TEMP		".\\upload.new"
+/* 完了の記録がこれ以上で、残りの件数より多ければ詰め直す */
+#define UPLOAD_JOURNAL_COMPACT	(64)
+/* 1回の接続で続けて送る件数 */
+#define UPLOAD_BATCH_MAX		(8)
+/* 同じファイルを送り直す回数の上限（超えたら諦める） */
+#define UPLOAD_ATTEMPT_MAX		(8)
+/* 送れなかったときの待ち時間の下限と上限[ms] */
+#define UPLOAD_BACKOFF_MIN		(5 * 1000)
+#define UPLOAD_BACKOFF_MAX		(10 * 60 * 1000)
+
+/*
+ * アップロード待ちのキュー
+ *
+ * 追加と完了を1行ずつ記録ファイルに追記し（1行ごとに閉じる）、起動時に読み直す。
+ * 途中で電源が切れて壊れた行はチェックサムで読み飛ばす。
+ * 送り先ごとにまとめて取り出し、送れなかった送り先は指数的に待ち時間を延ばす（ゆらぎ付き）。
+ */
+class UploadQueue
+{
+public:
+	UploadQueue();
+	virtual ~UploadQueue();
+public:
+	struct job_t {
+		uint32_t id;
+		std::string dest;			// 送り先のホスト名
+		std::string filename;
+		uint32_t size;
+		int attempts;
+	};
+private:
+	struct dest_t {
+		std::string name;
+		int failures;				// 続けて送れなかった回数
+		us_timestamp_t next;		// 次に送ってよい時刻
+	};
+	rtos::Mutex _mutex;
+	std::list<job_t> _jobs;
+	std::list<dest_t> _dests;
+	uint32_t _nextId;
+	uint64_t _pendingBytes;
+	int _journalDone;				// 記録ファイルにある完了の行数
+	uint32_t _journalErrors;
+	uint32_t _uploaded;
+	uint64_t _uploadedBytes;
+	uint32_t _failed;
+	uint32_t _abandoned;
+	uint32_t _lastBytes;			// 最後にまとめて送った量と時間
+	us_timestamp_t _lastElapse;
+	dest_t *GetDest(const std::string &name);
+	bool WriteRecord(FILE *fp, const char *record);
+	bool AppendRecord(const char *record);
+	bool ParseRecord(char *line);
+	void Compact();
+	void Remove(std::list<job_t>::iterator it);
+	void Done(std::list<job_t>::iterator it, bool uploaded);
+public:
+	/* 記録ファイルを読み直す（起動時に1回、Pushが呼ばれる前に） */
+	void Load();
+	void Push(const std::string &dest, const std::string &filename, uint32_t size);
+	/* 送ってよい送り先の先頭からUPLOAD_BATCH_MAX件を写して返す（キューには残す） */
+	bool GetBatch(std::string &dest, std::list<job_t> &batch);
+	/* 送り終わった、または送れないことが分かった */
+	void Complete(uint32_t id, bool uploaded);
+	/* サーバーに断られたので後回しにする */
+	void Reject(uint32_t id);
+	/* 送り先ごとの結果 */
+	void Succeeded(const std::string &dest, uint32_t bytes, us_timestamp_t elapse);
+	void Failed(const std::string &dest);
+	/* 接続し直したときは待たずに送る */
+	void ResetBackoff();
+	/* 次に送れるまでの時間[ms]、空ならosWaitForever */
+	int GetWaitTime();
+	int GetCount();
+	uint64_t GetPendingBytes();
+	void PrintStats();
+};
+
+#endif // _UPLOADQUEUE_H_
@@ -0,0 +1,379 @@
+#include "mbed.h"
+#include "opencv.hpp"
+#include "ImageReaderSource.h"
+#include "camera_if.hpp"
+#include "FrameBus.h"
+#include "ZXingCorpus.h"
+#include "ZXingScheduler.h"
+#include <zxing/common/DecodeProfile.h>
+#include <map>
+
+using namespace zxing;
+
+/* 1枚を何回デコードして一番速かった時間を使うか */
+#define CORPUS_REPEAT		(5)
+/* 基準からこれ以上変わった時間を速くなった・遅くなったとする[%] */
+#define CORPUS_TIME_MARGIN	(10)
+
+struct CorpusEntry {
+	std::string file;
+	std::string format;			// -はコードの無い画像
+	std::string hintNames;		// ,を+にしたもの（CSVに書くため）
+	uint32_t hints;
+	std::string text;
+};
+
+struct CorpusResult {
+	bool ok;
+	us_timestamp_t time;		// 一番速かった1回
+	uint32_t objects;			// 以下はデコード1回あたり（Arrayを含むCountedの数で、ヒープ確保の全てではない）
+	uint32_t retains;
+	unsigned long long stages[DecodeProfile::STAGE_COUNT];
+};
+
+struct CorpusBaseline {
+	bool ok;
+	unsigned long time;
+	unsigned long objects;
+};
+
+static unsigned long long ProfileClock()
+{
+	return ticker_read_us(get_us_ticker_data());
+}
+
+/* *posから区切り文字で区切った次の語を返す（strtok_rはWindowsに無い） */
+static char *NextToken(char **pos, const char *delims)
+{
+	char *token = *pos + strspn(*pos, delims);
+	if (*token == '\0')
+		return NULL;
+	char *end = token + strcspn(token, delims);
+	*pos = end;
+	if (*end != '\0') {
+		*end = '\0';
+		*pos = end + 1;
+	}
+	return token;
+}
+
+static bool ParseEntry(char *line, CorpusEntry &entry)
+{
+	char *end = line + strlen(line);
+	while ((end > line) && ((end[-1] == '\n') || (end[-1] == '\r')))
+		*--end = '\0';
+
+	char *pos = line;
+	char *file = NextToken(&pos, " \t");
+	if ((file == NULL) || (file[0] == '#'))
+		return false;
+	char *format = NextToken(&pos, " \t");
+	char *hints = NextToken(&pos, " \t");
+	if ((format == NULL) || (hints == NULL)) {
+		printf("skip %s: no format or hints\n", file);
+		return false;
+	}
+	// 期待する文字列は空白を含めて行の終わりまで
+	char *text = pos + strspn(pos, " \t");
+
+	entry.file = file;
+	entry.format = format;
+	entry.text = text;
+	entry.hints = 0;
+	entry.hintNames.clear();
+
+	pos = hints;
+	for (char *name = NextToken(&pos, ","); name != NULL; name = NextToken(&pos, ",")) {
+		uint32_t bits;
+		if (strcmp(name, "harder") == 0)
+			bits = DecodeHints::TRYHARDER_HINT;
+		else
+			bits = ZXingScheduler::GetFormatHints(name);
+		if (bits == 0) {
+			printf("skip %s: unknown format %s\n", file, name);
+			return false;
+		}
+		entry.hints |= bits;
+		if (!entry.hintNames.empty())
+			entry.hintNames += "+";
+		entry.hintNames += name;
+	}
+	return entry.hints != 0;
+}
+
+static bool EndsWith(const std::string &str, const char *suffix)
+{
+	size_t len = strlen(suffix);
+	return (str.size() >= len) && (str.compare(str.size() - len, len, suffix) == 0);
+}
+
+/*
+ * 画像を読み込んでグレースケールにする
+ * フレームバッファのダンプはカメラと同じようにFrameBusを通す
+ */
+static bool LoadImage(const std::string &path, FrameBus *bus, FrameSubscriber *sub,
+	std::vector<uint8_t> &gray, int &width, int &height)
+{
+	bool yuv = EndsWith(path, ".yuv");
+	if (yuv || EndsWith(path, ".rgb565")) {
+		FILE *fp = fopen(path.c_str(), "rb");
+		if (fp == NULL)
+			return false;
+		std::vector<uint8_t> data;
+		uint8_t buf[1024];
+		size_t len;
+		while ((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+			data.insert(data.end(), buf, buf + len);
+		fclose(fp);
+
+		int lines = data.size() / FRAME_BUFFER_STRIDE;
+		if (lines == 0)
+			return false;
+		bus->Publish(&data[0], VIDEO_PIXEL_HW, lines, FRAME_BUFFER_STRIDE,
+			yuv ? StreamVideoFormat::YCbCr422 : StreamVideoFormat::RGB565);
+		const FrameView *frame = bus->Acquire(sub);
+		if (frame == NULL)
+			return false;
+		width = frame->GetWidth();
+		height = frame->GetHeight();
+		gray.assign(frame->GetGray(), frame->GetGray() + width * height);
+		bus->Release(frame);
+		return true;
+	}
+
+	cv::Mat mat = cv::imread(path, cv::IMREAD_GRAYSCALE);
+	if (mat.empty())
+		return false;
+	width = mat.cols;
+	height = mat.rows;
+	gray.resize(width * height);
+	for (int y = 0; y < height; y++)
+		memcpy(&gray[y * width], mat.ptr(y), width);
+	return true;
+}
+
+static bool Matches(const CorpusEntry &entry, vector<Ref<Result> > &results)
+{
+	if (entry.format == "-")
+		return results.empty();
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const char *format = BarcodeFormat::barcodeFormatNames[results[i]->getBarcodeFormat()];
+		if ((entry.format == format) && (entry.text == results[i]->getText()->getText()))
+			return true;
+	}
+	return false;
+}
+
+static void DecodeEntry(const CorpusEntry &entry, const std::vector<uint8_t> &gray, int width, int height,
+	ZXingBinarizer::T binarizer, CorpusResult &result)
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+
+	result.ok = true;
+	result.time = 0;
+	DecodeProfile::reset();
+	RefStats before = Counted::getStats();
+
+	for (int i = 0; i < CORPUS_REPEAT; i++) {
+		vector<Ref<Result> > results;
+		DecodeHints hints(entry.hints);
+		us_timestamp_t start = ticker_read_us(ticker);
+		{
+			// どの段階にも入らない時間（リーダーの処理など）をotherに数える
+			DecodeProfile::Scope scope(DecodeProfile::OTHER);
+			ex_decode_gray(&gray[0], width, height, &results, hints, binarizer);
+		}
+		us_timestamp_t time = ticker_read_us(ticker) - start;
+		if ((i == 0) || (time < result.time))
+			result.time = time;
+		// 1回でも違えば失敗にする（同じ画像なので普通は毎回同じ）
+		if (!Matches(entry, results))
+			result.ok = false;
+	}
+
+	RefStats after = Counted::getStats();
+	result.objects = (after.objects - before.objects) / CORPUS_REPEAT;
+	result.retains = (after.retains - before.retains) / CORPUS_REPEAT;
+	for (int s = 0; s < DecodeProfile::STAGE_COUNT; s++)
+		result.stages[s] = DecodeProfile::getTime((DecodeProfile::Stage)s) / CORPUS_REPEAT;
+}
+
+static void LoadBaseline(const char *filename, std::map<std::string, CorpusBaseline> &baseline)
+{
+	FILE *fp = fopen(filename, "r");
+	if (fp == NULL) {
+		printf("cannot open %s\n", filename);
+		return;
+	}
+
+	char line[512], file[256], hints[128];
+	int ok;
+	CorpusBaseline base;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		// 見出しの行は数値が読めないので飛ばされる
+		if (sscanf(line, "%255[^,],%127[^,],%d,%lu,%lu", file, hints, &ok, &base.time, &base.objects) != 5)
+			continue;
+		base.ok = ok != 0;
+		baseline[std::string(file) + "," + hints] = base;
+	}
+	fclose(fp);
+}
+
+static const char *CompareResult(const CorpusBaseline &base, const CorpusResult &result)
+{
+	if (base.ok != result.ok)
+		return result.ok ? "fixed" : "broken";
+	if (result.time * 100 > base.time * (100 + CORPUS_TIME_MARGIN))
+		return "slower";
+	if (result.time * 100 < base.time * (100 - CORPUS_TIME_MARGIN))
+		return "faster";
+	return "same";
+}
+
+void ZXingCorpusBench(const char *list, ZXingBinarizer::T binarizer, const char *save, const char *baseline)
+{
+	FILE *fp = fopen(list, "r");
+	if (fp == NULL) {
+		printf("cannot open %s\n", list);
+		return;
+	}
+
+	// 画像のファイル名は一覧のあるフォルダから
+	std::string dir(list);
+	size_t sep = dir.find_last_of("/\\");
+	dir = (sep == std::string::npos) ? "" : dir.substr(0, sep + 1);
+
+	std::vector<CorpusEntry> entries;
+	char line[512];
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		CorpusEntry entry;
+		if (ParseEntry(line, entry))
+			entries.push_back(entry);
+	}
+	fclose(fp);
+
+	std::map<std::string, CorpusBaseline> bases;
+	if (baseline != NULL)
+		LoadBaseline(baseline, bases);
+
+	FrameBus *bus = new FrameBus();
+	FrameSubscriber sub("corpus");
+	bus->Subscribe(&sub);
+	DecodeProfile::setClock(ProfileClock);
+
+	std::vector<CorpusResult> results(entries.size());
+	std::vector<bool> loaded(entries.size(), false);
+	// 形式と探す形式ごとの[成功, 枚数]
+	std::map<std::string, std::pair<uint32_t, uint32_t> > groups;
+	unsigned long long stages[DecodeProfile::STAGE_COUNT] = { 0 };
+	us_timestamp_t total = 0;
+	uint32_t images = 0, decoded = 0;
+
+	printf("binarizer %s, best of %d\n", ZXingBinarizer::GetName(binarizer), CORPUS_REPEAT);
+	printf("file,format,hints,ok,us,objects,retains,stage\n");
+	for (size_t i = 0; i < entries.size(); i++) {
+		const CorpusEntry &entry = entries[i];
+		std::vector<uint8_t> gray;
+		int width, height;
+		if (!LoadImage(dir + entry.file, bus, &sub, gray, width, height)) {
+			printf("cannot load %s\n", entry.file.c_str());
+			continue;
+		}
+
+		CorpusResult &result = results[i];
+		DecodeEntry(entry, gray, width, height, binarizer, result);
+		loaded[i] = true;
+
+		int top = 0;
+		for (int s = 0; s < DecodeProfile::STAGE_COUNT; s++) {
+			stages[s] += result.stages[s];
+			if (result.stages[s] > result.stages[top])
+				top = s;
+		}
+		images++;
+		if (result.ok)
+			decoded++;
+		total += result.time;
+		std::pair<uint32_t, uint32_t> &group = groups[entry.format + " " + entry.hintNames];
+		if (result.ok)
+			group.first++;
+		group.second++;
+
+		printf("%s,%s,%s,%d,%lu,%lu,%lu,%s\n", entry.file.c_str(), entry.format.c_str(), entry.hintNames.c_str(),
+			result.ok ? 1 : 0, (uint32_t)result.time, result.objects, result.retains,
+			DecodeProfile::getStageName((DecodeProfile::Stage)top));
+	}
+
+	DecodeProfile::setClock(NULL);
+	delete bus;
+
+	if (images == 0) {
+		printf("no images\n");
+		return;
+	}
+
+	printf("images %lu, decoded %lu (%lu%%), %.3fms/image, %.1f frames/s\n", images, decoded,
+		decoded * 100 / images, total / (images * 1000.0), total == 0 ? 0.0 : images * 1000000.0 / total);
+	for (std::map<std::string, std::pair<uint32_t, uint32_t> >::iterator it = groups.begin(); it != groups.end(); ++it)
+		printf("%s: %lu/%lu\n", it->first.c_str(), it->second.first, it->second.second);
+	if (!Counted::hasStats())
+		printf("objects/retains (Counted objects, not all heap allocations) need ZXING_REF_STATS\n");
+
+	unsigned long long staged = 0;
+	for (int s = 0; s < DecodeProfile::STAGE_COUNT; s++)
+		staged += stages[s];
+	for (int s = 0; s < DecodeProfile::STAGE_COUNT; s++) {
+		printf("%s %.3fms/image (%llu%%)\n", DecodeProfile::getStageName((DecodeProfile::Stage)s),
+			stages[s] / (images * 1000.0), staged == 0 ? 0 : stages[s] * 100 / staged);
+	}
+
+	if (save != NULL) {
+		FILE *out = fopen(save, "w");
+		if (out == NULL) {
+			printf("cannot open %s\n", save);
+		}
+		else {
+			fprintf(out, "file,hints,ok,us,objects\n");
+			for (size_t i = 0; i < entries.size(); i++) {
+				if (!loaded[i])
+					continue;
+				fprintf(out, "%s,%s,%d,%lu,%lu\n", entries[i].file.c_str(), entries[i].hintNames.c_str(),
+					results[i].ok ? 1 : 0, (uint32_t)results[i].time, results[i].objects);
+			}
+			fclose(out);
+		}
+	}
+
+	if (baseline != NULL) {
+		// 基準にもある画像だけで合計を比べる
+		us_timestamp_t base_total = 0, cur_total = 0;
+		uint32_t base_decoded = 0, cur_decoded = 0, broken = 0;
+		printf("cmp,file,hints,base_ok,ok,base_us,us,result\n");
+		for (size_t i = 0; i < entries.size(); i++) {
+			if (!loaded[i])
+				continue;
+			const CorpusResult &result = results[i];
+			std::map<std::string, CorpusBaseline>::iterator it = bases.find(entries[i].file + "," + entries[i].hintNames);
+			if (it == bases.end()) {
+				printf("cmp,%s,%s,,%d,,%lu,new\n", entries[i].file.c_str(), entries[i].hintNames.c_str(),
+					result.ok ? 1 : 0, (uint32_t)result.time);
+				continue;
+			}
+			const CorpusBaseline &base = it->second;
+			const char *status = CompareResult(base, result);
+			if (strcmp(status, "broken") == 0)
+				broken++;
+			base_total += base.time;
+			cur_total += result.time;
+			if (base.ok)
+				base_decoded++;
+			if (result.ok)
+				cur_decoded++;
+			printf("cmp,%s,%s,%d,%d,%lu,%lu,%s\n", entries[i].file.c_str(), entries[i].hintNames.c_str(),
+				base.ok ? 1 : 0, result.ok ? 1 : 0, base.time, (uint32_t)result.time, status);
+		}
+		printf("cmp,total,,%lu,%lu,%lu,%lu,%s\n", base_decoded, cur_decoded, (uint32_t)base_total, (uint32_t)cur_total,
+			broken > 0 ? "broken" : "ok");
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef _ZXINGCORPUS_H_
+#define _ZXINGCORPUS_H_
+
+#include "ZXingBinarizer.h"
+
+/*
+ * 画像の一覧（コーパス）を全てデコードして、読めたかと時間を調べる
+ *
+ * 一覧は1行に1枚で「ファイル 形式 探す形式 期待する文字列」と書く（#で始まる行はコメント）。
+ *   qr_v2.png      QR_CODE      qr           https://example.com/peach
+ *   ean13.jpg      EAN_13       1d,harder    4901234567894
+ *   frame0.yuv     QR_CODE      qr,1d        hello
+ *   empty.png      -            qr           -
+ *  - ファイルは一覧のあるフォルダから探す。.yuvはYCbCr422、.rgb565はRGB565の
+ *    カメラのフレームバッファのダンプ（幅VIDEO_PIXEL_HW、1行FRAME_BUFFER_STRIDEバイト）
+ *  - 形式はBarcodeFormatの名前。-はコードの無い画像で、何も読めなければ成功
+ *  - 探す形式はZXingScheduler::GetFormatHintsの名前を,で区切る。harderでtryHarderにする
+ *  - 期待する文字列は行の終わりまで（空白を含んでよい）
+ *
+ * 画像ごとの結果・時間・参照カウントされたオブジェクト（Countedを継承したもので、Arrayを含む。
+ * std::vectorやstd::stringの確保は数えない）の数、形式と探す形式ごとの成功率、
+ * 段階（二値化・検出・サンプリング・誤り訂正・ビット列）ごとの時間を表示する。
+ * saveに結果を保存し、baselineの結果と比べてCSVで表示する（どちらもNULLでよい）。
+ */
+void ZXingCorpusBench(const char *list, ZXingBinarizer::T binarizer, const char *save, const char *baseline);
+
+#endif // _ZXINGCORPUS_H_
@@ -0,0 +1,418 @@
+#include "mbed.h"
+#include "ZXingScheduler.h"
+#include <zxing/Binarizer.h>
+#include <zxing/BinaryBitmap.h>
+#include <zxing/InvertedLuminanceSource.h>
+#include <zxing/common/GreyscaleLuminanceSource.h>
+#include <zxing/common/GlobalHistogramBinarizer.h>
+#include <zxing/common/HybridBinarizer.h>
+#include <zxing/common/reedsolomon/GenericGF.h>
+#include <zxing/qrcode/QRCodeReader.h>
+#include <zxing/datamatrix/DataMatrixReader.h>
+#include <zxing/aztec/AztecReader.h>
+#include <zxing/pdf417/PDF417Reader.h>
+#include <zxing/oned/MultiFormatOneDReader.h>
+#include <zxing/multi/qrcode/QRCodeMultiReader.h>
+#include <zxing/multi/GenericMultipleBarcodeReader.h>
+#include <zxing/multi/ByQuadrantReader.h>
+
+using namespace zxing;
+using namespace zxing::multi;
+
+/*
+ * 先に作った二値化画像を返す
+ * 1Dの行と切り出し・回転した画像は元の画素から二値化する
+ */
+class SharedBinarizer : public Binarizer
+{
+public:
+	SharedBinarizer(Ref<LuminanceSource> source, Ref<BitMatrix> matrix, ZXingBinarizer::T type) :
+		Binarizer(source), _matrix(matrix), _type(type)
+	{
+	}
+private:
+	Ref<BitMatrix> _matrix;
+	ZXingBinarizer::T _type;
+	Ref<Binarizer> _rows;
+public:
+	int getBlackRow(int y, Ref<BitArray> row, Ref<BitArray> &result) override
+	{
+		if (!_rows)
+			_rows = new GlobalHistogramBinarizer(getLuminanceSource());
+		return _rows->getBlackRow(y, row, result);
+	}
+	int getBlackMatrix(Ref<BitMatrix> &matrix) override
+	{
+		matrix = _matrix;
+		return 0;
+	}
+	Ref<Binarizer> createBinarizer(Ref<LuminanceSource> source) override
+	{
+		if (_type == ZXingBinarizer::Global)
+			return Ref<Binarizer>(new GlobalHistogramBinarizer(source));
+		return Ref<Binarizer>(new HybridBinarizer(source));
+	}
+};
+
+/* 取り出す順（形式ごとに一通り試してから、見つからなかった形式を念入りに） */
+static const struct {
+	ZXingScheduler::Format::T format;
+	ZXingScheduler::Variant::T variant;
+} job_order[] = {
+	{ ZXingScheduler::Format::QRCode, ZXingScheduler::Variant::Normal },
+	{ ZXingScheduler::Format::DataMatrix, ZXingScheduler::Variant::Normal },
+	{ ZXingScheduler::Format::Aztec, ZXingScheduler::Variant::Normal },
+	{ ZXingScheduler::Format::PDF417, ZXingScheduler::Variant::Normal },
+	{ ZXingScheduler::Format::OneD, ZXingScheduler::Variant::Normal },
+	{ ZXingScheduler::Format::QRCode, ZXingScheduler::Variant::Inverted },
+	{ ZXingScheduler::Format::DataMatrix, ZXingScheduler::Variant::Inverted },
+	{ ZXingScheduler::Format::Aztec, ZXingScheduler::Variant::Inverted },
+	{ ZXingScheduler::Format::OneD, ZXingScheduler::Variant::Harder },
+	{ ZXingScheduler::Format::QRCode, ZXingScheduler::Variant::Quadrant },
+	{ ZXingScheduler::Format::DataMatrix, ZXingScheduler::Variant::Quadrant },
+};
+
+ZXingScheduler::ZXingScheduler() :
+	_started(false),
+	_next(0),
+	_running(0),
+	_finished(true),
+	_binarizer(ZXingBinarizer::Global)
+{
+	ResetStats();
+}
+
+ZXingScheduler::~ZXingScheduler()
+{
+	for (size_t i = 0; i < _threads.size(); i++) {
+		_threads[i]->terminate();
+		delete _threads[i];
+	}
+}
+
+void ZXingScheduler::Start()
+{
+	if (_started)
+		return;
+	_started = true;
+
+	// 最初に使った時に作る表をスレッドを始める前に作っておく
+	GenericGF::initializeFields();
+
+	// 計算だけのワーカーはStorageTask（osPriorityBelowNormal）の書き込みを待たせないように一段下げる
+	for (int i = 0; i < ZXING_SCHEDULER_WORKERS; i++) {
+		rtos::Thread *thread = new rtos::Thread(osPriorityLow, ZXING_SCHEDULER_STACK_SIZE, NULL, "ZXingWorker");
+		thread->start(callback(this, &ZXingScheduler::WorkerMain));
+		_threads.push_back(thread);
+	}
+}
+
+void ZXingScheduler::WorkerMain()
+{
+	for (;;) {
+		_ready.wait();
+		RunJobs();
+	}
+}
+
+bool ZXingScheduler::HasFormat(const DecodeHints &hints, Format::T format)
+{
+	switch (format) {
+	case Format::QRCode:
+		return hints.containsFormat(BarcodeFormat::QR_CODE);
+	case Format::DataMatrix:
+		return hints.containsFormat(BarcodeFormat::DATA_MATRIX);
+	case Format::Aztec:
+		return hints.containsFormat(BarcodeFormat::AZTEC);
+	case Format::PDF417:
+		return hints.containsFormat(BarcodeFormat::PDF_417);
+	case Format::OneD:
+		return hints.containsFormat(BarcodeFormat::CODABAR)
+			|| hints.containsFormat(BarcodeFormat::CODE_39)
+			|| hints.containsFormat(BarcodeFormat::CODE_93)
+			|| hints.containsFormat(BarcodeFormat::CODE_128)
+			|| hints.containsFormat(BarcodeFormat::EAN_8)
+			|| hints.containsFormat(BarcodeFormat::EAN_13)
+			|| hints.containsFormat(BarcodeFormat::ITF)
+			|| hints.containsFormat(BarcodeFormat::UPC_A)
+			|| hints.containsFormat(BarcodeFormat::UPC_E);
+	default:
+		return false;
+	}
+}
+
+const char *ZXingScheduler::GetFormatName(Format::T format)
+{
+	switch (format) {
+	case Format::QRCode:
+		return "qr";
+	case Format::DataMatrix:
+		return "datamatrix";
+	case Format::Aztec:
+		return "aztec";
+	case Format::PDF417:
+		return "pdf417";
+	case Format::OneD:
+		return "1d";
+	default:
+		return "?";
+	}
+}
+
+uint32_t ZXingScheduler::GetFormatHints(const char *name)
+{
+	if (strcmp(name, GetFormatName(Format::QRCode)) == 0)
+		return DecodeHints::QR_CODE_HINT;
+	if (strcmp(name, GetFormatName(Format::DataMatrix)) == 0)
+		return DecodeHints::DATA_MATRIX_HINT;
+	if (strcmp(name, GetFormatName(Format::Aztec)) == 0)
+		return DecodeHints::AZTEC_HINT;
+	if (strcmp(name, GetFormatName(Format::PDF417)) == 0)
+		return DecodeHints::PDF_417_HINT;
+	if (strcmp(name, GetFormatName(Format::OneD)) == 0)
+		return DecodeHints::CODABAR_HINT | DecodeHints::CODE_39_HINT | DecodeHints::CODE_93_HINT
+			| DecodeHints::CODE_128_HINT | DecodeHints::EAN_8_HINT | DecodeHints::EAN_13_HINT
+			| DecodeHints::ITF_HINT | DecodeHints::UPC_A_HINT | DecodeHints::UPC_E_HINT;
+	return 0;
+}
+
+int ZXingScheduler::Decode(const uint8_t *gray, int width, int height, DecodeHints &hints,
+	ZXingBinarizer::T binarizer, std::vector<Ref<Result> > &results)
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+	us_timestamp_t start = ticker_read_us(ticker);
+
+	Start();
+
+	// 画素は仕事が終わるまで持っておく
+	ArrayRef<char> pixels(width * height);
+	memcpy(&pixels[0], gray, width * height);
+	Ref<LuminanceSource> source(new GreyscaleLuminanceSource(pixels, width, height, 0, 0, width, height));
+
+	// 自動はここでは1回で済むハイブリッドにする（失敗した形式は反転や分割でも試す）
+	Ref<Binarizer> first;
+	if (binarizer == ZXingBinarizer::Global)
+		first = new GlobalHistogramBinarizer(source);
+	else
+		first = new HybridBinarizer(source);
+	Ref<BitMatrix> matrix;
+	if (first->getBlackMatrix(matrix) < 0)
+		return -1;
+
+	std::vector<Job> jobs;
+	bool inverted = false;
+	for (size_t i = 0; i < sizeof(job_order) / sizeof(job_order[0]); i++) {
+		if (!HasFormat(hints, job_order[i].format))
+			continue;
+		Job job = { job_order[i].format, job_order[i].variant };
+		jobs.push_back(job);
+		if (job.variant == Variant::Inverted)
+			inverted = true;
+	}
+	if (jobs.empty())
+		return -1;
+
+	// 反転は有効なビットだけ（行の端の余りは0のまま）
+	Ref<BitMatrix> invertedMatrix;
+	if (inverted) {
+		invertedMatrix = new BitMatrix(width, height);
+		int rowSize = matrix->getRowSize();
+		int bits = width % BitMatrix::bitsPerWord;
+		unsigned int lastMask = (bits == 0) ? ~0u : ((1u << bits) - 1);
+		for (int y = 0; y < height; y++) {
+			const unsigned int *src = matrix->getRowBits(y);
+			unsigned int *dst = invertedMatrix->getRowBits(y);
+			for (int i = 0; i < rowSize; i++)
+				dst[i] = ~src[i];
+			dst[rowSize - 1] &= lastMask;
+		}
+	}
+
+	_mutex.lock();
+	_hints = hints;
+	_binarizer = binarizer;
+	_source = source;
+	_invertedSource = inverted ? Ref<LuminanceSource>(new InvertedLuminanceSource(source)) : Ref<LuminanceSource>();
+	_matrix = matrix;
+	_invertedMatrix = invertedMatrix;
+	_jobs.swap(jobs);
+	_next = 0;
+	_running = 0;
+	_finished = false;
+	for (int i = 0; i < Format::Count; i++)
+		_found[i] = false;
+	_results.clear();
+	_mutex.unlock();
+
+	for (size_t i = 0; i < _threads.size(); i++)
+		_ready.release();
+
+	// 呼び出したスレッドも仕事をして、残りが終わるのを待つ
+	RunJobs();
+	_idle.wait();
+
+	_mutex.lock();
+	int count = (int)_results.size();
+	results.insert(results.end(), _results.begin(), _results.end());
+	_results.clear();
+	_source.reset(NULL);
+	_invertedSource.reset(NULL);
+	_matrix.reset(NULL);
+	_invertedMatrix.reset(NULL);
+	_frames++;
+	_codes += count;
+	_frameTime += ticker_read_us(ticker) - start;
+	_mutex.unlock();
+
+	return (count > 0) ? 0 : -1;
+}
+
+void ZXingScheduler::RunJobs()
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+
+	_mutex.lock();
+	for (;;) {
+		if (_next >= _jobs.size())
+			break;
+		Job job = _jobs[_next++];
+		if ((job.variant != Variant::Normal) && _found[job.format]) {
+			_stats[job.format].cancelled++;
+			continue;
+		}
+		_running++;
+		_mutex.unlock();
+
+		std::vector<Ref<Result> > found;
+		us_timestamp_t start = ticker_read_us(ticker);
+		RunJob(job, found);
+		us_timestamp_t time = ticker_read_us(ticker) - start;
+
+		_mutex.lock();
+		Stats &stats = _stats[job.format];
+		stats.jobs++;
+		stats.time += time;
+		for (size_t i = 0; i < found.size(); i++) {
+			// 別の仕事で同じコードを読んでいることがある
+			bool duplicated = false;
+			for (size_t j = 0; j < _results.size(); j++) {
+				if ((_results[j]->getBarcodeFormat() == found[i]->getBarcodeFormat())
+					&& (_results[j]->getText()->getText() == found[i]->getText()->getText())) {
+					duplicated = true;
+					break;
+				}
+			}
+			if (duplicated)
+				continue;
+			_results.push_back(found[i]);
+			stats.found++;
+			_found[job.format] = true;
+		}
+		_running--;
+	}
+	bool finished = Finish();
+	_mutex.unlock();
+
+	if (finished)
+		_idle.release();
+}
+
+/* 最後の仕事が終わった時（取り消しで終わった時も）に1回だけtrueを返す（_mutexの中で呼ぶ） */
+bool ZXingScheduler::Finish()
+{
+	if (_finished || (_next < _jobs.size()) || (_running > 0))
+		return false;
+	_finished = true;
+	return true;
+}
+
+void ZXingScheduler::RunJob(const Job &job, std::vector<Ref<Result> > &results)
+{
+	bool inverted = (job.variant == Variant::Inverted);
+	Ref<Binarizer> binarizer(new SharedBinarizer(inverted ? _invertedSource : _source,
+		inverted ? _invertedMatrix : _matrix, _binarizer));
+	Ref<BinaryBitmap> image(new BinaryBitmap(binarizer));
+	DecodeHints hints(_hints);
+	hints.setTryHarder(job.variant == Variant::Harder);
+	Ref<Result> result;
+
+	switch (job.format) {
+	case Format::QRCode: {
+		if (job.variant == Variant::Quadrant) {
+			qrcode::QRCodeReader reader;
+			ByQuadrantReader quadrant(reader);
+			if (quadrant.decode(image, hints, result) == 0)
+				results.push_back(result);
+		}
+		else {
+			QRCodeMultiReader reader;
+			reader.decodeMultiple(image, hints, results);
+		}
+		break;
+	}
+	case Format::DataMatrix: {
+		datamatrix::DataMatrixReader reader;
+		if (job.variant == Variant::Quadrant) {
+			ByQuadrantReader quadrant(reader);
+			if (quadrant.decode(image, hints, result) == 0)
+				results.push_back(result);
+		}
+		else {
+			GenericMultipleBarcodeReader multiple(reader);
+			multiple.decodeMultiple(image, hints, results);
+		}
+		break;
+	}
+	case Format::Aztec: {
+		aztec::AztecReader reader;
+		GenericMultipleBarcodeReader multiple(reader);
+		multiple.decodeMultiple(image, hints, results);
+		break;
+	}
+	case Format::PDF417: {
+		pdf417::PDF417Reader reader;
+		GenericMultipleBarcodeReader multiple(reader);
+		multiple.decodeMultiple(image, hints, results);
+		break;
+	}
+	case Format::OneD: {
+		oned::MultiFormatOneDReader reader(hints);
+		GenericMultipleBarcodeReader multiple(reader);
+		multiple.decodeMultiple(image, hints, results);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void ZXingScheduler::ResetStats()
+{
+	_mutex.lock();
+	for (int i = 0; i < Format::Count; i++) {
+		_stats[i].jobs = 0;
+		_stats[i].cancelled = 0;
+		_stats[i].found = 0;
+		_stats[i].time = 0;
+	}
+	_frames = 0;
+	_codes = 0;
+	_frameTime = 0;
+	_mutex.unlock();
+}
+
+void ZXingScheduler::PrintStats()
+{
+	_mutex.lock();
+	printf("frames %lu, codes %lu, %.2fms/frame, workers %d\n", _frames, _codes,
+		(_frames > 0) ? (_frameTime / 1000.0 / _frames) : 0.0, ZXING_SCHEDULER_WORKERS);
+	for (int i = 0; i < Format::Count; i++) {
+		Stats &stats = _stats[i];
+		if ((stats.jobs == 0) && (stats.cancelled == 0))
+			continue;
+		printf("%-10s jobs %lu, cancelled %lu, found %lu, %.2fms/job\n", GetFormatName((Format::T)i),
+			stats.jobs, stats.cancelled, stats.found,
+			(stats.jobs > 0) ? (stats.time / 1000.0 / stats.jobs) : 0.0);
+	}
+	_mutex.unlock();
+}
@@ -0,0 +1,112 @@
+#ifndef _ZXINGSCHEDULER_H_
+#define _ZXINGSCHEDULER_H_
+
+#include <stdint.h>
+#include <vector>
+#include <zxing/Result.h>
+#include <zxing/DecodeHints.h>
+#include <zxing/LuminanceSource.h>
+#include <zxing/common/BitMatrix.h>
+#include "ZXingBinarizer.h"
+
+/* デコードを手伝うスレッドの数（呼び出したスレッドも加わる） */
+#define ZXING_SCHEDULER_WORKERS		(2)
+#define ZXING_SCHEDULER_STACK_SIZE	(1024 * 32)
+
+/*
+ * 1フレームのデコードを形式ごと・試し方ごとの仕事に分けてスレッドで並べて行う
+ *
+ * 二値化はフレームに1回だけ行い、その結果（と白黒を反転したもの）を全ての仕事で共有する。
+ * 仕事は次の順に取り出す。
+ *  1. 形式ごとの読み取り（画面内の全てのコードを探す）
+ *  2. 白黒を反転した画像
+ *  3. 1Dの念入りな読み取り（行を増やし、90度回した画像も見る）
+ *  4. 画面を4分割した読み取り
+ * 2～4はその形式が既に見つかっていれば取り出した時に取り消す。
+ * 結果は重複を除いて全て返し、形式ごとの時間を数える。
+ * RZ/A1は1コアなので速くなるのは取り消しによる分で、並列に進むのはPCの上だけ。
+ */
+class ZXingScheduler
+{
+public:
+	class Format
+	{
+	public:
+		enum T {
+			QRCode,
+			DataMatrix,
+			Aztec,
+			PDF417,
+			OneD,
+			Count,
+		};
+	};
+	class Variant
+	{
+	public:
+		enum T {
+			Normal,
+			Inverted,
+			Harder,
+			Quadrant,
+		};
+	};
+	struct Stats {
+		uint32_t jobs;				// 行った仕事
+		uint32_t cancelled;			// 取り出した時に取り消した仕事
+		uint32_t found;				// 見つけたコード
+		us_timestamp_t time;		// 仕事にかかった時間の合計
+	};
+public:
+	ZXingScheduler();
+	virtual ~ZXingScheduler();
+private:
+	struct Job {
+		Format::T format;
+		Variant::T variant;
+	};
+	rtos::Mutex _mutex;
+	rtos::Semaphore _ready;			// 仕事が入った（スレッドごとに1つ）
+	rtos::Semaphore _idle;			// フレームの仕事が全て終わった
+	std::vector<rtos::Thread *> _threads;
+	bool _started;
+	/* フレームごと（_mutexで守る） */
+	std::vector<Job> _jobs;
+	size_t _next;
+	int _running;
+	bool _finished;					// _idleを返した
+	bool _found[Format::Count];
+	std::vector<zxing::Ref<zxing::Result> > _results;
+	/* フレームごと（仕事の間は読むだけ） */
+	zxing::DecodeHints _hints;
+	ZXingBinarizer::T _binarizer;
+	zxing::Ref<zxing::LuminanceSource> _source;
+	zxing::Ref<zxing::LuminanceSource> _invertedSource;
+	zxing::Ref<zxing::BitMatrix> _matrix;
+	zxing::Ref<zxing::BitMatrix> _invertedMatrix;
+	/* 統計（_mutexで守る） */
+	Stats _stats[Format::Count];
+	uint32_t _frames;
+	uint32_t _codes;
+	us_timestamp_t _frameTime;
+	void Start();
+	void WorkerMain();
+	void RunJobs();
+	bool Finish();
+	void RunJob(const Job &job, std::vector<zxing::Ref<zxing::Result> > &results);
+	static bool HasFormat(const zxing::DecodeHints &hints, Format::T format);
+public:
+	/*
+	 * grayの画像からhintsの形式のコードを全て探してresultsに加える
+	 * 見つからなければ-1を返す
+	 */
+	int Decode(const uint8_t *gray, int width, int height, zxing::DecodeHints &hints,
+		ZXingBinarizer::T binarizer, std::vector<zxing::Ref<zxing::Result> > &results);
+	void ResetStats();
+	void PrintStats();
+	static const char *GetFormatName(Format::T format);
+	/* GetFormatNameの名前からDecodeHintsのビットを返す（知らない名前は0） */
+	static uint32_t GetFormatHints(const char *name);
+};
+
+#endif // _ZXINGSCHEDULER_H_
@@ -4,8 +4,10 @@
 #include "ImageReaderSource.h"
 #include "camera_if.hpp"
 #include "ZXingTask.h"
+#include "ZXingScheduler.h"
+#include <zxing/common/GridSampler.h>
+#include <zxing/common/reedsolomon/ReedSolomonDecoder.h>
 
-extern uint8_t FrameBuffer_Video[FRAME_BUFFER_STRIDE * FRAME_BUFFER_HEIGHT];
 
 /**** User Selection *********/
 /** Decode hints **/
@@ -20,21 +22,68 @@ ZXingTask::ZXingTask(GlobalState *globalState) :
 	_globalState(globalState),
 	_state(State::PowerOff),
 	_timer(0),
+	_frames("ZXingTask", this),
+	_decodedSeq(0),
+	_decoded(false),
+	_binarizer(ZXingBinarizer::Global),
+	_tracker(new QRCodeTracker()),
+	_tracking(true),
+	_scheduler(new ZXingScheduler()),
+	_multi(false),
+	_formats(DECODE_HINTS),
 	p_callback_func(NULL)
 {
 }
 
 ZXingTask::~ZXingTask()
 {
+	delete _scheduler;
+	delete _tracker;
 }
 
-void ZXingTask::Init(void (*pfunc)(const char *addr, int size))
+void ZXingTask::Init(void (*pfunc)(const char *addr, int size, int first))
 {
 	p_callback_func = pfunc;
 }
 
+bool ZXingTask::DecodeFrame(const FrameView *frame, ZXingBinarizer::T binarizer)
+{
+	vector<Ref<Result>> results;
+	DecodeHints hints(DECODE_HINTS);
+	hints.setTryHarder(false);
+
+	return ex_decode_gray(frame->GetGray(), frame->GetWidth(), frame->GetHeight(), &results, hints, binarizer) == 0;
+}
+
+static void PrintTracker(QRCodeTracker *tracker)
+{
+	printf("frames %d, miss %d\n", tracker->getFrames(), tracker->getMisses());
+	for (int i = 0; i < QRCodeTracker::TIER_COUNT; i++) {
+		QRCodeTracker::Tier tier = (QRCodeTracker::Tier)i;
+		int attempts = tracker->getAttempts(tier);
+		printf("%-9s %d/%d (%d%%)\n", QRCodeTracker::getTierName(tier), tracker->getHits(tier), attempts,
+			(attempts > 0) ? (tracker->getHits(tier) * 100 / attempts) : 0);
+	}
+}
+
+void ZXingTask::PrintTrackStats()
+{
+	printf("tracking %s%s\n", _tracking ? "on" : "off", _tracker->isTracking() ? " (locked)" : "");
+	PrintTracker(_tracker);
+}
+
+void ZXingTask::PrintPoolStats()
+{
+	printf("multi %s\n", _multi ? "on" : "off");
+	_scheduler->PrintStats();
+	_mutex.lock();
+	printf("%s", _lastCodes.c_str());
+	_mutex.unlock();
+}
+
 void ZXingTask::OnStart()
 {
+	frameBus.Subscribe(&_frames);
 }
 
 void ZXingTask::OnEnd()
@@ -48,6 +97,9 @@ int ZXingTask::GetTimer()
 
 void ZXingTask::Progress(int elapse)
 {
+	// 無期限に待っている間は時間で起きない
+	if (_timer == (int)osWaitForever)
+		return;
 	_timer -= elapse;
 	if (_timer < 0)
 		_timer = 0;
@@ -55,6 +107,11 @@ void ZXingTask::Progress(int elapse)
 
 void ZXingTask::ProcessEvent(InterTaskSignals::T signals)
 {
+	// 新しいフレームを待っていたら処理を再開する
+	if (((signals & InterTaskSignals::FrameReady) != 0)
+		&& (_state == State::Detecting) && (_timer == (int)osWaitForever)) {
+		_timer = 0;
+	}
 	if ((signals & InterTaskSignals::PowerOn) != 0) {
 		_state = State::Detecting;
 		_timer = 100;
@@ -71,26 +128,67 @@ void ZXingTask::Process()
 		return;
 
 	int decode_result;
-	const char *decode_str;
 
 	switch (_state) {
 	case State::Detecting: {
 		vector<Ref<Result>> results;
-		DecodeHints hints(DECODE_HINTS);
+		DecodeHints hints(_formats);
 		hints.setTryHarder(false);
-		decode_result = ex_decode(FrameBuffer_Video, (FRAME_BUFFER_STRIDE * VIDEO_PIXEL_VW), VIDEO_PIXEL_HW, VIDEO_PIXEL_VW, &results, hints);
+		// 前回から新しいフレームが来ていなければ次のフレームの通知（FrameReady）を待つ
+		// （フレームバッファはYCbCr422なので、配信が始まる前も直接は読まない）
+		const FrameView *frame = frameBus.Acquire(&_frames);
+		if (frame == NULL) {
+			_timer = osWaitForever;
+			break;
+		}
+		// 読めなかった画面から変化が無ければデコードしても同じ
+		if (!_decoded && !frame->IsChangedSince(_decodedSeq)) {
+			_frames.CountSkipped();
+			frameBus.Release(frame);
+			_timer = osWaitForever;
+			break;
+		}
+		if (_multi) {
+			decode_result = _scheduler->Decode(frame->GetGray(), frame->GetWidth(), frame->GetHeight(), hints, _binarizer, results);
+			if (decode_result == 0) {
+				std::string codes;
+				for (size_t i = 0; i < results.size(); i++) {
+					codes += BarcodeFormat::barcodeFormatNames[results[i]->getBarcodeFormat()];
+					codes += ": ";
+					codes += results[i]->getText()->getText();
+					codes += "\n";
+				}
+				_mutex.lock();
+				_lastCodes.swap(codes);
+				_mutex.unlock();
+			}
+		}
+		else {
+			decode_result = ex_decode_gray(frame->GetGray(), frame->GetWidth(), frame->GetHeight(), &results, hints, _binarizer, _tracking ? _tracker : NULL);
+		}
+		_decodedSeq = frame->GetSeq();
+		_decoded = (decode_result == 0);
+		frameBus.Release(frame);
 		if (decode_result == 0) {
-			decode_str = results[0]->getText()->getText().c_str();
-			int size = strlen(decode_str);
+			// 読めたコードは全て1行に1つずつ渡す（LCDの文字描画に合わせてCRLFで区切る）
+			std::string decode_str;
+			int first = 0;
+			for (size_t i = 0; i < results.size(); i++) {
+				if (i > 0)
+					decode_str += "\r\n";
+				decode_str += results[i]->getText()->getText();
+				if (i == 0)
+					first = (int)decode_str.size();
+			}
 			if (p_callback_func != NULL) {
-				p_callback_func(decode_str, size);
+				p_callback_func(decode_str.c_str(), (int)decode_str.size(), first);
 			}
 			_state = State::Detected;
 			_timer = 500;
 		}
 		else {
 			if (p_callback_func != NULL) {
-				p_callback_func("", 0);
+				p_callback_func("", 0, 0);
 			}
 			_state = State::Detecting;
 			_timer = 10;
@@ -99,7 +197,7 @@ void ZXingTask::Process()
 	}
 	case State::Detected:
 		if (p_callback_func != NULL) {
-			p_callback_func("", 0);
+			p_callback_func("", 0, 0);
 		}
 		_state = State::Detecting;
 		_timer = 0;
@@ -110,3 +208,264 @@ void ZXingTask::Process()
 		break;
 	}
 }
+
+static bool SameMatrix(Ref<BitMatrix> &a, Ref<BitMatrix> &b)
+{
+	if ((a->getWidth() != b->getWidth()) || (a->getHeight() != b->getHeight()))
+		return false;
+
+	for (int y = 0; y < a->getHeight(); y++) {
+		if (memcmp(a->getRowBits(y), b->getRowBits(y), a->getRowSize() * sizeof(unsigned int)) != 0)
+			return false;
+	}
+	return true;
+}
+
+void ZXingBinarizerBench(const char *filename)
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+	StreamReader reader;
+	StreamChunkHeader chunk;
+	std::vector<uint8_t> payload;
+	FrameBus *bus = new FrameBus();
+	FrameSubscriber sub("bench");
+	uint32_t frames = 0;
+	uint64_t pixels = 0;
+	// [Global/Hybrid][C/SIMD]
+	us_timestamp_t binarize_time[2][2] = { { 0 } }, start;
+	uint32_t mismatch[2] = { 0 };
+	us_timestamp_t decode_time[3] = { 0 }, tracked_time = 0;
+	uint32_t decoded[3] = { 0 }, tracked = 0;
+	// デコード中の参照カウントの操作（ZXING_REF_STATSでビルドした時だけ数える）
+	RefStats refs = { 0, 0, 0 };
+	QRCodeTracker *tracker = new QRCodeTracker();
+	int width = 0, height = 0;
+
+	if (!reader.Open(filename)) {
+		printf("cannot open %s\n", filename);
+		delete tracker;
+		delete bus;
+		return;
+	}
+
+	bus->Subscribe(&sub);
+
+	DecodeHints hints(DECODE_HINTS);
+	hints.setTryHarder(false);
+
+	while (reader.Next(StreamChunk::Video, &chunk, payload)) {
+		if (payload.size() < sizeof(StreamVideoInfo))
+			continue;
+		StreamVideoInfo *info = (StreamVideoInfo *)&payload[0];
+		bus->Publish(&payload[sizeof(StreamVideoInfo)], info->width, info->height,
+			info->stride, (StreamVideoFormat::T)info->format);
+
+		const FrameView *frame = bus->Acquire(&sub);
+		if (frame == NULL)
+			continue;
+		frames++;
+		width = frame->GetWidth();
+		height = frame->GetHeight();
+		pixels += width * height;
+
+		Ref<LuminanceSource> source;
+		ImageReaderSource::createGray(frame->GetGray(), width, height, source);
+
+		for (int type = 0; type < 2; type++) {
+			Ref<BitMatrix> matrix[2];
+			int ret[2];
+			for (int simd = 0; simd < 2; simd++) {
+				start = ticker_read_us(ticker);
+				Ref<Binarizer> binarizer;
+				if (type == 0)
+					binarizer = new GlobalHistogramBinarizer(source, simd != 0);
+				else
+					binarizer = new HybridBinarizer(source, simd != 0);
+				ret[simd] = binarizer->getBlackMatrix(matrix[simd]);
+				binarize_time[type][simd] += ticker_read_us(ticker) - start;
+			}
+			if ((ret[0] != ret[1]) || ((ret[0] >= 0) && !SameMatrix(matrix[0], matrix[1])))
+				mismatch[type]++;
+		}
+
+		RefStats before = Counted::getStats();
+		for (int mode = ZXingBinarizer::Global; mode <= ZXingBinarizer::Auto; mode++) {
+			start = ticker_read_us(ticker);
+			if (ZXingTask::DecodeFrame(frame, (ZXingBinarizer::T)mode))
+				decoded[mode]++;
+			decode_time[mode] += ticker_read_us(ticker) - start;
+		}
+		RefStats after = Counted::getStats();
+		refs.objects += after.objects - before.objects;
+		refs.retains += after.retains - before.retains;
+		refs.releases += after.releases - before.releases;
+
+		start = ticker_read_us(ticker);
+		vector<Ref<Result>> results;
+		if (ex_decode_gray(frame->GetGray(), width, height, &results, hints, ZXingBinarizer::Global, tracker) == 0)
+			tracked++;
+		tracked_time += ticker_read_us(ticker) - start;
+
+		bus->Release(frame);
+	}
+
+	delete bus;
+
+	if (frames == 0) {
+		printf("no video frames\n");
+		delete tracker;
+		return;
+	}
+
+	// 640x480の1フレームあたりに換算する
+	double scale = (640.0 * 480.0) / ((double)pixels * 1000.0);
+	printf("frames %lu (%dx%d)\n", frames, width, height);
+	for (int type = 0; type < 2; type++) {
+		printf("%s: C %.3fms, %s %.3fms, mismatch %lu\n", ZXingBinarizer::GetName((ZXingBinarizer::T)type),
+			binarize_time[type][0] * scale, GlobalHistogramBinarizer::getKernelName(),
+			binarize_time[type][1] * scale, mismatch[type]);
+	}
+	for (int mode = ZXingBinarizer::Global; mode <= ZXingBinarizer::Auto; mode++) {
+		printf("decode %s: %.3fms, %lu/%lu frames\n", ZXingBinarizer::GetName((ZXingBinarizer::T)mode),
+			decode_time[mode] * scale, decoded[mode], frames);
+	}
+	printf("decode global tracked: %.3fms, %lu/%lu frames\n", tracked_time * scale, tracked, frames);
+	if (Counted::hasStats()) {
+		// 3つの二値化でデコードした1回あたり
+		uint32_t decodes = frames * 3;
+		printf("refs/decode: objects %lu, retains %lu, releases %lu\n",
+			refs.objects / decodes, refs.retains / decodes, refs.releases / decodes);
+	}
+	PrintTracker(tracker);
+	delete tracker;
+}
+
+void ZXingSamplerBench()
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+	static const int versions[] = { 10, 25, 40 };
+	static const GridSampler::Kernel kernels[] = {
+		GridSampler::KERNEL_POINTS, GridSampler::KERNEL_SCALAR, GridSampler::KERNEL_AUTO
+	};
+	static const int repeat = 50;
+	const int width = 640, height = 480;
+
+	// 二値化した画像の代わりに乱数で埋める
+	Ref<BitMatrix> image(new BitMatrix(width, height));
+	uint32_t seed = 1;
+	for (int y = 0; y < height; y++) {
+		unsigned int *row = image->getRowBits(y);
+		for (int i = 0; i < image->getRowSize(); i++) {
+			seed = seed * 1103515245 + 12345;
+			row[i] = seed ^ (seed >> 16);
+		}
+	}
+
+	printf("version  points  C  %s [ns/module], mismatch C/%s\n",
+		PerspectiveTransform::getKernelName(), PerspectiveTransform::getKernelName());
+	for (size_t v = 0; v < sizeof(versions) / sizeof(versions[0]); v++) {
+		int dimension = 17 + 4 * versions[v];
+		float size = 420.0f;
+		// 少し傾けて遠近を付けた四角形に写す
+		Ref<PerspectiveTransform> transform = PerspectiveTransform::quadrilateralToQuadrilateral(
+			3.5f, 3.5f, dimension - 3.5f, 3.5f, dimension - 3.5f, dimension - 3.5f, 3.5f, dimension - 3.5f,
+			120.0f, 40.0f, 120.0f + size, 60.0f, 100.0f + size * 0.97f, 40.0f + size * 0.98f,
+			110.0f, 30.0f + size * 0.95f);
+		Ref<BitMatrix> bits[3];
+		double ns[3];
+		for (int k = 0; k < 3; k++) {
+			us_timestamp_t start = ticker_read_us(ticker);
+			for (int i = 0; i < repeat; i++) {
+				GridSampler::getInstance().sampleGrid(image, dimension, dimension, transform, bits[k], kernels[k]);
+			}
+			us_timestamp_t time = ticker_read_us(ticker) - start;
+			ns[k] = time * 1000.0 / ((double)repeat * dimension * dimension);
+		}
+		// 境界ぎりぎりの点は丸め誤差で隣のモジュールになることがある
+		int mismatch[2] = { 0, 0 };
+		for (int k = 1; k < 3; k++) {
+			for (int y = 0; y < dimension; y++) {
+				for (int x = 0; x < dimension; x++) {
+					if (bits[k]->get(x, y) != bits[0]->get(x, y))
+						mismatch[k - 1]++;
+				}
+			}
+		}
+		printf("%2d (%3d)  %.2f  %.2f  %.2f, %d/%d\n", versions[v], dimension,
+			ns[0], ns[1], ns[2], mismatch[0], mismatch[1]);
+	}
+}
+
+// 生成多項式で割った余りを後ろに付けて符号語にする
+static void EncodeReedSolomon(GenericGF &field, std::vector<int> &codeword, int twoS)
+{
+	std::vector<int> generator(1, 1);
+	for (int i = 0; i < twoS; i++) {
+		int root = field.exp(i + field.getGeneratorBase());
+		std::vector<int> next(generator.size() + 1, 0);
+		for (size_t j = 0; j < generator.size(); j++) {
+			next[j] ^= generator[j];
+			next[j + 1] ^= field.multiply(generator[j], root);
+		}
+		generator.swap(next);
+	}
+
+	int data = codeword.size() - twoS;
+	std::vector<int> remainder(twoS, 0);
+	for (int j = 0; j < data; j++) {
+		int feedback = codeword[j] ^ remainder[0];
+		for (int i = 0; i < twoS - 1; i++)
+			remainder[i] = remainder[i + 1] ^ field.multiply(feedback, generator[i + 1]);
+		remainder[twoS - 1] = field.multiply(feedback, generator[twoS]);
+	}
+	for (int i = 0; i < twoS; i++)
+		codeword[data + i] = remainder[i];
+}
+
+void ZXingReedSolomonBench()
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+	static const int errors[] = { 0, 1, 2, 4, 8, 15 };
+	static const ReedSolomonDecoder::Kernel kernels[] = {
+		ReedSolomonDecoder::KERNEL_EUCLIDEAN, ReedSolomonDecoder::KERNEL_SCALAR, ReedSolomonDecoder::KERNEL_AUTO
+	};
+	static const int repeat = 200;
+	// 大きいバージョンのブロックに近い長さ（最大は153語）
+	const int length = 146, twoS = 30;
+	Ref<GenericGF> field = GenericGF::QR_CODE_FIELD_256;
+	ReedSolomonDecoder decoder(field);
+
+	std::vector<int> codeword(length);
+	uint32_t seed = 1;
+	for (int i = 0; i < length - twoS; i++) {
+		seed = seed * 1103515245 + 12345;
+		codeword[i] = (seed >> 16) & 0xFF;
+	}
+	EncodeReedSolomon(*field, codeword, twoS);
+
+	printf("errors  euclidean  C  %s [us/block (codewords/s)], failed\n", ReedSolomonDecoder::getKernelName());
+	for (size_t e = 0; e < sizeof(errors) / sizeof(errors[0]); e++) {
+		// 誤りは離れた位置に散らす
+		std::vector<int> received(codeword);
+		for (int i = 0; i < errors[e]; i++)
+			received[(i * 37) % length] ^= 0x5A;
+
+		double us[3], rate[3];
+		int failed = 0;
+		for (int k = 0; k < 3; k++) {
+			us_timestamp_t time = 0;
+			for (int i = 0; i < repeat; i++) {
+				ArrayRef<int> block(new Array<int>(received));
+				us_timestamp_t start = ticker_read_us(ticker);
+				if ((decoder.decode(block, twoS, kernels[k]) < 0) || (block->values() != codeword))
+					failed++;
+				time += ticker_read_us(ticker) - start;
+			}
+			us[k] = (double)time / repeat;
+			// ブロック長×ブロック数÷経過時間
+			rate[k] = (time > 0) ? (double)length * repeat * 1000000.0 / time : 0.0;
+		}
+		printf("%2d  %.1f (%.0f)  %.1f (%.0f)  %.1f (%.0f), %d\n", errors[e],
+			us[0], rate[0], us[1], rate[1], us[2], rate[2], failed);
+	}
+}
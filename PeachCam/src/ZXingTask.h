@@ -3,8 +3,13 @@
 #define ZXING_MAIN_H
 
 #include "TaskBase.h"
+#include "FrameBus.h"
+#include "ZXingBinarizer.h"
+#include <string>
 
 class GlobalState;
+class ZXingScheduler;
+namespace zxing { namespace qrcode { class QRCodeTracker; } }
 
 class ZXingTask : public TaskThread, public ITask
 {
@@ -25,11 +30,37 @@ private:
 	GlobalState *_globalState;
 	State::T _state;
 	int _timer;
-	void (*p_callback_func)(const char *addr, int size);
+	FrameSubscriber _frames;
+	uint32_t _decodedSeq;	// 最後にデコードしたフレーム
+	bool _decoded;			// 最後のデコードで読めたか
+	ZXingBinarizer::T _binarizer;
+	zxing::qrcode::QRCodeTracker *_tracker;	// 前のフレームで見つけた位置から探す
+	bool _tracking;
+	ZXingScheduler *_scheduler;	// 全ての形式・全てのコードを仕事に分けて探す
+	bool _multi;
+	uint32_t _formats;		// 探す形式（DecodeHintsのビット）
+	rtos::Mutex _mutex;
+	std::string _lastCodes;	// 最後に読めたコード（1行に1つ）
+	void (*p_callback_func)(const char *addr, int size, int first);
 public:
-	void Init(void (*pfunc)(const char *addr, int size));
+	/* pfuncには読めたコードを全てCRLFで区切って渡す（読めなければ長さ0）、firstは先頭のコードの長さ */
+	void Init(void (*pfunc)(const char *addr, int size, int first));
+	static bool DecodeFrame(const FrameView *frame, ZXingBinarizer::T binarizer = ZXingBinarizer::Global);
 public:
 	State::T GetState() { return _state; }
+	/* 次のフレームから使う二値化 */
+	void SetBinarizer(ZXingBinarizer::T binarizer) { _binarizer = binarizer; }
+	ZXingBinarizer::T GetBinarizer() { return _binarizer; }
+	/* 前のフレームの位置を使うか（次のフレームから） */
+	void SetTracking(bool enable) { _tracking = enable; }
+	bool IsTracking() { return _tracking; }
+	void PrintTrackStats();
+	/* 形式ごとの仕事に分けてデコードするか（次のフレームから） */
+	void SetMulti(bool enable) { _multi = enable; }
+	bool IsMulti() { return _multi; }
+	void SetFormats(uint32_t formats) { _formats = formats; }
+	uint32_t GetFormats() { return _formats; }
+	void PrintPoolStats();
 	void OnStart() override;
 	void OnEnd() override;
 	int GetTimer() override;
@@ -38,5 +69,24 @@ public:
 	void Process() override;
 };
 
+/*
+ * 記録したカメラ映像で二値化の時間（640x480換算[ms/frame]）、C/SIMDの一致と
+ * 二値化ごと・位置の追跡ありのデコード時間とデコードできたフレーム数を表示する
+ * ZXING_REF_STATSでビルドした時はデコード1回あたりの参照カウントの操作の数も表示する
+ */
+void ZXingBinarizerBench(const char *filename);
+
+/*
+ * 乱数の画像からQRコードのモジュールを読み取る時間[ns/module]をバージョン10/25/40で表示する
+ * （1点ずつの変換、行ごとの変換のC/SIMD、1点ずつとの不一致の数）
+ */
+void ZXingSamplerBench();
+
+/*
+ * QRコードのブロック（146語、誤り訂正30語）に誤りを0～15個入れて、
+ * 1ブロックの誤り訂正にかかる時間[us]をユークリッド法と表引き（C/SIMD）で表示する
+ */
+void ZXingReedSolomonBench();
+
 #endif
 
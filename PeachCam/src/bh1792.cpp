@@ -146,29 +146,6 @@ int32_t BH1792::StartMeasure(void)
 
 	if (this->prm.msr < BH1792_PRM_MSR_SINGLE) {
 		this->is_measuring = 1;
-
-		// Initialize moving average parameters
-		this->ma_prm.sum.off = 0U;
-		this->ma_prm.sum.on = 0U;
-		this->ma_prm.pos = 0;
-		this->ma_prm.num = 0;
-
-		switch (this->prm.msr) {
-		case BH1792_PRM_MSR_32HZ:
-		case BH1792_PRM_MSR_128HZ:
-		case BH1792_PRM_MSR_64HZ:
-			this->ma_prm.len = 1;
-			break;
-		case BH1792_PRM_MSR_256HZ:
-			this->ma_prm.len = 2;
-			break;
-		case BH1792_PRM_MSR_1024HZ:
-			this->ma_prm.len = 8;
-			break;
-		default:
-			this->ma_prm.len = 0;
-			break;
-		}
 	}
 
 	reg[0] = BH1792_ADDR_MEAS_START;
@@ -229,6 +206,9 @@ int32_t BH1792::GetMeasData(bh1792_data_t *dat)
 	uint8_t fifo_level = 0U;
 
 	if (this->prm.msr <= BH1792_PRM_MSR_1024HZ) {
+		// FIFOの読み出しは途中で他のデバイスに割り込まれないよう一括で行う
+		wire.lock();
+
 		ret_i2c = i2c_read(BH1792_SLAVE_ADDR, BH1792_ADDR_FIFO_LEV, &dat->fifo_lev, 1U);
 		if (ret_i2c == 0) {
 			if (dat->fifo_lev == BH1792_PRM_FIFO_LEV_FULL) {
@@ -244,6 +224,8 @@ int32_t BH1792::GetMeasData(bh1792_data_t *dat)
 				ret_i2c = i2c_read(BH1792_SLAVE_ADDR, BH1792_ADDR_FIFO_LEV, &fifo_level, 1U);
 			}
 		}
+
+		wire.unlock();
 	}
 	else {
 		dat->fifo_lev = 0U;
@@ -384,41 +366,27 @@ int32_t BH1792::getFifoData(bh1792_data_t *dat)
 {
 	int32_t ret_i2c = 0;
 	uint8_t i = 0U;
-	uint8_t reg[4];
-	bh1792_maPrm_t *ma_prm;
+	uint8_t reg[4 * BH1792_PRM_FIFO_LEV_FULL];
+	uint8_t *pos;
 
-	ma_prm = &this->ma_prm;
+	if (dat->fifo_lev > BH1792_PRM_FIFO_LEV_FULL) {
+		dat->fifo_lev = BH1792_PRM_FIFO_LEV_FULL;
+	}
 
-	for (i = 0U; i < dat->fifo_lev; i++) {
-		ret_i2c = i2c_read(BH1792_SLAVE_ADDR, BH1792_ADDR_FIFO_DATA0_LSBS, reg, 4U);
+	// FIFO_DATA1_MSBSを読むとFIFOが進むが、レジスタアドレスは4Ch-4Fhで
+	// 折り返さないため、1サンプル毎にアドレスを指定し直す
+	for (i = 0U, pos = reg; i < dat->fifo_lev; i++, pos += 4) {
+		ret_i2c = i2c_read(BH1792_SLAVE_ADDR, BH1792_ADDR_FIFO_DATA0_LSBS, pos, 4U);
 		if (ret_i2c != 0) {
-			break;
-		}
-		dat->fifo[i].off = ((uint16_t)reg[1] << 8) | (uint16_t)reg[0];
-		dat->fifo[i].on = ((uint16_t)reg[3] << 8) | (uint16_t)reg[2];
-
-		// Moving Average
-		if (ma_prm->num == ma_prm->len) {
-			ma_prm->sum.off -= ma_prm->buf[ma_prm->pos].off;
-			ma_prm->sum.on -= ma_prm->buf[ma_prm->pos].on;
-		}
-		ma_prm->sum.off += dat->fifo[i].off;
-		ma_prm->sum.on += dat->fifo[i].on;
-		ma_prm->buf[ma_prm->pos].off = dat->fifo[i].off;
-		ma_prm->buf[ma_prm->pos].on = dat->fifo[i].on;
-
-		ma_prm->pos++;
-		if (ma_prm->pos >= ma_prm->len) {
-			ma_prm->pos = 0;
-		}
-		if (ma_prm->num < ma_prm->len) {
-			ma_prm->num++;
+			dat->fifo_lev = i;
+			return ret_i2c;
 		}
+	}
 
-		if (ma_prm->num > 0) {
-			dat->fifo_lpf[i].off = ma_prm->sum.off / ma_prm->num;
-			dat->fifo_lpf[i].on = ma_prm->sum.on / ma_prm->num;
-		}
+	// 読み出しを先に済ませてから変換する
+	for (i = 0U, pos = reg; i < dat->fifo_lev; i++, pos += 4) {
+		dat->fifo[i].off = ((uint16_t)pos[1] << 8) | (uint16_t)pos[0];
+		dat->fifo[i].on = ((uint16_t)pos[3] << 8) | (uint16_t)pos[2];
 	}
 
 	return ret_i2c;
@@ -159,7 +159,6 @@ typedef struct {
     u16_pair_t     ir;
     u16_pair_t     green;
     u16_pair_t     fifo[35];
-    u16_pair_t     fifo_lpf[35];
     uint8_t        fifo_lev;
 } bh1792_data_t;
 
@@ -180,14 +179,6 @@ typedef struct {
     uint8_t        int_sel;
 } bh1792_prm_t;
 
-// BH1792 Moving Average Parameters
-typedef struct {
-    u16_pair_t     buf[8];
-    u32_pair_t     sum;
-    int8_t         pos;
-    int8_t         len;
-    int8_t         num;
-} bh1792_maPrm_t;
 
 // BH1792 Configuration
 class BH1792 {
@@ -195,7 +186,6 @@ public:
 	BH1792(PinName sda_pin, PinName scl_pin);
 private:
 	bh1792_prm_t   prm;
-	bh1792_maPrm_t ma_prm;
 	int32_t        i2c_err;
 	int8_t         is_measuring;
 	int8_t         sync_seq;
@@ -11,10 +11,16 @@
 #include "adafruit_gfx.h"
 #include "bh1792.h"
 #include "ZXingTask.h"
+#include "ZXingScheduler.h"
+#include "ZXingCorpus.h"
+#include "JpegBench.h"
+#include "StorageTask.h"
+#include "ThermalRecord.h"
 #include "TouchKey.h"
 #include "EasyAttach_CameraAndLCD.h"
 #include "SocketInterface.h"
 #include "qrcode.h"
+#include "QRCodeSprite.h"
 
 using namespace cv;
 
@@ -42,6 +48,7 @@ ESP32Interface wifi(P3_10, P3_9, P2_14, P2_15);
 static NetTask netTask(&globalState, &wifi);
 static LeptonTaskThread leptonTask(&globalState);
 static ZXingTask zxingTask(&globalState);
+static StorageTask storageTask(&globalState);
 
 NetworkInterface * NetworkInterface::get_default_instance(void)
 {
@@ -432,7 +439,7 @@ extern "C" int usrcmd_lpt(int argc, char **argv)
 	if (strcmp(argv[1], "s") == 0) {
 		globalState.MakeFilePath();
 		auto file = globalState.GetFilePath() + ".bmp";
-		lepton->SaveImage(file.c_str());
+		lepton->SaveImage(&storageTask, file.c_str());
 	}
 	else if ((strcmp(argv[1], "a") == 0) && (argc > 2)) {
 		lepton->ReqAgc(strcmp(argv[2], "0") == 0);
@@ -470,42 +477,392 @@ extern "C" int usrcmd_lpt(int argc, char **argv)
 	else if ((strcmp(argv[1], "b") == 0) && (argc > 5)) {
 		lepton->ReqSetSpotmeterRoi(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), atoi(argv[5]));
 	}
+	else if (strcmp(argv[1], "d0") == 0) {
+		lepton->ReqDenoise(false);
+	}
+	else if (strcmp(argv[1], "d1") == 0) {
+		lepton->ReqDenoise(true);
+	}
+	else if (strcmp(argv[1], "i") == 0) {
+		printf("%dx%d, invalid segments %lu, restarted segments %lu\n", lepton->GetWidth(), lepton->GetHeight(),
+			lepton->GetInvalidSegments(), lepton->GetRestartedSegments());
+		printf("denoise %s, threshold %d\n", lepton->IsDenoiseEnabled() ? "on" : "off",
+			lepton->GetNoiseThreshold());
+	}
 
 	return 0;
 }
 
-void zxing_callback(const char *addr, int size)
+extern "C" int usrcmd_fus(int argc, char **argv)
 {
-	if (size <= 0) {
-		lcd_fillRect(&lcd, 0, 20, lcd._width / 2, lcd._height / 2, 0x0000);
+	if (argc < 2) {
+		printf("fusion %s\n", lepton->IsFusionEnabled() ? "on" : "off");
+		lepton->GetFusion()->PrintInfo();
+		return 0;
+	}
+
+	if (strcmp(argv[1], "on") == 0) {
+		lepton->ReqFusion(true);
+	}
+	else if (strcmp(argv[1], "off") == 0) {
+		lepton->ReqFusion(false);
+	}
+	else if ((strcmp(argv[1], "a") == 0) && (argc > 2)) {
+		lepton->GetFusion()->SetAlpha(atoi(argv[2]));
+	}
+	else if ((strcmp(argv[1], "cal") == 0) && (argc >= 2 + 4 * 4) && (((argc - 2) % 4) == 0)) {
+		// 熱画像の座標とカメラの座標の組
+		std::vector<cv::Point2f> thermal, camera;
+		for (int i = 2; i < argc; i += 4) {
+			thermal.push_back(cv::Point2f((float)atof(argv[i]), (float)atof(argv[i + 1])));
+			camera.push_back(cv::Point2f((float)atof(argv[i + 2]), (float)atof(argv[i + 3])));
+		}
+		if (lepton->GetFusion()->Calibrate(thermal, camera, lepton->GetWidth(), lepton->GetHeight()))
+			lepton->GetFusion()->PrintInfo();
+	}
+	else if (strcmp(argv[1], "reset") == 0) {
+		lepton->GetFusion()->ResetCalibration();
+	}
+	else if (strcmp(argv[1], "bench") == 0) {
+		ThermalFusionBench();
+	}
+	else {
+		printf("fus [on | off | a <0-15> | cal <tx ty cx cy> x4.. | reset | bench]\n");
+	}
+
+	return 0;
+}
+
+extern "C" int usrcmd_face(int argc, char **argv)
+{
+	if (argc < 2) {
+		printf("face [bench | pool | par <image>] \n");
+		return 0;
+	}
+
+	if (strcmp(argv[1], "bench") == 0) {
+		detectFaceBench(FACE_DETECTOR_MODEL);
+	}
+	else if ((strcmp(argv[1], "par") == 0) && (argc > 2)) {
+		// FaceDetectTaskが使っている識別器とは別に読み込む
+		CascadeClassifier classifier;
+		if (detectFaceLoad(classifier, FACE_DETECTOR_MODEL)) {
+			// スレッド数を変えて測る間、検出のワーカーと取り合わないように止める
+			faceDetectTask.Pause();
+			detectFaceScalingBench(argv[2], classifier);
+			faceDetectTask.Resume();
+		}
+	}
+	else if (strcmp(argv[1], "pool") == 0) {
+		faceDetectTask.PrintPoolStats();
+	}
+
+	return 0;
+}
+
+extern "C" int usrcmd_jpeg(int argc, char **argv)
+{
+	if ((argc < 3) || (strcmp(argv[1], "bench") != 0)) {
+		printf("jpeg bench <image> [quality]\n");
+		return 0;
+	}
+
+	JpegStageBench(argv[2], (argc > 3) ? atoi(argv[3]) : 75);
+
+	return 0;
+}
+
+extern "C" int usrcmd_hr(int argc, char **argv)
+{
+	if (argc < 2) {
+		HeartRateTask *heartRate = sensorTask.GetHeartRateTask();
+		printf("%d bpm (confidence %d)\n", heartRate->GetBpm(), heartRate->GetConfidence());
+		return 0;
+	}
+
+	if ((strcmp(argv[1], "bench") == 0) && (argc > 3)) {
+		HeartRateBench(argv[2], atoi(argv[3]), (argc > 4) ? atoi(argv[4]) : 0);
+	}
+	else {
+		printf("hr [bench <file> <rate> [bpm]] \n");
+	}
+
+	return 0;
+}
+
+extern "C" int usrcmd_sensor(int argc, char **argv)
+{
+	uint32_t start = sensorTask.GetWakeups();
+	ThisThread::sleep_for(1000);
+	uint32_t wakeups = sensorTask.GetWakeups() - start;
+
+	printf("%lu wakeups/s\n", wakeups);
+
+	return 0;
+}
+
+extern "C" int usrcmd_thr(int argc, char **argv)
+{
+	if (argc < 2) {
+		printf("thr start [file] | stop | stat | verify <file>\n");
+		return 0;
+	}
+
+	if (strcmp(argv[1], "start") == 0) {
+		std::string file;
+		if (argc > 2) {
+			file = argv[2];
+		}
+		else {
+			globalState.MakeFilePath();
+			file = globalState.GetFilePath() + ".thr";
+		}
+		if (thermalRecorder.Open(&storageTask, file.c_str(), lepton->GetWidth(), lepton->GetHeight()))
+			printf("recording %s\n", file.c_str());
+	}
+	else if (strcmp(argv[1], "stop") == 0) {
+		thermalRecorder.Close();
+	}
+	else if (strcmp(argv[1], "stat") == 0) {
+		thermalRecorder.PrintStats();
+	}
+	else if ((strcmp(argv[1], "verify") == 0) && (argc > 2)) {
+		ThermalReader reader;
+		if (!reader.Open(argv[2]))
+			return 0;
+
+		uint32_t count = reader.GetFrameCount();
+		std::vector<uint16_t> frame(reader.GetWidth() * reader.GetHeight());
+		std::vector<uint16_t> middle(frame.size());
+		uint64_t timestamp = 0;
+		uint32_t decoded = 0;
+		us_timestamp_t start = ticker_read_us(get_us_ticker_data());
+		for (; decoded < count; decoded++) {
+			if (!reader.ReadFrame(decoded, frame.data(), NULL, &timestamp))
+				break;
+			if (decoded == count / 2)
+				middle = frame;
+		}
+		us_timestamp_t elapse = ticker_read_us(get_us_ticker_data()) - start;
+		printf("%dx%d, %lu/%lu frames, %.1f s, decode avg %llu us\n", reader.GetWidth(), reader.GetHeight(),
+			(unsigned long)decoded, (unsigned long)count, timestamp / 1000000.0,
+			(decoded > 0) ? elapse / decoded : 0);
+
+		// 索引から途中のフレームを直接読んで、先頭から読んだものと比べる
+		if ((decoded == count) && (count > 0)) {
+			start = ticker_read_us(get_us_ticker_data());
+			bool match = reader.ReadFrame(count / 2, frame.data(), NULL, NULL) && (frame == middle);
+			elapse = ticker_read_us(get_us_ticker_data()) - start;
+			printf("seek frame %lu %s, %llu us\n", (unsigned long)(count / 2), match ? "ok" : "mismatch", elapse);
+		}
+	}
+
+	return 0;
+}
+
+extern "C" int usrcmd_storage(int argc, char **argv)
+{
+	storageTask.PrintStats();
+
+	return 0;
+}
+
+extern "C" int usrcmd_upload(int argc, char **argv)
+{
+	netTask.GetUploadQueue()->PrintStats();
+
+	return 0;
+}
+
+/*
+ * 記録したカメラ映像で変化検出による省略の効果を測る
+ * 毎フレーム処理した結果と、変化が無いときに前回の結果を使った場合を比べる。
+ */
+static void SceneChangeBench(const char *filename)
+{
+	const ticker_data_t *ticker = get_us_ticker_data();
+	StreamReader reader;
+	StreamChunkHeader chunk;
+	std::vector<uint8_t> payload;
+	FrameBus *bus = new FrameBus();
+	FrameSubscriber sub("bench");
+	uint32_t frames = 0, changed = 0;
+	uint32_t face_runs = 0, face_miss = 0, qr_runs = 0, qr_miss = 0;
+	us_timestamp_t face_full = 0, face_gated = 0, qr_full = 0, qr_gated = 0, start;
+	uint32_t face_seq = 0, qr_seq = 0;
+	bool face_last = false, qr_last = false;
+	Rect roi;
+	// FaceDetectTaskが使っている識別器とは別に読み込む
+	CascadeClassifier classifier;
+
+	if (!detectFaceLoad(classifier, FACE_DETECTOR_MODEL)) {
+		printf("cannot load %s\n", FACE_DETECTOR_MODEL);
+		delete bus;
+		return;
+	}
+	if (!reader.Open(filename)) {
+		printf("cannot open %s\n", filename);
+		delete bus;
 		return;
 	}
 
-	lcd_drawString(&lcd, addr, 0, 20, 0xFCCC, 0x0000);
+	bus->Subscribe(&sub);
+
+	while (reader.Next(StreamChunk::Video, &chunk, payload)) {
+		if (payload.size() < sizeof(StreamVideoInfo))
+			continue;
+		StreamVideoInfo *info = (StreamVideoInfo *)&payload[0];
+		bus->Publish(&payload[sizeof(StreamVideoInfo)], info->width, info->height,
+			info->stride, (StreamVideoFormat::T)info->format);
+
+		const FrameView *frame = bus->Acquire(&sub);
+		if (frame == NULL)
+			continue;
+		frames++;
+		if (frame->GetChangedTiles() != 0)
+			changed++;
+
+		Mat gray = frame->GetGrayMat();
+
+		start = ticker_read_us(ticker);
+		detectFace(classifier, gray, roi);
+		face_full += ticker_read_us(ticker) - start;
+		bool face = (roi.width > 0) && (roi.height > 0);
+
+		if (face_last || frame->IsChangedSince(face_seq)) {
+			// FaceDetectTaskと同じく、顔が無かった画面からは変化した所だけを探す
+			Rect search(0, 0, gray.cols, gray.rows);
+			if (!face_last)
+				search = FaceDetectTask::GetSearchRect(frame, bus->GetChangedTiles(frame, face_seq));
+			start = ticker_read_us(ticker);
+			detectFace(classifier, gray(search), roi);
+			face_gated += ticker_read_us(ticker) - start;
+			face_last = (roi.width > 0) && (roi.height > 0);
+			face_seq = frame->GetSeq();
+			face_runs++;
+		}
+		if (face_last != face)
+			face_miss++;
+
+		start = ticker_read_us(ticker);
+		bool qr = ZXingTask::DecodeFrame(frame);
+		qr_full += ticker_read_us(ticker) - start;
+
+		if (qr_last || frame->IsChangedSince(qr_seq)) {
+			start = ticker_read_us(ticker);
+			qr_last = ZXingTask::DecodeFrame(frame);
+			qr_gated += ticker_read_us(ticker) - start;
+			qr_seq = frame->GetSeq();
+			qr_runs++;
+		}
+		if (qr_last != qr)
+			qr_miss++;
+
+		bus->Release(frame);
+	}
+
+	delete bus;
+
+	printf("frames %lu, changed %lu\n", frames, changed);
+	printf("face: full %lluus, gated %lluus (%lu runs), miss %lu\n", face_full, face_gated, face_runs, face_miss);
+	printf("qr  : full %lluus, gated %lluus (%lu runs), miss %lu\n", qr_full, qr_gated, qr_runs, qr_miss);
+}
+
+extern "C" int usrcmd_bus(int argc, char **argv)
+{
+	if (argc < 2) {
+		frameBus.PrintStats();
+		return 0;
+	}
+
+	if ((strcmp(argv[1], "bench") == 0) && (argc > 2)) {
+		SceneChangeBench(argv[2]);
+	}
+	else {
+		printf("bus [bench <file>] \n");
+	}
+
+	return 0;
+}
+
+extern "C" int usrcmd_zx(int argc, char **argv)
+{
+	if (argc < 2) {
+		printf("binarizer %s\n", ZXingBinarizer::GetName(zxingTask.GetBinarizer()));
+		zxingTask.PrintTrackStats();
+		return 0;
+	}
 
-	// The structure to manage the QR code
-	QRCode qrcode;
-
-	// Allocate a chunk of memory to store the QR code
-	uint8_t *qrcodeBytes = (uint8_t *)malloc(qrcode_getBufferSize(3));
-	if (qrcodeBytes != NULL) {
-	qrcode_initText(&qrcode, qrcodeBytes, 3, ECC_LOW, addr);
-
-	for (int y = 0; y < qrcode.size; y++) {
-		for (int x = 0; x < qrcode.size; x++) {
-			if (qrcode_getModule(&qrcode, x, y)) {
-					lcd_fillRect(&lcd, 2 * x + 32, 2 * y + 32, 2, 2, 0xF000);
-					//lcd_drawPixel(&lcd, x, y, 0xFFFF);
-				}
-				else {
-					lcd_fillRect(&lcd, 2 * x + 32, 2 * y + 32, 2, 2, 0xCCCC);
-				//lcd_drawPixel(&lcd, x, y, 0xFFFF);
+	if (strcmp(argv[1], "global") == 0) {
+		zxingTask.SetBinarizer(ZXingBinarizer::Global);
+	}
+	else if (strcmp(argv[1], "hybrid") == 0) {
+		zxingTask.SetBinarizer(ZXingBinarizer::Hybrid);
+	}
+	else if (strcmp(argv[1], "auto") == 0) {
+		zxingTask.SetBinarizer(ZXingBinarizer::Auto);
+	}
+	else if ((strcmp(argv[1], "track") == 0) && (argc > 2)) {
+		zxingTask.SetTracking(strcmp(argv[2], "on") == 0);
+	}
+	else if ((strcmp(argv[1], "bench") == 0) && (argc > 2)) {
+		ZXingBinarizerBench(argv[2]);
+	}
+	else if (strcmp(argv[1], "sample") == 0) {
+		ZXingSamplerBench();
+	}
+	else if (strcmp(argv[1], "rs") == 0) {
+		ZXingReedSolomonBench();
+	}
+	else if ((strcmp(argv[1], "multi") == 0) && (argc > 2)) {
+		zxingTask.SetMulti(strcmp(argv[2], "on") == 0);
+	}
+	else if ((strcmp(argv[1], "formats") == 0) && (argc > 2)) {
+		uint32_t formats = 0;
+		for (int i = 2; i < argc; i++) {
+			uint32_t hints = ZXingScheduler::GetFormatHints(argv[i]);
+			if (hints == 0) {
+				printf("unknown format %s\n", argv[i]);
+				return 0;
 			}
+			formats |= hints;
 		}
-		}
+		zxingTask.SetFormats(formats);
+	}
+	else if (strcmp(argv[1], "pool") == 0) {
+		zxingTask.PrintPoolStats();
+	}
+	else if ((strcmp(argv[1], "corpus") == 0) && (argc > 2)) {
+		const char *save = NULL, *baseline = NULL;
+		for (int i = 3; i + 1 < argc; i += 2) {
+			if (strcmp(argv[i], "save") == 0)
+				save = argv[i + 1];
+			else if (strcmp(argv[i], "cmp") == 0)
+				baseline = argv[i + 1];
+		}
+		ZXingCorpusBench(argv[2], zxingTask.GetBinarizer(), save, baseline);
+	}
+	else {
+		printf("zx [global | hybrid | auto | track <on | off> | bench <file> | sample | rs | multi <on | off> | formats <qr | datamatrix | aztec | pdf417 | 1d>... | pool | corpus <list> [save <file>] [cmp <file>]]\n");
+	}
+
+	return 0;
+}
+
+// 読めたコードを2倍の大きさで描く（同じ文字列の間は覚えた絵を写すだけ）
+static QRCodeSprite qrcodeSprite(3, ECC_LOW, 2, 0xF000, 0xCCCC);
 
-		free(qrcodeBytes);
+void zxing_callback(const char *addr, int size, int first)
+{
+	if (size <= 0) {
+		lcd_fillRect(&lcd, 0, 20, lcd._width / 2, lcd._height / 2, 0x0000);
+		return;
 	}
+
+	// 文字は全てのコードを、QRコードは先頭のコードだけを描く
+	lcd_drawString(&lcd, addr, 0, 20, 0xFCCC, 0x0000);
+
+	qrcodeSprite.Draw(&lcd, 32, 32, addr, first);
 }
 
 int main()
@@ -520,6 +877,7 @@ int main()
 	globalState.sensorTask = &sensorTask;
 	globalState.leptonTask = &leptonTask;
 	globalState.zxingTask = &zxingTask;
+	globalState.storageTask = &storageTask;
 
 	uint8_t touch_num = 0;
 	TouchKey::touch_pos_t touch_pos[TOUCH_NUM];
@@ -537,8 +895,13 @@ int main()
 	faceDetectTask.Init(FACE_DETECTOR_MODEL);
 	lepton = leptonTask.GetLeptonTask();
 	lepton->SetConfig(&config.lepton);
+	lepton->SetStorage(&storageTask);
 	zxingTask.Init(zxing_callback);
 
+	// 電源が切れる前に送れなかったファイルを、書き込みスレッドが追加を始める前に戻す
+	netTask.GetUploadQueue()->Load();
+
+	storageTask.Start();
 	netTask.Start();
 	sensorTask.Start();
 	mediaTask.Start();
@@ -10,6 +10,8 @@
 #include "SdUsbConnect.h"
 #include "TLV320_RBSP.h"
 #include "EasyAttach_CameraAndLCD.h"
+#include "StreamRecord.h"
+#include <io.h>
 
 DisplayBase::DisplayBase()
 {
@@ -85,26 +87,49 @@ DisplayBase::graphics_error_t DisplayBase::Video_Write_Setting(
 		(DRV_VIDEO_ADC_VINSEL)video_adc_vinsel);
 }
 
-R_BSP_Ssif::R_BSP_Ssif(PinName sck, PinName ws, PinName tx, PinName rx, PinName audio_clk)
+R_BSP_Ssif::R_BSP_Ssif(PinName sck, PinName ws, PinName tx, PinName rx, PinName audio_clk) :
+	_sample_freq(44100)
 {
 	TestBench->i2s_init(&_i2s, tx, rx, sck, ws, audio_clk);
 }
 
 void R_BSP_Ssif::init(ssif_channel_cfg_t *cfg, int32_t max_write_num, int32_t max_read_num)
 {
+	_sample_freq = cfg->sample_freq;
 	TestBench->i2s_config(&_i2s, cfg, max_write_num, max_read_num);
 }
 
 void R_BSP_Ssif::ConfigChannel(ssif_channel_cfg_t *cfg)
 {
+	_sample_freq = cfg->sample_freq;
 	TestBench->i2s_config_channel(&_i2s, cfg);
 }
 
 int32_t R_BSP_Ssif::read(void * const p_data, uint32_t data_size, const rbsp_data_conf_t * const p_data_conf)
 {
+	if (streamReplay.IsActive())
+		return streamReplay.ReadPcm(p_data, data_size, p_data_conf);
+
+	// 記録中は完了通知を横取りしてPCMを保存してから元の通知先に渡す
+	if (streamRecorder.IsRecording()) {
+		_read_conf = *p_data_conf;
+		return TestBench->i2s_read(&_i2s, (uint8_t *)p_data, data_size, (intptr_t)&R_BSP_Ssif::read_end_tap, (intptr_t)this);
+	}
+
 	return TestBench->i2s_read(&_i2s, (uint8_t *)p_data, data_size, (intptr_t)p_data_conf->p_notify_func, (intptr_t)p_data_conf->p_app_data);
 }
 
+void R_BSP_Ssif::read_end_tap(void *p_data, int32_t result, void *p_app_data)
+{
+	R_BSP_Ssif *self = (R_BSP_Ssif *)p_app_data;
+
+	if ((result > 0) && streamRecorder.IsRecording())
+		streamRecorder.WritePcm(p_data, result, self->_sample_freq, 2);
+
+	if (self->_read_conf.p_notify_func != NULL)
+		self->_read_conf.p_notify_func(p_data, result, self->_read_conf.p_app_data);
+}
+
 int32_t R_BSP_Ssif::write(void * const p_data, uint32_t data_size, const rbsp_data_conf_t * const p_data_conf)
 {
 	return TestBench->i2s_write(&_i2s, (uint8_t *)p_data, data_size, (intptr_t)p_data_conf->p_notify_func, (intptr_t)p_data_conf->p_app_data);
@@ -123,6 +148,16 @@ int mkdir(char const *name, mode_t mode)
 	return 0;
 }
 
+int ftruncate(int fd, long length)
+{
+	return _chsize(fd, length);
+}
+
+int fsync(int fd)
+{
+	return _commit(fd);
+}
+
 int set_time(time_t tm)
 {
 	return 0;
@@ -220,11 +220,21 @@ static void bb_initGrid(BitBucket *bitGrid, uint8_t *data, uint8_t size)
 
 static void bb_appendBits(BitBucket *bitBuffer, uint32_t val, uint8_t length)
 {
+	// Merge the partial last byte and the new bits in one 32-bit word and store
+	// the bytes it covers; callers append at most 16 bits, so 7 + 16 fit.
+	// The bytes after the partial one are still zero from bb_initBuffer.
+	if (length == 0) {
+		return;
+	}
 	uint32_t offset = bitBuffer->bitOffsetOrWidth;
-	for (int8_t i = length - 1; i >= 0; i--, offset++) {
-		bitBuffer->data[offset >> 3] |= ((val >> i) & 1) << (7 - (offset & 7));
+	uint8_t *p = &bitBuffer->data[offset >> 3];
+	uint8_t used = offset & 7;
+	uint32_t word = ((uint32_t)p[0] << 24) | ((val & ((1u << length) - 1)) << (32 - used - length));
+	uint8_t bytes = (used + length + 7) >> 3;
+	for (uint8_t i = 0; i < bytes; i++) {
+		p[i] = (uint8_t)(word >> (24 - 8 * i));
 	}
-	bitBuffer->bitOffsetOrWidth = offset;
+	bitBuffer->bitOffsetOrWidth = offset + length;
 }
 /*
 void bb_setBits(BitBucket *bitBuffer, uint32_t val, int offset, uint8_t length) {
@@ -245,53 +255,69 @@ static void bb_setBit(BitBucket *bitGrid, uint8_t x, uint8_t y, bool on)
 	}
 }
 
-static void bb_invertBit(BitBucket *bitGrid, uint8_t x, uint8_t y, bool invert)
+static bool bb_getBit(BitBucket *bitGrid, uint8_t x, uint8_t y)
 {
 	uint32_t offset = y * bitGrid->bitOffsetOrWidth + x;
-	uint8_t mask = 1 << (7 - (offset & 0x07));
-	bool on = ((bitGrid->data[offset >> 3] & (1 << (7 - (offset & 0x07)))) != 0);
-	if (on ^ invert) {
-		bitGrid->data[offset >> 3] |= mask;
-	}
-	else {
-		bitGrid->data[offset >> 3] &= ~mask;
-	}
+	return (bitGrid->data[offset >> 3] & (1 << (7 - (offset & 0x07)))) != 0;
 }
 
-static bool bb_getBit(BitBucket *bitGrid, uint8_t x, uint8_t y)
+// Unpacks row y of the grid into one byte (0 or 1) per module, reading each grid byte once
+static void bb_getRow(BitBucket *bitGrid, uint8_t y, uint8_t *row)
 {
-	uint32_t offset = y * bitGrid->bitOffsetOrWidth + x;
-	return (bitGrid->data[offset >> 3] & (1 << (7 - (offset & 0x07)))) != 0;
+	uint8_t size = bitGrid->bitOffsetOrWidth;
+	uint32_t offset = y * size;
+	const uint8_t *data = &bitGrid->data[offset >> 3];
+	uint8_t left = 8 - (offset & 7);
+	uint8_t byte = *data++ << (offset & 7);
+	for (uint8_t x = 0; x < size; x++) {
+		if (left == 0) {
+			byte = *data++;
+			left = 8;
+		}
+		row[x] = byte >> 7;
+		byte <<= 1;
+		left--;
+	}
 }
 
 
 #pragma mark - Drawing Patterns
 
+static bool getMaskBit(uint8_t mask, uint8_t x, uint8_t y)
+{
+	switch (mask) {
+	case 0:  return (x + y) % 2 == 0;
+	case 1:  return y % 2 == 0;
+	case 2:  return x % 3 == 0;
+	case 3:  return (x + y) % 3 == 0;
+	case 4:  return (x / 3 + y / 2) % 2 == 0;
+	case 5:  return x * y % 2 + x * y % 3 == 0;
+	case 6:  return (x * y % 2 + x * y % 3) % 2 == 0;
+	case 7:  return ((x + y) % 2 + x * y % 3) % 2 == 0;
+	}
+	return false;
+}
+
 // XORs the data modules in this QR Code with the given mask pattern. Due to XOR's mathematical
 // properties, calling applyMask(m) twice with the same value is equivalent to no change at all.
-// This means it is possible to apply a mask, undo it, and try another mask. Note that a final
-// well-formed QR Code symbol needs exactly one mask applied (not zero, not two, etc.).
+// Note that a final well-formed QR Code symbol needs exactly one mask applied (not zero, not two, etc.).
+// The pattern is built a byte at a time and the function modules are masked out with one AND.
 static void applyMask(BitBucket *modules, BitBucket *isFunction, uint8_t mask)
 {
 	uint8_t size = modules->bitOffsetOrWidth;
-
-	for (uint8_t y = 0; y < size; y++) {
-		for (uint8_t x = 0; x < size; x++) {
-			if (bb_getBit(isFunction, x, y)) { continue; }
-
-			bool invert = 0;
-			switch (mask) {
-			case 0:  invert = (x + y) % 2 == 0;                    break;
-			case 1:  invert = y % 2 == 0;                          break;
-			case 2:  invert = x % 3 == 0;                          break;
-			case 3:  invert = (x + y) % 3 == 0;                    break;
-			case 4:  invert = (x / 3 + y / 2) % 2 == 0;            break;
-			case 5:  invert = x * y % 2 + x * y % 3 == 0;          break;
-			case 6:  invert = (x * y % 2 + x * y % 3) % 2 == 0;    break;
-			case 7:  invert = ((x + y) % 2 + x * y % 3) % 2 == 0;  break;
+	uint16_t bytes = bb_getGridSizeBytes(size);
+
+	uint8_t x = 0, y = 0;
+	for (uint16_t i = 0; i < bytes; i++) {
+		uint8_t invert = 0;
+		for (uint8_t bit = 0x80; bit != 0 && y < size; bit >>= 1) {
+			if (getMaskBit(mask, x, y)) { invert |= bit; }
+			if (++x == size) {
+				x = 0;
+				y++;
 			}
-			bb_invertBit(modules, x, y, invert);
 		}
+		modules->data[i] ^= invert & ~isFunction->data[i];
 	}
 }
 
@@ -507,91 +533,92 @@ static void drawCodewords(BitBucket *modules, BitBucket *isFunction, BitBucket *
 #define PENALTY_N3     40
 #define PENALTY_N4     10
 
-// Calculates and returns the penalty score based on state of this QR Code's current modules.
-// This is used by the automatic mask choice algorithm to find the mask pattern that yields the lowest score.
-// @TODO: This can be optimized by working with the bytes instead of bits.
-static uint32_t getPenaltyScore(BitBucket * modules)
+#define MAX_SIZE      (40 * 4 + 17)
+
+// Calculates and returns the penalty score of this QR Code's modules as they would be with
+// the given mask applied. This is used by the automatic mask choice algorithm to find the mask
+// pattern that yields the lowest score.
+// The grid is not modified: each row is unpacked once, masked, and all four rules are updated
+// from it. Columns keep their current run and last 11 modules, and the 2*2 rule looks at the
+// row above, so the score is accumulated incrementally in a single pass.
+static uint32_t getPenaltyScore(BitBucket *modules, BitBucket *isFunction, uint8_t mask)
 {
 	uint32_t result = 0;
 
 	uint8_t size = modules->bitOffsetOrWidth;
 
-	// Adjacent modules in row having same color
+	uint8_t rows[2][MAX_SIZE];
+	uint8_t function[MAX_SIZE];
+	uint8_t runY[MAX_SIZE];
+	uint16_t bitsCol[MAX_SIZE];
+
+	uint16_t black = 0;
 	for (uint8_t y = 0; y < size; y++) {
+		uint8_t *row = rows[y & 1];
+		uint8_t *above = rows[(y & 1) ^ 1];
+		bb_getRow(modules, y, row);
+		bb_getRow(isFunction, y, function);
+		for (uint8_t x = 0; x < size; x++) {
+			if (!function[x] && getMaskBit(mask, x, y)) { row[x] ^= 1; }
+		}
 
-		bool colorX = bb_getBit(modules, 0, y);
-		for (uint8_t x = 1, runX = 1; x < size; x++) {
-			bool cx = bb_getBit(modules, x, y);
-			if (cx != colorX) {
-				colorX = cx;
-				runX = 1;
+		uint8_t runX = 1;
+		uint16_t bitsRow = 0;
+		for (uint8_t x = 0; x < size; x++) {
+			uint8_t color = row[x];
 
-			}
-			else {
-				runX++;
-				if (runX == 5) {
-					result += PENALTY_N1;
+			// Adjacent modules in row having same color
+			if (x > 0) {
+				if (color != row[x - 1]) {
+					runX = 1;
 				}
-				else if (runX > 5) {
-					result++;
+				else {
+					runX++;
+					if (runX == 5) {
+						result += PENALTY_N1;
+					}
+					else if (runX > 5) {
+						result++;
+					}
 				}
 			}
-		}
-	}
 
-	// Adjacent modules in column having same color
-	for (uint8_t x = 0; x < size; x++) {
-		bool colorY = bb_getBit(modules, x, 0);
-		for (uint8_t y = 1, runY = 1; y < size; y++) {
-			bool cy = bb_getBit(modules, x, y);
-			if (cy != colorY) {
-				colorY = cy;
-				runY = 1;
+			// Adjacent modules in column having same color
+			if (y == 0) {
+				runY[x] = 1;
+			}
+			else if (color != above[x]) {
+				runY[x] = 1;
 			}
 			else {
-				runY++;
-				if (runY == 5) {
+				runY[x]++;
+				if (runY[x] == 5) {
 					result += PENALTY_N1;
 				}
-				else if (runY > 5) {
+				else if (runY[x] > 5) {
 					result++;
 				}
 			}
-		}
-	}
-
-	uint16_t black = 0;
-	for (uint8_t y = 0; y < size; y++) {
-		uint16_t bitsRow = 0, bitsCol = 0;
-		for (uint8_t x = 0; x < size; x++) {
-			bool color = bb_getBit(modules, x, y);
 
 			// 2*2 blocks of modules having same color
 			if (x > 0 && y > 0) {
-				bool colorUL = bb_getBit(modules, x - 1, y - 1);
-				bool colorUR = bb_getBit(modules, x, y - 1);
-				bool colorL = bb_getBit(modules, x - 1, y);
-				if (color == colorUL && color == colorUR && color == colorL) {
+				if (color == above[x - 1] && color == above[x] && color == row[x - 1]) {
 					result += PENALTY_N2;
 				}
 			}
 
-			// Finder-like pattern in rows and columns
+			// Finder-like pattern in rows and columns (needs 11 bits accumulated)
 			bitsRow = ((bitsRow << 1) & 0x7FF) | color;
-			bitsCol = ((bitsCol << 1) & 0x7FF) | bb_getBit(modules, y, x);
-
-			// Needs 11 bits accumulated
-			if (x >= 10) {
-				if (bitsRow == 0x05D || bitsRow == 0x5D0) {
-					result += PENALTY_N3;
-				}
-				if (bitsCol == 0x05D || bitsCol == 0x5D0) {
-					result += PENALTY_N3;
-				}
+			if (x >= 10 && (bitsRow == 0x05D || bitsRow == 0x5D0)) {
+				result += PENALTY_N3;
+			}
+			bitsCol[x] = (y == 0) ? color : (((bitsCol[x] << 1) & 0x7FF) | color);
+			if (y >= 10 && (bitsCol[x] == 0x05D || bitsCol[x] == 0x5D0)) {
+				result += PENALTY_N3;
 			}
 
 			// Balance of black and white modules
-			if (color) { black++; }
+			black += color;
 		}
 	}
 
@@ -727,6 +754,18 @@ static int8_t encodeDataCodewords(BitBucket *dataCodewords, const uint8_t *text,
 	return mode;
 }
 
+// Number of bits encodeDataCodewords() will append for this text
+static uint32_t getEncodedBits(const uint8_t *text, uint16_t length, uint8_t version)
+{
+	if (isNumeric((char *)text, length)) {
+		return 4 + getModeBits(version, MODE_NUMERIC) + length / 3 * 10 + (length % 3 == 0 ? 0 : length % 3 * 3 + 1);
+	}
+	if (isAlphanumeric((char *)text, length)) {
+		return 4 + getModeBits(version, MODE_ALPHANUMERIC) + length / 2 * 11 + length % 2 * 6;
+	}
+	return 4 + getModeBits(version, MODE_BYTE) + length * 8;
+}
+
 static void performErrorCorrection(uint8_t version, uint8_t ecc, BitBucket *data)
 {
 
@@ -817,7 +856,6 @@ uint16_t qrcode_getBufferSize(uint8_t version)
 	return bb_getGridSizeBytes(4 * version + 17);
 }
 
-// @TODO: Return error if data is too big.
 int8_t qrcode_initBytes(QRCode *qrcode, uint8_t *modules, uint8_t version, uint8_t ecc, uint8_t *data, uint16_t length)
 {
 	uint8_t size = version * 4 + 17;
@@ -837,6 +875,9 @@ int8_t qrcode_initBytes(QRCode *qrcode, uint8_t *modules, uint8_t version, uint8
 	uint16_t dataCapacity = moduleCount / 8 - NUM_ERROR_CORRECTION_CODEWORDS[eccFormatBits];
 #endif
 
+	// Data that does not fit would be written past the codeword buffer
+	if (getEncodedBits(data, length, version) > dataCapacity * 8u) { return -1; }
+
 	struct BitBucket codewords;
 	int32_t bufsize = bb_getBufferSizeBytes(moduleCount);
 	uint8_t *codewordBytes = new uint8_t[bufsize];
@@ -845,7 +886,10 @@ int8_t qrcode_initBytes(QRCode *qrcode, uint8_t *modules, uint8_t version, uint8
 	// Place the data code words into the buffer
 	int8_t mode = encodeDataCodewords(&codewords, data, length, version);
 
-	if (mode < 0) { return -1; }
+	if (mode < 0) {
+		delete[] codewordBytes;
+		return -1;
+	}
 	qrcode->mode = mode;
 
 	// Add terminator and pad up to a byte if applicable
@@ -876,13 +920,11 @@ int8_t qrcode_initBytes(QRCode *qrcode, uint8_t *modules, uint8_t version, uint8
 	int32_t minPenalty = INT32_MAX;
 	for (uint8_t i = 0; i < 8; i++) {
 		drawFormatBits(&modulesGrid, &isFunctionGrid, eccFormatBits, i);
-		applyMask(&modulesGrid, &isFunctionGrid, i);
-		int penalty = getPenaltyScore(&modulesGrid);
+		int penalty = getPenaltyScore(&modulesGrid, &isFunctionGrid, i);
 		if (penalty < minPenalty) {
 			mask = i;
 			minPenalty = penalty;
 		}
-		applyMask(&modulesGrid, &isFunctionGrid, i);  // Undoes the mask due to XOR
 	}
 
 	qrcode->mask = mask;
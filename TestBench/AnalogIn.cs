@@ -1,9 +1,17 @@
-﻿namespace TestBench
+﻿using System;
+
+namespace TestBench
 {
 	public class AnalogIn : IUnitInterface
 	{
 		internal ADCName adc;
 		internal PinName pin;
+		ushort value;
+		ushort low;
+		ushort high;
+		bool state;
+		GpioIrqHandler handler;
+		IntPtr id;
 
 		public AnalogIn(ADCName adc, PinName pin)
 		{
@@ -15,11 +23,42 @@
 
 		public string InterfaceName => adc.ToString();
 
-		public ushort Value { get; internal set; }
+		public ushort Value {
+			get { return value; }
+			internal set {
+				this.value = value;
+				Compare();
+			}
+		}
 
 		internal ushort Read()
 		{
 			return Value;
 		}
+
+		internal void SetComparator(ushort low, ushort high, GpioIrqHandler handler, IntPtr id)
+		{
+			this.low = low;
+			this.high = high;
+			this.id = id;
+			state = value >= (low + high) / 2;
+			this.handler = handler;
+		}
+
+		// ヒステリシス付きコンパレータ、閾値を横切ったときだけ通知する
+		private void Compare()
+		{
+			if (handler == null)
+				return;
+
+			if (!state && (value > high)) {
+				state = true;
+				handler(id, gpio_irq_event.IRQ_RISE);
+			}
+			else if (state && (value < low)) {
+				state = false;
+				handler(id, gpio_irq_event.IRQ_FALL);
+			}
+		}
 	}
 }
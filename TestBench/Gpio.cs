@@ -8,6 +8,7 @@ namespace TestBench
 		PinMode mode;
 		PinDirection direction;
 		int value;
+		internal Action<PinName, bool> ValueChanged;
 
 		internal Gpio(PinName pin)
 		{
@@ -21,7 +22,7 @@ namespace TestBench
 
 		public bool Value {
 			get { return value != 0; }
-			set { this.value = value ? 1 : 0; }
+			set { Write(value ? 1 : 0); }
 		}
 
 		public static string GetString(PinName pin)
@@ -78,7 +79,13 @@ namespace TestBench
 
 		internal void Write(int value)
 		{
+			bool changed = (this.value != 0) != (value != 0);
+
 			this.value = value;
+
+			if (changed) {
+				ValueChanged?.Invoke(pin, value != 0);
+			}
 		}
 
 		internal int Read()
@@ -0,0 +1,41 @@
+﻿using System;
+
+namespace TestBench
+{
+	public class GpioIrq : IUnitInterface
+	{
+		internal PinName pin;
+		GpioIrqHandler handler;
+		IntPtr id;
+		bool rise;
+		bool fall;
+
+		internal GpioIrq(PinName pin, GpioIrqHandler handler, IntPtr id)
+		{
+			this.pin = pin;
+			this.handler = handler;
+			this.id = id;
+			InterfaceName = "IRQ_" + Gpio.GetString(pin);
+		}
+
+		public string TypeName => "GpioIrq";
+
+		public string InterfaceName { get; }
+
+		internal void Set(gpio_irq_event evt, bool enable)
+		{
+			switch (evt) {
+			case gpio_irq_event.IRQ_RISE: rise = enable; break;
+			case gpio_irq_event.IRQ_FALL: fall = enable; break;
+			}
+		}
+
+		internal void Notify(bool value)
+		{
+			if (value && rise)
+				handler(id, gpio_irq_event.IRQ_RISE);
+			else if (!value && fall)
+				handler(id, gpio_irq_event.IRQ_FALL);
+		}
+	}
+}
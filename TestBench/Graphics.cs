@@ -57,20 +57,16 @@ namespace TestBench
 				return;
 
 			var data = bitmap.LockBits(new Rectangle(0, 0, bitmap.Width, bitmap.Height), ImageLockMode.WriteOnly, bitmap.PixelFormat);
+			var pin = (clut != null) ? GCHandle.Alloc(clut, GCHandleType.Pinned) : default(GCHandle);
 			try {
-				switch (gr_format) {
-				case DRV_GRAPHICS_FORMAT.YCBCR422:
-					PeachCam.ARGB8888FromYCBCR422(data.Scan0, framebuff, data.Width, data.Height);
-					break;
-				case DRV_GRAPHICS_FORMAT.ARGB4444:
-					PeachCam.ARGB8888FromARGB4444(data.Scan0, framebuff, data.Width, data.Height);
-					break;
-				case DRV_GRAPHICS_FORMAT.ARGB8888:
-					Marshal.Copy(new IntPtr[] { framebuff }, 0, data.Scan0, 4 * data.Width * data.Height);
-					break;
-				}
+				var clut_ptr = pin.IsAllocated ? pin.AddrOfPinnedObject() : IntPtr.Zero;
+				var clut_count = (clut != null) ? clut.Length / 4 : 0;
+				PeachCam.ARGB8888FromGraphics(data.Scan0, data.Stride, framebuff, (int)fb_stride,
+					data.Width, data.Height, gr_format, wr_rd_swa, clut_ptr, clut_count);
 			}
 			finally {
+				if (pin.IsAllocated)
+					pin.Free();
 				bitmap.UnlockBits(data);
 			}
 
@@ -96,7 +92,7 @@ namespace TestBench
 		{
 			layers[0] = new GraphicLayer();
 			layers[0].debug = true;
-			layers[1] = null;
+			layers[1] = new GraphicLayer();
 			layers[2] = new GraphicLayer();
 			layers[3] = new GraphicLayer();
 			layers[2].debug = true;
@@ -170,10 +166,18 @@ namespace TestBench
 		}
 
 		IntPtr framebuff;
+		uint fb_stride;
+		DRV_VIDEO_FORMAT video_format;
+		ushort video_write_buff_vw;
+		ushort video_write_buff_hw;
 
 		internal GRAPHICS VideoWriteSetting(VIDEO_INPUT input, DRV_COL_SYS col_sys, IntPtr framebuff, uint fb_stride, DRV_VIDEO_FORMAT video_format, DRV_WR_RD wr_rd_swa, ushort video_write_buff_vw, ushort video_write_buff_hw, DRV_VIDEO_ADC_VINSEL video_adc_vinsel)
 		{
 			this.framebuff = framebuff;
+			this.fb_stride = fb_stride;
+			this.video_format = video_format;
+			this.video_write_buff_vw = video_write_buff_vw;
+			this.video_write_buff_hw = video_write_buff_hw;
 			return GRAPHICS.OK;
 		}
 
@@ -183,7 +187,8 @@ namespace TestBench
 				return null;
 
 			if (video != null) {
-				video.Capture(framebuff, bitmap.Width, bitmap.Height);
+				// Keeps the previous image until the camera delivers a new frame
+				video.Capture(framebuff, (int)fb_stride, video_write_buff_hw, video_write_buff_vw, video_format);
 			}
 
 			using (var canvas = System.Drawing.Graphics.FromImage(bitmap)) {
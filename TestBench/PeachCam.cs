@@ -57,6 +57,10 @@ namespace TestBench
 		private delegate void TARGB8888FromYCBCR422(IntPtr dst, IntPtr src, int width, int height);
 		static TARGB8888FromYCBCR422 m_ARGB8888FromYCBCR422;
 		[UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+		private delegate bool TARGB8888FromGraphics(IntPtr dst, int dst_stride, IntPtr src, int src_stride,
+			int width, int height, DRV_GRAPHICS_FORMAT format, DRV_WR_RD swa, IntPtr clut, int clut_count);
+		static TARGB8888FromGraphics m_ARGB8888FromGraphics;
+		[UnmanagedFunctionPointer(CallingConvention.Cdecl)]
 		private delegate void TEnumerateDevices();
 		static TEnumerateDevices m_EnumerateDevices;
 		[UnmanagedFunctionPointer(CallingConvention.Cdecl)]
@@ -72,7 +76,7 @@ namespace TestBench
 		private delegate void Tvideoio_VideoCapture_delete(IntPtr ptr);
 		static Tvideoio_VideoCapture_delete m_videoio_VideoCapture_delete;
 		[UnmanagedFunctionPointer(CallingConvention.Cdecl)]
-		private delegate bool TVideoCapture_Capture(IntPtr ptr, IntPtr dst, int width, int height);
+		private delegate bool TVideoCapture_Capture(IntPtr ptr, IntPtr dst, int stride, int width, int height, DRV_VIDEO_FORMAT format);
 		static TVideoCapture_Capture m_VideoCapture_Capture;
 		[UnmanagedFunctionPointer(CallingConvention.Cdecl)]
 		private delegate void TStdin([In, MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 1)]byte[] data, int length);
@@ -121,6 +125,7 @@ namespace TestBench
 			m_Stop = DllImport.GetFunction<TStop>(m_Module, "Stop");
 			m_ARGB8888FromARGB4444 = DllImport.GetFunction<TARGB8888FromARGB4444>(m_Module, "ARGB8888FromARGB4444");
 			m_ARGB8888FromYCBCR422 = DllImport.GetFunction<TARGB8888FromYCBCR422>(m_Module, "ARGB8888FromYCBCR422");
+			m_ARGB8888FromGraphics = DllImport.GetFunction<TARGB8888FromGraphics>(m_Module, "ARGB8888FromGraphics");
 			m_videoio_VideoCapture_new1 = DllImport.GetFunction<Tvideoio_VideoCapture_new1>(m_Module, "videoio_VideoCapture_new1");
 			m_videoio_VideoCapture_open2 = DllImport.GetFunction<Tvideoio_VideoCapture_open2>(m_Module, "videoio_VideoCapture_open2");
 			m_videoio_VideoCapture_release = DllImport.GetFunction<Tvideoio_VideoCapture_release>(m_Module, "videoio_VideoCapture_release");
@@ -151,6 +156,12 @@ namespace TestBench
 			m_ARGB8888FromYCBCR422(dst, src, width, height);
 		}
 
+		public static bool ARGB8888FromGraphics(IntPtr dst, int dst_stride, IntPtr src, int src_stride,
+			int width, int height, DRV_GRAPHICS_FORMAT format, DRV_WR_RD swa, IntPtr clut, int clut_count)
+		{
+			return m_ARGB8888FromGraphics(dst, dst_stride, src, src_stride, width, height, format, swa, clut, clut_count);
+		}
+
 		public static void EnumerateDevices()
 		{
 			m_EnumerateDevices();
@@ -176,9 +187,9 @@ namespace TestBench
 			m_videoio_VideoCapture_delete(ptr);
 		}
 
-		public static bool VideoCapture_Capture(IntPtr ptr, IntPtr dst, int width, int height)
+		public static bool VideoCapture_Capture(IntPtr ptr, IntPtr dst, int stride, int width, int height, DRV_VIDEO_FORMAT format)
 		{
-			return m_VideoCapture_Capture(ptr, dst, width, height);
+			return m_VideoCapture_Capture(ptr, dst, stride, width, height, format);
 		}
 
 		internal static void Stdin(byte[] data)
@@ -18,6 +18,7 @@ namespace TestBench
 	{
 		private Dictionary<int, IUnitInterface> interfaces = new Dictionary<int, IUnitInterface>();
 		private Dictionary<PinName, IUnitInterface> pin_if = new Dictionary<PinName, IUnitInterface>();
+		private Dictionary<PinName, List<GpioIrq>> pin_irq = new Dictionary<PinName, List<GpioIrq>>();
 
 		public IEnumerable<IUnitInterface> Interfaces => interfaces.Values;
 		public List<Tuple<int, string, string>> VideoDevices { get; } = new List<Tuple<int, string, string>>();
@@ -60,6 +61,7 @@ namespace TestBench
 					throw new ArgumentException();
 				}
 				uif = new Gpio(pin);
+				((Gpio)uif).ValueChanged = GpioValueChanged;
 				obj.id = uif.GetHashCode();
 				interfaces.Add(obj.id, uif);
 
@@ -353,6 +355,56 @@ namespace TestBench
 			PinMap.PinMode(pin, mode);
 		}
 
+		private void GpioValueChanged(PinName pin, bool value)
+		{
+			if (!pin_irq.TryGetValue(pin, out var irqs))
+				return;
+
+			foreach (var irq in irqs) {
+				irq.Notify(value);
+			}
+		}
+
+		public void gpio_irq_init(ref gpio_irq_t obj, PinName pin, GpioIrqHandler handler, IntPtr id)
+		{
+			if (pin == PinName.NC)
+				return;
+
+			if (!interfaces.TryGetValue(obj.id, out var uif)) {
+				uif = new GpioIrq(pin, handler, id);
+				obj.id = uif.GetHashCode();
+				interfaces.Add(obj.id, uif);
+
+				if (!pin_irq.TryGetValue(pin, out var irqs)) {
+					irqs = new List<GpioIrq>();
+					pin_irq.Add(pin, irqs);
+				}
+				irqs.Add((GpioIrq)uif);
+			}
+		}
+
+		public void gpio_irq_free(ref gpio_irq_t obj)
+		{
+			if (!interfaces.TryGetValue(obj.id, out var uif)) {
+				throw new ArgumentException();
+			}
+
+			var irq = (GpioIrq)uif;
+			if (pin_irq.TryGetValue(irq.pin, out var irqs)) {
+				irqs.Remove(irq);
+			}
+			interfaces.Remove(obj.id);
+		}
+
+		public void gpio_irq_set(ref gpio_irq_t obj, gpio_irq_event evt, int enable)
+		{
+			if (!interfaces.TryGetValue(obj.id, out var uif)) {
+				throw new ArgumentException();
+			}
+
+			((GpioIrq)uif).Set(evt, enable != 0);
+		}
+
 		public void analogin_init(ref analogin_t obj, PinName pin)
 		{
 			CreateAnalogIn(ref obj, pin);
@@ -376,6 +428,15 @@ namespace TestBench
 			return ((AnalogIn)uif).Read();
 		}
 
+		public void analogin_comparator(ref analogin_t obj, ushort low, ushort high, GpioIrqHandler handler, IntPtr id)
+		{
+			if (!interfaces.TryGetValue(obj.id, out var uif)) {
+				throw new ArgumentException();
+			}
+
+			((AnalogIn)uif).SetComparator(low, high, handler, id);
+		}
+
 		public void analogout_init(ref dac_t obj, PinName pin)
 		{
 			CreateDac(ref obj, pin);
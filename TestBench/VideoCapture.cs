@@ -30,9 +30,9 @@ namespace TestBench
 			PeachCam.videoio_VideoCapture_release(_ptr);
 		}
 
-		internal bool Capture(IntPtr framebuff, int width, int height)
+		internal bool Capture(IntPtr framebuff, int stride, int width, int height, DRV_VIDEO_FORMAT format)
 		{
-			return PeachCam.VideoCapture_Capture(_ptr, framebuff, width, height);
+			return PeachCam.VideoCapture_Capture(_ptr, framebuff, stride, width, height, format);
 		}
 	}
 }
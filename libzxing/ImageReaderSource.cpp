@@ -117,25 +117,38 @@ int ImageReaderSource::create(char *buf, int buf_size, int width, int height, Re
 	return 0;
 }
 
+int ImageReaderSource::createGray(const uint8_t *gray, int width, int height, Ref<LuminanceSource> &result)
+{
+	zxing::ArrayRef<char> image;
+
+	image = zxing::ArrayRef<char>(width * height);
+	memcpy(&image[0], gray, width * height);
+
+	result = new ImageReaderSource(image, width, height, 1);
+	return 0;
+}
+
 int ImageReaderSource::getRow(int y, zxing::ArrayRef<char> row, zxing::ArrayRef<char> &result) const
 {
-#if INPUTIMG_RGB888 || INPUTIMG_RGB565    //1:RGB888 0:YCBCR422
-	const char *pixelRow = &image[0] + y * getWidth() * 4;
-	if (!row) {
-		row = zxing::ArrayRef<char>(getWidth());
-	}
-	for (int x = 0; x < getWidth(); x++) {
-		row[x] = convertPixel(pixelRow + (x * 4));
-	}
-#else
-	const char *pixelRow = &image[0] + y * getWidth();
-	if (!row) {
-		row = zxing::ArrayRef<char>(getWidth());
+	if (comps == 1) {
+		// Luminance only (YCbCr422 or createGray)
+		const char *pixelRow = &image[0] + y * getWidth();
+		if (!row) {
+			row = zxing::ArrayRef<char>(getWidth());
+		}
+		for (int x = 0; x < getWidth(); x++) {
+			row[x] = pixelRow[x];
+		}
 	}
-	for (int x = 0; x < getWidth(); x++) {
-		row[x] = pixelRow[x];
+	else {
+		const char *pixelRow = &image[0] + y * getWidth() * 4;
+		if (!row) {
+			row = zxing::ArrayRef<char>(getWidth());
+		}
+		for (int x = 0; x < getWidth(); x++) {
+			row[x] = convertPixel(pixelRow + (x * 4));
+		}
 	}
-#endif
 	result = row;
 	return 0;
 }
@@ -143,7 +156,9 @@ int ImageReaderSource::getRow(int y, zxing::ArrayRef<char> row, zxing::ArrayRef<
 /** This is a more efficient implementation. */
 zxing::ArrayRef<char> ImageReaderSource::getMatrix() const
 {
-#if INPUTIMG_RGB888 || INPUTIMG_RGB565  //1:RGB888 0:YCBCR422
+	if (comps == 1)
+		return image;
+
 	const char *p = &image[0];
 	zxing::ArrayRef<char> matrix(getWidth() * getHeight());
 	char *m = &matrix[0];
@@ -155,9 +170,6 @@ zxing::ArrayRef<char> ImageReaderSource::getMatrix() const
 		}
 	}
 	return matrix;
-#else
-	return image;
-#endif
 }
 
 int decode(Ref<BinaryBitmap> image, DecodeHints hints, vector<Ref<Result>> &results)
@@ -171,13 +183,41 @@ int decode(Ref<BinaryBitmap> image, DecodeHints hints, vector<Ref<Result>> &resu
 	return 0;
 }
 
-int decode_image(Ref<LuminanceSource> source, bool hybrid, vector<Ref<Result>> *results, DecodeHints &hints)
+int decode_tracked(Ref<BinaryBitmap> image, DecodeHints hints, QRCodeTracker *tracker, vector<Ref<Result>> &results)
 {
+	int ret;
+	Ref<Result> result;
+	if ((ret = tracker->decode(image, hints, result)) < 0)
+		return ret;
+	results.push_back(result);
+	return 0;
+}
+
+int decode_image(Ref<LuminanceSource> source, ZXingBinarizer::T binarizer_type, vector<Ref<Result>> *results, DecodeHints &hints,
+	QRCodeTracker *tracker)
+{
+	if (binarizer_type == ZXingBinarizer::Auto) {
+		// the tracker sees both binarizations as one frame so a miss on one keeps the location
+		if (tracker != NULL) {
+			vector<Ref<BinaryBitmap>> images;
+			images.push_back(Ref<BinaryBitmap>(new BinaryBitmap(Ref<Binarizer>(new GlobalHistogramBinarizer(source)))));
+			images.push_back(Ref<BinaryBitmap>(new BinaryBitmap(Ref<Binarizer>(new HybridBinarizer(source)))));
+			Ref<Result> result;
+			if (tracker->decode(images, hints, result) < 0)
+				return -1;
+			results->push_back(result);
+			return 0;
+		}
+		if (decode_image(source, ZXingBinarizer::Global, results, hints, tracker) == 0)
+			return 0;
+		return decode_image(source, ZXingBinarizer::Hybrid, results, hints, tracker);
+	}
+
 	string cell_result;
 	int ret;
 
 	Ref<Binarizer> binarizer;
-	if (hybrid) {
+	if (binarizer_type == ZXingBinarizer::Hybrid) {
 		binarizer = new HybridBinarizer(source);
 	}
 	else {
@@ -185,13 +225,18 @@ int decode_image(Ref<LuminanceSource> source, bool hybrid, vector<Ref<Result>> *
 	}
 	Ref<BinaryBitmap> binary(new BinaryBitmap(binarizer));
 
-	if ((ret = decode(binary, hints, *results)) < 0)
+	if (tracker != NULL)
+		ret = decode_tracked(binary, hints, tracker, *results);
+	else
+		ret = decode(binary, hints, *results);
+	if (ret < 0)
 		return ret;
 
 	return 0;
 }
 
-int ex_decode(uint8_t *buf, int buf_size, int width, int height, vector<Ref<Result>> *results, DecodeHints &hints)
+int ex_decode(uint8_t *buf, int buf_size, int width, int height, vector<Ref<Result>> *results, DecodeHints &hints,
+	ZXingBinarizer::T binarizer, QRCodeTracker *tracker)
 {
 	int h_result = 1;
 	int result = 0;
@@ -203,7 +248,7 @@ int ex_decode(uint8_t *buf, int buf_size, int width, int height, vector<Ref<Resu
 		cerr << ret << " (ignoring)" << endl;
 	}
 
-	h_result = decode_image(source, false, results, hints);
+	h_result = decode_image(source, binarizer, results, hints, tracker);
 	if (h_result != 0) {
 		result = -1;
 	}
@@ -211,3 +256,16 @@ int ex_decode(uint8_t *buf, int buf_size, int width, int height, vector<Ref<Resu
 	return result;
 }
 
+int ex_decode_gray(const uint8_t *gray, int width, int height, vector<Ref<Result>> *results, DecodeHints &hints,
+	ZXingBinarizer::T binarizer, QRCodeTracker *tracker)
+{
+	Ref<LuminanceSource> source;
+
+	ImageReaderSource::createGray(gray, width, height, source);
+
+	if (decode_image(source, binarizer, results, hints, tracker) != 0)
+		return -1;
+
+	return 0;
+}
+
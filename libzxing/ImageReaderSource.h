@@ -34,8 +34,10 @@
 #include <zxing/common/IllegalArgumentException.h>
 #include <zxing/BinaryBitmap.h>
 #include <zxing/DecodeHints.h>
+#include "ZXingBinarizer.h"
 
 #include <zxing/qrcode/QRCodeReader.h>
+#include <zxing/qrcode/QRCodeTracker.h>
 #include <zxing/multi/qrcode/QRCodeMultiReader.h>
 #include <zxing/multi/ByQuadrantReader.h>
 #include <zxing/multi/MultipleBarcodeReader.h>
@@ -64,6 +66,7 @@ private:
 
 public:
 	static int create(char *buf, int buf_size, int width, int height, zxing::Ref<LuminanceSource> &result);
+	static int createGray(const uint8_t *gray, int width, int height, zxing::Ref<LuminanceSource> &result);
 
 	ImageReaderSource(zxing::ArrayRef<char> image, int width, int height, int comps);
 
@@ -71,7 +74,14 @@ public:
 	zxing::ArrayRef<char> getMatrix() const;
 };
 
-extern int ex_decode(uint8_t *buf, int buf_size, int width, int height, vector<Ref<Result> > *results, DecodeHints &hints);
+/*
+ * With a tracker, only QR codes are read, starting from the location
+ * found in the previous frame (see QRCodeTracker).
+ */
+extern int ex_decode(uint8_t *buf, int buf_size, int width, int height, vector<Ref<Result> > *results, DecodeHints &hints,
+	ZXingBinarizer::T binarizer = ZXingBinarizer::Global, QRCodeTracker *tracker = NULL);
+extern int ex_decode_gray(const uint8_t *gray, int width, int height, vector<Ref<Result> > *results, DecodeHints &hints,
+	ZXingBinarizer::T binarizer = ZXingBinarizer::Global, QRCodeTracker *tracker = NULL);
 
 
 #endif /* __IMAGE_READER_SOURCE_H_ */
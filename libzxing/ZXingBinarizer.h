@@ -0,0 +1,28 @@
+#ifndef __ZXING_BINARIZER_H_
+#define __ZXING_BINARIZER_H_
+
+/*
+ * Binarizer used by ex_decode / ex_decode_gray for one frame.
+ */
+class ZXingBinarizer
+{
+public:
+	enum T {
+		Global,		// GlobalHistogramBinarizer (one black point for the frame)
+		Hybrid,		// HybridBinarizer (local thresholds per 8x8 block, for uneven lighting)
+		Auto,		// Global first, Hybrid if nothing was decoded
+	};
+	static const char *GetName(T binarizer)
+	{
+		switch (binarizer) {
+		case Global:
+			return "global";
+		case Hybrid:
+			return "hybrid";
+		default:
+			return "auto";
+		}
+	}
+};
+
+#endif /* __ZXING_BINARIZER_H_ */
@@ -16,6 +16,7 @@
  */
 
 #include <zxing/BinaryBitmap.h>
+#include <zxing/common/DecodeProfile.h>
 
 using zxing::Ref;
 using zxing::BitArray;
@@ -36,11 +37,13 @@ BinaryBitmap::~BinaryBitmap()
 
 int BinaryBitmap::getBlackRow(int y, Ref<BitArray> row, Ref<BitArray> &result)
 {
+	DecodeProfile::Scope scope(DecodeProfile::BINARIZE);
 	return binarizer_->getBlackRow(y, row, result);
 }
 
 int BinaryBitmap::getBlackMatrix(Ref<BitMatrix> &matrix)
 {
+	DecodeProfile::Scope scope(DecodeProfile::BINARIZE);
 	return binarizer_->getBlackMatrix(matrix);
 }
 
@@ -30,6 +30,7 @@
 #include <zxing/common/reedsolomon/GenericGF.h>
 #include <zxing/common/IllegalArgumentException.h>
 #include <zxing/common/DecoderResult.h>
+#include <zxing/common/DecodeProfile.h>
 
 using zxing::aztec::Decoder;
 using zxing::DecoderResult;
@@ -152,6 +153,7 @@ Decoder::Decoder() :
 
 int Decoder::decode(Ref<zxing::aztec::AztecDetectorResult> detectorResult, Ref<DecoderResult> &rresult)
 {
+	DecodeProfile::Scope scope(DecodeProfile::BITSTREAM);
 	ddata_ = detectorResult;
 
 	// std::printf("getting bits\n");
@@ -28,6 +28,7 @@
 #include <iostream>
 #include <zxing/common/detector/MathUtils.h>
 #include <zxing/NotFoundException.h>
+#include <zxing/common/DecodeProfile.h>
 
 using std::vector;
 using zxing::aztec::Detector;
@@ -52,6 +53,7 @@ Detector::Detector(Ref<BitMatrix> image) :
 
 int Detector::detect(Ref<AztecDetectorResult> &result)
 {
+	DecodeProfile::Scope scope(DecodeProfile::DETECT);
 	Ref<Point> pCenter = getMatrixCenter();
 	int ret;
 	std::vector<Ref<Point> > bullEyeCornerPoints;
@@ -89,6 +89,15 @@ public:
 	{
 		return values_.size() == 0;
 	}
+	/* contiguous storage for hot loops, null when empty */
+	T const *data() const
+	{
+		return values_.empty() ? 0 : &values_[0];
+	}
+	T *data()
+	{
+		return values_.empty() ? 0 : &values_[0];
+	}
 	std::vector<T> const &values() const
 	{
 		return values_;
@@ -99,7 +108,11 @@ public:
 	}
 };
 
-template<typename T> class ArrayRef : public Counted {
+/*
+ * counting reference to an Array; like Ref, a raw Array is only taken
+ * explicitly and a moved-from ArrayRef is left empty
+ */
+template<typename T> class ArrayRef {
 private:
 public:
 	Array<T> *array_;
@@ -117,16 +130,21 @@ public:
 	{
 		reset(new Array<T>(ts, n));
 	}
-	ArrayRef(Array<T> *a) :
+	explicit ArrayRef(Array<T> *a) :
 		array_(0)
 	{
 		reset(a);
 	}
 	ArrayRef(const ArrayRef &other) :
-		Counted(), array_(0)
+		array_(0)
 	{
 		reset(other.array_);
 	}
+	ArrayRef(ArrayRef &&other) :
+		array_(other.array_)
+	{
+		other.array_ = 0;
+	}
 
 	template<class Y>
 	ArrayRef(const ArrayRef<Y> &other) :
@@ -153,6 +171,16 @@ public:
 		return (*array_)[i];
 	}
 
+	/* span-style access: hoist data() out of a loop instead of indexing through the Array */
+	T *data() const
+	{
+		return array_ ? array_->data() : 0;
+	}
+	int size() const
+	{
+		return array_ ? array_->size() : 0;
+	}
+
 	void reset(Array<T> *a)
 	{
 		if (a) {
@@ -172,6 +200,18 @@ public:
 		reset(other);
 		return *this;
 	}
+	ArrayRef<T> &operator=(ArrayRef<T> &&other)
+	{
+		if (this != &other) {
+			Array<T> *old = array_;
+			array_ = other.array_;
+			other.array_ = 0;
+			if (old) {
+				old->release();
+			}
+		}
+		return *this;
+	}
 	ArrayRef<T> &operator=(Array<T> *a)
 	{
 		reset(a);
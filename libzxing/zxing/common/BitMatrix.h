@@ -32,12 +32,6 @@ class BitMatrix : public Counted {
 public:
 	static const int bitsPerWord = std::numeric_limits<unsigned int>::digits;
 
-private:
-	int width;
-	int height;
-	int rowSize;
-	ArrayRef<int> bits;
-
 #define ZX_LOG_DIGITS(digits) \
     ((digits == 8) ? 3 : \
      ((digits == 16) ? 4 : \
@@ -49,6 +43,12 @@ private:
 	static const int logBits = ZX_LOG_DIGITS(bitsPerWord);
 	static const int bitsMask = (1 << logBits) - 1;
 
+private:
+	int width;
+	int height;
+	int rowSize;
+	ArrayRef<int> bits;
+
 public:
 	BitMatrix(int dimension);
 	BitMatrix(int width, int height);
@@ -67,6 +67,18 @@ public:
 		bits[offset] |= 1 << (x & bitsMask);
 	}
 
+	// Packed row words (bit x & bitsMask of word x >> logBits), for writers
+	// that produce a whole word at a time.
+	unsigned int *getRowBits(int y)
+	{
+		return reinterpret_cast<unsigned int *>(&bits[y * rowSize]);
+	}
+
+	int getRowSize() const
+	{
+		return rowSize;
+	}
+
 	void flip(int x, int y);
 	void setRegion(int left, int top, int width, int height);
 	Ref<BitArray> getRow(int y, Ref<BitArray> row);
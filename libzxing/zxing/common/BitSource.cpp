@@ -33,6 +33,7 @@ int BitSource::readBits(int numBits)
 		return -1;
 	}
 
+	const byte *bytes = bytes_.data();
 	int result = 0;
 
 	// First, read remainder from current byte
@@ -41,7 +42,7 @@ int BitSource::readBits(int numBits)
 		int toRead = numBits < bitsLeft ? numBits : bitsLeft;
 		int bitsToNotRead = bitsLeft - toRead;
 		int mask = (0xFF >> (8 - toRead)) << bitsToNotRead;
-		result = (bytes_[byteOffset_] & mask) >> bitsToNotRead;
+		result = (bytes[byteOffset_] & mask) >> bitsToNotRead;
 		numBits -= toRead;
 		bitOffset_ += toRead;
 		if (bitOffset_ == 8) {
@@ -53,7 +54,7 @@ int BitSource::readBits(int numBits)
 	// Next read whole bytes
 	if (numBits > 0) {
 		while (numBits >= 8) {
-			result = (result << 8) | (bytes_[byteOffset_] & 0xFF);
+			result = (result << 8) | (bytes[byteOffset_] & 0xFF);
 			byteOffset_++;
 			numBits -= 8;
 		}
@@ -63,7 +64,7 @@ int BitSource::readBits(int numBits)
 		if (numBits > 0) {
 			int bitsToNotRead = 8 - numBits;
 			int mask = (0xFF >> bitsToNotRead) << bitsToNotRead;
-			result = (result << numBits) | ((bytes_[byteOffset_] & mask) >> bitsToNotRead);
+			result = (result << numBits) | ((bytes[byteOffset_] & mask) >> bitsToNotRead);
 			bitOffset_ += numBits;
 		}
 	}
@@ -19,30 +19,72 @@
  */
 
 #include <iostream>
+#include <atomic>
 
 namespace zxing {
 
+/*
+ * Building with ZXING_REF_STATS counts the reference-counted objects created
+ * and the retain/release calls made on them, to measure the reference
+ * counting cost of a decode; otherwise the counters stay at zero.
+ */
+struct RefStats {
+	unsigned long objects;
+	unsigned long retains;
+	unsigned long releases;
+};
+
+#ifdef ZXING_REF_STATS
+struct RefCounters {
+	std::atomic<unsigned long> objects;
+	std::atomic<unsigned long> retains;
+	std::atomic<unsigned long> releases;
+};
+
+inline RefCounters &refCounters()
+{
+	static RefCounters counters;
+	return counters;
+}
+#define ZXING_REF_COUNT(name) (refCounters().name++)
+#else
+#define ZXING_REF_COUNT(name) ((void)0)
+#endif
+
 /* base class for reference-counted objects */
+/* the count is atomic so that decoders on several threads can share objects */
 class Counted {
 private:
-	unsigned int count_;
+	std::atomic<unsigned int> count_;
 public:
 	Counted() :
 		count_(0)
 	{
+		ZXING_REF_COUNT(objects);
+	}
+	/* a copy is a new object with its own references */
+	Counted(const Counted &) :
+		count_(0)
+	{
+		ZXING_REF_COUNT(objects);
+	}
+	Counted &operator=(const Counted &)
+	{
+		return *this;
 	}
 	virtual ~Counted()
 	{
 	}
 	Counted *retain()
 	{
+		ZXING_REF_COUNT(retains);
 		count_++;
 		return this;
 	}
 	void release()
 	{
-		count_--;
-		if (count_ == 0) {
+		ZXING_REF_COUNT(releases);
+		if (--count_ == 0) {
 			count_ = 0xDEADF001;
 			delete this;
 		}
@@ -54,14 +96,49 @@ public:
 	{
 		return count_;
 	}
+
+	static bool hasStats()
+	{
+#ifdef ZXING_REF_STATS
+		return true;
+#else
+		return false;
+#endif
+	}
+	static RefStats getStats()
+	{
+		RefStats stats = { 0, 0, 0 };
+#ifdef ZXING_REF_STATS
+		stats.objects = refCounters().objects;
+		stats.retains = refCounters().retains;
+		stats.releases = refCounters().releases;
+#endif
+		return stats;
+	}
+	static void resetStats()
+	{
+#ifdef ZXING_REF_STATS
+		refCounters().objects = 0;
+		refCounters().retains = 0;
+		refCounters().releases = 0;
+#endif
+	}
 };
 
-/* counting reference to reference-counted objects */
+/*
+ * counting reference to reference-counted objects
+ * a raw pointer is only taken explicitly, and a moved-from Ref is left empty
+ * so that passing and returning temporaries costs no retain/release pair
+ */
 template<typename T> class Ref {
 private:
 public:
 	T *object_;
-	explicit Ref(T *o = 0) :
+	Ref() :
+		object_(0)
+	{
+	}
+	explicit Ref(T *o) :
 		object_(0)
 	{
 		reset(o);
@@ -71,6 +148,11 @@ public:
 	{
 		reset(other.object_);
 	}
+	Ref(Ref &&other) :
+		object_(other.object_)
+	{
+		other.object_ = 0;
+	}
 
 	template<class Y>
 	Ref(const Ref<Y> &other) :
@@ -78,6 +160,12 @@ public:
 	{
 		reset(other.object_);
 	}
+	template<class Y>
+	Ref(Ref<Y> &&other) :
+		object_(other.object_)
+	{
+		other.object_ = 0;
+	}
 
 	~Ref()
 	{
@@ -101,12 +189,35 @@ public:
 		reset(other.object_);
 		return *this;
 	}
+	Ref &operator=(Ref &&other)
+	{
+		if (this != &other) {
+			T *old = object_;
+			object_ = other.object_;
+			other.object_ = 0;
+			if (old != 0) {
+				old->release();
+			}
+		}
+		return *this;
+	}
 	template<class Y>
 	Ref &operator=(const Ref<Y> &other)
 	{
 		reset(other.object_);
 		return *this;
 	}
+	template<class Y>
+	Ref &operator=(Ref<Y> &&other)
+	{
+		T *old = object_;
+		object_ = other.object_;
+		other.object_ = 0;
+		if (old != 0) {
+			old->release();
+		}
+		return *this;
+	}
 	Ref &operator=(T *o)
 	{
 		reset(o);
@@ -127,6 +238,10 @@ public:
 	{
 		return object_;
 	}
+	T *get() const
+	{
+		return object_;
+	}
 	operator T *() const
 	{
 		return object_;
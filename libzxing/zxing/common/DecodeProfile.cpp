@@ -0,0 +1,90 @@
+// -*- mode:c++; tab-width:2; indent-tabs-mode:nil; c-basic-offset:2 -*-
+/*
+ *  DecodeProfile.cpp
+ *  zxing
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <zxing/common/DecodeProfile.h>
+
+namespace zxing {
+
+std::atomic<DecodeProfile::Clock> DecodeProfile::clock_(0);
+thread_local DecodeProfile::Stage DecodeProfile::current_ = DecodeProfile::OTHER;
+thread_local int DecodeProfile::depth_ = 0;
+thread_local unsigned long long DecodeProfile::mark_ = 0;
+thread_local unsigned long long DecodeProfile::times_[DecodeProfile::STAGE_COUNT] = { 0 };
+
+void DecodeProfile::setClock(Clock clock)
+{
+	clock_.store(clock, std::memory_order_relaxed);
+	current_ = OTHER;
+	depth_ = 0;
+	reset();
+}
+
+void DecodeProfile::reset()
+{
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		times_[i] = 0;
+	}
+}
+
+unsigned long long DecodeProfile::getTime(Stage stage)
+{
+	return times_[stage];
+}
+
+const char *DecodeProfile::getStageName(Stage stage)
+{
+	switch (stage) {
+	case BINARIZE:
+		return "binarize";
+	case DETECT:
+		return "detect";
+	case SAMPLE:
+		return "sample";
+	case ERROR_CORRECTION:
+		return "ec";
+	case BITSTREAM:
+		return "bitstream";
+	default:
+		return "other";
+	}
+}
+
+DecodeProfile::Stage DecodeProfile::enter(Clock clock, Stage stage)
+{
+	unsigned long long now = clock();
+	// Time between outermost scopes is not part of any decode.
+	if (depth_ > 0) {
+		times_[current_] += now - mark_;
+	}
+	mark_ = now;
+	depth_++;
+	Stage previous = current_;
+	current_ = stage;
+	return previous;
+}
+
+void DecodeProfile::leave(Clock clock, Stage previous)
+{
+	unsigned long long now = clock();
+	times_[current_] += now - mark_;
+	mark_ = now;
+	depth_--;
+	current_ = previous;
+}
+
+}
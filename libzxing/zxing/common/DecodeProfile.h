@@ -0,0 +1,91 @@
+// -*- mode:c++; tab-width:2; indent-tabs-mode:nil; c-basic-offset:2 -*-
+#ifndef __DECODE_PROFILE_H__
+#define __DECODE_PROFILE_H__
+
+#include <atomic>
+
+/*
+ *  DecodeProfile.h
+ *  zxing
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+namespace zxing {
+
+/**
+ * Time spent in each stage of decoding, for benchmarks.
+ *
+ * Profiling is off until a microsecond clock is installed with setClock();
+ * until then a stage scope costs a single test. Time is charged to the
+ * innermost open stage only, so a detector that calls the grid sampler is
+ * charged for its own work and the sampling goes to SAMPLE. Time inside an
+ * OTHER scope that no stage covers (reader overhead) is charged to OTHER.
+ * The open stage and the totals are per thread; reset() and getTime() see
+ * those of the calling thread only.
+ */
+class DecodeProfile {
+public:
+	enum Stage {
+		OTHER,
+		BINARIZE,
+		DETECT,
+		SAMPLE,
+		ERROR_CORRECTION,
+		BITSTREAM,
+		STAGE_COUNT
+	};
+	typedef unsigned long long (*Clock)();
+
+	class Scope {
+	private:
+		// Loaded once, so that leaving uses the clock of entering even if
+		// setClock() runs on another thread in between.
+		Clock clock_;
+		Stage previous_;
+	public:
+		explicit Scope(Stage stage)
+			: clock_(DecodeProfile::clock_.load(std::memory_order_relaxed)), previous_(OTHER)
+		{
+			if (clock_ != 0) {
+				previous_ = enter(clock_, stage);
+			}
+		}
+		~Scope()
+		{
+			if (clock_ != 0) {
+				leave(clock_, previous_);
+			}
+		}
+	};
+
+	// A null clock turns profiling off.
+	static void setClock(Clock clock);
+	static void reset();
+	static unsigned long long getTime(Stage stage);
+	static const char *getStageName(Stage stage);
+
+private:
+	static std::atomic<Clock> clock_;
+	static thread_local Stage current_;
+	static thread_local int depth_;
+	static thread_local unsigned long long mark_;
+	static thread_local unsigned long long times_[STAGE_COUNT];
+
+	static Stage enter(Clock clock, Stage stage);
+	static void leave(Clock clock, Stage previous);
+};
+
+}
+
+#endif // __DECODE_PROFILE_H__
@@ -21,6 +21,15 @@
 #include <zxing/common/GlobalHistogramBinarizer.h>
 #include <zxing/NotFoundException.h>
 #include <zxing/common/Array.h>
+#include <vector>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BINARIZER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BINARIZER_NEON
+#endif
 
 using zxing::GlobalHistogramBinarizer;
 using zxing::Binarizer;
@@ -37,10 +46,70 @@ const int LUMINANCE_BITS = 5;
 const int LUMINANCE_SHIFT = 8 - LUMINANCE_BITS;
 const int LUMINANCE_BUCKETS = 1 << LUMINANCE_BITS;
 const ArrayRef<char> EMPTY(0);
+
+// Bits per packed BitMatrix word; the kernels below produce one word per store.
+const int WORD_BITS = BitMatrix::bitsPerWord;
+
+void threshold_row_c(const unsigned char *pixels, const unsigned char *thresholds,
+	int width, unsigned int *bits)
+{
+	for (int x = 0; x < width; x += WORD_BITS) {
+		int count = width - x < WORD_BITS ? width - x : WORD_BITS;
+		unsigned int word = 0;
+		for (int i = 0; i < count; i++) {
+			word |= (unsigned int)(pixels[x + i] <= thresholds[x + i]) << i;
+		}
+		bits[x / WORD_BITS] |= word;
+	}
+}
+
+#if defined(BINARIZER_SSE2)
+void threshold_row_simd(const unsigned char *pixels, const unsigned char *thresholds,
+	int width, unsigned int *bits)
+{
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		__m128i p0 = _mm_loadu_si128((const __m128i *)(pixels + x));
+		__m128i p1 = _mm_loadu_si128((const __m128i *)(pixels + x + 16));
+		__m128i t0 = _mm_loadu_si128((const __m128i *)(thresholds + x));
+		__m128i t1 = _mm_loadu_si128((const __m128i *)(thresholds + x + 16));
+		// Unsigned p <= t is min(p, t) == p; movemask packs one bit per byte
+		// in pixel order, which is the BitMatrix bit order.
+		__m128i b0 = _mm_cmpeq_epi8(_mm_min_epu8(p0, t0), p0);
+		__m128i b1 = _mm_cmpeq_epi8(_mm_min_epu8(p1, t1), p1);
+		bits[x / WORD_BITS] |= (unsigned int)_mm_movemask_epi8(b0)
+			| ((unsigned int)_mm_movemask_epi8(b1) << 16);
+	}
+	threshold_row_c(pixels + x, thresholds + x, width - x, bits + x / WORD_BITS);
+}
+#elif defined(BINARIZER_NEON)
+void threshold_row_simd(const unsigned char *pixels, const unsigned char *thresholds,
+	int width, unsigned int *bits)
+{
+	static const uint8_t weights[16] = {
+		1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+	};
+	uint8x16_t w = vld1q_u8(weights);
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		uint8x16_t b0 = vandq_u8(vcleq_u8(vld1q_u8(pixels + x), vld1q_u8(thresholds + x)), w);
+		uint8x16_t b1 = vandq_u8(vcleq_u8(vld1q_u8(pixels + x + 16), vld1q_u8(thresholds + x + 16)), w);
+		// No movemask on NEON: three pairwise adds fold each 8 weighted
+		// lanes into one byte of the word.
+		uint8x8_t s = vpadd_u8(vpadd_u8(vget_low_u8(b0), vget_high_u8(b0)),
+			vpadd_u8(vget_low_u8(b1), vget_high_u8(b1)));
+		s = vpadd_u8(s, s);
+		bits[x / WORD_BITS] |= vget_lane_u32(vreinterpret_u32_u8(s), 0);
+	}
+	threshold_row_c(pixels + x, thresholds + x, width - x, bits + x / WORD_BITS);
+}
+#else
+#define threshold_row_simd threshold_row_c
+#endif
 }
 
-GlobalHistogramBinarizer::GlobalHistogramBinarizer(Ref<LuminanceSource> source)
-	: Binarizer(source), luminances(EMPTY), buckets(LUMINANCE_BUCKETS)
+GlobalHistogramBinarizer::GlobalHistogramBinarizer(Ref<LuminanceSource> source, bool simd)
+	: Binarizer(source), luminances(EMPTY), buckets(LUMINANCE_BUCKETS), simd_(simd)
 {
 }
 
@@ -80,18 +149,15 @@ int GlobalHistogramBinarizer::getBlackRow(int y, Ref<BitArray> row, Ref<BitArray
 		}
 		std::cerr << std::endl;
 	}
-	ArrayRef<int> localBuckets = buckets;
-	for (int x = 0; x < width; x++) {
-		int pixel = localLuminances[x] & 0xff;
-		localBuckets[pixel >> LUMINANCE_SHIFT]++;
-	}
-	int blackPoint = estimateBlackPoint(localBuckets);
+	const unsigned char *pixels = (const unsigned char *)localLuminances.data();
+	addHistogram(pixels, width, buckets.data());
+	int blackPoint = estimateBlackPoint(buckets);
 	// std::cerr << "gbr bp " << y << " " << blackPoint << std::endl;
 
-	int left = localLuminances[0] & 0xff;
-	int center = localLuminances[1] & 0xff;
+	int left = pixels[0];
+	int center = pixels[1];
 	for (int x = 1; x < width - 1; x++) {
-		int right = localLuminances[x + 1] & 0xff;
+		int right = pixels[x + 1];
 		// A simple -1 4 -1 box filter with a weight of 2.
 		int luminance = ((center << 2) - left - right) >> 1;
 		if (luminance < blackPoint) {
@@ -115,38 +181,78 @@ int GlobalHistogramBinarizer::getBlackMatrix(Ref<BitMatrix> &matrix)
 	// This proved to be more robust on the blackbox tests than sampling a
 	// diagonal as we used to do.
 	initArrays(width);
-	ArrayRef<int> localBuckets = buckets;
 	for (int y = 1; y < 5; y++) {
 		int ret;
 		int row = height * y / 5;
 		ArrayRef<char> localLuminances;
 		if ((ret = source.getRow(row, luminances, localLuminances)) < 0)
 			return ret;
+		int left = width / 5;
 		int right = (width << 2) / 5;
-		for (int x = width / 5; x < right; x++) {
-			int pixel = localLuminances[x] & 0xff;
-			localBuckets[pixel >> LUMINANCE_SHIFT]++;
-		}
+		addHistogram((const unsigned char *)localLuminances.data() + left, right - left, buckets.data());
 	}
 
-	int blackPoint = estimateBlackPoint(localBuckets);
+	int blackPoint = estimateBlackPoint(buckets);
 	if (blackPoint < 0)
 		return blackPoint;
+	// pixel < blackPoint; a black point of 0 leaves the matrix empty.
+	if (blackPoint == 0)
+		return 0;
 
 	ArrayRef<char> localLuminances = source.getMatrix();
+	const unsigned char *pixels = (const unsigned char *)localLuminances.data();
+	std::vector<unsigned char> thresholds(width, (unsigned char)(blackPoint - 1));
 	for (int y = 0; y < height; y++) {
-		int offset = y * width;
-		for (int x = 0; x < width; x++) {
-			int pixel = localLuminances[offset + x] & 0xff;
-			if (pixel < blackPoint) {
-				matrix->set(x, y);
-			}
-		}
+		thresholdRow(pixels + y * width, &thresholds[0], width, matrix->getRowBits(y), simd_);
 	}
 
 	return 0;
 }
 
+void GlobalHistogramBinarizer::addHistogram(const unsigned char *pixels, int count, int *buckets)
+{
+	// Four interleaved sub-histograms, so that runs of similar pixels do not
+	// serialize on a single counter.
+	int counts[4][LUMINANCE_BUCKETS] = { { 0 } };
+	int x = 0;
+	for (; x + 4 <= count; x += 4) {
+		counts[0][pixels[x] >> LUMINANCE_SHIFT]++;
+		counts[1][pixels[x + 1] >> LUMINANCE_SHIFT]++;
+		counts[2][pixels[x + 2] >> LUMINANCE_SHIFT]++;
+		counts[3][pixels[x + 3] >> LUMINANCE_SHIFT]++;
+	}
+	for (; x < count; x++) {
+		counts[0][pixels[x] >> LUMINANCE_SHIFT]++;
+	}
+	for (int i = 0; i < LUMINANCE_BUCKETS; i++) {
+		buckets[i] += counts[0][i] + counts[1][i] + counts[2][i] + counts[3][i];
+	}
+}
+
+void GlobalHistogramBinarizer::thresholdRow(const unsigned char *pixels, const unsigned char *thresholds,
+	int width, unsigned int *bits, bool simd)
+{
+	if (simd) {
+		threshold_row_simd(pixels, thresholds, width, bits);
+	}
+	else {
+		threshold_row_c(pixels, thresholds, width, bits);
+	}
+}
+
+const char *GlobalHistogramBinarizer::getKernelName(bool simd)
+{
+	if (!simd)
+		return "C";
+#if defined(BINARIZER_SSE2)
+	return "SSE2";
+#elif defined(BINARIZER_NEON)
+	return "NEON";
+#else
+	return "C";
+#endif
+}
+
 using namespace std;
 
 int GlobalHistogramBinarizer::estimateBlackPoint(ArrayRef<int> const &buckets)
@@ -225,5 +331,5 @@ int GlobalHistogramBinarizer::estimateBlackPoint(ArrayRef<int> const &buckets)
 
 Ref<Binarizer> GlobalHistogramBinarizer::createBinarizer(Ref<LuminanceSource> source)
 {
-	return Ref<Binarizer>(new GlobalHistogramBinarizer(source));
+	return Ref<Binarizer>(new GlobalHistogramBinarizer(source, simd_));
 }
@@ -31,14 +31,25 @@ class GlobalHistogramBinarizer : public Binarizer {
 private:
 	ArrayRef<char> luminances;
 	ArrayRef<int> buckets;
+protected:
+	bool simd_;
 public:
-	GlobalHistogramBinarizer(Ref<LuminanceSource> source);
+	// simd selects the SSE2/NEON kernels when the build has them; false forces
+	// the portable ones (same output, used to cross-check and benchmark).
+	GlobalHistogramBinarizer(Ref<LuminanceSource> source, bool simd = true);
 	virtual ~GlobalHistogramBinarizer();
 
 	virtual int getBlackRow(int y, Ref<BitArray> row, Ref<BitArray> &result);
 	virtual int getBlackMatrix(Ref<BitMatrix> &matrix);
 	static int estimateBlackPoint(ArrayRef<int> const &buckets);
 	Ref<Binarizer> createBinarizer(Ref<LuminanceSource> source);
+	static const char *getKernelName(bool simd = true);
+protected:
+	// Adds the LUMINANCE_BITS histogram of count pixels to buckets.
+	static void addHistogram(const unsigned char *pixels, int count, int *buckets);
+	// ORs into the packed row bits every pixel with pixels[x] <= thresholds[x].
+	static void thresholdRow(const unsigned char *pixels, const unsigned char *thresholds,
+		int width, unsigned int *bits, bool simd);
 private:
 	void initArrays(int luminanceSize);
 };
@@ -66,7 +66,8 @@ GreyscaleRotatedLuminanceSource::getRow(int y, ArrayRef<char> row, ArrayRef<char
 		row[x] = greyData_[offset];
 		offset += dataWidth_;
 	}
-	return row;
+	result = row;
+	return 0;
 }
 
 ArrayRef<char> GreyscaleRotatedLuminanceSource::getMatrix() const
@@ -21,8 +21,10 @@
 #include <zxing/common/GridSampler.h>
 #include <zxing/common/PerspectiveTransform.h>
 #include <zxing/ReaderException.h>
+#include <zxing/common/DecodeProfile.h>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 
 namespace zxing {
 using namespace std;
@@ -33,32 +35,70 @@ GridSampler::GridSampler()
 {
 }
 
+namespace {
+// Points transformed per call of transformRow; the buffers live on the stack.
+const int SAMPLE_CHUNK = 64;
+}
+
 int GridSampler::sampleGrid(Ref<BitMatrix> image, int dimension, Ref<PerspectiveTransform> transform, Ref<BitMatrix> &result)
 {
-	Ref<BitMatrix> bits(new BitMatrix(dimension));
-	vector<float> points(dimension << 1, (const float)0.0f);
-	for (int y = 0; y < dimension; y++) {
-		int max = points.size();
-		float yValue = (float)y + 0.5f;
-		for (int x = 0; x < max; x += 2) {
-			points[x] = (float)(x >> 1) + 0.5f;
-			points[x + 1] = yValue;
-		}
-		transform->transformPoints(points);
-		int ret;
-		if ((ret = checkAndNudgePoints(image, points)) < 0)
-			return ret;
-		for (int x = 0; x < max; x += 2) {
-			if (image->get((int)points[x], (int)points[x + 1])) {
-				bits->set(x >> 1, y);
+	return sampleGrid(image, dimension, dimension, transform, result);
+}
+
+int GridSampler::sampleGrid(Ref<BitMatrix> image, int dimensionX, int dimensionY, Ref<PerspectiveTransform> transform,
+	Ref<BitMatrix> &result, Kernel kernel)
+{
+	DecodeProfile::Scope scope(DecodeProfile::SAMPLE);
+	if (kernel == KERNEL_POINTS)
+		return sampleGridPoints(image, dimensionX, dimensionY, transform, result);
+
+	Ref<BitMatrix> bits(new BitMatrix(dimensionX, dimensionY));
+	const int width = image->getWidth();
+	const int height = image->getHeight();
+	// Same bounds as checkAndNudgePoints: the truncated coordinate may be one
+	// pixel outside the image and is then clamped to the edge.
+	const float limitX = (float)(width + 1);
+	const float limitY = (float)(height + 1);
+	const unsigned int *imageBits = image->getRowBits(0);
+	const int imageRowSize = image->getRowSize();
+	const PerspectiveTransform &pt = *transform;
+	const bool simd = (kernel == KERNEL_AUTO);
+	float xs[SAMPLE_CHUNK];
+	float ys[SAMPLE_CHUNK];
+
+	for (int y = 0; y < dimensionY; y++) {
+		unsigned int *row = bits->getRowBits(y);
+		unsigned int word = 0;
+		for (int x0 = 0; x0 < dimensionX; x0 += SAMPLE_CHUNK) {
+			int count = min(SAMPLE_CHUNK, dimensionX - x0);
+			pt.transformRow((float)x0 + 0.5f, (float)y + 0.5f, count, xs, ys, simd);
+			for (int i = 0; i < count; i++) {
+				// Written so that NaN fails the test too.
+				if (!((xs[i] > -2.0f) && (xs[i] < limitX) && (ys[i] > -2.0f) && (ys[i] < limitY)))
+					return -1;
+				int px = (int)xs[i];
+				int py = (int)ys[i];
+				px = (px < 0) ? 0 : (px >= width) ? width - 1 : px;
+				py = (py < 0) ? 0 : (py >= height) ? height - 1 : py;
+				unsigned int bit = (imageBits[py * imageRowSize + (px >> BitMatrix::logBits)] >> (px & BitMatrix::bitsMask)) & 1;
+				int x = x0 + i;
+				word |= bit << (x & BitMatrix::bitsMask);
+				if ((x & BitMatrix::bitsMask) == BitMatrix::bitsMask) {
+					row[x >> BitMatrix::logBits] = word;
+					word = 0;
+				}
 			}
 		}
+		if ((dimensionX & BitMatrix::bitsMask) != 0) {
+			row[dimensionX >> BitMatrix::logBits] = word;
+		}
 	}
 	result = bits;
 	return 0;
 }
 
-int GridSampler::sampleGrid(Ref<BitMatrix> image, int dimensionX, int dimensionY, Ref<PerspectiveTransform> transform, Ref<BitMatrix> &result)
+int GridSampler::sampleGridPoints(Ref<BitMatrix> image, int dimensionX, int dimensionY, Ref<PerspectiveTransform> transform,
+	Ref<BitMatrix> &result)
 {
 	Ref<BitMatrix> bits(new BitMatrix(dimensionX, dimensionY));
 	vector<float> points(dimensionX << 1, (const float)0.0f);
@@ -26,13 +26,24 @@
 
 namespace zxing {
 class GridSampler {
+public:
+	enum Kernel {
+		KERNEL_AUTO,	// batched row transform with SSE2/NEON when available
+		KERNEL_SCALAR,	// batched row transform, portable
+		KERNEL_POINTS	// transformPoints + checkAndNudgePoints per row (reference)
+	};
+
 private:
 	static GridSampler gridSampler;
 	GridSampler();
 
+	int sampleGridPoints(Ref<BitMatrix> image, int dimensionX, int dimensionY, Ref<PerspectiveTransform> transform,
+		Ref<BitMatrix> &result);
+
 public:
 	int sampleGrid(Ref<BitMatrix> image, int dimension, Ref<PerspectiveTransform> transform, Ref<BitMatrix> &result);
-	int sampleGrid(Ref<BitMatrix> image, int dimensionX, int dimensionY, Ref<PerspectiveTransform> transform, Ref<BitMatrix> &result);
+	int sampleGrid(Ref<BitMatrix> image, int dimensionX, int dimensionY, Ref<PerspectiveTransform> transform,
+		Ref<BitMatrix> &result, Kernel kernel = KERNEL_AUTO);
 
 	int sampleGrid(Ref<BitMatrix> image, int dimension, float p1ToX, float p1ToY, float p2ToX, float p2ToY,
 		float p3ToX, float p3ToY, float p4ToX, float p4ToY, float p1FromX, float p1FromY, float p2FromX,
@@ -21,6 +21,16 @@
 #include <zxing/common/HybridBinarizer.h>
 
 #include <zxing/common/IllegalArgumentException.h>
+#include <vector>
+#include <string.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BINARIZER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BINARIZER_NEON
+#endif
 
 using namespace std;
 using namespace zxing;
@@ -30,10 +40,106 @@ const int BLOCK_SIZE_POWER = 3;
 const int BLOCK_SIZE = 1 << BLOCK_SIZE_POWER; // ...0100...00
 const int BLOCK_SIZE_MASK = BLOCK_SIZE - 1;   // ...0011...11
 const int MINIMUM_DIMENSION = BLOCK_SIZE * 5;
+
+// Sum, min and max of count adjacent blocks whose top left pixel is row.
+void block_stats_c(const unsigned char *row, int stride, int count, int *sums, int *mins, int *maxs)
+{
+	for (int b = 0; b < count; b++) {
+		const unsigned char *p = row + (b << BLOCK_SIZE_POWER);
+		int sum = 0;
+		int min = 0xFF;
+		int max = 0;
+		for (int yy = 0; yy < BLOCK_SIZE; yy++, p += stride) {
+			for (int xx = 0; xx < BLOCK_SIZE; xx++) {
+				int pixel = p[xx];
+				sum += pixel;
+				if (pixel < min) {
+					min = pixel;
+				}
+				if (pixel > max) {
+					max = pixel;
+				}
+			}
+		}
+		sums[b] = sum;
+		mins[b] = min;
+		maxs[b] = max;
+	}
+}
+
+#if defined(BINARIZER_SSE2)
+// Two blocks per 16 byte load: psadbw sums each 8 byte half, and the
+// min/max reduce to byte 0 and byte 8 with three shifts.
+void block_stats_simd(const unsigned char *row, int stride, int count, int *sums, int *mins, int *maxs)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int b = 0;
+	for (; b + 2 <= count; b += 2) {
+		const unsigned char *p = row + (b << BLOCK_SIZE_POWER);
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		__m128i vmin = v;
+		__m128i vmax = v;
+		__m128i vsum = _mm_sad_epu8(v, zero);
+		for (int yy = 1; yy < BLOCK_SIZE; yy++) {
+			v = _mm_loadu_si128((const __m128i *)(p + yy * stride));
+			vmin = _mm_min_epu8(vmin, v);
+			vmax = _mm_max_epu8(vmax, v);
+			vsum = _mm_add_epi64(vsum, _mm_sad_epu8(v, zero));
+		}
+		vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 4));
+		vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 2));
+		vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 1));
+		vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 4));
+		vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 2));
+		vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 1));
+		sums[b] = _mm_cvtsi128_si32(vsum);
+		sums[b + 1] = _mm_cvtsi128_si32(_mm_srli_si128(vsum, 8));
+		mins[b] = _mm_extract_epi16(vmin, 0) & 0xFF;
+		mins[b + 1] = _mm_extract_epi16(vmin, 4) & 0xFF;
+		maxs[b] = _mm_extract_epi16(vmax, 0) & 0xFF;
+		maxs[b + 1] = _mm_extract_epi16(vmax, 4) & 0xFF;
+	}
+	block_stats_c(row + (b << BLOCK_SIZE_POWER), stride, count - b, sums + b, mins + b, maxs + b);
+}
+#elif defined(BINARIZER_NEON)
+void block_stats_simd(const unsigned char *row, int stride, int count, int *sums, int *mins, int *maxs)
+{
+	int b = 0;
+	for (; b + 2 <= count; b += 2) {
+		const unsigned char *p = row + (b << BLOCK_SIZE_POWER);
+		uint8x16_t v = vld1q_u8(p);
+		uint8x16_t vmin = v;
+		uint8x16_t vmax = v;
+		uint16x8_t vsum = vpaddlq_u8(v);
+		for (int yy = 1; yy < BLOCK_SIZE; yy++) {
+			v = vld1q_u8(p + yy * stride);
+			vmin = vminq_u8(vmin, v);
+			vmax = vmaxq_u8(vmax, v);
+			vsum = vpadalq_u8(vsum, v);
+		}
+		uint64x2_t total = vpaddlq_u32(vpaddlq_u16(vsum));
+		uint8x8_t m = vpmin_u8(vget_low_u8(vmin), vget_high_u8(vmin));
+		m = vpmin_u8(m, m);
+		m = vpmin_u8(m, m);
+		uint8x8_t n = vpmax_u8(vget_low_u8(vmax), vget_high_u8(vmax));
+		n = vpmax_u8(n, n);
+		n = vpmax_u8(n, n);
+		sums[b] = (int)vgetq_lane_u64(total, 0);
+		sums[b + 1] = (int)vgetq_lane_u64(total, 1);
+		mins[b] = vget_lane_u8(m, 0);
+		mins[b + 1] = vget_lane_u8(m, 1);
+		maxs[b] = vget_lane_u8(n, 0);
+		maxs[b + 1] = vget_lane_u8(n, 1);
+	}
+	block_stats_c(row + (b << BLOCK_SIZE_POWER), stride, count - b, sums + b, mins + b, maxs + b);
+}
+#else
+#define block_stats_simd block_stats_c
+#endif
 }
 
-HybridBinarizer::HybridBinarizer(Ref<LuminanceSource> source) :
-	GlobalHistogramBinarizer(source), matrix_(NULL), cached_row_(NULL)
+HybridBinarizer::HybridBinarizer(Ref<LuminanceSource> source, bool simd) :
+	GlobalHistogramBinarizer(source, simd), matrix_(NULL), cached_row_(NULL)
 {
 }
 
@@ -45,7 +151,7 @@ HybridBinarizer::~HybridBinarizer()
 Ref<Binarizer>
 HybridBinarizer::createBinarizer(Ref<LuminanceSource> source)
 {
-	return Ref<Binarizer>(new HybridBinarizer(source));
+	return Ref<Binarizer>(new HybridBinarizer(source, simd_));
 }
 
 
@@ -112,56 +218,61 @@ HybridBinarizer::calculateThresholdForBlock(ArrayRef<char> luminances,
 	ArrayRef<int> blackPoints,
 	Ref<BitMatrix> const &matrix)
 {
+	// Summed-area table of the black points, so that each 5x5 neighbourhood
+	// mean is four lookups: sat[y * satWidth + x] is the sum above and left of (x, y).
+	int satWidth = subWidth + 1;
+	std::vector<int> sat(satWidth * (subHeight + 1), 0);
+	for (int y = 0; y < subHeight; y++) {
+		int rowSum = 0;
+		const int *blackRow = blackPoints.data() + y * subWidth;
+		int *above = &sat[y * satWidth];
+		int *current = above + satWidth;
+		for (int x = 0; x < subWidth; x++) {
+			rowSum += blackRow[x];
+			current[x + 1] = above[x + 1] + rowSum;
+		}
+	}
+
+	const unsigned char *pixels = (const unsigned char *)luminances.data();
+	std::vector<unsigned char> thresholds(width);
+	int maxXOffset = width - BLOCK_SIZE;
+	int maxYOffset = height - BLOCK_SIZE;
 	for (int y = 0; y < subHeight; y++) {
 		int yoffset = y << BLOCK_SIZE_POWER;
-		int maxYOffset = height - BLOCK_SIZE;
 		if (yoffset > maxYOffset) {
 			yoffset = maxYOffset;
 		}
+		int top = cap(y, 2, subHeight - 3);
+		const int *satTop = &sat[(top - 2) * satWidth];
+		const int *satBottom = &sat[(top + 3) * satWidth];
 		for (int x = 0; x < subWidth; x++) {
+			int left = cap(x, 2, subWidth - 3);
+			int sum = satBottom[left + 3] - satBottom[left - 2] - satTop[left + 3] + satTop[left - 2];
+			unsigned char average = (unsigned char)(sum / 25);
 			int xoffset = x << BLOCK_SIZE_POWER;
-			int maxXOffset = width - BLOCK_SIZE;
 			if (xoffset > maxXOffset) {
-				xoffset = maxXOffset;
+				// The last block is pulled back over its neighbour; a pixel
+				// under both is black under either threshold.
+				for (int xx = maxXOffset; xx < width; xx++) {
+					if (xx >= xoffset || thresholds[xx] < average) {
+						thresholds[xx] = average;
+					}
+				}
 			}
-			int left = cap(x, 2, subWidth - 3);
-			int top = cap(y, 2, subHeight - 3);
-			int sum = 0;
-			for (int z = -2; z <= 2; z++) {
-				int *blackRow = &blackPoints[(top + z) * subWidth];
-				sum += blackRow[left - 2];
-				sum += blackRow[left - 1];
-				sum += blackRow[left];
-				sum += blackRow[left + 1];
-				sum += blackRow[left + 2];
+			else {
+				memset(&thresholds[xoffset], average, BLOCK_SIZE);
 			}
-			int average = sum / 25;
-			thresholdBlock(luminances, xoffset, yoffset, average, width, matrix);
 		}
-	}
-}
-
-void HybridBinarizer::thresholdBlock(ArrayRef<char> luminances,
-	int xoffset,
-	int yoffset,
-	int threshold,
-	int stride,
-	Ref<BitMatrix> const &matrix)
-{
-	for (int y = 0, offset = yoffset * stride + xoffset;
-		y < BLOCK_SIZE;
-		y++, offset += stride) {
-		for (int x = 0; x < BLOCK_SIZE; x++) {
-			int pixel = luminances[offset + x] & 0xff;
-			if (pixel <= threshold) {
-				matrix->set(xoffset + x, yoffset + y);
-			}
+		// Rows shared with the previous block row are ORed in the same way.
+		for (int yy = 0; yy < BLOCK_SIZE; yy++) {
+			int row = yoffset + yy;
+			thresholdRow(pixels + row * width, &thresholds[0], width, matrix->getRowBits(row), simd_);
 		}
 	}
 }
 
 namespace {
-inline int getBlackPointFromNeighbors(ArrayRef<int> blackPoints, int subWidth, int x, int y)
+inline int getBlackPointFromNeighbors(const int *blackPoints, int subWidth, int x, int y)
 {
 	return (blackPoints[(y - 1) * subWidth + x] +
 		2 * blackPoints[y * subWidth + x - 1] +
@@ -178,61 +289,47 @@ ArrayRef<int> HybridBinarizer::calculateBlackPoints(ArrayRef<char> luminances,
 {
 	const int minDynamicRange = 24;
 
+	const unsigned char *pixels = (const unsigned char *)luminances.data();
+	std::vector<int> sums(subWidth), mins(subWidth), maxs(subWidth);
+	// Blocks that start inside the image; a partial last block is pulled
+	// back to width - BLOCK_SIZE.
+	int fullWidth = width >> BLOCK_SIZE_POWER;
+	int maxXOffset = width - BLOCK_SIZE;
+	int maxYOffset = height - BLOCK_SIZE;
+
 	ArrayRef<int> blackPoints(subHeight * subWidth);
+	int *points = blackPoints.data();
 	for (int y = 0; y < subHeight; y++) {
 		int yoffset = y << BLOCK_SIZE_POWER;
-		int maxYOffset = height - BLOCK_SIZE;
 		if (yoffset > maxYOffset) {
 			yoffset = maxYOffset;
 		}
+		const unsigned char *row = pixels + yoffset * width;
+		if (simd_) {
+			block_stats_simd(row, width, fullWidth, &sums[0], &mins[0], &maxs[0]);
+		}
+		else {
+			block_stats_c(row, width, fullWidth, &sums[0], &mins[0], &maxs[0]);
+		}
+		if (subWidth > fullWidth) {
+			block_stats_c(row + maxXOffset, width, 1, &sums[fullWidth], &mins[fullWidth], &maxs[fullWidth]);
+		}
 		for (int x = 0; x < subWidth; x++) {
-			int xoffset = x << BLOCK_SIZE_POWER;
-			int maxXOffset = width - BLOCK_SIZE;
-			if (xoffset > maxXOffset) {
-				xoffset = maxXOffset;
-			}
-			int sum = 0;
-			int min = 0xFF;
-			int max = 0;
-			for (int yy = 0, offset = yoffset * width + xoffset;
-				yy < BLOCK_SIZE;
-				yy++, offset += width) {
-				for (int xx = 0; xx < BLOCK_SIZE; xx++) {
-					int pixel = luminances[offset + xx] & 0xFF;
-					sum += pixel;
-					// still looking for good contrast
-					if (pixel < min) {
-						min = pixel;
-					}
-					if (pixel > max) {
-						max = pixel;
-					}
-				}
-
-				// short-circuit min/max tests once dynamic range is met
-				if (max - min > minDynamicRange) {
-				  // finish the rest of the rows quickly
-					for (yy++, offset += width; yy < BLOCK_SIZE; yy++, offset += width) {
-						for (int xx = 0; xx < BLOCK_SIZE; xx += 2) {
-							sum += luminances[offset + xx] & 0xFF;
-							sum += luminances[offset + xx + 1] & 0xFF;
-						}
-					}
-				}
-			}
+			int min = mins[x];
+			int max = maxs[x];
 			// See
 			// http://groups.google.com/group/zxing/browse_thread/thread/d06efa2c35a7ddc0
-			int average = sum >> (BLOCK_SIZE_POWER * 2);
+			int average = sums[x] >> (BLOCK_SIZE_POWER * 2);
 			if (max - min <= minDynamicRange) {
 				average = min >> 1;
 				if (y > 0 && x > 0) {
-					int bp = getBlackPointFromNeighbors(blackPoints, subWidth, x, y);
+					int bp = getBlackPointFromNeighbors(points, subWidth, x, y);
 					if (min < bp) {
 						average = bp;
 					}
 				}
 			}
-			blackPoints[y * subWidth + x] = average;
+			points[y * subWidth + x] = average;
 		}
 	}
 	return blackPoints;
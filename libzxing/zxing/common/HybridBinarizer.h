@@ -34,7 +34,7 @@ private:
 	Ref<BitArray> cached_row_;
 
 public:
-	HybridBinarizer(Ref<LuminanceSource> source);
+	HybridBinarizer(Ref<LuminanceSource> source, bool simd = true);
 	virtual ~HybridBinarizer();
 
 	virtual int getBlackMatrix(Ref<BitMatrix> &matrix);
@@ -54,12 +54,6 @@ private:
 		int height,
 		ArrayRef<int> blackPoints,
 		Ref<BitMatrix> const &matrix);
-	void thresholdBlock(ArrayRef<char>luminances,
-		int xoffset,
-		int yoffset,
-		int threshold,
-		int stride,
-		Ref<BitMatrix> const &matrix);
 };
 
 }
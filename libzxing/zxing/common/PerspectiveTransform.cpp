@@ -20,6 +20,14 @@
 
 #include <zxing/common/PerspectiveTransform.h>
 
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PERSPECTIVE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PERSPECTIVE_NEON
+#endif
+
 namespace zxing {
 using namespace std;
 
@@ -106,6 +114,78 @@ void PerspectiveTransform::transformPoints(vector<float> &points)
 	}
 }
 
+void PerspectiveTransform::transformRow(float x, float y, int count, float *xs, float *ys, bool simd) const
+{
+	// Each point is evaluated in the same order as transformPoints, so the
+	// results are bit-identical to it; only the y terms are hoisted.
+	float ty1 = a21 * y;
+	float ty2 = a22 * y;
+	float ty3 = a23 * y;
+	int i = 0;
+#if defined(PERSPECTIVE_SSE2)
+	if (simd && count >= 4) {
+		__m128 vx = _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+		const __m128 four = _mm_set1_ps(4.0f);
+		for (; i + 4 <= count; i += 4) {
+			__m128 nx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a11), vx), _mm_set1_ps(ty1)), _mm_set1_ps(a31));
+			__m128 ny = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a12), vx), _mm_set1_ps(ty2)), _mm_set1_ps(a32));
+			__m128 nd = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a13), vx), _mm_set1_ps(ty3)), _mm_set1_ps(a33));
+			_mm_storeu_ps(xs + i, _mm_div_ps(nx, nd));
+			_mm_storeu_ps(ys + i, _mm_div_ps(ny, nd));
+			vx = _mm_add_ps(vx, four);
+		}
+	}
+#elif defined(PERSPECTIVE_NEON)
+	if (simd && count >= 4) {
+		static const float lanes[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+		float32x4_t vx = vaddq_f32(vdupq_n_f32(x), vld1q_f32(lanes));
+		const float32x4_t four = vdupq_n_f32(4.0f);
+		for (; i + 4 <= count; i += 4) {
+			// Separate multiply and add: a fused multiply-add would round differently.
+			float32x4_t nx = vaddq_f32(vaddq_f32(vmulq_n_f32(vx, a11), vdupq_n_f32(ty1)), vdupq_n_f32(a31));
+			float32x4_t ny = vaddq_f32(vaddq_f32(vmulq_n_f32(vx, a12), vdupq_n_f32(ty2)), vdupq_n_f32(a32));
+			float32x4_t nd = vaddq_f32(vaddq_f32(vmulq_n_f32(vx, a13), vdupq_n_f32(ty3)), vdupq_n_f32(a33));
+#if defined(__aarch64__)
+			vst1q_f32(xs + i, vdivq_f32(nx, nd));
+			vst1q_f32(ys + i, vdivq_f32(ny, nd));
+#else
+			// No vector divide on ARMv7, and a reciprocal estimate is not exact.
+			vst1q_f32(xs + i, nx);
+			vst1q_f32(ys + i, ny);
+			float d[4];
+			vst1q_f32(d, nd);
+			for (int j = 0; j < 4; j++) {
+				xs[i + j] /= d[j];
+				ys[i + j] /= d[j];
+			}
+#endif
+			vx = vaddq_f32(vx, four);
+		}
+	}
+#else
+	(void)simd;
+#endif
+	for (; i < count; i++) {
+		float vx = x + (float)i;
+		float denominator = a13 * vx + ty3 + a33;
+		xs[i] = (a11 * vx + ty1 + a31) / denominator;
+		ys[i] = (a12 * vx + ty2 + a32) / denominator;
+	}
+}
+
+const char *PerspectiveTransform::getKernelName(bool simd)
+{
+	if (!simd)
+		return "C";
+#if defined(PERSPECTIVE_SSE2)
+	return "SSE2";
+#elif defined(PERSPECTIVE_NEON)
+	return "NEON";
+#else
+	return "C";
+#endif
+}
+
 ostream &operator<<(ostream &out, const PerspectiveTransform &pt)
 {
 	out << pt.a11 << ", " << pt.a12 << ", " << pt.a13 << ", \n";
@@ -41,6 +41,11 @@ public:
 	Ref<PerspectiveTransform> buildAdjoint();
 	Ref<PerspectiveTransform> times(Ref<PerspectiveTransform> other);
 	void transformPoints(std::vector<float> &points);
+	// Transforms the count points (x + i, y), i = 0..count-1, into xs/ys.
+	// Bit-identical to transformPoints; four points at a time with SSE2/NEON
+	// when simd is set.
+	void transformRow(float x, float y, int count, float *xs, float *ys, bool simd = true) const;
+	static const char *getKernelName(bool simd = true);
 
 	friend std::ostream &operator<<(std::ostream &out, const PerspectiveTransform &pt);
 };
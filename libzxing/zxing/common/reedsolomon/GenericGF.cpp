@@ -39,35 +39,97 @@ Ref<GenericGF> GenericGF::MAXICODE_FIELD_64 = AZTEC_DATA_6;
 
 namespace {
 int INITIALIZATION_THRESHOLD = 0;
+
+// exp[size - 1] wraps around to 1; log[0] is never used.
+template <int SIZE>
+struct GFTables {
+	unsigned short exp[SIZE];
+	unsigned short log[SIZE];
+
+	constexpr GFTables(int primitive) : exp(), log()
+	{
+		int x = 1;
+		for (int i = 0; i < SIZE; i++) {
+			exp[i] = (unsigned short)x;
+			if (i < SIZE - 1)
+				log[x] = (unsigned short)i;
+			x <<= 1; // x = x * 2; we're assuming the generator alpha is 2
+			if (x >= SIZE)
+				x = (x ^ primitive) & (SIZE - 1);
+		}
+	}
+};
+
+constexpr GFTables<4096> AZTEC_DATA_12_TABLES(0x1069);
+constexpr GFTables<1024> AZTEC_DATA_10_TABLES(0x409);
+constexpr GFTables<64> AZTEC_DATA_6_TABLES(0x43);
+constexpr GFTables<16> AZTEC_PARAM_TABLES(0x13);
+constexpr GFTables<256> QR_CODE_TABLES(0x011D);
+constexpr GFTables<256> DATA_MATRIX_TABLES(0x012D);
+
+struct GFTablesEntry {
+	int primitive;
+	int size;
+	const unsigned short *exp;
+	const unsigned short *log;
+};
+
+const GFTablesEntry GF_TABLES[] = {
+	{ 0x1069, 4096, AZTEC_DATA_12_TABLES.exp, AZTEC_DATA_12_TABLES.log },
+	{ 0x409, 1024, AZTEC_DATA_10_TABLES.exp, AZTEC_DATA_10_TABLES.log },
+	{ 0x43, 64, AZTEC_DATA_6_TABLES.exp, AZTEC_DATA_6_TABLES.log },
+	{ 0x13, 16, AZTEC_PARAM_TABLES.exp, AZTEC_PARAM_TABLES.log },
+	{ 0x011D, 256, QR_CODE_TABLES.exp, QR_CODE_TABLES.log },
+	{ 0x012D, 256, DATA_MATRIX_TABLES.exp, DATA_MATRIX_TABLES.log },
+};
 }
 
 GenericGF::GenericGF(int primitive_, int size_, int b)
-	: size(size_), primitive(primitive_), generatorBase(b), initialized(false)
+	: expTable(0), logTable(0), size(size_), primitive(primitive_), generatorBase(b), initialized(false)
 {
+	for (size_t i = 0; i < sizeof(GF_TABLES) / sizeof(GF_TABLES[0]); i++) {
+		if ((GF_TABLES[i].primitive == primitive) && (GF_TABLES[i].size == size)) {
+			expTable = GF_TABLES[i].exp;
+			logTable = GF_TABLES[i].log;
+			break;
+		}
+	}
+	if (expTable == 0) {
+		ownTables.resize(size * 2);
+		unsigned short *exp = &ownTables[0];
+		unsigned short *log = &ownTables[size];
+		int x = 1;
+		for (int i = 0; i < size; i++) {
+			exp[i] = (unsigned short)x;
+			x <<= 1; // x = x * 2; we're assuming the generator alpha is 2
+			if (x >= size) {
+				x ^= primitive;
+				x &= size - 1;
+			}
+		}
+		for (int i = 0; i < size - 1; i++) {
+			log[exp[i]] = (unsigned short)i;
+		}
+		expTable = exp;
+		logTable = log;
+	}
 	if (size <= INITIALIZATION_THRESHOLD) {
 		initialize();
 	}
 }
 
-void GenericGF::initialize()
+void GenericGF::initializeFields()
 {
-	expTable.resize(size);
-	logTable.resize(size);
-
-	int x = 1;
+	AZTEC_DATA_12->checkInit();
+	AZTEC_DATA_10->checkInit();
+	AZTEC_DATA_6->checkInit();
+	AZTEC_PARAM->checkInit();
+	QR_CODE_FIELD_256->checkInit();
+	DATA_MATRIX_FIELD_256->checkInit();
+}
 
-	for (int i = 0; i < size; i++) {
-		expTable[i] = x;
-		x <<= 1; // x = x * 2; we're assuming the generator alpha is 2
-		if (x >= size) {
-			x ^= primitive;
-			x &= size - 1;
-		}
-	}
-	for (int i = 0; i < size - 1; i++) {
-		logTable[expTable[i]] = i;
-	}
-	//logTable[0] == 0 but this should never be used
+void GenericGF::initialize()
+{
 	zero =
 		Ref<GenericGFPoly>(new GenericGFPoly(*this, ArrayRef<int>(new Array<int>(1))));
 	if (!zero->IsActive())
@@ -128,13 +190,11 @@ int GenericGF::addOrSubtract(int a, int b)
 
 int GenericGF::exp(int a)
 {
-	checkInit();
 	return expTable[a];
 }
 
 int GenericGF::log(int a)
 {
-	checkInit();
 	if (a == 0) {
 		throw IllegalArgumentException("cannot give log(0)");
 	}
@@ -143,7 +203,6 @@ int GenericGF::log(int a)
 
 int GenericGF::inverse(int a)
 {
-	checkInit();
 	if (a == 0) {
 		throw IllegalArgumentException("Cannot calculate the inverse of 0");
 	}
@@ -152,8 +211,6 @@ int GenericGF::inverse(int a)
 
 int GenericGF::multiply(int a, int b)
 {
-	checkInit();
-
 	if (a == 0 || b == 0) {
 		return 0;
 	}
@@ -166,6 +223,11 @@ int GenericGF::getSize()
 	return size;
 }
 
+int GenericGF::getPrimitive()
+{
+	return primitive;
+}
+
 int GenericGF::getGeneratorBase()
 {
 	return generatorBase;
@@ -31,8 +31,11 @@ class GenericGFPoly;
 class GenericGF : public Counted {
 
 private:
-	std::vector<int> expTable;
-	std::vector<int> logTable;
+	// Compile-time tables for the fields below; any other field builds its
+	// own into ownTables.
+	const unsigned short *expTable;
+	const unsigned short *logTable;
+	std::vector<unsigned short> ownTables;
 	Ref<GenericGFPoly> zero;
 	Ref<GenericGFPoly> one;
 	int size;
@@ -55,9 +58,15 @@ public:
 
 	GenericGF(int primitive, int size, int b);
 
+	// The zero and one polynomials of the fields above are built on first
+	// use, which is not safe from several threads at once; this builds them
+	// all up front.
+	static void initializeFields();
+
 	Ref<GenericGFPoly> getZero();
 	Ref<GenericGFPoly> getOne();
 	int getSize();
+	int getPrimitive();
 	int getGeneratorBase();
 	int buildMonomial(int degree, int coefficient, Ref<GenericGFPoly> &result);
 
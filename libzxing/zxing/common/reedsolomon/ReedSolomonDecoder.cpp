@@ -19,10 +19,20 @@
 #include <iostream>
 
 #include <memory>
+#include <string.h>
 #include <zxing/common/reedsolomon/ReedSolomonDecoder.h>
 #include <zxing/common/reedsolomon/ReedSolomonException.h>
 #include <zxing/common/IllegalArgumentException.h>
 #include <zxing/IllegalStateException.h>
+#include <zxing/common/DecodeProfile.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#include <emmintrin.h>
+#define REEDSOLOMON_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define REEDSOLOMON_NEON
+#endif
 
 using std::vector;
 using zxing::Ref;
@@ -34,13 +44,282 @@ using zxing::IllegalStateException;
 // VC++
 using zxing::GenericGF;
 
+namespace {
+// Largest field of the table driven decoder; twoS and the codeword length
+// are below it, which bounds the polynomials kept on the stack.
+const int MAX_FIELD_SIZE = 256;
+const int MAX_DEGREE = MAX_FIELD_SIZE;
+
+// log/antilog tables built at compile time. exp is doubled so that the sum
+// of two logarithms needs no modulo.
+struct GFTables {
+	int size;
+	int primitive;
+	unsigned char exp[MAX_FIELD_SIZE * 2];
+	unsigned char log[MAX_FIELD_SIZE];
+
+	constexpr GFTables(int primitive_, int size_) : size(size_), primitive(primitive_), exp(), log()
+	{
+		int x = 1;
+		for (int i = 0; i < (size - 1) * 2; i++) {
+			exp[i] = (unsigned char)x;
+			if (i < size - 1)
+				log[x] = (unsigned char)i;
+			x <<= 1;
+			if (x >= size)
+				x = (x ^ primitive) & (size - 1);
+		}
+	}
+};
+
+constexpr GFTables QR_CODE_TABLES(0x011D, 256);
+constexpr GFTables DATA_MATRIX_TABLES(0x012D, 256);
+constexpr GFTables AZTEC_DATA_6_TABLES(0x43, 64);
+constexpr GFTables AZTEC_PARAM_TABLES(0x13, 16);
+
+const GFTables *findTables(GenericGF &field)
+{
+	static const GFTables *const tables[] = {
+		&QR_CODE_TABLES, &DATA_MATRIX_TABLES, &AZTEC_DATA_6_TABLES, &AZTEC_PARAM_TABLES
+	};
+	for (size_t i = 0; i < sizeof(tables) / sizeof(tables[0]); i++) {
+		if ((tables[i]->size == field.getSize()) && (tables[i]->primitive == field.getPrimitive()))
+			return tables[i];
+	}
+	return 0;
+}
+
+inline int gfMultiply(const GFTables &gf, int a, int b)
+{
+	if (a == 0 || b == 0)
+		return 0;
+	return gf.exp[gf.log[a] + gf.log[b]];
+}
+
+inline int gfInverse(const GFTables &gf, int a)
+{
+	return gf.exp[gf.size - 1 - gf.log[a]];
+}
+
+// S_i = r(a^(i + base)) by Horner's rule, one syndrome at a time.
+void syndromes_c(const GFTables &gf, const int *received, int n, int twoS, int base, unsigned char *syndromes)
+{
+	int mask = gf.size - 1;
+	for (int i = 0; i < twoS; i++) {
+		int power = i + base;
+		int s = 0;
+		for (int j = 0; j < n; j++) {
+			s = (s == 0 ? 0 : gf.exp[gf.log[s] + power]) ^ (received[j] & mask);
+		}
+		syndromes[i] = (unsigned char)s;
+	}
+}
+
+#if defined(REEDSOLOMON_SSE2) || defined(REEDSOLOMON_NEON)
+const int SYNDROME_LANES = 16;
+
+// Sixteen syndromes per vector for the 256 element fields. Every Horner step
+// multiplies lane i by its own constant a^(i + base): the products of the
+// accumulator with x^0..x^7 (repeated doubling modulo the primitive) are
+// selected by the bits of the constant and XORed.
+void syndromes_simd(const GFTables &gf, const int *received, int n, int twoS, int base, unsigned char *syndromes)
+{
+	if (gf.size != 256) {
+		syndromes_c(gf, received, n, twoS, base, syndromes);
+		return;
+	}
+	for (int i0 = 0; i0 < twoS; i0 += SYNDROME_LANES) {
+		unsigned char select[8][SYNDROME_LANES];
+		for (int lane = 0; lane < SYNDROME_LANES; lane++) {
+			int power = (i0 + lane + base) % (gf.size - 1);
+			int c = gf.exp[power];
+			for (int k = 0; k < 8; k++)
+				select[k][lane] = (c >> k) & 1 ? 0xFF : 0x00;
+		}
+		unsigned char out[SYNDROME_LANES];
+#if defined(REEDSOLOMON_SSE2)
+		__m128i m[8];
+		for (int k = 0; k < 8; k++)
+			m[k] = _mm_loadu_si128((const __m128i *)select[k]);
+		const __m128i poly = _mm_set1_epi8((char)(gf.primitive & 0xFF));
+		const __m128i zero = _mm_setzero_si128();
+		__m128i s = zero;
+		for (int j = 0; j < n; j++) {
+			__m128i x = s;
+			__m128i acc = _mm_and_si128(x, m[0]);
+			for (int k = 1; k < 8; k++) {
+				__m128i carry = _mm_cmplt_epi8(x, zero);
+				x = _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(carry, poly));
+				acc = _mm_xor_si128(acc, _mm_and_si128(x, m[k]));
+			}
+			s = _mm_xor_si128(acc, _mm_set1_epi8((char)received[j]));
+		}
+		_mm_storeu_si128((__m128i *)out, s);
+#else
+		uint8x16_t m[8];
+		for (int k = 0; k < 8; k++)
+			m[k] = vld1q_u8(select[k]);
+		const uint8x16_t poly = vdupq_n_u8((uint8_t)(gf.primitive & 0xFF));
+		uint8x16_t s = vdupq_n_u8(0);
+		for (int j = 0; j < n; j++) {
+			uint8x16_t x = s;
+			uint8x16_t acc = vandq_u8(x, m[0]);
+			for (int k = 1; k < 8; k++) {
+				uint8x16_t carry = vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(x), 7));
+				x = veorq_u8(vshlq_n_u8(x, 1), vandq_u8(carry, poly));
+				acc = veorq_u8(acc, vandq_u8(x, m[k]));
+			}
+			s = veorq_u8(acc, vdupq_n_u8((uint8_t)received[j]));
+		}
+		vst1q_u8(out, s);
+#endif
+		int count = twoS - i0 < SYNDROME_LANES ? twoS - i0 : SYNDROME_LANES;
+		for (int lane = 0; lane < count; lane++)
+			syndromes[i0 + lane] = out[lane];
+	}
+}
+#else
+#define syndromes_simd syndromes_c
+#endif
+
+// Berlekamp-Massey for the error locator, Chien search for its roots and
+// Forney for the magnitudes. All polynomials are fixed size arrays.
+int decodeTables(const GFTables &gf, int *received, int n, int twoS, int base, bool simd)
+{
+	const int order = gf.size - 1;
+	unsigned char syndromes[MAX_DEGREE];
+	if (simd)
+		syndromes_simd(gf, received, n, twoS, base, syndromes);
+	else
+		syndromes_c(gf, received, n, twoS, base, syndromes);
+
+	bool noError = true;
+	for (int i = 0; i < twoS; i++) {
+		if (syndromes[i] != 0) {
+			noError = false;
+			break;
+		}
+	}
+	if (noError)
+		return 0;
+
+	// Error locator: lambda(x) = prod(1 - X_k x)
+	unsigned char lambda[MAX_DEGREE + 1] = { 1 };
+	unsigned char prev[MAX_DEGREE + 1] = { 1 };
+	unsigned char tmp[MAX_DEGREE + 1];
+	int L = 0, shift = 1, lastDiscrepancy = 1;
+	for (int k = 0; k < twoS; k++) {
+		int d = syndromes[k];
+		for (int i = 1; i <= L; i++)
+			d ^= gfMultiply(gf, lambda[i], syndromes[k - i]);
+		if (d == 0) {
+			shift++;
+			continue;
+		}
+		int scale = gfMultiply(gf, d, gfInverse(gf, lastDiscrepancy));
+		if (2 * L <= k) {
+			memcpy(tmp, lambda, twoS + 1);
+			for (int i = 0; i + shift <= twoS; i++)
+				lambda[i + shift] ^= gfMultiply(gf, scale, prev[i]);
+			L = k + 1 - L;
+			memcpy(prev, tmp, twoS + 1);
+			lastDiscrepancy = d;
+			shift = 1;
+		}
+		else {
+			for (int i = 0; i + shift <= twoS; i++)
+				lambda[i + shift] ^= gfMultiply(gf, scale, prev[i]);
+			shift++;
+		}
+	}
+	if (2 * L > twoS)
+		return -1;
+
+	// Chien search over the positions of the codeword only; a root elsewhere
+	// leaves fewer than L of them and fails the decode.
+	int terms[MAX_DEGREE + 1];
+	for (int i = 1; i <= L; i++)
+		terms[i] = lambda[i] == 0 ? -1 : gf.log[lambda[i]];
+	int positions[MAX_DEGREE];
+	int found = 0;
+	for (int p = 0; p < n && found < L; p++) {
+		// terms[i] = log(lambda_i * a^(-i p))
+		int sum = lambda[0];
+		for (int i = 1; i <= L; i++) {
+			if (terms[i] < 0)
+				continue;
+			sum ^= gf.exp[terms[i]];
+			terms[i] -= i % order;
+			if (terms[i] < 0)
+				terms[i] += order;
+		}
+		if (sum == 0)
+			positions[found++] = p;
+	}
+	if (found != L)
+		return -1;
+
+	// Error evaluator: omega(x) = S(x) lambda(x) mod x^twoS
+	unsigned char omega[MAX_DEGREE];
+	for (int i = 0; i < twoS; i++) {
+		int v = 0;
+		for (int j = 0; j <= i && j <= L; j++)
+			v ^= gfMultiply(gf, lambda[j], syndromes[i - j]);
+		omega[i] = (unsigned char)v;
+	}
+
+	// Forney: e_k = X_k^(1 - base) omega(X_k^-1) / lambda'(X_k^-1)
+	for (int e = 0; e < L; e++) {
+		int p = positions[e];
+		int xInverse = gf.exp[(order - p % order) % order];
+		int numerator = 0;
+		for (int i = twoS - 1; i >= 0; i--)
+			numerator = gfMultiply(gf, numerator, xInverse) ^ omega[i];
+		int denominator = 0;
+		int xInverse2 = gfMultiply(gf, xInverse, xInverse);
+		for (int i = L - (L % 2 == 0 ? 1 : 0); i >= 1; i -= 2)
+			denominator = gfMultiply(gf, denominator, xInverse2) ^ lambda[i];
+		if (denominator == 0)
+			return -1;
+		int magnitude = gfMultiply(gf, numerator, gfInverse(gf, denominator));
+		if (base == 0)
+			magnitude = gfMultiply(gf, magnitude, gf.exp[p % order]);
+		received[n - 1 - p] ^= magnitude;
+	}
+	return 0;
+}
+}
+
 ReedSolomonDecoder::ReedSolomonDecoder(Ref<GenericGF> field_) : field(field_) {}
 
 ReedSolomonDecoder::~ReedSolomonDecoder()
 {
 }
 
-int ReedSolomonDecoder::decode(ArrayRef<int> received, int twoS)
+const char *ReedSolomonDecoder::getKernelName(bool simd)
+{
+	if (!simd)
+		return "C";
+#if defined(REEDSOLOMON_SSE2)
+	return "SSE2";
+#elif defined(REEDSOLOMON_NEON)
+	return "NEON";
+#else
+	return "C";
+#endif
+}
+
+int ReedSolomonDecoder::decode(ArrayRef<int> received, int twoS, Kernel kernel)
+{
+	DecodeProfile::Scope scope(DecodeProfile::ERROR_CORRECTION);
+	int n = received->size();
+	const GFTables *gf = kernel == KERNEL_EUCLIDEAN ? 0 : findTables(*field);
+	if ((gf == 0) || (twoS <= 0) || (twoS > n) || (n > gf->size - 1))
+		return decodeEuclidean(received, twoS);
+	return decodeTables(*gf, &received[0], n, twoS, field->getGeneratorBase(), kernel == KERNEL_AUTO);
+}
+
+int ReedSolomonDecoder::decodeEuclidean(ArrayRef<int> received, int twoS)
 {
 	Ref<GenericGFPoly> poly(new GenericGFPoly(*field, received));
 	if (!poly->IsActive())
@@ -32,15 +32,26 @@ class GenericGFPoly;
 class GenericGF;
 
 class ReedSolomonDecoder {
+public:
+	enum Kernel {
+		KERNEL_AUTO,		// table driven, syndromes with SSE2/NEON when available
+		KERNEL_SCALAR,		// table driven, portable
+		KERNEL_EUCLIDEAN	// GenericGFPoly and the Euclidean algorithm (reference)
+	};
+
 private:
 	Ref<GenericGF> field;
 public:
 	ReedSolomonDecoder(Ref<GenericGF> fld);
 	~ReedSolomonDecoder();
-	int decode(ArrayRef<int> received, int twoS);
+	// The table driven kernels handle the fields of up to 256 elements (QR code,
+	// Data Matrix and the smaller Aztec fields); others always use the Euclidean one.
+	int decode(ArrayRef<int> received, int twoS, Kernel kernel = KERNEL_AUTO);
 	int runEuclideanAlgorithm(Ref<GenericGFPoly> a, Ref<GenericGFPoly> b, int R, std::vector<Ref<GenericGFPoly>> &result);
+	static const char *getKernelName(bool simd = true);
 
 private:
+	int decodeEuclidean(ArrayRef<int> received, int twoS);
 	int findErrorLocations(Ref<GenericGFPoly> errorLocator, ArrayRef<int> &result);
 	ArrayRef<int> findErrorMagnitudes(Ref<GenericGFPoly> errorEvaluator, ArrayRef<int> errorLocations);
 };
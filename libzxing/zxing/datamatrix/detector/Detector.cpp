@@ -25,6 +25,7 @@
 #include <zxing/datamatrix/detector/Detector.h>
 #include <zxing/common/detector/MathUtils.h>
 #include <zxing/NotFoundException.h>
+#include <zxing/common/DecodeProfile.h>
 #include <sstream>
 #include <cstdlib>
 #include <algorithm>
@@ -90,6 +91,7 @@ Ref<BitMatrix> Detector::getImage()
 
 int Detector::detect(Ref<DetectorResult> &result)
 {
+	DecodeProfile::Scope scope(DecodeProfile::DETECT);
 	Ref<WhiteRectangleDetector> rectangleDetector_(new WhiteRectangleDetector(image_));
 
 	int ret;
@@ -17,6 +17,7 @@
 #include <zxing/multi/qrcode/detector/MultiDetector.h>
 #include <zxing/multi/qrcode/detector/MultiFinderPatternFinder.h>
 #include <zxing/ReaderException.h>
+#include <zxing/common/DecodeProfile.h>
 
 namespace zxing {
 namespace multi {
@@ -28,6 +29,7 @@ MultiDetector::~MultiDetector() {}
 
 int MultiDetector::detectMulti(DecodeHints hints, std::vector<Ref<DetectorResult>> &results)
 {
+	DecodeProfile::Scope scope(DecodeProfile::DETECT);
 	Ref<BitMatrix> image = getImage();
 	MultiFinderPatternFinder finder = MultiFinderPatternFinder(image, hints.getResultPointCallback());
 	int ret;
@@ -309,6 +309,8 @@ int Code128Reader::decodeRow(int rowNumber, Ref<BitArray> row, Ref<Result> &rres
 		lastCode = code;
 
 		code = decodeCode(row, counters, nextStart);
+		if (code < 0)
+			return code;
 
 		// Remember whether the last code was printable or not (excluding CODE_STOP)
 		if (code != CODE_STOP) {
@@ -20,6 +20,7 @@
 #include <zxing/ReaderException.h>
 #include <zxing/oned/OneDResultPoint.h>
 #include <zxing/NotFoundException.h>
+#include <zxing/common/DecodeProfile.h>
 #include <math.h>
 #include <limits.h>
 #include <algorithm>
@@ -74,6 +75,7 @@ int OneDReader::decode(Ref<BinaryBitmap> image, DecodeHints hints, Ref<Result> &
 
 int OneDReader::doDecode(Ref<BinaryBitmap> image, DecodeHints hints, Ref<Result> &result)
 {
+	DecodeProfile::Scope scope(DecodeProfile::DETECT);
 	int width = image->getWidth();
 	int height = image->getHeight();
 	Ref<BitArray> row(new BitArray(width));
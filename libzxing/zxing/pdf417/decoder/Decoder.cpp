@@ -25,6 +25,7 @@
 #include <zxing/pdf417/decoder/DecodedBitStreamParser.h>
 #include <zxing/ReaderException.h>
 #include <zxing/common/reedsolomon/ReedSolomonException.h>
+#include <zxing/common/DecodeProfile.h>
 
 using zxing::pdf417::decoder::Decoder;
 using zxing::pdf417::decoder::ec::ErrorCorrection;
@@ -42,6 +43,7 @@ const int Decoder::MAX_EC_CODEWORDS = 512;
 
 int Decoder::decode(Ref<BitMatrix> bits, DecodeHints const &hints, Ref<DecoderResult> &result)
 {
+	DecodeProfile::Scope scope(DecodeProfile::BITSTREAM);
 	(void)hints;
 	// Construct a parser to read the data codewords and error-correction level
 	BitMatrixParser parser(bits);
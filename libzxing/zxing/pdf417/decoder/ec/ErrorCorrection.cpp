@@ -20,6 +20,8 @@
 #include <zxing/pdf417/decoder/ec/ErrorCorrection.h>
 #include <zxing/pdf417/decoder/ec/ModulusPoly.h>
 #include <zxing/pdf417/decoder/ec/ModulusGF.h>
+#include <zxing/common/DecodeProfile.h>
+#include <string.h>
 
 using std::vector;
 using zxing::Ref;
@@ -28,6 +30,170 @@ using zxing::pdf417::decoder::ec::ErrorCorrection;
 using zxing::pdf417::decoder::ec::ModulusPoly;
 using zxing::pdf417::decoder::ec::ModulusGF;
 
+namespace {
+// GF(929) with generator 3, the field of ModulusGF::PDF417_GF.
+const int MODULUS = 929;
+const int ORDER = MODULUS - 1;
+// Decoder::MAX_EC_CODEWORDS; bounds the polynomials kept on the stack.
+const int MAX_EC_CODEWORDS = 512;
+
+// log/antilog tables built at compile time. exp is doubled so that the sum
+// of two logarithms needs no modulo.
+struct ModulusTables {
+	unsigned short exp[ORDER * 2];
+	unsigned short log[MODULUS];
+
+	constexpr ModulusTables(int generator) : exp(), log()
+	{
+		int x = 1;
+		for (int i = 0; i < ORDER * 2; i++) {
+			exp[i] = (unsigned short)x;
+			if (i < ORDER)
+				log[x] = (unsigned short)i;
+			x = (x * generator) % MODULUS;
+		}
+	}
+};
+
+constexpr ModulusTables PDF417_TABLES(3);
+
+inline int gfAdd(int a, int b)
+{
+	int sum = a + b;
+	return sum >= MODULUS ? sum - MODULUS : sum;
+}
+
+inline int gfSubtract(int a, int b)
+{
+	int difference = a - b;
+	return difference < 0 ? difference + MODULUS : difference;
+}
+
+inline int gfMultiply(int a, int b)
+{
+	if (a == 0 || b == 0)
+		return 0;
+	return PDF417_TABLES.exp[PDF417_TABLES.log[a] + PDF417_TABLES.log[b]];
+}
+
+inline int gfInverse(int a)
+{
+	return PDF417_TABLES.exp[ORDER - PDF417_TABLES.log[a]];
+}
+
+// Same steps as the table driven ReedSolomonDecoder: syndromes by Horner's
+// rule, Berlekamp-Massey for the error locator, Chien search over the
+// codeword positions and Forney for the magnitudes, all on fixed size
+// arrays. The syndromes are r(3^i) for i = 1..twoS.
+int decodeTables(int *received, int n, int twoS)
+{
+	const ModulusTables &gf = PDF417_TABLES;
+	unsigned short syndromes[MAX_EC_CODEWORDS];
+	bool noError = true;
+	for (int i = 0; i < twoS; i++) {
+		int power = i + 1;
+		int s = 0;
+		for (int j = 0; j < n; j++) {
+			s = gfAdd(s == 0 ? 0 : gf.exp[gf.log[s] + power], received[j]);
+		}
+		syndromes[i] = (unsigned short)s;
+		if (s != 0)
+			noError = false;
+	}
+	if (noError)
+		return 0;
+
+	// Error locator: lambda(x) = prod(1 - X_k x)
+	unsigned short lambda[MAX_EC_CODEWORDS + 1] = { 1 };
+	unsigned short prev[MAX_EC_CODEWORDS + 1] = { 1 };
+	unsigned short tmp[MAX_EC_CODEWORDS + 1];
+	int L = 0, shift = 1, lastDiscrepancy = 1;
+	for (int k = 0; k < twoS; k++) {
+		int d = syndromes[k];
+		for (int i = 1; i <= L; i++)
+			d = gfAdd(d, gfMultiply(lambda[i], syndromes[k - i]));
+		if (d == 0) {
+			shift++;
+			continue;
+		}
+		int scale = gfMultiply(d, gfInverse(lastDiscrepancy));
+		if (2 * L <= k) {
+			memcpy(tmp, lambda, (twoS + 1) * sizeof(lambda[0]));
+			for (int i = 0; i + shift <= twoS; i++)
+				lambda[i + shift] = (unsigned short)gfSubtract(lambda[i + shift], gfMultiply(scale, prev[i]));
+			L = k + 1 - L;
+			memcpy(prev, tmp, (twoS + 1) * sizeof(prev[0]));
+			lastDiscrepancy = d;
+			shift = 1;
+		}
+		else {
+			for (int i = 0; i + shift <= twoS; i++)
+				lambda[i + shift] = (unsigned short)gfSubtract(lambda[i + shift], gfMultiply(scale, prev[i]));
+			shift++;
+		}
+	}
+	if (2 * L > twoS)
+		return -1;
+
+	// Chien search; terms[i] = log(lambda_i * 3^(-i p))
+	int terms[MAX_EC_CODEWORDS + 1];
+	for (int i = 1; i <= L; i++)
+		terms[i] = lambda[i] == 0 ? -1 : gf.log[lambda[i]];
+	int positions[MAX_EC_CODEWORDS / 2];
+	int found = 0;
+	for (int p = 0; p < n && found < L; p++) {
+		int sum = lambda[0];
+		for (int i = 1; i <= L; i++) {
+			if (terms[i] < 0)
+				continue;
+			sum = gfAdd(sum, gf.exp[terms[i]]);
+			terms[i] -= i;
+			if (terms[i] < 0)
+				terms[i] += ORDER;
+		}
+		if (sum == 0)
+			positions[found++] = p;
+	}
+	if (found != L)
+		return -1;
+
+	// Error evaluator: omega(x) = S(x) lambda(x) mod x^twoS
+	unsigned short omega[MAX_EC_CODEWORDS];
+	for (int i = 0; i < twoS; i++) {
+		int v = 0;
+		for (int j = 0; j <= i && j <= L; j++)
+			v = gfAdd(v, gfMultiply(lambda[j], syndromes[i - j]));
+		omega[i] = (unsigned short)v;
+	}
+
+	// Forney: e_k = -omega(X_k^-1) / lambda'(X_k^-1), and r -= e_k
+	for (int e = 0; e < L; e++) {
+		int p = positions[e];
+		int xInverse = gf.exp[(ORDER - p) % ORDER];
+		int numerator = 0;
+		for (int i = twoS - 1; i >= 0; i--)
+			numerator = gfAdd(gfMultiply(numerator, xInverse), omega[i]);
+		int denominator = 0;
+		for (int i = L; i >= 1; i--)
+			denominator = gfAdd(gfMultiply(denominator, xInverse), gfMultiply(i, lambda[i]));
+		if (denominator == 0)
+			return -1;
+		int position = n - 1 - p;
+		received[position] = gfAdd(received[position], gfMultiply(numerator, gfInverse(denominator)));
+	}
+	return 0;
+}
+
+bool isFieldElements(ArrayRef<int> received)
+{
+	for (int i = 0; i < received->size(); i++) {
+		if (received[i] < 0 || received[i] >= MODULUS)
+			return false;
+	}
+	return true;
+}
+}
+
 /**
  * <p>PDF417 error correction implementation.</p>
  *
@@ -48,6 +214,14 @@ int ErrorCorrection::decode(ArrayRef<int> received,
 	int numECCodewords,
 	ArrayRef<int> erasures)
 {
+	DecodeProfile::Scope scope(DecodeProfile::ERROR_CORRECTION);
+	// The erasures are not used by either path.
+	int n = received->size();
+	if ((numECCodewords > 0) && (numECCodewords <= MAX_EC_CODEWORDS) && (numECCodewords <= n) &&
+		(n <= ORDER) && isFieldElements(received)) {
+		return decodeTables(&received[0], n, numECCodewords);
+	}
+
 	Ref<ModulusPoly> poly(new ModulusPoly(field_, received));
 	ArrayRef<int> S(new Array<int>(numECCodewords));
 	bool error = false;
@@ -90,9 +264,7 @@ int ErrorCorrection::decode(ArrayRef<int> received,
 		ArrayRef<int> errorLocations;
 		if ((ret = findErrorLocations(sigma, errorLocations)) < 0)
 			return ret;
-		ArrayRef<int> errorMagnitudes;
-		if ((ret = findErrorMagnitudes(omega, sigma, errorLocations)) < 0)
-			return ret;
+		ArrayRef<int> errorMagnitudes = findErrorMagnitudes(omega, sigma, errorLocations);
 
 		for (int i = 0; i < errorLocations->size(); i++) {
 			int position = received->size() - 1 - field_.log(errorLocations[i]);
@@ -200,7 +372,7 @@ int ErrorCorrection::findErrorLocations(Ref<ModulusPoly> errorLocator, ArrayRef<
 		OutputDebugString(szmsg);
 	}
 #endif
-	return result;
+	return 0;
 }
 
 ArrayRef<int> ErrorCorrection::findErrorMagnitudes(Ref<ModulusPoly> errorEvaluator,
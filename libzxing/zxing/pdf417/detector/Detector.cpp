@@ -21,6 +21,7 @@
 #include <zxing/common/GridSampler.h>
 #include <zxing/common/detector/JavaMath.h>
 #include <zxing/common/detector/MathUtils.h>
+#include <zxing/common/DecodeProfile.h>
 #include <algorithm>  // vs12, std::min und std:max
 
 using std::max;
@@ -83,6 +84,7 @@ int Detector::detect(Ref<DetectorResult> &result)
 
 int Detector::detect(DecodeHints const &hints, Ref<DetectorResult> &result)
 {
+	DecodeProfile::Scope scope(DecodeProfile::DETECT);
 	(void)hints;
 	int ret;
 	// Fetch the 1 bit matrix once up front.
@@ -236,7 +238,7 @@ ArrayRef< Ref<ResultPoint> > Detector::findVertices180(Ref<BitMatrix> matrix, in
 	ArrayRef< Ref<ResultPoint> > result(16);
 	bool found = false;
 
-	ArrayRef<int> counters = new Array<int>(START_PATTERN_REVERSE_LENGTH);
+	ArrayRef<int> counters(new Array<int>(START_PATTERN_REVERSE_LENGTH));
 
 	// Top Left
 	for (int i = height - 1; i > 0; i -= rowStep) {
@@ -334,7 +336,7 @@ ArrayRef<int> Detector::findGuardPattern(Ref<BitMatrix> matrix,
 			if (counterPosition == patternLength - 1) {
 				if (patternMatchVariance(counters, pattern,
 					MAX_INDIVIDUAL_VARIANCE) < MAX_AVG_VARIANCE) {
-					ArrayRef<int> result = new Array<int>(2);
+					ArrayRef<int> result(new Array<int>(2));
 					result[0] = patternStart;
 					result[1] = x;
 					return result;
@@ -0,0 +1,199 @@
+// -*- mode:c++; tab-width:2; indent-tabs-mode:nil; c-basic-offset:2 -*-
+/*
+ *  QRCodeTracker.cpp
+ *  zxing
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <zxing/qrcode/QRCodeTracker.h>
+#include <zxing/qrcode/detector/Detector.h>
+#include <zxing/common/GridSampler.h>
+#include <zxing/common/DetectorResult.h>
+#include <zxing/common/DecoderResult.h>
+#include <algorithm>
+
+namespace zxing {
+namespace qrcode {
+
+using std::min;
+using std::max;
+
+namespace {
+// The window searched around the last finder pattern centers, in modules.
+// A finder pattern reaches 3.5 modules from its center, which leaves about
+// 4 modules of movement between attempts.
+const float WINDOW_MARGIN = 8.0f;
+
+// Binarizes images[index] on first use so a hit on an earlier image skips
+// the later ones. An image that cannot be binarized yields an empty matrix.
+Ref<BitMatrix> getMatrix(std::vector< Ref<BinaryBitmap> > const &images,
+	std::vector< Ref<BitMatrix> > &matrices, size_t index, int &ret)
+{
+	while (matrices.size() <= index) {
+		Ref<BitMatrix> matrix;
+		if ((ret = images[matrices.size()]->getBlackMatrix(matrix)) < 0)
+			matrix.reset(0);
+		matrices.push_back(matrix);
+	}
+	return matrices[index];
+}
+}
+
+QRCodeTracker::QRCodeTracker() :
+	decoder_(), tracking_(false), dimension_(0), moduleSize_(0.0f)
+{
+	resetStats();
+}
+
+QRCodeTracker::~QRCodeTracker()
+{
+}
+
+void QRCodeTracker::reset()
+{
+	tracking_ = false;
+	transform_.reset(0);
+	points_ = ArrayRef< Ref<ResultPoint> >();
+}
+
+void QRCodeTracker::resetStats()
+{
+	frames_ = 0;
+	misses_ = 0;
+	for (int i = 0; i < TIER_COUNT; i++) {
+		attempts_[i] = 0;
+		hits_[i] = 0;
+	}
+}
+
+const char *QRCodeTracker::getTierName(Tier tier)
+{
+	switch (tier) {
+	case PREDICTED:
+		return "predicted";
+	case WINDOW:
+		return "window";
+	default:
+		return "full";
+	}
+}
+
+int QRCodeTracker::decode(Ref<BinaryBitmap> image, DecodeHints hints, Ref<Result> &result)
+{
+	std::vector< Ref<BinaryBitmap> > images(1, image);
+	return decode(images, hints, result);
+}
+
+int QRCodeTracker::decode(std::vector< Ref<BinaryBitmap> > const &images, DecodeHints hints, Ref<Result> &result)
+{
+	int ret = -1;
+	std::vector< Ref<BitMatrix> > matrices;
+	frames_++;
+
+	if (tracking_) {
+		attempts_[PREDICTED]++;
+		for (size_t i = 0; i < images.size(); i++) {
+			Ref<BitMatrix> matrix = getMatrix(images, matrices, i, ret);
+			Ref<BitMatrix> bits;
+			if (!matrix.empty()
+				&& (GridSampler::getInstance().sampleGrid(matrix, dimension_, transform_, bits) == 0)
+				&& (decodeBits(bits, points_, result) == 0)) {
+				hits_[PREDICTED]++;
+				return 0;
+			}
+		}
+
+		attempts_[WINDOW]++;
+		for (size_t i = 0; i < images.size(); i++) {
+			Ref<BitMatrix> matrix = getMatrix(images, matrices, i, ret);
+			if (!matrix.empty() && (detectAndDecode(matrix, hints, true, result) == 0)) {
+				hits_[WINDOW]++;
+				return 0;
+			}
+		}
+	}
+
+	attempts_[FULL]++;
+	for (size_t i = 0; i < images.size(); i++) {
+		Ref<BitMatrix> matrix = getMatrix(images, matrices, i, ret);
+		if (matrix.empty())
+			continue;
+		if ((ret = detectAndDecode(matrix, hints, false, result)) == 0) {
+			hits_[FULL]++;
+			return 0;
+		}
+	}
+
+	misses_++;
+	reset();
+	return ret;
+}
+
+int QRCodeTracker::decodeBits(Ref<BitMatrix> bits, ArrayRef< Ref<ResultPoint> > points, Ref<Result> &result)
+{
+	int ret;
+	Ref<DecoderResult> decoderResult;
+	if ((ret = decoder_.decode(bits, decoderResult)) < 0)
+		return ret;
+	result = new Result(decoderResult->getText(), decoderResult->getRawBytes(), points, BarcodeFormat::QR_CODE);
+	return 0;
+}
+
+int QRCodeTracker::detectAndDecode(Ref<BitMatrix> matrix, DecodeHints const &hints, bool window, Ref<Result> &result)
+{
+	int ret;
+	Detector detector(matrix);
+	Ref<DetectorResult> detectorResult;
+	if (window) {
+		int left, top, right, bottom;
+		getWindow(matrix->getWidth(), matrix->getHeight(), left, top, right, bottom);
+		if ((right <= left) || (bottom <= top))
+			return -1;
+		ret = detector.detect(hints, left, top, right - left, bottom - top, detectorResult);
+	}
+	else {
+		ret = detector.detect(hints, detectorResult);
+	}
+	if (ret < 0)
+		return ret;
+
+	if ((ret = decodeBits(detectorResult->getBits(), detectorResult->getPoints(), result)) < 0)
+		return ret;
+
+	tracking_ = true;
+	transform_ = detector.getTransform();
+	dimension_ = detector.getDimension();
+	moduleSize_ = detector.getModuleSize();
+	points_ = detectorResult->getPoints();
+	return 0;
+}
+
+void QRCodeTracker::getWindow(int width, int height, int &left, int &top, int &right, int &bottom) const
+{
+	float minX = (float)width, minY = (float)height, maxX = 0.0f, maxY = 0.0f;
+	for (int i = 0; i < points_->size(); i++) {
+		minX = min(minX, points_[i]->getX());
+		minY = min(minY, points_[i]->getY());
+		maxX = max(maxX, points_[i]->getX());
+		maxY = max(maxY, points_[i]->getY());
+	}
+	float margin = WINDOW_MARGIN * moduleSize_;
+	left = max(0, (int)(minX - margin));
+	top = max(0, (int)(minY - margin));
+	right = min(width, (int)(maxX + margin) + 1);
+	bottom = min(height, (int)(maxY + margin) + 1);
+}
+
+}
+}
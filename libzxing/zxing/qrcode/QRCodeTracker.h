@@ -0,0 +1,98 @@
+// -*- mode:c++; tab-width:2; indent-tabs-mode:nil; c-basic-offset:2 -*-
+#ifndef __QR_CODE_TRACKER_H__
+#define __QR_CODE_TRACKER_H__
+
+/*
+ *  QRCodeTracker.h
+ *  zxing
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <zxing/common/Counted.h>
+#include <zxing/common/Array.h>
+#include <zxing/common/BitMatrix.h>
+#include <zxing/common/PerspectiveTransform.h>
+#include <zxing/qrcode/decoder/Decoder.h>
+#include <zxing/BinaryBitmap.h>
+#include <zxing/DecodeHints.h>
+#include <zxing/Result.h>
+#include <zxing/ResultPoint.h>
+#include <vector>
+
+namespace zxing {
+namespace qrcode {
+
+/**
+ * QR code reader for a stream of frames of the same scene.
+ *
+ * A code held in front of the camera barely moves between attempts, so the
+ * geometry of the last decode is reused in three tiers:
+ *  1. Predicted: sample the grid with the previous transform and decode.
+ *  2. Window: search finder patterns only around the previous location.
+ *  3. Full: the usual whole-image finder pattern scan.
+ * The Reed-Solomon check of the decoder rejects a stale prediction, and a
+ * failed full scan forgets the location.
+ *
+ * A frame may be given as several binarizations of the same image; each
+ * tier is tried on all of them before falling back to the next tier, and
+ * the frame counts as one attempt.
+ */
+class QRCodeTracker : public Counted {
+public:
+	enum Tier {
+		PREDICTED,
+		WINDOW,
+		FULL,
+		TIER_COUNT
+	};
+
+private:
+	Decoder decoder_;
+	bool tracking_;
+	Ref<PerspectiveTransform> transform_;
+	int dimension_;
+	float moduleSize_;
+	ArrayRef< Ref<ResultPoint> > points_;
+	int frames_;
+	int misses_;
+	int attempts_[TIER_COUNT];
+	int hits_[TIER_COUNT];
+
+	int decodeBits(Ref<BitMatrix> bits, ArrayRef< Ref<ResultPoint> > points, Ref<Result> &result);
+	int detectAndDecode(Ref<BitMatrix> matrix, DecodeHints const &hints, bool window, Ref<Result> &result);
+	void getWindow(int width, int height, int &left, int &top, int &right, int &bottom) const;
+
+public:
+	QRCodeTracker();
+	virtual ~QRCodeTracker();
+
+	int decode(Ref<BinaryBitmap> image, DecodeHints hints, Ref<Result> &result);
+	// images are binarizations of one frame, in order of preference.
+	int decode(std::vector< Ref<BinaryBitmap> > const &images, DecodeHints hints, Ref<Result> &result);
+	// Forgets the last location; the next decode starts with a full scan.
+	void reset();
+	void resetStats();
+
+	bool isTracking() const { return tracking_; }
+	int getFrames() const { return frames_; }
+	int getMisses() const { return misses_; }
+	int getAttempts(Tier tier) const { return attempts_[tier]; }
+	int getHits(Tier tier) const { return hits_[tier]; }
+	static const char *getTierName(Tier tier);
+};
+
+}
+}
+
+#endif // __QR_CODE_TRACKER_H__
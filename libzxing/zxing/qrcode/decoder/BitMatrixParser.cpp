@@ -130,6 +130,8 @@ int BitMatrixParser::readCodewords(ArrayRef<char> &result)
 	if ((ret = readFormatInformation(formatInfo)) < 0)
 		return ret;
 	Version *version = readVersion();
+	if (version == NULL)
+		return -1;
 
 
 	// Get the data mask for the format used in this QR Code. This will exclude
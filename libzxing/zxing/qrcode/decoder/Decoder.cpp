@@ -28,6 +28,7 @@
 #include <zxing/ReaderException.h>
 #include <zxing/ChecksumException.h>
 #include <zxing/common/reedsolomon/ReedSolomonException.h>
+#include <zxing/common/DecodeProfile.h>
 
 using zxing::qrcode::Decoder;
 using zxing::DecoderResult;
@@ -63,6 +64,7 @@ int Decoder::correctErrors(ArrayRef<char> codewordBytes, int numDataCodewords)
 
 int Decoder::decode(Ref<BitMatrix> bits, Ref<DecoderResult> &result)
 {
+	DecodeProfile::Scope scope(DecodeProfile::BITSTREAM);
 	// Construct a parser and read version, error-correction level
 	BitMatrixParser parser(bits);
 	if (!parser.IsActive())
@@ -28,6 +28,7 @@
 #include <zxing/common/GridSampler.h>
 #include <zxing/DecodeHints.h>
 #include <zxing/common/detector/MathUtils.h>
+#include <zxing/common/DecodeProfile.h>
 #include <sstream>
 #include <cstdlib>
 #include <algorithm>  // vs12, std::min und std:max
@@ -52,7 +53,7 @@ using zxing::qrcode::FinderPatternInfo;
 using zxing::ResultPoint;
 
 Detector::Detector(Ref<BitMatrix> image) :
-	image_(image)
+	image_(image), dimension_(0), moduleSize_(0.0f)
 {
 }
 
@@ -68,6 +69,7 @@ Ref<ResultPointCallback> Detector::getResultPointCallback() const
 
 int Detector::detect(DecodeHints const &hints, Ref<DetectorResult> &result)
 {
+	DecodeProfile::Scope scope(DecodeProfile::DETECT);
 	callback_ = hints.getResultPointCallback();
 	FinderPatternFinder finder(image_, hints.getResultPointCallback());
 	int ret;
@@ -77,6 +79,18 @@ int Detector::detect(DecodeHints const &hints, Ref<DetectorResult> &result)
 	return processFinderPatternInfo(info, result);
 }
 
+int Detector::detect(DecodeHints const &hints, int left, int top, int width, int height, Ref<DetectorResult> &result)
+{
+	DecodeProfile::Scope scope(DecodeProfile::DETECT);
+	callback_ = hints.getResultPointCallback();
+	FinderPatternFinder finder(image_, hints.getResultPointCallback());
+	int ret;
+	Ref<FinderPatternInfo> info;
+	if ((ret = finder.find(hints, left, top, width, height, info)) < 0)
+		return ret;
+	return processFinderPatternInfo(info, result);
+}
+
 int Detector::processFinderPatternInfo(Ref<FinderPatternInfo> info, Ref<DetectorResult> &result)
 {
 	Ref<FinderPattern> topLeft(info->getTopLeft());
@@ -125,6 +139,9 @@ int Detector::processFinderPatternInfo(Ref<FinderPatternInfo> info, Ref<Detector
 	Ref<BitMatrix> bits;
 	if ((ret = sampleGrid(image_, dimension, transform, bits)) < 0)
 		return ret;
+	transform_ = transform;
+	dimension_ = dimension;
+	moduleSize_ = moduleSize;
 	ArrayRef< Ref<ResultPoint> > points(new Array< Ref<ResultPoint> >(alignmentPattern == 0 ? 3 : 4));
 	points[0].reset(bottomLeft);
 	points[1].reset(topLeft);
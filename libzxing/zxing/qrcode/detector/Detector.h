@@ -39,6 +39,10 @@ class Detector : public Counted {
 private:
 	Ref<BitMatrix> image_;
 	Ref<ResultPointCallback> callback_;
+	// Geometry of the last processFinderPatternInfo, kept for tracking.
+	Ref<PerspectiveTransform> transform_;
+	int dimension_;
+	float moduleSize_;
 
 protected:
 	Ref<BitMatrix> getImage() const;
@@ -60,6 +64,12 @@ public:
 
 	Detector(Ref<BitMatrix> image);
 	int detect(DecodeHints const &hints, Ref<DetectorResult> &result);
+	// Same as detect, but only searches the given region for finder patterns.
+	int detect(DecodeHints const &hints, int left, int top, int width, int height, Ref<DetectorResult> &result);
+
+	Ref<PerspectiveTransform> getTransform() const { return transform_; }
+	int getDimension() const { return dimension_; }
+	float getModuleSize() const { return moduleSize_; }
 
 
 };
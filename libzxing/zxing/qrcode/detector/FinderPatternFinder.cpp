@@ -50,7 +50,7 @@ public:
 		averageModuleSize_(averageModuleSize)
 	{
 	}
-	bool operator()(Ref<FinderPattern> a, Ref<FinderPattern> b)
+	bool operator()(Ref<FinderPattern> const &a, Ref<FinderPattern> const &b) const
 	{
 		float dA = abs(a->getEstimatedModuleSize() - averageModuleSize_);
 		float dB = abs(b->getEstimatedModuleSize() - averageModuleSize_);
@@ -65,7 +65,7 @@ public:
 		averageModuleSize_(averageModuleSize)
 	{
 	}
-	bool operator()(Ref<FinderPattern> a, Ref<FinderPattern> b)
+	bool operator()(Ref<FinderPattern> const &a, Ref<FinderPattern> const &b) const
 	{
 // N.B.: we want the result in descending order ...
 		if (a->getCount() != b->getCount()) {
@@ -256,7 +256,7 @@ bool FinderPatternFinder::handlePossibleCenter(int *stateCount, size_t i, size_t
 			bool found = false;
 			size_t max = possibleCenters_.size();
 			for (size_t index = 0; index < max; index++) {
-				Ref<FinderPattern> center = possibleCenters_[index];
+				Ref<FinderPattern> const &center = possibleCenters_[index];
 				// Look for about the same center and module size:
 				if (center->aboutEquals(estimatedModuleSize, centerI, centerJ)) {
 					possibleCenters_[index] = center->combineEstimate(centerI, centerJ, estimatedModuleSize);
@@ -285,7 +285,7 @@ int FinderPatternFinder::findRowSkip()
 	}
 	Ref<FinderPattern> firstConfirmedCenter;
 	for (size_t i = 0; i < max; i++) {
-		Ref<FinderPattern> center = possibleCenters_[i];
+		Ref<FinderPattern> const &center = possibleCenters_[i];
 		if (center->getCount() >= CENTER_QUORUM) {
 			if (firstConfirmedCenter == 0) {
 				firstConfirmedCenter = center;
@@ -311,7 +311,7 @@ bool FinderPatternFinder::haveMultiplyConfirmedCenters()
 	float totalModuleSize = 0.0f;
 	size_t max = possibleCenters_.size();
 	for (size_t i = 0; i < max; i++) {
-		Ref<FinderPattern> pattern = possibleCenters_[i];
+		Ref<FinderPattern> const &pattern = possibleCenters_[i];
 		if (pattern->getCount() >= CENTER_QUORUM) {
 			confirmedCount++;
 			totalModuleSize += pattern->getEstimatedModuleSize();
@@ -327,7 +327,7 @@ bool FinderPatternFinder::haveMultiplyConfirmedCenters()
 	float average = totalModuleSize / max;
 	float totalDeviation = 0.0f;
 	for (size_t i = 0; i < max; i++) {
-		Ref<FinderPattern> pattern = possibleCenters_[i];
+		Ref<FinderPattern> const &pattern = possibleCenters_[i];
 		totalDeviation += abs(pattern->getEstimatedModuleSize() - average);
 	}
 	return totalDeviation <= 0.05f * totalModuleSize;
@@ -448,11 +448,19 @@ FinderPatternFinder::FinderPatternFinder(Ref<BitMatrix> image,
 }
 
 int FinderPatternFinder::find(DecodeHints const &hints, Ref<FinderPatternInfo> &result)
+{
+	return find(hints, 0, 0, image_->getWidth(), image_->getHeight(), result);
+}
+
+int FinderPatternFinder::find(DecodeHints const &hints, int left, int top, int width, int height,
+	Ref<FinderPatternInfo> &result)
 {
 	bool tryHarder = hints.getTryHarder();
 
-	size_t maxI = image_->getHeight();
-	size_t maxJ = image_->getWidth();
+	size_t minI = top;
+	size_t minJ = left;
+	size_t maxI = top + height;
+	size_t maxJ = left + width;
 
 
 	// We are looking for black/white/black/white/black modules in
@@ -468,7 +476,7 @@ int FinderPatternFinder::find(DecodeHints const &hints, Ref<FinderPatternInfo> &
 	// modules in size. This gives the smallest number of pixels the center
 	// could be, so skip this often. When trying harder, look for all
 	// QR versions regardless of how dense they are.
-	int iSkip = (3 * maxI) / (4 * MAX_MODULES);
+	int iSkip = (3 * height) / (4 * MAX_MODULES);
 	if (iSkip < MIN_SKIP || tryHarder) {
 		iSkip = MIN_SKIP;
 	}
@@ -476,7 +484,7 @@ int FinderPatternFinder::find(DecodeHints const &hints, Ref<FinderPatternInfo> &
 	// This is slightly faster than using the Ref. Efficiency is important here
 	BitMatrix &matrix = *image_;
 
-	for (size_t i = iSkip - 1; i < maxI && !done; i += iSkip) {
+	for (size_t i = minI + iSkip - 1; i < maxI && !done; i += iSkip) {
 	  // Get a row of black/white values
 
 		stateCount[0] = 0;
@@ -485,7 +493,7 @@ int FinderPatternFinder::find(DecodeHints const &hints, Ref<FinderPatternInfo> &
 		stateCount[3] = 0;
 		stateCount[4] = 0;
 		int currentState = 0;
-		for (size_t j = 0; j < maxJ; j++) {
+		for (size_t j = minJ; j < maxJ; j++) {
 			if (matrix.get(j, i)) {
 			  // Black pixel
 				if ((currentState & 1) == 1) { // Counting white pixels
@@ -69,6 +69,9 @@ public:
 	static float distance(Ref<ResultPoint> p1, Ref<ResultPoint> p2);
 	FinderPatternFinder(Ref<BitMatrix> image, Ref<ResultPointCallback>const &);
 	int find(DecodeHints const &hints, Ref<FinderPatternInfo> &result);
+	// Scans only rows [top, top + height) and columns [left, left + width);
+	// cross checks may still look outside the region.
+	int find(DecodeHints const &hints, int left, int top, int width, int height, Ref<FinderPatternInfo> &result);
 };
 }
 }
@@ -12,6 +12,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
 /* Private subobject */
@@ -529,6 +530,10 @@ jinit_color_converter (j_compress_ptr cinfo)
     case JCS_RGB:
       cconvert->pub.start_pass = rgb_ycc_start;
       cconvert->pub.color_convert = rgb_ycc_convert;
+#ifdef JSIMD_SUPPORTED
+      if (jsimd_can_rgb_ycc())
+	cconvert->pub.color_convert = jsimd_rgb_ycc_convert;
+#endif
       break;
     case JCS_YCbCr:
       cconvert->pub.color_convert = null_convert;
@@ -554,6 +559,10 @@ jinit_color_converter (j_compress_ptr cinfo)
       /* compute normal YCC first */
       cconvert->pub.start_pass = rgb_ycc_start;
       cconvert->pub.color_convert = rgb_ycc_convert;
+#ifdef JSIMD_SUPPORTED
+      if (jsimd_can_rgb_ycc())
+	cconvert->pub.color_convert = jsimd_rgb_ycc_convert;
+#endif
       break;
     case JCS_YCbCr:
       /* need quantization scale by factor of 2 after DCT */
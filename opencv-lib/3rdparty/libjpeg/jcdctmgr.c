@@ -16,6 +16,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
 
 
 /* Private subobject for this module */
@@ -131,6 +132,32 @@ forward_DCT (j_compress_ptr cinfo, jpeg_component_info * compptr,
 }
 
 
+#ifdef JSIMD_SUPPORTED
+
+METHODDEF(void)
+forward_DCT_simd (j_compress_ptr cinfo, jpeg_component_info * compptr,
+		  JSAMPARRAY sample_data, JBLOCKROW coef_blocks,
+		  JDIMENSION start_row, JDIMENSION start_col,
+		  JDIMENSION num_blocks)
+/* Same as forward_DCT, with the quantization done by jsimd_quantize. */
+{
+  my_fdct_ptr fdct = (my_fdct_ptr) cinfo->fdct;
+  forward_DCT_method_ptr do_dct = fdct->do_dct[compptr->component_index];
+  DCTELEM * divisors = (DCTELEM *) compptr->dct_table;
+  DCTELEM workspace[DCTSIZE2];	/* work area for FDCT subroutine */
+  JDIMENSION bi;
+
+  sample_data += start_row;	/* fold in the vertical offset once */
+
+  for (bi = 0; bi < num_blocks; bi++, start_col += compptr->DCT_h_scaled_size) {
+    (*do_dct) (workspace, sample_data, start_col);
+    jsimd_quantize(coef_blocks[bi], divisors, workspace);
+  }
+}
+
+#endif /* JSIMD_SUPPORTED */
+
+
 #ifdef DCT_FLOAT_SUPPORTED
 
 METHODDEF(void)
@@ -258,6 +285,10 @@ start_pass_fdctmgr (j_compress_ptr cinfo)
       break;
     case ((16 << 8) + 16):
       fdct->do_dct[ci] = jpeg_fdct_16x16;
+#ifdef JSIMD_SUPPORTED
+      if (jsimd_enabled())
+	fdct->do_dct[ci] = jsimd_fdct_16x16;
+#endif
       method = JDCT_ISLOW;	/* jfdctint uses islow-style table */
       break;
     case ((16 << 8) + 8):
@@ -330,6 +361,10 @@ start_pass_fdctmgr (j_compress_ptr cinfo)
 #ifdef DCT_ISLOW_SUPPORTED
       case JDCT_ISLOW:
 	fdct->do_dct[ci] = jpeg_fdct_islow;
+#ifdef JSIMD_SUPPORTED
+	if (jsimd_enabled())
+	  fdct->do_dct[ci] = jsimd_fdct_islow;
+#endif
 	method = JDCT_ISLOW;
 	break;
 #endif
@@ -446,6 +481,10 @@ start_pass_fdctmgr (j_compress_ptr cinfo)
       ERREXIT(cinfo, JERR_NOT_COMPILED);
       break;
     }
+#ifdef JSIMD_SUPPORTED
+    if (fdct->pub.forward_DCT[ci] == forward_DCT && jsimd_enabled())
+      fdct->pub.forward_DCT[ci] = forward_DCT_simd;
+#endif
   }
 }
 
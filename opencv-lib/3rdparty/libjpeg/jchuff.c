@@ -907,6 +907,79 @@ encode_mcu_AC_refine (j_compress_ptr cinfo, JBLOCKROW *MCU_data)
 }
 
 
+/* Sequential mode blocks are coded through a wider local bit buffer:
+ * up to 63 bits are kept right-justified in a 64-bit accumulator, so a
+ * Huffman code and the value bits that follow it go in with one shift,
+ * and output is written 32 bits at a time.  Only at the end of the block
+ * is the buffer brought back to the <= 7 bit form of savable_state.
+ */
+
+#ifdef _MSC_VER
+typedef unsigned __int64 block_bit_buf;
+#else
+typedef unsigned long long block_bit_buf;
+#endif
+
+/* Emit the 4 bytes of w, most significant first; return TRUE if
+ * successful, FALSE if must suspend.
+ */
+
+INLINE
+LOCAL(boolean)
+emit_word_s (working_state * state, unsigned int w)
+{
+  register JOCTET * p;
+  int i, c;
+
+  if (state->free_in_buffer > 8) {
+    p = state->next_output_byte;
+    if (((~w - 0x01010101U) & w & 0x80808080U) == 0) {
+      /* No 0xFF byte, which is the common case */
+      p[0] = (JOCTET) (w >> 24);
+      p[1] = (JOCTET) (w >> 16);
+      p[2] = (JOCTET) (w >> 8);
+      p[3] = (JOCTET) w;
+      p += 4;
+    } else {
+      /* Write a zero after every byte, and keep it only after 0xFF */
+      for (i = 24; i >= 0; i -= 8) {
+	c = (int) (w >> i) & 0xFF;
+	*p++ = (JOCTET) c;
+	*p = 0;
+	p += (c == 0xFF);
+      }
+    }
+    state->free_in_buffer -= (size_t) (p - state->next_output_byte);
+    state->next_output_byte = p;
+    return TRUE;
+  }
+
+  /* Near the end of the output buffer */
+  for (i = 24; i >= 0; i -= 8) {
+    c = (int) (w >> i) & 0xFF;
+    emit_byte_s(state, c, return FALSE);
+    if (c == 0xFF) {		/* need to stuff a zero byte? */
+      emit_byte_s(state, 0, return FALSE);
+    }
+  }
+  return TRUE;
+}
+
+
+/* Add 'size' bits (already masked) to the block bit buffer, writing out
+ * 32 bits when there are that many.  At most 32 bits are added at once.
+ */
+
+#define put_bits_b(bits,size)  \
+	{ put_buffer = (put_buffer << (size)) | (block_bit_buf) (bits);  \
+	  put_bits += (size);  \
+	  if (put_bits >= 32) {  \
+	    put_bits -= 32;  \
+	    if (! emit_word_s(state, (unsigned int) (put_buffer >> put_bits)))  \
+	      return FALSE;  \
+	  } }
+
+
 /* Encode a single block's worth of coefficients */
 
 LOCAL(boolean)
@@ -914,11 +987,18 @@ encode_one_block (working_state * state, JCOEFPTR block, int last_dc_val,
 		  c_derived_tbl *dctbl, c_derived_tbl *actbl)
 {
   register int temp, temp2;
-  register int nbits;
+  register int nbits, size;
   register int r, k;
+  register block_bit_buf put_buffer;
+  register int put_bits;
   int Se = state->cinfo->lim_Se;
   const int * natural_order = state->cinfo->natural_order;
 
+  /* Load the <= 7 pending bits, right-justified */
+  put_bits = state->cur.put_bits;
+  put_buffer = ((block_bit_buf) state->cur.put_buffer >> (24 - put_bits)) &
+	       ((((block_bit_buf) 1) << put_bits) - 1);
+
   /* Encode the DC coefficient difference per section F.1.2.1 */
 
   temp = temp2 = block[0] - last_dc_val;
@@ -942,15 +1022,16 @@ encode_one_block (working_state * state, JCOEFPTR block, int last_dc_val,
   if (nbits > MAX_COEF_BITS+1)
     ERREXIT(state->cinfo, JERR_BAD_DCT_COEF);
 
-  /* Emit the Huffman-coded symbol for the number of bits */
-  if (! emit_bits_s(state, dctbl->ehufco[nbits], dctbl->ehufsi[nbits]))
-    return FALSE;
-
-  /* Emit that number of bits of the value, if positive, */
-  /* or the complement of its magnitude, if negative. */
-  if (nbits)			/* emit_bits rejects calls with size 0 */
-    if (! emit_bits_s(state, (unsigned int) temp2, nbits))
-      return FALSE;
+  /* Emit the Huffman-coded symbol for the number of bits,
+   * followed by that number of bits of the value, if positive,
+   * or the complement of its magnitude, if negative.
+   */
+  size = dctbl->ehufsi[nbits];
+  /* if size is 0, caller used an invalid Huffman table entry */
+  if (size == 0)
+    ERREXIT(state->cinfo, JERR_HUFF_MISSING_CODE);
+  put_bits_b(((unsigned int) dctbl->ehufco[nbits] << nbits) |
+	     ((unsigned int) temp2 & ((1U << nbits) - 1)), size + nbits);
 
   /* Encode the AC coefficients per section F.1.2.2 */
 
@@ -962,8 +1043,10 @@ encode_one_block (working_state * state, JCOEFPTR block, int last_dc_val,
     } else {
       /* if run length > 15, must emit special run-length-16 codes (0xF0) */
       while (r > 15) {
-	if (! emit_bits_s(state, actbl->ehufco[0xF0], actbl->ehufsi[0xF0]))
-	  return FALSE;
+	size = actbl->ehufsi[0xF0];
+	if (size == 0)
+	  ERREXIT(state->cinfo, JERR_HUFF_MISSING_CODE);
+	put_bits_b(actbl->ehufco[0xF0], size);
 	r -= 16;
       }
 
@@ -982,24 +1065,41 @@ encode_one_block (working_state * state, JCOEFPTR block, int last_dc_val,
       if (nbits > MAX_COEF_BITS)
 	ERREXIT(state->cinfo, JERR_BAD_DCT_COEF);
 
-      /* Emit Huffman symbol for run length / number of bits */
+      /* Emit Huffman symbol for run length / number of bits,
+       * and the value bits with it.
+       */
       temp = (r << 4) + nbits;
-      if (! emit_bits_s(state, actbl->ehufco[temp], actbl->ehufsi[temp]))
-	return FALSE;
-
-      /* Emit that number of bits of the value, if positive, */
-      /* or the complement of its magnitude, if negative. */
-      if (! emit_bits_s(state, (unsigned int) temp2, nbits))
-	return FALSE;
+      size = actbl->ehufsi[temp];
+      if (size == 0)
+	ERREXIT(state->cinfo, JERR_HUFF_MISSING_CODE);
+      put_bits_b(((unsigned int) actbl->ehufco[temp] << nbits) |
+		 ((unsigned int) temp2 & ((1U << nbits) - 1)), size + nbits);
 
       r = 0;
     }
   }
 
   /* If the last coef(s) were zero, emit an end-of-block code */
-  if (r > 0)
-    if (! emit_bits_s(state, actbl->ehufco[0], actbl->ehufsi[0]))
-      return FALSE;
+  if (r > 0) {
+    size = actbl->ehufsi[0];
+    if (size == 0)
+      ERREXIT(state->cinfo, JERR_HUFF_MISSING_CODE);
+    put_bits_b(actbl->ehufco[0], size);
+  }
+
+  /* Write out whole bytes and keep the rest left-justified in 24 bits */
+  while (put_bits >= 8) {
+    int c = (int) (put_buffer >> (put_bits - 8)) & 0xFF;
+
+    emit_byte_s(state, c, return FALSE);
+    if (c == 0xFF) {		/* need to stuff a zero byte? */
+      emit_byte_s(state, 0, return FALSE);
+    }
+    put_bits -= 8;
+  }
+  state->cur.put_buffer = (INT32)
+    (put_buffer & ((((block_bit_buf) 1) << put_bits) - 1)) << (24 - put_bits);
+  state->cur.put_bits = put_bits;
 
   return TRUE;
 }
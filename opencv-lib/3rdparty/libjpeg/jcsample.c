@@ -48,6 +48,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
 /* Pointer to routine to downsample a single component */
@@ -293,6 +294,48 @@ h2v2_downsample (j_compress_ptr cinfo, jpeg_component_info * compptr,
 }
 
 
+#ifdef JSIMD_SUPPORTED
+
+/*
+ * Same as h2v1_downsample and h2v2_downsample, with the row loops
+ * done by jsimd.c.
+ */
+
+METHODDEF(void)
+h2v1_downsample_simd (j_compress_ptr cinfo, jpeg_component_info * compptr,
+		      JSAMPARRAY input_data, JSAMPARRAY output_data)
+{
+  int inrow;
+  JDIMENSION output_cols = compptr->width_in_blocks * compptr->DCT_h_scaled_size;
+
+  expand_right_edge(input_data, cinfo->max_v_samp_factor,
+		    cinfo->image_width, output_cols * 2);
+
+  for (inrow = 0; inrow < cinfo->max_v_samp_factor; inrow++)
+    jsimd_h2v1_downsample_row(input_data[inrow], output_data[inrow],
+			      output_cols);
+}
+
+
+METHODDEF(void)
+h2v2_downsample_simd (j_compress_ptr cinfo, jpeg_component_info * compptr,
+		      JSAMPARRAY input_data, JSAMPARRAY output_data)
+{
+  int inrow, outrow;
+  JDIMENSION output_cols = compptr->width_in_blocks * compptr->DCT_h_scaled_size;
+
+  expand_right_edge(input_data, cinfo->max_v_samp_factor,
+		    cinfo->image_width, output_cols * 2);
+
+  for (inrow = outrow = 0; inrow < cinfo->max_v_samp_factor;
+       inrow += 2, outrow++)
+    jsimd_h2v2_downsample_row(input_data[inrow], input_data[inrow+1],
+			      output_data[outrow], output_cols);
+}
+
+#endif /* JSIMD_SUPPORTED */
+
+
 #ifdef INPUT_SMOOTHING_SUPPORTED
 
 /*
@@ -518,6 +561,11 @@ jinit_downsampler (j_compress_ptr cinfo)
     } else if (h_in_group == h_out_group * 2 &&
 	       v_in_group == v_out_group) {
       smoothok = FALSE;
+#ifdef JSIMD_SUPPORTED
+      if (jsimd_enabled())
+	downsample->methods[ci] = h2v1_downsample_simd;
+      else
+#endif
       downsample->methods[ci] = h2v1_downsample;
     } else if (h_in_group == h_out_group * 2 &&
 	       v_in_group == v_out_group * 2) {
@@ -526,6 +574,11 @@ jinit_downsampler (j_compress_ptr cinfo)
 	downsample->methods[ci] = h2v2_smooth_downsample;
 	downsample->pub.need_context_rows = TRUE;
       } else
+#endif
+#ifdef JSIMD_SUPPORTED
+      if (jsimd_enabled())
+	downsample->methods[ci] = h2v2_downsample_simd;
+      else
 #endif
 	downsample->methods[ci] = h2v2_downsample;
     } else if ((h_in_group % h_out_group) == 0 &&
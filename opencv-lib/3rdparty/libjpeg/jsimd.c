@@ -0,0 +1,892 @@
+/*
+ * jsimd.c
+ *
+ * This file is an addition to the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains the SSE2 / NEON versions of the compressor's inner
+ * loops (see jsimd.h).  They follow the integer arithmetic of the C code
+ * step by step, so the results are bit-exact:
+ *
+ *   jsimd_fdct_islow   jpeg_fdct_islow (jfdctint.c), 4 rows/columns at once
+ *   jsimd_fdct_16x16   jpeg_fdct_16x16 (jfdctint.c), used for the chroma
+ *                      of 4:2:0 images when do_fancy_downsampling is set
+ *   jsimd_quantize     the quantization loop of forward_DCT (jcdctmgr.c)
+ *   jsimd_rgb_ycc_convert  rgb_ycc_convert (jccolor.c)
+ *   jsimd_h2v?_downsample_row  h2v1/h2v2_downsample (jcsample.c)
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
+
+
+static boolean simd_enabled = TRUE;
+
+
+GLOBAL(void)
+jsimd_set_enabled (boolean enabled)
+{
+  simd_enabled = enabled;
+}
+
+
+GLOBAL(boolean)
+jsimd_enabled (void)
+{
+#ifdef JSIMD_SUPPORTED
+  return simd_enabled;
+#else
+  return FALSE;
+#endif
+}
+
+
+#ifdef JSIMD_SUPPORTED
+
+#ifdef JSIMD_SSE2
+#include <emmintrin.h>
+#else
+#include <arm_neon.h>
+#endif
+
+
+/*
+ * Four 32-bit lanes.  The DCT code is written once against these
+ * operations; only loads, transposes and multiplies differ per target.
+ */
+
+#ifdef JSIMD_SSE2
+
+typedef __m128i v32;
+
+#define v32_add(a,b)	_mm_add_epi32(a, b)
+#define v32_sub(a,b)	_mm_sub_epi32(a, b)
+#define v32_set(x)	_mm_set1_epi32((int) (x))
+#define v32_shl(a,n)	_mm_slli_epi32(a, n)
+#define v32_sra(a,n)	_mm_srai_epi32(a, n)
+#define v32_store(p,a)	_mm_storeu_si128((__m128i *) (p), a)
+#define v32_mulc(a,k)	v32_mul(a, v32_set(k))
+
+/* SSE2 has no 32-bit low multiply (pmulld is SSE4.1); build it from
+ * two 32x32->64 multiplies of the even and odd lanes.
+ */
+
+LOCAL(v32)
+v32_mul (v32 a, v32 c)
+{
+  v32 even = _mm_mul_epu32(a, c);
+  v32 odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(c, 32));
+
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+			    _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+}
+
+LOCAL(void)
+load_row8 (JSAMPROW p, v32 * out)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i w = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) p), zero);
+
+  out[0] = _mm_unpacklo_epi16(w, zero);
+  out[1] = _mm_unpackhi_epi16(w, zero);
+}
+
+LOCAL(void)
+load_row16 (JSAMPROW p, v32 * out)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i b = _mm_loadu_si128((const __m128i *) p);
+  __m128i w0 = _mm_unpacklo_epi8(b, zero);
+  __m128i w1 = _mm_unpackhi_epi8(b, zero);
+
+  out[0] = _mm_unpacklo_epi16(w0, zero);
+  out[1] = _mm_unpackhi_epi16(w0, zero);
+  out[2] = _mm_unpacklo_epi16(w1, zero);
+  out[3] = _mm_unpackhi_epi16(w1, zero);
+}
+
+LOCAL(void)
+transpose4 (const v32 * in, v32 * out)
+{
+  v32 t0 = _mm_unpacklo_epi32(in[0], in[1]);
+  v32 t1 = _mm_unpacklo_epi32(in[2], in[3]);
+  v32 t2 = _mm_unpackhi_epi32(in[0], in[1]);
+  v32 t3 = _mm_unpackhi_epi32(in[2], in[3]);
+
+  out[0] = _mm_unpacklo_epi64(t0, t1);
+  out[1] = _mm_unpackhi_epi64(t0, t1);
+  out[2] = _mm_unpacklo_epi64(t2, t3);
+  out[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+#else /* JSIMD_NEON */
+
+typedef int32x4_t v32;
+
+#define v32_add(a,b)	vaddq_s32(a, b)
+#define v32_sub(a,b)	vsubq_s32(a, b)
+#define v32_set(x)	vdupq_n_s32((int32_t) (x))
+#define v32_shl(a,n)	vshlq_n_s32(a, n)
+#define v32_sra(a,n)	vshrq_n_s32(a, n)
+#define v32_store(p,a)	vst1q_s32((int32_t *) (p), a)
+#define v32_mulc(a,k)	vmulq_n_s32(a, (int32_t) (k))
+
+LOCAL(void)
+load_row8 (JSAMPROW p, v32 * out)
+{
+  uint16x8_t w = vmovl_u8(vld1_u8(p));
+
+  out[0] = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(w)));
+  out[1] = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(w)));
+}
+
+LOCAL(void)
+load_row16 (JSAMPROW p, v32 * out)
+{
+  uint8x16_t b = vld1q_u8(p);
+  uint16x8_t w0 = vmovl_u8(vget_low_u8(b));
+  uint16x8_t w1 = vmovl_u8(vget_high_u8(b));
+
+  out[0] = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(w0)));
+  out[1] = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(w0)));
+  out[2] = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(w1)));
+  out[3] = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(w1)));
+}
+
+LOCAL(void)
+transpose4 (const v32 * in, v32 * out)
+{
+  int32x4x2_t t01 = vtrnq_s32(in[0], in[1]);
+  int32x4x2_t t23 = vtrnq_s32(in[2], in[3]);
+
+  out[0] = vcombine_s32(vget_low_s32(t01.val[0]), vget_low_s32(t23.val[0]));
+  out[1] = vcombine_s32(vget_low_s32(t01.val[1]), vget_low_s32(t23.val[1]));
+  out[2] = vcombine_s32(vget_high_s32(t01.val[0]), vget_high_s32(t23.val[0]));
+  out[3] = vcombine_s32(vget_high_s32(t01.val[1]), vget_high_s32(t23.val[1]));
+}
+
+#endif /* JSIMD_SSE2 */
+
+
+/*
+ * Forward DCT.  Same constants and operation order as jfdctint.c;
+ * see there for the derivation.
+ */
+
+#define CONST_BITS  13
+#define PASS1_BITS  2
+
+#define FIX_0_298631336  ((INT32)  2446)	/* FIX(0.298631336) */
+#define FIX_0_390180644  ((INT32)  3196)	/* FIX(0.390180644) */
+#define FIX_0_541196100  ((INT32)  4433)	/* FIX(0.541196100) */
+#define FIX_0_765366865  ((INT32)  6270)	/* FIX(0.765366865) */
+#define FIX_0_899976223  ((INT32)  7373)	/* FIX(0.899976223) */
+#define FIX_1_175875602  ((INT32)  9633)	/* FIX(1.175875602) */
+#define FIX_1_501321110  ((INT32)  12299)	/* FIX(1.501321110) */
+#define FIX_1_847759065  ((INT32)  15137)	/* FIX(1.847759065) */
+#define FIX_1_961570560  ((INT32)  16069)	/* FIX(1.961570560) */
+#define FIX_2_053119869  ((INT32)  16819)	/* FIX(2.053119869) */
+#define FIX_2_562915447  ((INT32)  20995)	/* FIX(2.562915447) */
+#define FIX_3_072711026  ((INT32)  25172)	/* FIX(3.072711026) */
+
+
+/* 8-point transform of d[0..7] in place; each lane is one row (pass 1)
+ * or one column (pass 2).
+ */
+
+LOCAL(void)
+islow_8 (v32 * d, boolean first_pass)
+{
+  v32 tmp0, tmp1, tmp2, tmp3, tmp10, tmp11, tmp12, tmp13, z1, fudge;
+
+  /* Even part */
+
+  tmp0 = v32_add(d[0], d[7]);
+  tmp1 = v32_add(d[1], d[6]);
+  tmp2 = v32_add(d[2], d[5]);
+  tmp3 = v32_add(d[3], d[4]);
+
+  tmp10 = v32_add(tmp0, tmp3);
+  tmp12 = v32_sub(tmp0, tmp3);
+  tmp11 = v32_add(tmp1, tmp2);
+  tmp13 = v32_sub(tmp1, tmp2);
+
+  tmp0 = v32_sub(d[0], d[7]);
+  tmp1 = v32_sub(d[1], d[6]);
+  tmp2 = v32_sub(d[2], d[5]);
+  tmp3 = v32_sub(d[3], d[4]);
+
+  if (first_pass) {
+    /* Apply unsigned->signed conversion. */
+    d[0] = v32_shl(v32_sub(v32_add(tmp10, tmp11), v32_set(8 * CENTERJSAMPLE)),
+		   PASS1_BITS);
+    d[4] = v32_shl(v32_sub(tmp10, tmp11), PASS1_BITS);
+    fudge = v32_set(ONE << (CONST_BITS-PASS1_BITS-1));
+  } else {
+    tmp10 = v32_add(tmp10, v32_set(ONE << (PASS1_BITS-1)));
+    d[0] = v32_sra(v32_add(tmp10, tmp11), PASS1_BITS);
+    d[4] = v32_sra(v32_sub(tmp10, tmp11), PASS1_BITS);
+    fudge = v32_set(ONE << (CONST_BITS+PASS1_BITS-1));
+  }
+
+  z1 = v32_add(v32_mulc(v32_add(tmp12, tmp13), FIX_0_541196100), fudge);
+  d[2] = v32_add(z1, v32_mulc(tmp12, FIX_0_765366865));
+  d[6] = v32_sub(z1, v32_mulc(tmp13, FIX_1_847759065));
+
+  /* Odd part */
+
+  tmp12 = v32_add(tmp0, tmp2);
+  tmp13 = v32_add(tmp1, tmp3);
+
+  z1 = v32_add(v32_mulc(v32_add(tmp12, tmp13), FIX_1_175875602), fudge);
+  tmp12 = v32_add(v32_mulc(tmp12, - FIX_0_390180644), z1);
+  tmp13 = v32_add(v32_mulc(tmp13, - FIX_1_961570560), z1);
+
+  z1 = v32_mulc(v32_add(tmp0, tmp3), - FIX_0_899976223);
+  d[1] = v32_add(v32_mulc(tmp0, FIX_1_501321110), v32_add(z1, tmp12));
+  d[7] = v32_add(v32_mulc(tmp3, FIX_0_298631336), v32_add(z1, tmp13));
+
+  z1 = v32_mulc(v32_add(tmp1, tmp2), - FIX_2_562915447);
+  d[3] = v32_add(v32_mulc(tmp1, FIX_3_072711026), v32_add(z1, tmp13));
+  d[5] = v32_add(v32_mulc(tmp2, FIX_2_053119869), v32_add(z1, tmp12));
+
+  if (first_pass) {
+    d[1] = v32_sra(d[1], CONST_BITS-PASS1_BITS);
+    d[2] = v32_sra(d[2], CONST_BITS-PASS1_BITS);
+    d[3] = v32_sra(d[3], CONST_BITS-PASS1_BITS);
+    d[5] = v32_sra(d[5], CONST_BITS-PASS1_BITS);
+    d[6] = v32_sra(d[6], CONST_BITS-PASS1_BITS);
+    d[7] = v32_sra(d[7], CONST_BITS-PASS1_BITS);
+  } else {
+    d[1] = v32_sra(d[1], CONST_BITS+PASS1_BITS);
+    d[2] = v32_sra(d[2], CONST_BITS+PASS1_BITS);
+    d[3] = v32_sra(d[3], CONST_BITS+PASS1_BITS);
+    d[5] = v32_sra(d[5], CONST_BITS+PASS1_BITS);
+    d[6] = v32_sra(d[6], CONST_BITS+PASS1_BITS);
+    d[7] = v32_sra(d[7], CONST_BITS+PASS1_BITS);
+  }
+}
+
+
+GLOBAL(void)
+jsimd_fdct_islow (int * data, JSAMPARRAY sample_data, JDIMENSION start_col)
+{
+  v32 lo[DCTSIZE], hi[DCTSIZE];	/* row r, columns 0-3 and 4-7 */
+  v32 top[DCTSIZE], bot[DCTSIZE];	/* column c, rows 0-3 and 4-7 */
+  int ctr;
+
+  for (ctr = 0; ctr < DCTSIZE; ctr++) {
+    v32 row[2];
+
+    load_row8(sample_data[ctr] + start_col, row);
+    lo[ctr] = row[0];
+    hi[ctr] = row[1];
+  }
+
+  /* Pass 1: process rows, four at a time. */
+
+  transpose4(lo, top);
+  transpose4(hi, top + 4);
+  transpose4(lo + 4, bot);
+  transpose4(hi + 4, bot + 4);
+  islow_8(top, TRUE);
+  islow_8(bot, TRUE);
+
+  /* Pass 2: process columns, four at a time. */
+
+  transpose4(top, lo);
+  transpose4(top + 4, hi);
+  transpose4(bot, lo + 4);
+  transpose4(bot + 4, hi + 4);
+  islow_8(lo, FALSE);
+  islow_8(hi, FALSE);
+
+  for (ctr = 0; ctr < DCTSIZE; ctr++) {
+    v32_store(data + DCTSIZE*ctr, lo[ctr]);
+    v32_store(data + DCTSIZE*ctr + 4, hi[ctr]);
+  }
+}
+
+
+/* 16-point transform of in[0..15] giving the 8 retained outputs. */
+
+LOCAL(void)
+islow_16 (const v32 * in, v32 * out, boolean first_pass)
+{
+  v32 tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  v32 tmp10, tmp11, tmp12, tmp13, tmp14, tmp15, tmp16, tmp17;
+  v32 fudge;
+
+  /* Even part */
+
+  tmp0 = v32_add(in[0], in[15]);
+  tmp1 = v32_add(in[1], in[14]);
+  tmp2 = v32_add(in[2], in[13]);
+  tmp3 = v32_add(in[3], in[12]);
+  tmp4 = v32_add(in[4], in[11]);
+  tmp5 = v32_add(in[5], in[10]);
+  tmp6 = v32_add(in[6], in[9]);
+  tmp7 = v32_add(in[7], in[8]);
+
+  tmp10 = v32_add(tmp0, tmp7);
+  tmp14 = v32_sub(tmp0, tmp7);
+  tmp11 = v32_add(tmp1, tmp6);
+  tmp15 = v32_sub(tmp1, tmp6);
+  tmp12 = v32_add(tmp2, tmp5);
+  tmp16 = v32_sub(tmp2, tmp5);
+  tmp13 = v32_add(tmp3, tmp4);
+  tmp17 = v32_sub(tmp3, tmp4);
+
+  tmp0 = v32_sub(in[0], in[15]);
+  tmp1 = v32_sub(in[1], in[14]);
+  tmp2 = v32_sub(in[2], in[13]);
+  tmp3 = v32_sub(in[3], in[12]);
+  tmp4 = v32_sub(in[4], in[11]);
+  tmp5 = v32_sub(in[5], in[10]);
+  tmp6 = v32_sub(in[6], in[9]);
+  tmp7 = v32_sub(in[7], in[8]);
+
+  out[0] = v32_add(v32_add(tmp10, tmp11), v32_add(tmp12, tmp13));
+  if (first_pass) {
+    /* Apply unsigned->signed conversion. */
+    out[0] = v32_shl(v32_sub(out[0], v32_set(16 * CENTERJSAMPLE)), PASS1_BITS);
+    fudge = v32_set(ONE << (CONST_BITS-PASS1_BITS-1));
+  } else {
+    out[0] = v32_sra(v32_add(out[0], v32_set(ONE << (PASS1_BITS+1))),
+		     PASS1_BITS+2);
+    fudge = v32_set(ONE << (CONST_BITS+PASS1_BITS+1));
+  }
+
+  out[4] = v32_add(v32_add(v32_mulc(v32_sub(tmp10, tmp13), FIX(1.306562965)),
+			   v32_mulc(v32_sub(tmp11, tmp12), FIX_0_541196100)),
+		   fudge);
+
+  tmp10 = v32_add(v32_mulc(v32_sub(tmp17, tmp15), FIX(0.275899379)),
+		  v32_mulc(v32_sub(tmp14, tmp16), FIX(1.387039845)));
+  tmp10 = v32_add(tmp10, fudge);
+
+  out[2] = v32_add(v32_add(tmp10, v32_mulc(tmp15, FIX(1.451774982))),
+		   v32_mulc(tmp16, FIX(2.172734804)));
+  out[6] = v32_sub(v32_sub(tmp10, v32_mulc(tmp14, FIX(0.211164243))),
+		   v32_mulc(tmp17, FIX(1.061594338)));
+
+  /* Odd part */
+
+  tmp11 = v32_add(v32_mulc(v32_add(tmp0, tmp1), FIX(1.353318001)),
+		  v32_mulc(v32_sub(tmp6, tmp7), FIX(0.410524528)));
+  tmp12 = v32_add(v32_mulc(v32_add(tmp0, tmp2), FIX(1.247225013)),
+		  v32_mulc(v32_add(tmp5, tmp7), FIX(0.666655658)));
+  tmp13 = v32_add(v32_mulc(v32_add(tmp0, tmp3), FIX(1.093201867)),
+		  v32_mulc(v32_sub(tmp4, tmp7), FIX(0.897167586)));
+  tmp14 = v32_add(v32_mulc(v32_add(tmp1, tmp2), FIX(0.138617169)),
+		  v32_mulc(v32_sub(tmp6, tmp5), FIX(1.407403738)));
+  tmp15 = v32_add(v32_mulc(v32_add(tmp1, tmp3), - FIX(0.666655658)),
+		  v32_mulc(v32_add(tmp4, tmp6), - FIX(1.247225013)));
+  tmp16 = v32_add(v32_mulc(v32_add(tmp2, tmp3), - FIX(1.353318001)),
+		  v32_mulc(v32_sub(tmp5, tmp4), FIX(0.410524528)));
+
+  /* The fudge factor is folded into tmp11..tmp13 before they are reused. */
+  out[1] = v32_add(v32_add(tmp11, tmp12), v32_add(tmp13, fudge));
+  out[1] = v32_add(v32_sub(out[1], v32_mulc(tmp0, FIX(2.286341144))),
+		   v32_mulc(tmp7, FIX(0.779653625)));
+  out[3] = v32_add(v32_add(tmp11, fudge), v32_add(tmp14, tmp15));
+  out[3] = v32_sub(v32_add(out[3], v32_mulc(tmp1, FIX(0.071888074))),
+		   v32_mulc(tmp6, FIX(1.663905119)));
+  out[5] = v32_add(v32_add(tmp12, fudge), v32_add(tmp14, tmp16));
+  out[5] = v32_add(v32_sub(out[5], v32_mulc(tmp2, FIX(1.125726048))),
+		   v32_mulc(tmp5, FIX(1.227391138)));
+  out[7] = v32_add(v32_add(tmp13, fudge), v32_add(tmp15, tmp16));
+  out[7] = v32_add(v32_add(out[7], v32_mulc(tmp3, FIX(1.065388962))),
+		   v32_mulc(tmp4, FIX(2.167985692)));
+
+  if (first_pass) {
+    out[1] = v32_sra(out[1], CONST_BITS-PASS1_BITS);
+    out[2] = v32_sra(out[2], CONST_BITS-PASS1_BITS);
+    out[3] = v32_sra(out[3], CONST_BITS-PASS1_BITS);
+    out[4] = v32_sra(out[4], CONST_BITS-PASS1_BITS);
+    out[5] = v32_sra(out[5], CONST_BITS-PASS1_BITS);
+    out[6] = v32_sra(out[6], CONST_BITS-PASS1_BITS);
+    out[7] = v32_sra(out[7], CONST_BITS-PASS1_BITS);
+  } else {
+    out[1] = v32_sra(out[1], CONST_BITS+PASS1_BITS+2);
+    out[2] = v32_sra(out[2], CONST_BITS+PASS1_BITS+2);
+    out[3] = v32_sra(out[3], CONST_BITS+PASS1_BITS+2);
+    out[4] = v32_sra(out[4], CONST_BITS+PASS1_BITS+2);
+    out[5] = v32_sra(out[5], CONST_BITS+PASS1_BITS+2);
+    out[6] = v32_sra(out[6], CONST_BITS+PASS1_BITS+2);
+    out[7] = v32_sra(out[7], CONST_BITS+PASS1_BITS+2);
+  }
+}
+
+
+GLOBAL(void)
+jsimd_fdct_16x16 (int * data, JSAMPARRAY sample_data, JDIMENSION start_col)
+{
+  v32 lo[DCTSIZE*2], hi[DCTSIZE*2];	/* pass 1 output, row r */
+  v32 row[16], col[16], out[DCTSIZE];
+  int ctr, i;
+
+  /* Pass 1: process rows, four at a time.
+   * col[c] holds column c of the four rows.
+   */
+
+  for (ctr = 0; ctr < DCTSIZE*2; ctr += 4) {
+    for (i = 0; i < 4; i++)
+      load_row16(sample_data[ctr + i] + start_col, row + 4*i);
+    for (i = 0; i < 4; i++) {
+      v32 quad[4];
+
+      quad[0] = row[i];
+      quad[1] = row[4 + i];
+      quad[2] = row[8 + i];
+      quad[3] = row[12 + i];
+      transpose4(quad, col + 4*i);
+    }
+    islow_16(col, out, TRUE);
+    transpose4(out, lo + ctr);
+    transpose4(out + 4, hi + ctr);
+  }
+
+  /* Pass 2: process columns, four at a time. */
+
+  islow_16(lo, out, FALSE);
+  for (ctr = 0; ctr < DCTSIZE; ctr++)
+    v32_store(data + DCTSIZE*ctr, out[ctr]);
+  islow_16(hi, out, FALSE);
+  for (ctr = 0; ctr < DCTSIZE; ctr++)
+    v32_store(data + DCTSIZE*ctr + 4, out[ctr]);
+}
+
+
+/*
+ * Quantization.  The C code divides |coef| + q/2 by q and restores the
+ * sign.  Both operands are below 2^23 and exact in single precision, and
+ * a correctly rounded single precision quotient truncates to the same
+ * integer, so SSE2 can use divps.  NEON has no divide; there the quotient
+ * comes from a refined reciprocal estimate and is corrected by one step
+ * against the remainder.
+ */
+
+#ifdef JSIMD_SSE2
+
+LOCAL(__m128i)
+quantize4 (const int * workspace, const int * divisors)
+{
+  __m128i temp = _mm_loadu_si128((const __m128i *) workspace);
+  __m128i qval = _mm_loadu_si128((const __m128i *) divisors);
+  __m128i sign = _mm_srai_epi32(temp, 31);
+
+  temp = _mm_sub_epi32(_mm_xor_si128(temp, sign), sign);
+  temp = _mm_add_epi32(temp, _mm_srai_epi32(qval, 1));	/* for rounding */
+  temp = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(temp),
+				     _mm_cvtepi32_ps(qval)));
+  return _mm_sub_epi32(_mm_xor_si128(temp, sign), sign);
+}
+
+GLOBAL(void)
+jsimd_quantize (JCOEFPTR coef_block, int * divisors, int * workspace)
+{
+  int i;
+
+  for (i = 0; i < DCTSIZE2; i += 8) {
+    __m128i lo = quantize4(workspace + i, divisors + i);
+    __m128i hi = quantize4(workspace + i + 4, divisors + i + 4);
+
+    _mm_storeu_si128((__m128i *) (coef_block + i), _mm_packs_epi32(lo, hi));
+  }
+}
+
+#else /* JSIMD_NEON */
+
+LOCAL(int32x4_t)
+quantize4 (const int * workspace, const int * divisors)
+{
+  int32x4_t temp = vld1q_s32((const int32_t *) workspace);
+  int32x4_t qval = vld1q_s32((const int32_t *) divisors);
+  int32x4_t sign = vshrq_n_s32(temp, 31);
+  int32x4_t quot, rem;
+  float32x4_t qf = vcvtq_f32_s32(qval);
+  float32x4_t recip = vrecpeq_f32(qf);
+
+  recip = vmulq_f32(vrecpsq_f32(qf, recip), recip);
+  recip = vmulq_f32(vrecpsq_f32(qf, recip), recip);
+
+  temp = vabsq_s32(temp);
+  temp = vaddq_s32(temp, vshrq_n_s32(qval, 1));	/* for rounding */
+  quot = vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(temp), recip));
+
+  /* The estimate may be one off either way */
+  rem = vmlsq_s32(temp, quot, qval);
+  quot = vsubq_s32(quot, vreinterpretq_s32_u32(vcgeq_s32(rem, qval)));
+  quot = vaddq_s32(quot, vreinterpretq_s32_u32(vcltq_s32(rem, vdupq_n_s32(0))));
+
+  return vsubq_s32(veorq_s32(quot, sign), sign);
+}
+
+GLOBAL(void)
+jsimd_quantize (JCOEFPTR coef_block, int * divisors, int * workspace)
+{
+  int i;
+
+  for (i = 0; i < DCTSIZE2; i += 8) {
+    int32x4_t lo = quantize4(workspace + i, divisors + i);
+    int32x4_t hi = quantize4(workspace + i + 4, divisors + i + 4);
+
+    vst1q_s16(coef_block + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+  }
+}
+
+#endif /* JSIMD_SSE2 */
+
+
+/*
+ * RGB -> YCbCr conversion, same fixed-point equations as the tables of
+ * rgb_ycc_start (jccolor.c):
+ *
+ *	Y  = ( 0.29900 * R + 0.58700 * G + 0.11400 * B + 1/2) >> 16
+ *	Cb = (-0.16874 * R - 0.33126 * G + 0.50000 * B + 128 + 1/2-e) >> 16
+ *	Cr = ( 0.50000 * R - 0.41869 * G - 0.08131 * B + 128 + 1/2-e) >> 16
+ */
+
+#define SCALEBITS	16
+#define CBCR_OFFSET	((INT32) CENTERJSAMPLE << SCALEBITS)
+#define ONE_HALF	((INT32) 1 << (SCALEBITS-1))
+
+#define C_R_Y	19595		/* FIX(0.29900) */
+#define C_G_Y	38470		/* FIX(0.58700) */
+#define C_B_Y	7471		/* FIX(0.11400) */
+#define C_R_CB	11058		/* FIX(0.16873589) */
+#define C_G_CB	21710		/* FIX(0.33126411) */
+#define C_B_CB	32768		/* FIX(0.50000) */
+#define C_R_CR	32768		/* FIX(0.50000) */
+#define C_G_CR	27439		/* FIX(0.41868759) */
+#define C_B_CR	5329		/* FIX(0.08131241) */
+
+
+GLOBAL(boolean)
+jsimd_can_rgb_ycc (void)
+{
+#if RGB_RED == 0 && RGB_GREEN == 1 && RGB_BLUE == 2 && RGB_PIXELSIZE == 3
+  return jsimd_enabled();
+#else
+  return FALSE;
+#endif
+}
+
+
+#ifdef JSIMD_SSE2
+
+/* A pair of 16-bit multipliers for pmaddwd: lo applies to the even
+ * (low) word of each 32-bit lane, hi to the odd one.
+ */
+#define PAIR16(lo,hi) \
+	((int) (((unsigned int) (hi) << 16) | ((unsigned int) (lo) & 0xFFFF)))
+
+/* 8 pixels: rgb[0..2] hold R, G, B as 16-bit values; ycc[0..2] get
+ * Y, Cb, Cr the same way.  G's Y weight does not fit in 16 bits, so it is
+ * split between the (R,G) and (G,B) products; B's Cb weight and R's Cr
+ * weight are 2^15 and are applied with shifts.
+ */
+
+LOCAL(void)
+rgb_ycc_8 (const __m128i * rgb, __m128i * ycc)
+{
+  const __m128i k_rg_y = _mm_set1_epi32(PAIR16(C_R_Y, C_G_Y / 2));
+  const __m128i k_gb_y = _mm_set1_epi32(PAIR16(C_G_Y - C_G_Y / 2, C_B_Y));
+  const __m128i k_rg_cb = _mm_set1_epi32(PAIR16(- C_R_CB, - C_G_CB));
+  const __m128i k_gb_cr = _mm_set1_epi32(PAIR16(- C_G_CR, - C_B_CR));
+  const __m128i half = _mm_set1_epi32(ONE_HALF);
+  const __m128i offset = _mm_set1_epi32(CBCR_OFFSET + ONE_HALF - 1);
+  __m128i rg[2], gb[2], y[2], cb[2], cr[2];
+  int i;
+
+  rg[0] = _mm_unpacklo_epi16(rgb[0], rgb[1]);
+  rg[1] = _mm_unpackhi_epi16(rgb[0], rgb[1]);
+  gb[0] = _mm_unpacklo_epi16(rgb[1], rgb[2]);
+  gb[1] = _mm_unpackhi_epi16(rgb[1], rgb[2]);
+
+  for (i = 0; i < 2; i++) {
+    y[i] = _mm_add_epi32(_mm_madd_epi16(rg[i], k_rg_y),
+			 _mm_madd_epi16(gb[i], k_gb_y));
+    y[i] = _mm_srli_epi32(_mm_add_epi32(y[i], half), SCALEBITS);
+    /* B * 2^15 */
+    cb[i] = _mm_add_epi32(_mm_madd_epi16(rg[i], k_rg_cb),
+			  _mm_slli_epi32(_mm_srli_epi32(gb[i], 16), 15));
+    cb[i] = _mm_srli_epi32(_mm_add_epi32(cb[i], offset), SCALEBITS);
+    /* R * 2^15 */
+    cr[i] = _mm_add_epi32(_mm_madd_epi16(gb[i], k_gb_cr),
+			  _mm_srli_epi32(_mm_slli_epi32(rg[i], 16), 1));
+    cr[i] = _mm_srli_epi32(_mm_add_epi32(cr[i], offset), SCALEBITS);
+  }
+
+  ycc[0] = _mm_packs_epi32(y[0], y[1]);
+  ycc[1] = _mm_packs_epi32(cb[0], cb[1]);
+  ycc[2] = _mm_packs_epi32(cr[0], cr[1]);
+}
+
+/* Returns the number of pixels converted (a multiple of 32). */
+
+LOCAL(JDIMENSION)
+rgb_ycc_row (JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+	     JSAMPROW outptr2, JDIMENSION num_cols)
+{
+  const __m128i zero = _mm_setzero_si128();
+  JDIMENSION col;
+
+  for (col = 0; col + 32 <= num_cols; col += 32) {
+    __m128i c[6], n[6], rgb[3], lo[3], hi[3];
+    int i, layer;
+
+    for (i = 0; i < 6; i++)
+      c[i] = _mm_loadu_si128((const __m128i *) (inptr + 16*i));
+
+    /* Deinterleave: after five rounds of byte unpacking c[0..1] hold R,
+     * c[2..3] G and c[4..5] B of the 32 pixels.
+     */
+    for (layer = 0; layer < 5; layer++) {
+      n[0] = _mm_unpacklo_epi8(c[0], c[3]);
+      n[1] = _mm_unpackhi_epi8(c[0], c[3]);
+      n[2] = _mm_unpacklo_epi8(c[1], c[4]);
+      n[3] = _mm_unpackhi_epi8(c[1], c[4]);
+      n[4] = _mm_unpacklo_epi8(c[2], c[5]);
+      n[5] = _mm_unpackhi_epi8(c[2], c[5]);
+      for (i = 0; i < 6; i++)
+	c[i] = n[i];
+    }
+
+    for (i = 0; i < 2; i++) {
+      rgb[0] = _mm_unpacklo_epi8(c[i], zero);
+      rgb[1] = _mm_unpacklo_epi8(c[2 + i], zero);
+      rgb[2] = _mm_unpacklo_epi8(c[4 + i], zero);
+      rgb_ycc_8(rgb, lo);
+      rgb[0] = _mm_unpackhi_epi8(c[i], zero);
+      rgb[1] = _mm_unpackhi_epi8(c[2 + i], zero);
+      rgb[2] = _mm_unpackhi_epi8(c[4 + i], zero);
+      rgb_ycc_8(rgb, hi);
+      _mm_storeu_si128((__m128i *) (outptr0 + col + 16*i),
+		       _mm_packus_epi16(lo[0], hi[0]));
+      _mm_storeu_si128((__m128i *) (outptr1 + col + 16*i),
+		       _mm_packus_epi16(lo[1], hi[1]));
+      _mm_storeu_si128((__m128i *) (outptr2 + col + 16*i),
+		       _mm_packus_epi16(lo[2], hi[2]));
+    }
+    inptr += 32 * RGB_PIXELSIZE;
+  }
+  return col;
+}
+
+#else /* JSIMD_NEON */
+
+LOCAL(void)
+rgb_ycc_8 (uint8x8_t r8, uint8x8_t g8, uint8x8_t b8,
+	   uint8x8_t * y8, uint8x8_t * cb8, uint8x8_t * cr8)
+{
+  uint16x8_t r = vmovl_u8(r8), g = vmovl_u8(g8), b = vmovl_u8(b8);
+  const uint32x4_t half = vdupq_n_u32(ONE_HALF);
+  const uint32x4_t offset = vdupq_n_u32(CBCR_OFFSET + ONE_HALF - 1);
+  uint32x4_t lo, hi;
+
+  lo = vmull_n_u16(vget_low_u16(r), C_R_Y);
+  lo = vmlal_n_u16(lo, vget_low_u16(g), C_G_Y);
+  lo = vmlal_n_u16(lo, vget_low_u16(b), C_B_Y);
+  hi = vmull_n_u16(vget_high_u16(r), C_R_Y);
+  hi = vmlal_n_u16(hi, vget_high_u16(g), C_G_Y);
+  hi = vmlal_n_u16(hi, vget_high_u16(b), C_B_Y);
+  *y8 = vmovn_u16(vcombine_u16(vaddhn_u32(lo, half), vaddhn_u32(hi, half)));
+
+  /* Intermediate sums may wrap; the final sums are in range. */
+  lo = vmull_n_u16(vget_low_u16(b), C_B_CB);
+  lo = vmlsl_n_u16(lo, vget_low_u16(r), C_R_CB);
+  lo = vmlsl_n_u16(lo, vget_low_u16(g), C_G_CB);
+  hi = vmull_n_u16(vget_high_u16(b), C_B_CB);
+  hi = vmlsl_n_u16(hi, vget_high_u16(r), C_R_CB);
+  hi = vmlsl_n_u16(hi, vget_high_u16(g), C_G_CB);
+  *cb8 = vmovn_u16(vcombine_u16(vaddhn_u32(lo, offset), vaddhn_u32(hi, offset)));
+
+  lo = vmull_n_u16(vget_low_u16(r), C_R_CR);
+  lo = vmlsl_n_u16(lo, vget_low_u16(g), C_G_CR);
+  lo = vmlsl_n_u16(lo, vget_low_u16(b), C_B_CR);
+  hi = vmull_n_u16(vget_high_u16(r), C_R_CR);
+  hi = vmlsl_n_u16(hi, vget_high_u16(g), C_G_CR);
+  hi = vmlsl_n_u16(hi, vget_high_u16(b), C_B_CR);
+  *cr8 = vmovn_u16(vcombine_u16(vaddhn_u32(lo, offset), vaddhn_u32(hi, offset)));
+}
+
+/* Returns the number of pixels converted (a multiple of 16). */
+
+LOCAL(JDIMENSION)
+rgb_ycc_row (JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+	     JSAMPROW outptr2, JDIMENSION num_cols)
+{
+  JDIMENSION col;
+
+  for (col = 0; col + 16 <= num_cols; col += 16) {
+    uint8x16x3_t rgb = vld3q_u8(inptr);
+    uint8x8_t y[2], cb[2], cr[2];
+
+    rgb_ycc_8(vget_low_u8(rgb.val[0]), vget_low_u8(rgb.val[1]),
+	      vget_low_u8(rgb.val[2]), &y[0], &cb[0], &cr[0]);
+    rgb_ycc_8(vget_high_u8(rgb.val[0]), vget_high_u8(rgb.val[1]),
+	      vget_high_u8(rgb.val[2]), &y[1], &cb[1], &cr[1]);
+    vst1q_u8(outptr0 + col, vcombine_u8(y[0], y[1]));
+    vst1q_u8(outptr1 + col, vcombine_u8(cb[0], cb[1]));
+    vst1q_u8(outptr2 + col, vcombine_u8(cr[0], cr[1]));
+    inptr += 16 * RGB_PIXELSIZE;
+  }
+  return col;
+}
+
+#endif /* JSIMD_SSE2 */
+
+
+GLOBAL(void)
+jsimd_rgb_ycc_convert (j_compress_ptr cinfo,
+		       JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+		       JDIMENSION output_row, int num_rows)
+{
+  register INT32 r, g, b;
+  register JSAMPROW inptr;
+  register JSAMPROW outptr0, outptr1, outptr2;
+  register JDIMENSION col;
+  JDIMENSION num_cols = cinfo->image_width;
+
+  while (--num_rows >= 0) {
+    inptr = *input_buf++;
+    outptr0 = output_buf[0][output_row];
+    outptr1 = output_buf[1][output_row];
+    outptr2 = output_buf[2][output_row];
+    output_row++;
+    col = rgb_ycc_row(inptr, outptr0, outptr1, outptr2, num_cols);
+    /* Leftover pixels */
+    for (inptr += col * RGB_PIXELSIZE; col < num_cols; col++) {
+      r = GETJSAMPLE(inptr[RGB_RED]);
+      g = GETJSAMPLE(inptr[RGB_GREEN]);
+      b = GETJSAMPLE(inptr[RGB_BLUE]);
+      outptr0[col] = (JSAMPLE)
+	((C_R_Y * r + C_G_Y * g + C_B_Y * b + ONE_HALF) >> SCALEBITS);
+      outptr1[col] = (JSAMPLE)
+	((- C_R_CB * r - C_G_CB * g + C_B_CB * b + CBCR_OFFSET + ONE_HALF-1)
+	 >> SCALEBITS);
+      outptr2[col] = (JSAMPLE)
+	((C_R_CR * r - C_G_CR * g - C_B_CR * b + CBCR_OFFSET + ONE_HALF-1)
+	 >> SCALEBITS);
+      inptr += RGB_PIXELSIZE;
+    }
+  }
+}
+
+
+/*
+ * 2:1 horizontal and 2:1 horizontal + vertical downsampling of one row,
+ * with the same alternating rounding bias as jcsample.c.  The caller has
+ * already expanded the input to 2 * output_cols samples.
+ */
+
+GLOBAL(void)
+jsimd_h2v1_downsample_row (JSAMPROW inptr, JSAMPROW outptr,
+			   JDIMENSION output_cols)
+{
+  JDIMENSION outcol = 0;
+  int bias;
+
+#ifdef JSIMD_SSE2
+  const __m128i mask = _mm_set1_epi16(0x00FF);
+  const __m128i vbias = _mm_set_epi16(1, 0, 1, 0, 1, 0, 1, 0);
+
+  for (; outcol + 16 <= output_cols; outcol += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *) inptr);
+    __m128i b = _mm_loadu_si128((const __m128i *) (inptr + 16));
+
+    a = _mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8));
+    b = _mm_add_epi16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8));
+    a = _mm_srli_epi16(_mm_add_epi16(a, vbias), 1);
+    b = _mm_srli_epi16(_mm_add_epi16(b, vbias), 1);
+    _mm_storeu_si128((__m128i *) outptr, _mm_packus_epi16(a, b));
+    inptr += 32;
+    outptr += 16;
+  }
+#else
+  static const uint16_t bias01[8] = { 0, 1, 0, 1, 0, 1, 0, 1 };
+  const uint16x8_t vbias = vld1q_u16(bias01);
+
+  for (; outcol + 16 <= output_cols; outcol += 16) {
+    uint16x8_t a = vaddq_u16(vpaddlq_u8(vld1q_u8(inptr)), vbias);
+    uint16x8_t b = vaddq_u16(vpaddlq_u8(vld1q_u8(inptr + 16)), vbias);
+
+    vst1q_u8(outptr, vcombine_u8(vshrn_n_u16(a, 1), vshrn_n_u16(b, 1)));
+    inptr += 32;
+    outptr += 16;
+  }
+#endif
+
+  bias = 0;			/* bias = 0,1,0,1,... for successive samples */
+  for (; outcol < output_cols; outcol++) {
+    *outptr++ = (JSAMPLE) ((GETJSAMPLE(*inptr) + GETJSAMPLE(inptr[1])
+			    + bias) >> 1);
+    bias ^= 1;			/* 0=>1, 1=>0 */
+    inptr += 2;
+  }
+}
+
+
+GLOBAL(void)
+jsimd_h2v2_downsample_row (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW outptr,
+			   JDIMENSION output_cols)
+{
+  JDIMENSION outcol = 0;
+  int bias;
+
+#ifdef JSIMD_SSE2
+  const __m128i mask = _mm_set1_epi16(0x00FF);
+  const __m128i vbias = _mm_set_epi16(2, 1, 2, 1, 2, 1, 2, 1);
+
+  for (; outcol + 16 <= output_cols; outcol += 16) {
+    __m128i a0 = _mm_loadu_si128((const __m128i *) inptr0);
+    __m128i b0 = _mm_loadu_si128((const __m128i *) (inptr0 + 16));
+    __m128i a1 = _mm_loadu_si128((const __m128i *) inptr1);
+    __m128i b1 = _mm_loadu_si128((const __m128i *) (inptr1 + 16));
+    __m128i a, b;
+
+    a = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a0, mask), _mm_srli_epi16(a0, 8)),
+		      _mm_add_epi16(_mm_and_si128(a1, mask), _mm_srli_epi16(a1, 8)));
+    b = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(b0, mask), _mm_srli_epi16(b0, 8)),
+		      _mm_add_epi16(_mm_and_si128(b1, mask), _mm_srli_epi16(b1, 8)));
+    a = _mm_srli_epi16(_mm_add_epi16(a, vbias), 2);
+    b = _mm_srli_epi16(_mm_add_epi16(b, vbias), 2);
+    _mm_storeu_si128((__m128i *) outptr, _mm_packus_epi16(a, b));
+    inptr0 += 32;
+    inptr1 += 32;
+    outptr += 16;
+  }
+#else
+  static const uint16_t bias12[8] = { 1, 2, 1, 2, 1, 2, 1, 2 };
+  const uint16x8_t vbias = vld1q_u16(bias12);
+
+  for (; outcol + 16 <= output_cols; outcol += 16) {
+    uint16x8_t a = vpadalq_u8(vpaddlq_u8(vld1q_u8(inptr0)), vld1q_u8(inptr1));
+    uint16x8_t b = vpadalq_u8(vpaddlq_u8(vld1q_u8(inptr0 + 16)),
+			      vld1q_u8(inptr1 + 16));
+
+    a = vaddq_u16(a, vbias);
+    b = vaddq_u16(b, vbias);
+    vst1q_u8(outptr, vcombine_u8(vshrn_n_u16(a, 2), vshrn_n_u16(b, 2)));
+    inptr0 += 32;
+    inptr1 += 32;
+    outptr += 16;
+  }
+#endif
+
+  bias = 1;			/* bias = 1,2,1,2,... for successive samples */
+  for (; outcol < output_cols; outcol++) {
+    *outptr++ = (JSAMPLE) ((GETJSAMPLE(*inptr0) + GETJSAMPLE(inptr0[1]) +
+			    GETJSAMPLE(*inptr1) + GETJSAMPLE(inptr1[1])
+			    + bias) >> 2);
+    bias ^= 3;			/* 1=>2, 2=>1 */
+    inptr0 += 2; inptr1 += 2;
+  }
+}
+
+#endif /* JSIMD_SUPPORTED */
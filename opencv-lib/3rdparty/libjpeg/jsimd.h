@@ -0,0 +1,71 @@
+/*
+ * jsimd.h
+ *
+ * This file is an addition to the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This include file declares the SSE2 / NEON versions of the compressor's
+ * inner loops: forward DCT, quantization, RGB->YCbCr conversion and
+ * 2:1 downsampling.  Each routine gives exactly the same output as the
+ * portable C code it replaces, so the compressed data does not depend
+ * on whether they are used.
+ *
+ * The routines are only compiled for 8-bit samples on targets with SSE2
+ * or NEON (JSIMD_SUPPORTED); callers select them at module init time
+ * when jsimd_enabled() is TRUE.
+ */
+
+#ifndef JSIMD_H
+#define JSIMD_H
+
+#if BITS_IN_JSAMPLE == 8
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#define JSIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define JSIMD_NEON
+#endif
+#endif
+
+#if defined(JSIMD_SSE2) || defined(JSIMD_NEON)
+#define JSIMD_SUPPORTED
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Global switch, on by default.  It takes effect at the next
+ * jpeg_start_compress(); a compression in progress is not affected.
+ */
+EXTERN(void) jsimd_set_enabled JPP((boolean enabled));
+EXTERN(boolean) jsimd_enabled JPP((void));
+
+#ifdef JSIMD_SUPPORTED
+
+/* DCTELEM is int for 8-bit samples (see jdct.h). */
+
+EXTERN(void) jsimd_fdct_islow
+    JPP((int * data, JSAMPARRAY sample_data, JDIMENSION start_col));
+EXTERN(void) jsimd_fdct_16x16
+    JPP((int * data, JSAMPARRAY sample_data, JDIMENSION start_col));
+EXTERN(void) jsimd_quantize
+    JPP((JCOEFPTR coef_block, int * divisors, int * workspace));
+
+EXTERN(boolean) jsimd_can_rgb_ycc JPP((void));
+EXTERN(void) jsimd_rgb_ycc_convert
+    JPP((j_compress_ptr cinfo, JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+	 JDIMENSION output_row, int num_rows));
+
+EXTERN(void) jsimd_h2v1_downsample_row
+    JPP((JSAMPROW inptr, JSAMPROW outptr, JDIMENSION output_cols));
+EXTERN(void) jsimd_h2v2_downsample_row
+    JPP((JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW outptr,
+	 JDIMENSION output_cols));
+
+#endif /* JSIMD_SUPPORTED */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSIMD_H */
@@ -434,6 +434,73 @@ public:
     virtual BufferPoolController* getBufferPoolController(const char* id = NULL) const;
 };
 
+/** @brief Counters of a PoolMatAllocator. Sizes are in bytes.
+*/
+struct CV_EXPORTS MatPoolStats
+{
+    MatPoolStats();
+
+    size_t allocations;     //!< buffers handed out
+    size_t hits;            //!< buffers handed out from the pool
+    size_t misses;          //!< buffers and headers taken from the heap
+    size_t frozenMisses;    //!< misses while the pool was frozen
+    size_t inUse;           //!< bytes handed out and not released yet
+    size_t inUsePeak;       //!< high-water mark of inUse
+    size_t reserved;        //!< bytes kept in the pool for reuse
+    size_t footprintPeak;   //!< high-water mark of inUse + reserved
+};
+
+/** @brief Allocator that keeps released matrix buffers and hands them out again.
+
+Buffers are grouped in size classes a quarter of a power of two apart, so a released buffer is
+reused by any later request of the same class, typically the same matrix in the next frame. The
+matrix headers (UMatData) are recycled too, so once every shape a frame needs has been allocated
+once, further frames of the same shapes do not touch the heap. freeze() marks the end of that
+warm-up: any heap allocation after it is counted in MatPoolStats::frozenMisses, or refused.
+
+Install it for all threads with Mat::setDefaultAllocator(), for the calling thread with
+setThreadMatAllocator(), or for a single matrix through Mat::allocator. The pool is guarded by
+cv::Mutex; where that is a no-op (__MBED__ builds), use one pool per thread.
+The allocator must outlive every matrix allocated from it.
+*/
+class CV_EXPORTS PoolMatAllocator : public MatAllocator
+{
+public:
+    PoolMatAllocator();
+    ~PoolMatAllocator();
+
+    UMatData* allocate(int dims, const int* sizes, int type,
+                       void* data, size_t* step, int flags, UMatUsageFlags usageFlags) const;
+    bool allocate(UMatData* data, int accessflags, UMatUsageFlags usageFlags) const;
+    void deallocate(UMatData* data) const;
+    //! controls the reserved (released but kept) buffers
+    BufferPoolController* getBufferPoolController(const char* id = NULL) const;
+
+    /** @brief Ends the warm-up: counts every heap allocation from now on.
+    @param strict Refuse such allocations with CV_StsNoMem instead of only counting them.
+     */
+    void freeze(bool strict = false);
+    //! allows heap allocations again
+    void thaw();
+    MatPoolStats getStats() const;
+    //! restarts the high-water marks from the current sizes
+    void resetPeaks();
+
+    struct Impl;
+protected:
+    Impl* p;
+private:
+    PoolMatAllocator(const PoolMatAllocator&);
+    PoolMatAllocator& operator = (const PoolMatAllocator&);
+};
+
+/** @brief Sets the allocator used for matrices created by the calling thread.
+
+It takes precedence over Mat::setDefaultAllocator() and is returned by Mat::getDefaultAllocator()
+on this thread. Pass NULL to go back to the process-wide default.
+ */
+CV_EXPORTS void setThreadMatAllocator(MatAllocator* allocator);
+
 
 //////////////////////////////// MatCommaInitializer //////////////////////////////////
 
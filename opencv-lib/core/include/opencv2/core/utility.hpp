@@ -239,6 +239,45 @@ The exact meaning of return value depends on the threading framework used by Ope
  */
 CV_EXPORTS_W int getThreadNum();
 
+/** @brief Sets the scheduling priority of the worker threads that run parallel regions.
+
+The priority is relative to a normal thread, on the same scale as the Windows THREAD_PRIORITY_*
+and CMSIS-RTOS osPriority values: -2 (lowest), -1 (below normal), 0 (normal), 1 (above normal),
+2 (highest). Choose a value below the latency-sensitive threads of the application (capture,
+audio) so that parallel regions never preempt them. The workers are restarted with the new
+priority at the next parallel region.
+
+The behaviour depends on the threading framework:
+-   `pthreads` – Workers always run with the SCHED_OTHER policy, so they never inherit a
+    real-time policy from the thread that created the pool. On Linux each step is 5 nice levels
+    relative to that thread; raising the priority needs CAP_SYS_NICE and is ignored otherwise.
+-   `Concurrency` – Used as the ContextPriority of the scheduler created for OpenCV.
+-   Other frameworks – Ignored.
+@param priority Relative priority of the worker threads, 0 by default.
+@sa getParallelThreadPriority, setParallelThreadAffinity
+ */
+CV_EXPORTS void setParallelThreadPriority(int priority);
+
+/** @brief Returns the priority set by setParallelThreadPriority.
+@sa setParallelThreadPriority
+ */
+CV_EXPORTS int getParallelThreadPriority();
+
+/** @brief Restricts the worker threads that run parallel regions to a set of CPUs.
+
+Bit i of the mask allows CPU i; 0 (the default) allows all CPUs. Use it to keep cores free for
+real-time threads. The workers are restarted with the new mask at the next parallel region.
+Only the `pthreads` framework on Linux honours the mask; other frameworks ignore it.
+@param cpuMask Allowed CPUs of the worker threads.
+@sa getParallelThreadAffinity, setParallelThreadPriority
+ */
+CV_EXPORTS void setParallelThreadAffinity(uint64 cpuMask);
+
+/** @brief Returns the mask set by setParallelThreadAffinity.
+@sa setParallelThreadAffinity
+ */
+CV_EXPORTS uint64 getParallelThreadAffinity();
+
 /** @brief Returns full configuration time cmake output.
 
 Returned value is raw cmake output including version control system revision, compiler version,
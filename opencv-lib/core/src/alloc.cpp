@@ -41,6 +41,7 @@
 //M*/
 
 #include "precomp.hpp"
+#include <new>
 
 #define CV_USE_SYSTEM_MALLOC 1
 
@@ -692,6 +693,282 @@ void fastFree( void* ptr )
 
 #endif //CV_USE_SYSTEM_MALLOC
 
+//////////////////////////////// PoolMatAllocator ////////////////////////////////
+
+MatPoolStats::MatPoolStats()
+    : allocations(0), hits(0), misses(0), frozenMisses(0),
+      inUse(0), inUsePeak(0), reserved(0), footprintPeak(0)
+{
+}
+
+struct PoolMatAllocator::Impl : public BufferPoolController
+{
+    // Size classes are 4, 5, 6 and 7 times a power of two, starting at 64 bytes
+    enum { MIN_SHIFT = 4, CLASS_COUNT = (sizeof(size_t)*8 - MIN_SHIFT - 2)*4 };
+
+    // Released blocks are chained through their own first bytes
+    struct FreeBlock { FreeBlock* next; };
+
+    Impl() : headers(0), maxReserved((size_t)-1), frozen(false), strict(false)
+    {
+        for( int i = 0; i < CLASS_COUNT; i++ )
+            buffers[i] = 0;
+    }
+    virtual ~Impl() { freeAllReservedBuffers(); }
+
+    static int sizeClass(size_t size)
+    {
+        if( size <= ((size_t)4 << MIN_SHIFT) )
+            return 0;
+        size_t n = size - 1;
+        int shift = 0;
+        while( (n >> shift) >= 8 )
+            shift++;
+        size_t m = (n >> shift) + 1;
+        if( m == 8 )
+        {
+            m = 4;
+            shift++;
+        }
+        int c = (shift - MIN_SHIFT)*4 + (int)(m - 4);
+        CV_Assert( c < CLASS_COUNT );
+        return c;
+    }
+
+    static size_t classSize(int c)
+    {
+        return (size_t)(4 + (c & 3)) << ((c >> 2) + MIN_SHIFT);
+    }
+
+    // the caller holds the mutex
+    void* heapAlloc(size_t size)
+    {
+        if( frozen )
+        {
+            if( strict )
+                CV_Error_(CV_StsNoMem, ("PoolMatAllocator is frozen, refused %lu bytes", (unsigned long)size));
+            stats.frozenMisses++;
+        }
+        stats.misses++;
+        return fastMalloc(size);
+    }
+
+    void updatePeaks()
+    {
+        stats.inUsePeak = std::max(stats.inUsePeak, stats.inUse);
+        stats.footprintPeak = std::max(stats.footprintPeak, stats.inUse + stats.reserved);
+    }
+
+    void* takeBuffer(size_t size)
+    {
+        int c = sizeClass(size);
+        size_t csize = classSize(c);
+        void* ptr;
+        if( buffers[c] )
+        {
+            FreeBlock* block = buffers[c];
+            buffers[c] = block->next;
+            stats.reserved -= csize;
+            stats.hits++;
+            ptr = block;
+        }
+        else
+            ptr = heapAlloc(csize);
+        stats.allocations++;
+        stats.inUse += csize;
+        updatePeaks();
+        return ptr;
+    }
+
+    void releaseBuffer(void* ptr, size_t size)
+    {
+        int c = sizeClass(size);
+        size_t csize = classSize(c);
+        stats.inUse -= csize;
+        if( stats.reserved + csize > maxReserved )
+        {
+            fastFree(ptr);
+            return;
+        }
+        FreeBlock* block = (FreeBlock*)ptr;
+        block->next = buffers[c];
+        buffers[c] = block;
+        stats.reserved += csize;
+        updatePeaks();
+    }
+
+    void* takeHeader()
+    {
+        if( !headers )
+            return heapAlloc(sizeof(UMatData));
+        FreeBlock* block = headers;
+        headers = block->next;
+        return block;
+    }
+
+    void releaseHeader(void* ptr)
+    {
+        FreeBlock* block = (FreeBlock*)ptr;
+        block->next = headers;
+        headers = block;
+    }
+
+    size_t getReservedSize() const { return stats.reserved; }
+    size_t getMaxReservedSize() const { return maxReserved; }
+
+    void setMaxReservedSize(size_t size)
+    {
+        AutoLock lock(mutex);
+        maxReserved = size;
+        // drop the largest buffers first, they are the least likely to fit a new shape
+        for( int c = CLASS_COUNT - 1; c >= 0 && stats.reserved > maxReserved; c-- )
+        {
+            while( buffers[c] && stats.reserved > maxReserved )
+            {
+                FreeBlock* block = buffers[c];
+                buffers[c] = block->next;
+                stats.reserved -= classSize(c);
+                fastFree(block);
+            }
+        }
+    }
+
+    void freeAllReservedBuffers()
+    {
+        AutoLock lock(mutex);
+        for( int c = 0; c < CLASS_COUNT; c++ )
+        {
+            while( buffers[c] )
+            {
+                FreeBlock* block = buffers[c];
+                buffers[c] = block->next;
+                fastFree(block);
+            }
+        }
+        while( headers )
+        {
+            FreeBlock* block = headers;
+            headers = block->next;
+            fastFree(block);
+        }
+        stats.reserved = 0;
+    }
+
+    Mutex mutex;
+    FreeBlock* buffers[CLASS_COUNT];
+    FreeBlock* headers;
+    size_t maxReserved;
+    bool frozen;
+    bool strict;
+    MatPoolStats stats;
+};
+
+PoolMatAllocator::PoolMatAllocator()
+{
+    p = new Impl();
+}
+
+PoolMatAllocator::~PoolMatAllocator()
+{
+    delete p;
+}
+
+UMatData* PoolMatAllocator::allocate(int dims, const int* sizes, int type,
+                                     void* data0, size_t* step, int /*flags*/, UMatUsageFlags /*usageFlags*/) const
+{
+    size_t total = CV_ELEM_SIZE(type);
+    for( int i = dims-1; i >= 0; i-- )
+    {
+        if( step )
+        {
+            if( data0 && step[i] != CV_AUTOSTEP )
+            {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            }
+            else
+                step[i] = total;
+        }
+        total *= sizes[i];
+    }
+
+    AutoLock lock(p->mutex);
+    uchar* data = data0 ? (uchar*)data0 : (uchar*)p->takeBuffer(total);
+    void* header;
+    try
+    {
+        header = p->takeHeader();
+    }
+    catch(...)
+    {
+        if( !data0 )
+            p->releaseBuffer(data, total);
+        throw;
+    }
+    UMatData* u = new (header) UMatData(this);
+    u->data = u->origdata = data;
+    u->size = total;
+    if(data0)
+        u->flags |= UMatData::USER_ALLOCATED;
+
+    return u;
+}
+
+bool PoolMatAllocator::allocate(UMatData* u, int /*accessFlags*/, UMatUsageFlags /*usageFlags*/) const
+{
+    if(!u) return false;
+    return true;
+}
+
+void PoolMatAllocator::deallocate(UMatData* u) const
+{
+    if(!u)
+        return;
+
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+    AutoLock lock(p->mutex);
+    if( !(u->flags & UMatData::USER_ALLOCATED) )
+    {
+        p->releaseBuffer(u->origdata, u->size);
+        u->origdata = 0;
+    }
+    u->~UMatData();
+    p->releaseHeader(u);
+}
+
+BufferPoolController* PoolMatAllocator::getBufferPoolController(const char* /*id*/) const
+{
+    return p;
+}
+
+void PoolMatAllocator::freeze(bool strict)
+{
+    AutoLock lock(p->mutex);
+    p->frozen = true;
+    p->strict = strict;
+}
+
+void PoolMatAllocator::thaw()
+{
+    AutoLock lock(p->mutex);
+    p->frozen = false;
+    p->strict = false;
+}
+
+MatPoolStats PoolMatAllocator::getStats() const
+{
+    AutoLock lock(p->mutex);
+    return p->stats;
+}
+
+void PoolMatAllocator::resetPeaks()
+{
+    AutoLock lock(p->mutex);
+    p->stats.inUsePeak = p->stats.inUse;
+    p->stats.footprintPeak = p->stats.inUse + p->stats.reserved;
+}
+
 }
 
 CV_IMPL void* cvAlloc( size_t size )
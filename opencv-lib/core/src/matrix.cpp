@@ -45,6 +45,10 @@
 
 #include "bufferpool.impl.hpp"
 
+#ifdef __MBED__
+#include "cmsis_os.h"
+#endif
+
 /****************************************************************************************\
 *                           [scaled] Identity matrix initialization                      *
 \****************************************************************************************/
@@ -223,11 +227,82 @@ public:
 namespace
 {
     MatAllocator* g_matAllocator = NULL;
+
+#if defined WIN32 || defined _WIN32
+    __declspec( thread ) MatAllocator* g_threadMatAllocator = NULL;
+
+    MatAllocator* getThreadMatAllocator() { return g_threadMatAllocator; }
+    void putThreadMatAllocator(MatAllocator* allocator) { g_threadMatAllocator = allocator; }
+#elif defined __MBED__
+    // [GNOMONS] There is no thread local storage, so keep a few slots keyed by the RTOS thread
+    enum { THREAD_MAT_ALLOCATOR_SLOTS = 8 };
+    struct ThreadMatAllocator
+    {
+        int used;
+        osThreadId id;
+        MatAllocator* allocator;
+    };
+    ThreadMatAllocator g_threadMatAllocators[THREAD_MAT_ALLOCATOR_SLOTS];
+
+    MatAllocator* getThreadMatAllocator()
+    {
+        osThreadId id = osThreadGetId();
+        for( int i = 0; i < THREAD_MAT_ALLOCATOR_SLOTS; i++ )
+        {
+            if( g_threadMatAllocators[i].used && g_threadMatAllocators[i].id == id )
+                return g_threadMatAllocators[i].allocator;
+        }
+        return NULL;
+    }
+
+    void putThreadMatAllocator(MatAllocator* allocator)
+    {
+        osThreadId id = osThreadGetId();
+        for( int i = 0; i < THREAD_MAT_ALLOCATOR_SLOTS; i++ )
+        {
+            ThreadMatAllocator& slot = g_threadMatAllocators[i];
+            if( slot.used && slot.id == id )
+            {
+                slot.allocator = allocator;
+                if( !allocator )
+                    CV_XADD(&slot.used, -1);
+                return;
+            }
+        }
+        if( !allocator )
+            return;
+        for( int i = 0; i < THREAD_MAT_ALLOCATOR_SLOTS; i++ )
+        {
+            ThreadMatAllocator& slot = g_threadMatAllocators[i];
+            // claim the slot atomically, another thread may be looking for a free one too
+            if( CV_XADD(&slot.used, 1) == 0 )
+            {
+                slot.id = id;
+                slot.allocator = allocator;
+                return;
+            }
+            CV_XADD(&slot.used, -1);
+        }
+        CV_Error(CV_StsOutOfRange, "Too many threads with their own Mat allocator");
+    }
+#else
+    __thread MatAllocator* g_threadMatAllocator = NULL;
+
+    MatAllocator* getThreadMatAllocator() { return g_threadMatAllocator; }
+    void putThreadMatAllocator(MatAllocator* allocator) { g_threadMatAllocator = allocator; }
+#endif
 }
 
+void setThreadMatAllocator(MatAllocator* allocator)
+{
+    putThreadMatAllocator(allocator);
+}
 
 MatAllocator* Mat::getDefaultAllocator()
 {
+    MatAllocator* allocator = getThreadMatAllocator();
+    if (allocator != NULL)
+        return allocator;
     if (g_matAllocator == NULL)
     {
         g_matAllocator = getStdAllocator();
@@ -130,12 +130,16 @@ namespace cv
     void parallel_for_pthreads(const cv::Range& range, const cv::ParallelLoopBody& body, double nstripes);
     size_t parallel_pthreads_get_threads_num();
     void parallel_pthreads_set_threads_num(int num);
+    void parallel_pthreads_set_thread_options(int priority, uint64 affinity);
 #endif
 }
 
 
 namespace
 {
+static int parallelThreadPriority = 0;
+static uint64 parallelThreadAffinity = 0;
+
 #ifdef CV_PARALLEL_FRAMEWORK
 #ifdef ENABLE_INSTRUMENTATION
     static void SyncNodes(cv::instr::InstrNode *pNode)
@@ -283,6 +287,34 @@ public:
     ~SchedPtr() {}
 };
 static SchedPtr pplScheduler;
+static int pplThreads = -1;
+static int pplPriority = 0;
+
+static void updatePplScheduler(int threads)
+{
+    if (threads == 1)
+    {
+        // Concurrency always uses >=2 threads, so we just disable it if 1 thread is requested
+        numThreads = 0;
+    }
+    else if (threads <= 0 && parallelThreadPriority == 0)
+    {
+        pplScheduler = 0;
+    }
+    else if (pplScheduler == 0 || pplThreads != threads || pplPriority != parallelThreadPriority)
+    {
+        if (threads > 0)
+            pplScheduler = Concurrency::Scheduler::Create(Concurrency::SchedulerPolicy(3,
+                           Concurrency::MinConcurrency, threads-1,
+                           Concurrency::MaxConcurrency, threads-1,
+                           Concurrency::ContextPriority, parallelThreadPriority));
+        else
+            pplScheduler = Concurrency::Scheduler::Create(Concurrency::SchedulerPolicy(1,
+                           Concurrency::ContextPriority, parallelThreadPriority));
+        pplThreads = threads;
+        pplPriority = parallelThreadPriority;
+    }
+}
 
 #endif
 
@@ -292,12 +324,14 @@ static SchedPtr pplScheduler;
 
 /* ================================   parallel_for_  ================================ */
 
-void cv::parallel_for_(const cv::Range& range, const cv::ParallelLoopBody& body, double nstripes)
-{
-    CV_INSTRUMENT_REGION_MT_FORK()
-    if (range.empty())
-        return;
+#ifdef CV_PARALLEL_FRAMEWORK
+// Set while a parallel region runs. parallel_for_() called from a loop body (or from another
+// thread meanwhile) runs sequentially instead of oversubscribing the workers.
+static volatile int flagNestedParallelFor = 0;
+#endif
 
+static void parallel_for_impl(const cv::Range& range, const cv::ParallelLoopBody& body, double nstripes)
+{
 #ifdef CV_PARALLEL_FRAMEWORK
 
     if(numThreads != 0)
@@ -373,6 +407,37 @@ void cv::parallel_for_(const cv::Range& range, const cv::ParallelLoopBody& body,
     }
 }
 
+void cv::parallel_for_(const cv::Range& range, const cv::ParallelLoopBody& body, double nstripes)
+{
+    CV_INSTRUMENT_REGION_MT_FORK()
+    if (range.empty())
+        return;
+
+#ifdef CV_PARALLEL_FRAMEWORK
+    bool isNotNestedRegion = flagNestedParallelFor == 0;
+    if (isNotNestedRegion)
+        isNotNestedRegion = CV_XADD(&flagNestedParallelFor, 1) == 0;
+    if (!isNotNestedRegion)
+    {
+        body(range);
+        return;
+    }
+
+    try
+    {
+        parallel_for_impl(range, body, nstripes);
+        flagNestedParallelFor = 0;
+    }
+    catch (...)
+    {
+        flagNestedParallelFor = 0;
+        throw;
+    }
+#else
+    parallel_for_impl(range, body, nstripes);
+#endif
+}
+
 int cv::getNumThreads(void)
 {
 #ifdef CV_PARALLEL_FRAMEWORK
@@ -457,21 +522,7 @@ void cv::setNumThreads( int threads )
 
 #elif defined HAVE_CONCURRENCY
 
-    if (threads <= 0)
-    {
-        pplScheduler = 0;
-    }
-    else if (threads == 1)
-    {
-        // Concurrency always uses >=2 threads, so we just disable it if 1 thread is requested
-        numThreads = 0;
-    }
-    else if (pplScheduler == 0 || 1 + pplScheduler->GetNumberOfVirtualProcessors() != (unsigned int)threads)
-    {
-        pplScheduler = Concurrency::Scheduler::Create(Concurrency::SchedulerPolicy(2,
-                       Concurrency::MinConcurrency, threads-1,
-                       Concurrency::MaxConcurrency, threads-1));
-    }
+    updatePplScheduler(threads);
 
 #elif defined HAVE_PTHREADS_PF
 
@@ -480,6 +531,50 @@ void cv::setNumThreads( int threads )
 #endif
 }
 
+void cv::setParallelThreadPriority(int priority)
+{
+    parallelThreadPriority = std::min(std::max(priority, -2), 2);
+
+#if defined HAVE_TBB || defined HAVE_CSTRIPES || defined HAVE_OPENMP || defined HAVE_GCD || defined WINRT
+
+    // unsupported
+
+#elif defined HAVE_CONCURRENCY
+
+    if (numThreads != 0)
+        updatePplScheduler(numThreads);
+
+#elif defined HAVE_PTHREADS_PF
+
+    parallel_pthreads_set_thread_options(parallelThreadPriority, parallelThreadAffinity);
+
+#endif
+}
+
+int cv::getParallelThreadPriority()
+{
+    return parallelThreadPriority;
+}
+
+void cv::setParallelThreadAffinity(uint64 cpuMask)
+{
+    parallelThreadAffinity = cpuMask;
+
+#if defined HAVE_TBB || defined HAVE_CSTRIPES || defined HAVE_OPENMP || defined HAVE_GCD || defined WINRT || defined HAVE_CONCURRENCY
+
+    // unsupported
+
+#elif defined HAVE_PTHREADS_PF
+
+    parallel_pthreads_set_thread_options(parallelThreadPriority, parallelThreadAffinity);
+
+#endif
+}
+
+uint64 cv::getParallelThreadAffinity()
+{
+    return parallelThreadAffinity;
+}
 
 int cv::getThreadNum(void)
 {
@@ -45,7 +45,15 @@
 #ifdef HAVE_PTHREADS_PF
 
 #include <algorithm>
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
 
 namespace cv
 {
@@ -108,6 +116,65 @@ struct work_load
     }
 };
 
+// Stripes [begin, end) dealt to one worker, packed as (begin << 32) | end so that the owner
+// (from the front) and idle workers stealing (from the back) take a stripe with one CAS.
+// 64 bits keep any unsigned stripe count; the load is atomic on 32-bit targets too.
+struct stripe_queue
+{
+    stripe_queue(): m_bounds(0)
+    {
+    }
+
+    static uint64 pack(unsigned int begin, unsigned int end)
+    {
+        return ((uint64)begin << 32) | end;
+    }
+
+    void set(unsigned int begin, unsigned int end)
+    {
+        __atomic_store_n(&m_bounds, pack(begin, end), __ATOMIC_RELEASE);
+    }
+
+    bool pop_front(unsigned int& stripe)
+    {
+        for(;;)
+        {
+            uint64 bounds = __atomic_load_n(&m_bounds, __ATOMIC_ACQUIRE);
+            unsigned int begin = (unsigned int)(bounds >> 32), end = (unsigned int)bounds;
+
+            if(begin >= end)
+                return false;
+
+            if(__sync_bool_compare_and_swap(&m_bounds, bounds, pack(begin + 1, end)))
+            {
+                stripe = begin;
+                return true;
+            }
+        }
+    }
+
+    bool pop_back(unsigned int& stripe)
+    {
+        for(;;)
+        {
+            uint64 bounds = __atomic_load_n(&m_bounds, __ATOMIC_ACQUIRE);
+            unsigned int begin = (unsigned int)(bounds >> 32), end = (unsigned int)bounds;
+
+            if(begin >= end)
+                return false;
+
+            if(__sync_bool_compare_and_swap(&m_bounds, bounds, pack(begin, end - 1)))
+            {
+                stripe = end - 1;
+                return true;
+            }
+        }
+    }
+
+    volatile uint64 m_bounds;
+    char m_pad[64 - sizeof(uint64)]; // one cache line per worker
+};
+
 class ForThread
 {
 public:
@@ -179,6 +246,8 @@ public:
 
     void setNumOfThreads(size_t n);
 
+    void setThreadOptions(int priority, uint64 affinity);
+
 private:
 
     ThreadManager();
@@ -200,7 +269,6 @@ private:
     pthread_cond_t  m_cond_thread_task_complete;
     bool            m_task_complete;
 
-    unsigned int m_task_position;
     unsigned int m_num_of_completed_tasks;
 
     pthread_mutex_t m_manager_access_mutex;
@@ -210,6 +278,11 @@ private:
 
     work_load m_work_load;
 
+    std::vector<stripe_queue> m_queues;
+
+    int m_priority;
+    uint64 m_affinity;
+
     struct work_thread_t
     {
         work_thread_t(): value(false) { }
@@ -257,7 +330,20 @@ bool ForThread::init(size_t id, ThreadManager* parent)
 
     if(!res)
     {
-        res = pthread_create(&m_posix_thread, NULL, thread_loop_wrapper, (void*)this);
+        // Never inherit a real-time policy from the thread that happens to create the pool,
+        // the workers must not preempt it or the other real-time threads
+        pthread_attr_t attr;
+        sched_param param;
+
+        pthread_attr_init(&attr);
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+        param.sched_priority = 0;
+        pthread_attr_setschedparam(&attr, &param);
+
+        res = pthread_create(&m_posix_thread, &attr, thread_loop_wrapper, (void*)this);
+
+        pthread_attr_destroy(&attr);
     }
 
 
@@ -301,25 +387,71 @@ void* ForThread::thread_loop_wrapper(void* thread_object)
 
 void ForThread::execute()
 {
-    unsigned int m_current_pos = CV_XADD(&m_parent->m_task_position, 1);
-
     work_load& load = m_parent->m_work_load;
 
-    while(m_current_pos < load.m_nstripes)
+    std::vector<stripe_queue>& queues = m_parent->m_queues;
+
+    size_t n = queues.size();
+
+    // Own stripes first, then steal from the back of the others. Queues only shrink during
+    // a run, so one pass over them leaves no stripe behind.
+    for(size_t i = 0; i < n; ++i)
     {
-        int start = load.m_range->start + m_current_pos*load.m_block_size;
-        int end = std::min(start + load.m_block_size, load.m_range->end);
+        stripe_queue& queue = queues[(m_id + i) % n];
 
-        load.m_body->operator()(cv::Range(start, end));
+        unsigned int stripe;
 
-        m_current_pos = CV_XADD(&m_parent->m_task_position, 1);
+        while(i == 0 ? queue.pop_front(stripe) : queue.pop_back(stripe))
+        {
+            int start = load.m_range->start + stripe*load.m_block_size;
+            int end = std::min(start + load.m_block_size, load.m_range->end);
+
+            load.m_body->operator()(cv::Range(start, end));
+        }
     }
 }
 
+static void apply_thread_options(int priority, uint64 affinity)
+{
+#ifdef __linux__
+    if(affinity != 0)
+    {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+
+        for(int i = 0; i < 64 && i < CPU_SETSIZE; ++i)
+        {
+            if(affinity & ((uint64)1 << i))
+                CPU_SET(i, &cpus);
+        }
+
+        sched_setaffinity(0, sizeof(cpus), &cpus);
+    }
+
+    if(priority != 0)
+    {
+        // nice values are per thread on Linux, starting from the one of the creating thread
+        pid_t tid = (pid_t)syscall(SYS_gettid);
+
+        errno = 0;
+        int nice_value = getpriority(PRIO_PROCESS, tid);
+
+        if(errno == 0)
+            setpriority(PRIO_PROCESS, tid, std::min(std::max(nice_value - 5*priority, -20), 19));
+    }
+#else
+    (void)priority;
+    (void)affinity;
+#endif
+}
+
 void ForThread::thread_body()
 {
     m_parent->m_is_work_thread.get()->value = true;
 
+    apply_thread_options(m_parent->m_priority, m_parent->m_affinity);
+
     pthread_mutex_lock(&m_thread_mutex);
 
     m_state = eFTStarted;
@@ -343,7 +475,7 @@ void ForThread::thread_body()
     pthread_mutex_unlock(&m_thread_mutex);
 }
 
-ThreadManager::ThreadManager(): m_num_threads(0), m_task_complete(false), m_num_of_completed_tasks(0), m_pool_state(eTMNotInited)
+ThreadManager::ThreadManager(): m_num_threads(0), m_task_complete(false), m_num_of_completed_tasks(0), m_priority(0), m_affinity(0), m_pool_state(eTMNotInited)
 {
     int res = 0;
 
@@ -360,14 +492,11 @@ ThreadManager::ThreadManager(): m_num_threads(0), m_task_complete(false), m_num_
     if(!res)
     {
         setNumOfThreads(defaultNumberOfThreads());
-
-        m_task_position = 0;
     }
     else
     {
         m_num_threads = 1;
         m_pool_state = eTMFailedToInit;
-        m_task_position = 0;
 
         //print error;
     }
@@ -407,12 +536,17 @@ void ThreadManager::run(const cv::Range& range, const cv::ParallelLoopBody& body
 
                 m_num_of_completed_tasks = 0;
 
-                m_task_position = 0;
-
                 m_task_complete = false;
 
                 m_work_load.set(range, body, cvCeil(nstripes));
 
+                unsigned int total = m_work_load.m_nstripes;
+
+                for(size_t i = 0; i < m_queues.size(); ++i)
+                {
+                    m_queues[i].set(unsigned(i*total/m_queues.size()), unsigned((i + 1)*total/m_queues.size()));
+                }
+
                 for(size_t i = 0; i < m_threads.size(); ++i)
                 {
                     m_threads[i].run();
@@ -472,11 +606,13 @@ bool ThreadManager::initPool()
 
     m_threads.resize(m_num_threads);
 
+    m_queues.resize(m_num_threads);
+
     bool res = true;
 
     for(size_t i = 0; i < m_threads.size(); ++i)
     {
-        res |= m_threads[i].init(i, this);
+        res &= m_threads[i].init(i, this);
     }
 
     if(res)
@@ -532,9 +668,35 @@ void ThreadManager::setNumOfThreads(size_t n)
     }
 }
 
+void ThreadManager::setThreadOptions(int priority, uint64 affinity)
+{
+    int res = pthread_mutex_lock(&m_manager_access_mutex);
+
+    if(!res)
+    {
+        if((priority != m_priority || affinity != m_affinity) && m_pool_state != eTMFailedToInit)
+        {
+            // the options are applied when a worker starts, so start them again
+            if(m_pool_state == eTMInited)
+            {
+                stop();
+                m_threads.clear();
+            }
+
+            m_priority = priority;
+            m_affinity = affinity;
+
+            m_pool_state = (m_num_threads == 1) ? eTMSingleThreaded : eTMNotInited;
+        }
+
+        pthread_mutex_unlock(&m_manager_access_mutex);
+    }
+}
+
 size_t ThreadManager::defaultNumberOfThreads()
 {
-    unsigned int result = m_default_number_of_threads;
+    // no more workers than CPUs, so that the pool leaves room for the application's threads
+    unsigned int result = std::min(m_default_number_of_threads, unsigned(std::max(cv::getNumberOfCPUs(), 1)));
 
     char * env = getenv(m_env_name);
 
@@ -552,6 +714,7 @@ size_t ThreadManager::defaultNumberOfThreads()
 void parallel_for_pthreads(const cv::Range& range, const cv::ParallelLoopBody& body, double nstripes);
 size_t parallel_pthreads_get_threads_num();
 void parallel_pthreads_set_threads_num(int num);
+void parallel_pthreads_set_thread_options(int priority, uint64 affinity);
 
 size_t parallel_pthreads_get_threads_num()
 {
@@ -570,6 +733,11 @@ void parallel_pthreads_set_threads_num(int num)
     }
 }
 
+void parallel_pthreads_set_thread_options(int priority, uint64 affinity)
+{
+    ThreadManager::instance().setThreadOptions(priority, affinity);
+}
+
 void parallel_for_pthreads(const cv::Range& range, const cv::ParallelLoopBody& body, double nstripes)
 {
     ThreadManager::instance().run(range, body, nstripes);
@@ -147,7 +147,9 @@
 #define HAVE_PTHREADS
 
 /* parallel_for with pthreads */
-/* #undef HAVE_PTHREADS_PF */
+#if defined __linux__ && !defined __MBED__
+#define HAVE_PTHREADS_PF
+#endif
 
 /* Qt support */
 /* #undef HAVE_QT */
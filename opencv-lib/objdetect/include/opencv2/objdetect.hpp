@@ -242,6 +242,24 @@ public:
     @note The file may contain a new cascade classifier (trained traincascade application) only.
      */
     CV_WRAP bool read( const FileNode& node );
+    /** @brief Loads a classifier from a precompiled binary cascade image.
+
+    @param buf Start of the image. It may point into a memory mapped file or read-only flash; the
+    stage, tree, leaf and feature arrays are taken over as laid out, without any parsing.
+    @param size Size of the image in bytes.
+    @param stamp Expected value of the stamp given to saveBinary, so that an image made from an
+    older version of the source cascade is rejected. 0 accepts any stamp.
+
+    @note Only LBP cascades in the new (traincascade) format are supported. Every count and index
+    in the image is checked, and a damaged image makes the function return false.
+     */
+    bool loadBinary( const void* buf, size_t size, uint64 stamp = 0 );
+    /** @brief Writes the loaded classifier as a binary cascade image readable by loadBinary.
+
+    @param filename Name of the file to write.
+    @param stamp Value identifying the source cascade (for example its size and modification time).
+     */
+    bool saveBinary( const String& filename, uint64 stamp = 0 ) const;
 
     /** @brief Detects objects of different sizes in the input image. The detected objects are returned as a list
     of rectangles.
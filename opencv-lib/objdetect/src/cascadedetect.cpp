@@ -804,6 +804,30 @@ bool LBPEvaluator::read( const FileNode& node, Size _origWinSize )
     return true;
 }
 
+bool LBPEvaluator::setFeatures( const Feature* f, size_t nfeatures, Size _origWinSize )
+{
+    if (!FeatureEvaluator::read(FileNode(), _origWinSize))
+        return false;
+    if(features.empty())
+        features = makePtr<std::vector<Feature> >();
+    if(optfeatures.empty())
+        optfeatures = makePtr<std::vector<OptFeature> >();
+    if (optfeatures_lbuf.empty())
+        optfeatures_lbuf = makePtr<std::vector<OptFeature> >();
+
+    features->assign(f, f + nfeatures);
+    optfeaturesPtr = 0;
+    nchannels = 1;
+    localSize = lbufSize = Size(0, 0);
+
+#ifdef HAVE_OPENCL
+    if (ocl::haveOpenCL())
+        localSize = Size(8, 8);
+#endif
+
+    return true;
+}
+
 Ptr<FeatureEvaluator> LBPEvaluator::clone() const
 {
     Ptr<LBPEvaluator> ret = makePtr<LBPEvaluator>();
@@ -1596,6 +1620,223 @@ bool CascadeClassifierImpl::read_(const FileNode& root)
     return featureEvaluator->read(fn, data.origWinSize);
 }
 
+static size_t alignBinarySection(size_t ofs)
+{
+    return (ofs + CC_BINARY_ALIGN - 1) & ~(size_t)(CC_BINARY_ALIGN - 1);
+}
+
+template<typename _Tp> static bool takeBinarySection(const uchar* buf, size_t size, size_t& ofs,
+                                                      int count, std::vector<_Tp>& vec)
+{
+    ofs = alignBinarySection(ofs);
+    if( count < 0 || ofs > size || (size_t)count > (size - ofs)/sizeof(_Tp) )
+        return false;
+    const _Tp* first = (const _Tp*)(buf + ofs);
+    vec.assign(first, first + count);
+    ofs += (size_t)count*sizeof(_Tp);
+    return true;
+}
+
+template<typename _Tp> static void putBinarySection(FILE* f, size_t& ofs, const std::vector<_Tp>& vec)
+{
+    static const char zeros[CC_BINARY_ALIGN] = { 0 };
+    size_t aligned = alignBinarySection(ofs);
+    fwrite(zeros, 1, aligned - ofs, f);
+    if( !vec.empty() )
+        fwrite(&vec[0], sizeof(_Tp), vec.size(), f);
+    ofs = aligned + vec.size()*sizeof(_Tp);
+}
+
+bool CascadeClassifierImpl::Data::check(int nfeatures) const
+{
+    // LBP codes are 8 bits, so a node's category subset has to cover 256 values
+    int subsetSize = (ncategories + 31)/32;
+    if( stageType != BOOST || featureType != FeatureEvaluator::LBP || subsetSize*32 < 256 )
+        return false;
+
+    // stages take the trees in order
+    size_t ntrees = 0;
+    for( size_t si = 0; si < stages.size(); si++ )
+    {
+        if( stages[si].first != (int)ntrees || stages[si].ntrees <= 0 ||
+            (size_t)stages[si].ntrees > classifiers.size() - ntrees )
+            return false;
+        ntrees += stages[si].ntrees;
+    }
+    if( ntrees != classifiers.size() )
+        return false;
+
+    // children are stored after their parent, leaves are -0..-nodeCount
+    size_t nodeOfs = 0, leafOfs = 0;
+    int minNodes = INT_MAX, maxNodes = 0;
+    for( size_t wi = 0; wi < classifiers.size(); wi++ )
+    {
+        int nodeCount = classifiers[wi].nodeCount;
+        if( nodeCount <= 0 || (size_t)nodeCount > nodes.size() - nodeOfs )
+            return false;
+        for( int i = 0; i < nodeCount; i++ )
+        {
+            const DTreeNode& node = nodes[nodeOfs + i];
+            if( node.featureIdx < 0 || node.featureIdx >= nfeatures ||
+                (node.left > 0 ? (node.left <= i || node.left >= nodeCount) : -node.left > nodeCount) ||
+                (node.right > 0 ? (node.right <= i || node.right >= nodeCount) : -node.right > nodeCount) )
+                return false;
+        }
+        nodeOfs += nodeCount;
+        leafOfs += nodeCount + 1;
+        minNodes = std::min(minNodes, nodeCount);
+        maxNodes = std::max(maxNodes, nodeCount);
+    }
+    if( nodeOfs != nodes.size() || leafOfs != leaves.size() ||
+        subsets.size() != nodes.size()*subsetSize ||
+        minNodes != minNodesPerTree || maxNodes != maxNodesPerTree )
+        return false;
+
+    // stumps replace the single-node trees one for one
+    if( stumps.size() != (maxNodesPerTree == 1 ? classifiers.size() : 0) )
+        return false;
+    for( size_t i = 0; i < stumps.size(); i++ )
+    {
+        if( stumps[i].featureIdx < 0 || stumps[i].featureIdx >= nfeatures )
+            return false;
+    }
+    return true;
+}
+
+// an LBP feature reads 3x3 blocks that have to lie inside the window
+static bool checkBinaryFeatures(const std::vector<LBPEvaluator::Feature>& features, Size winSize)
+{
+    for( size_t i = 0; i < features.size(); i++ )
+    {
+        const Rect& r = features[i].rect;
+        if( r.x < 0 || r.y < 0 || r.width <= 0 || r.height <= 0 ||
+            r.width > winSize.width/3 || r.height > winSize.height/3 ||
+            r.x > winSize.width - r.width*3 || r.y > winSize.height - r.height*3 )
+            return false;
+    }
+    return true;
+}
+
+bool CascadeClassifierImpl::loadBinary( const uchar* buf, size_t size, uint64 stamp )
+{
+    oldCascade.release();
+    data = Data();
+    featureEvaluator.release();
+#ifdef HAVE_OPENCL
+    tryOpenCL = true;
+    haarKernel = ocl::Kernel();
+    lbpKernel = ocl::Kernel();
+#endif
+    ustages.release();
+    unodes.release();
+    uleaves.release();
+
+    if( buf == 0 || size < sizeof(CascadeBinaryHeader) )
+        return false;
+
+    CascadeBinaryHeader hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+    if( memcmp(hdr.magic, CC_BINARY_MAGIC, 4) != 0 || hdr.version != CC_BINARY_VERSION ||
+        hdr.headerSize != (int)sizeof(hdr) || hdr.totalSize < 0 || (size_t)hdr.totalSize > size ||
+        (stamp != 0 && hdr.stamp != stamp) )
+        return false;
+    if( hdr.stageType != BOOST || hdr.featureType != FeatureEvaluator::LBP ||
+        hdr.winWidth <= 0 || hdr.winHeight <= 0 || hdr.nstages <= 0 )
+        return false;
+
+    data.stageType = hdr.stageType;
+    data.featureType = hdr.featureType;
+    data.ncategories = hdr.ncategories;
+    data.minNodesPerTree = hdr.minNodesPerTree;
+    data.maxNodesPerTree = hdr.maxNodesPerTree;
+    data.origWinSize = Size(hdr.winWidth, hdr.winHeight);
+
+    size_t ofs = sizeof(hdr);
+    std::vector<LBPEvaluator::Feature> features;
+    if( !takeBinarySection(buf, size, ofs, hdr.nstages, data.stages) ||
+        !takeBinarySection(buf, size, ofs, hdr.nclassifiers, data.classifiers) ||
+        !takeBinarySection(buf, size, ofs, hdr.nnodes, data.nodes) ||
+        !takeBinarySection(buf, size, ofs, hdr.nleaves, data.leaves) ||
+        !takeBinarySection(buf, size, ofs, hdr.nsubsets, data.subsets) ||
+        !takeBinarySection(buf, size, ofs, hdr.nstumps, data.stumps) ||
+        !takeBinarySection(buf, size, ofs, hdr.nfeatures, features) ||
+        !data.check((int)features.size()) || !checkBinaryFeatures(features, data.origWinSize) )
+    {
+        data = Data();
+        return false;
+    }
+
+    Ptr<LBPEvaluator> lbp = makePtr<LBPEvaluator>();
+    if( !lbp->setFeatures(features.empty() ? 0 : &features[0], features.size(), data.origWinSize) )
+    {
+        data = Data();
+        return false;
+    }
+    featureEvaluator = lbp.staticCast<FeatureEvaluator>();
+    return true;
+}
+
+bool CascadeClassifierImpl::saveBinary( const String& filename, uint64 stamp ) const
+{
+    if( oldCascade || data.stages.empty() || data.featureType != FeatureEvaluator::LBP ||
+        featureEvaluator.empty() )
+        return false;
+
+    const std::vector<LBPEvaluator::Feature>& features =
+        ((const LBPEvaluator*)featureEvaluator.get())->getFeatures();
+
+    CascadeBinaryHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CC_BINARY_MAGIC, 4);
+    hdr.version = CC_BINARY_VERSION;
+    hdr.headerSize = (int)sizeof(hdr);
+    hdr.stageType = data.stageType;
+    hdr.featureType = data.featureType;
+    hdr.ncategories = data.ncategories;
+    hdr.minNodesPerTree = data.minNodesPerTree;
+    hdr.maxNodesPerTree = data.maxNodesPerTree;
+    hdr.winWidth = data.origWinSize.width;
+    hdr.winHeight = data.origWinSize.height;
+    hdr.nstages = (int)data.stages.size();
+    hdr.nclassifiers = (int)data.classifiers.size();
+    hdr.nnodes = (int)data.nodes.size();
+    hdr.nleaves = (int)data.leaves.size();
+    hdr.nsubsets = (int)data.subsets.size();
+    hdr.nstumps = (int)data.stumps.size();
+    hdr.nfeatures = (int)features.size();
+    hdr.stamp = stamp;
+
+    size_t total = sizeof(hdr);
+    total = alignBinarySection(total) + data.stages.size()*sizeof(Data::Stage);
+    total = alignBinarySection(total) + data.classifiers.size()*sizeof(Data::DTree);
+    total = alignBinarySection(total) + data.nodes.size()*sizeof(Data::DTreeNode);
+    total = alignBinarySection(total) + data.leaves.size()*sizeof(float);
+    total = alignBinarySection(total) + data.subsets.size()*sizeof(int);
+    total = alignBinarySection(total) + data.stumps.size()*sizeof(Data::Stump);
+    total = alignBinarySection(total) + features.size()*sizeof(LBPEvaluator::Feature);
+    hdr.totalSize = (int)total;
+
+    FILE* f = fopen(filename.c_str(), "wb");
+    if( !f )
+        return false;
+
+    size_t ofs = sizeof(hdr);
+    fwrite(&hdr, sizeof(hdr), 1, f);
+    putBinarySection(f, ofs, data.stages);
+    putBinarySection(f, ofs, data.classifiers);
+    putBinarySection(f, ofs, data.nodes);
+    putBinarySection(f, ofs, data.leaves);
+    putBinarySection(f, ofs, data.subsets);
+    putBinarySection(f, ofs, data.stumps);
+    putBinarySection(f, ofs, features);
+
+    bool ok = ferror(f) == 0 && ofs == total;
+    fclose(f);
+    if( !ok )
+        remove(filename.c_str());
+    return ok;
+}
+
 template<> void DefaultDeleter<CvHaarClassifierCascade>::operator ()(CvHaarClassifierCascade* obj) const
 { cvReleaseHaarClassifierCascade(&obj); }
 
@@ -1638,6 +1879,24 @@ bool CascadeClassifier::read(const FileNode &root)
     return ok;
 }
 
+bool CascadeClassifier::loadBinary( const void* buf, size_t size, uint64 stamp )
+{
+    Ptr<CascadeClassifierImpl> ccimpl = makePtr<CascadeClassifierImpl>();
+    bool ok = ccimpl->loadBinary((const uchar*)buf, size, stamp);
+    if( ok )
+        cc = ccimpl.staticCast<BaseCascadeClassifier>();
+    else
+        cc.release();
+    return ok;
+}
+
+bool CascadeClassifier::saveBinary( const String& filename, uint64 stamp ) const
+{
+    if( empty() )
+        return false;
+    return ((const CascadeClassifierImpl*)cc.get())->saveBinary(filename, stamp);
+}
+
 void clipObjects(Size sz, std::vector<Rect>& objects,
                  std::vector<int>* a, std::vector<double>* b)
 {
@@ -84,6 +84,8 @@ public:
     bool load( const String& filename );
     void read( const FileNode& node );
     bool read_( const FileNode& node );
+    bool loadBinary( const uchar* buf, size_t size, uint64 stamp );
+    bool saveBinary( const String& filename, uint64 stamp ) const;
     void detectMultiScale( InputArray image,
                           CV_OUT std::vector<Rect>& objects,
                           double scaleFactor = 1.1,
@@ -197,6 +199,8 @@ protected:
         Data();
 
         bool read(const FileNode &node);
+        // checks that every count and index stays inside the arrays (for loadBinary)
+        bool check(int nfeatures) const;
 
         int stageType;
         int featureType;
@@ -258,6 +262,39 @@ protected:
 
 #define CC_HOG  "HOG"
 
+//----------------------------------------------  Binary cascade -----------------------------------
+// Flat little-endian image of CascadeClassifierImpl::Data and the LBP features.
+// Sections follow the header in the order stages, classifiers, nodes, leaves,
+// subsets, stumps, features; each section starts on an 8-byte boundary and
+// holds the elements exactly as the evaluator stores them in memory.
+
+#define CC_BINARY_MAGIC   "OCCB"
+#define CC_BINARY_VERSION 2
+#define CC_BINARY_ALIGN   8
+
+struct CascadeBinaryHeader
+{
+    char magic[4];
+    int version;
+    int headerSize;
+    int stageType;
+    int featureType;
+    int ncategories;
+    int minNodesPerTree;
+    int maxNodesPerTree;
+    int winWidth;
+    int winHeight;
+    int nstages;
+    int nclassifiers;
+    int nnodes;
+    int nleaves;
+    int nsubsets;
+    int nstumps;
+    int nfeatures;
+    int totalSize;
+    uint64 stamp;       // identifies the source cascade, given by the caller
+};
+
 #define CV_SUM_PTRS( p0, p1, p2, p3, sum, rect, step )                    \
     /* (x, y) */                                                          \
     (p0) = sum + (rect).x + (step) * (rect).y,                            \
@@ -435,6 +472,8 @@ public:
     virtual ~LBPEvaluator();
 
     virtual bool read( const FileNode& node, Size origWinSize );
+    bool setFeatures( const Feature* f, size_t nfeatures, Size origWinSize );
+    const std::vector<Feature>& getFeatures() const { return *features; }
     virtual Ptr<FeatureEvaluator> clone() const;
     virtual int getFeatureType() const { return FeatureEvaluator::LBP; }
 